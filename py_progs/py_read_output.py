@@ -437,3 +437,93 @@ def read_convergence (root ):
     final_conv = conv_fraction [-1]
     return final_conv
 		
+
+
+def read_wind_table (filename):
+
+    '''
+    Read a binary table written by windsave2table -bin, e.g. root.table.bin
+
+    Returns a dictionary containing the header, with keys such as
+    ndom, coord_type, ndim, mdim and ncells, and a dictionary, columns,
+    containing the values of each column as a numpy array with one
+    element per cell.
+    '''
+
+    if not filename.endswith(".bin"):
+        filename = filename + ".table.bin"
+
+    header_names = ["format", "byte_order", "ndom", "coord_type", "ndim", "mdim", "ncells", "ncols"]
+
+    with open(filename, 'rb') as f:
+        magic = f.read(16).split(b'\0')[0].decode()
+        if magic != "sirocco_table":
+            raise ValueError("%s is not a table written by windsave2table" % filename)
+
+        # the file is written in the byte order of the machine which wrote it
+        values = np.fromfile(f, dtype='<i4', count=len(header_names))
+        endian = '<'
+        if values[1] != 0x01020304:
+            values = values.byteswap()
+            endian = '>'
+        table = dict(zip(header_names, [int(v) for v in values]))
+
+        names = np.fromfile(f, dtype='S32', count=table["ncols"])
+        data = np.fromfile(f, dtype=endian + 'f8', count=table["ncols"] * table["ncells"])
+
+    data = data.reshape(table["ncols"], table["ncells"])
+    table["columns"] = dict((name.decode(), data[i]) for i, name in enumerate(names))
+
+    return table
+
+
+def read_cycle_stream (filename):
+
+    '''
+    Read the per-cycle diagnostics written when Diag.save_cycle_stream
+    is yes, e.g. root.cycles.bin
+
+    Returns a dictionary containing the header, a list describing
+    each domain (nstart, ndim2, coord_type, ndim, mdim), the cycle and
+    elapsed time of each record, and a dictionary, columns, containing
+    the values of each column as a numpy array of shape (number of
+    records, number of cells).  An incomplete record at the end of the
+    file, for example from a run which is still going, is ignored.
+    '''
+
+    if not filename.endswith(".bin"):
+        filename = filename + ".cycles.bin"
+
+    header_names = ["format", "byte_order", "ndomain", "ncells", "ncols", "spare"]
+
+    with open(filename, 'rb') as f:
+        magic = f.read(16).split(b'\0')[0].decode()
+        if magic != "sirocco_cycles":
+            raise ValueError("%s is not a cycle stream written by sirocco" % filename)
+
+        # the file is written in the byte order of the machine which wrote it
+        values = np.fromfile(f, dtype='<i4', count=len(header_names))
+        endian = '<'
+        if values[1] != 0x01020304:
+            values = values.byteswap()
+            endian = '>'
+        stream = dict(zip(header_names, [int(v) for v in values]))
+        stream["record_size"] = int(np.fromfile(f, dtype=endian + 'i8', count=1)[0])
+
+        domains = np.fromfile(f, dtype=endian + 'i4', count=5 * stream["ndomain"])
+        stream["domains"] = domains.reshape(stream["ndomain"], 5)
+        names = [name.decode() for name in np.fromfile(f, dtype='S32', count=stream["ncols"])]
+
+        record = np.dtype([("cycle", endian + 'i4'), ("ncols", endian + 'i4'), ("time", endian + 'f8'),
+                           ("data", endian + 'f8', (stream["ncols"], stream["ncells"]))])
+        start = f.tell()
+        f.seek(0, 2)
+        nrecords = (f.tell() - start) // record.itemsize
+        f.seek(start)
+        records = np.fromfile(f, dtype=record, count=nrecords)
+
+    stream["cycle"] = records["cycle"]
+    stream["time"] = records["time"]
+    stream["columns"] = dict((name, records["data"][:, i, :]) for i, name in enumerate(names))
+
+    return stream
@@ -4,6 +4,7 @@
    require the atomic data, but do need various physical constants */
 
 #include "constants.h"
+#include "threads.h"
 
 /* The next term attempts to globally define a minimum density to prevent zero divides in some routines */
 #define DENSITY_MIN		1.e-20
@@ -25,7 +26,8 @@
 extern int nelements;                  /**< The actual number of ions read from the data file */
 #define NIONS		500     /**< Maximum number of ions to consider */
 extern int nions;                      /**< The actual number of ions read from the datafile */
-#define NLEVELS 	12000   /**<  Maximum number of levels for all elements and ions */
+#define NLEVELS 	12000   /**<  Maximum number of levels for all elements and ions.  The arrays are
+                                   allocated for the number actually read */
 extern int nlevels;                    /**< These are the actual number of levels which were read in */
 #define NLTE_LEVELS	12000   /**<  Maximum number of levels to treat explicitly */
 extern int nlte_levels;                /**<  Actual number of levels to treat explicityly */
@@ -34,7 +36,9 @@ extern int nlte_levels;                /**<  Actual number of levels to treat ex
 /* AUGER NOTE: recommended to increase NLEVELS_MACRO to at least 500 for Auger macro-atoms */
 #define NLEVELS_MACRO   600     /**<  Maximum number of macro atom levels. (SS, June 04) */
 extern int nlevels_macro;              /**<  Actual number of macro atom levels. (SS, June 04) */
-#define NLINES 		200000  /**<  Maximum number of lines to be read */
+#define NLINES 		2000000 /**<  Maximum number of lines to be read.  The line arrays are allocated
+                                   for the number actually read, but nres values above NLINES denote
+                                   bound-free processes */
 extern int nlines;                     /**<  Actual number of lines that were read in */
 extern int nlines_macro;               /**<  Actual number of Macro Atom lines that were read in.  New version of get_atomic
                                    data assumes that macro lines are read in before non-macro lines */
@@ -250,7 +254,6 @@ typedef struct lines
   double f;                     /**< oscillator strength.  Note: it might be better to keep PI_E2_OVER_MEC flambda times this.
                                    Could do that by initializing */
   double el, eu;                /**<  The energy of the lower and upper levels for the transition */
-  double pow;                   /**< The power in the lines as last calculated in total_line_emission */
   int where_in_list;            /**<  Position of line in the line list: i.e. lin_ptr[line[n].where_in_list] points
                                    to the line. Added by SS for use in macro atom method. */
   int down_index;               /**<  This is to map from the line to knowing which macro atom jump it is (and therefore find
@@ -264,13 +267,15 @@ typedef struct lines
 line_dummy, *LinePtr;
 
 
-extern LinePtr line, lin_ptr[NLINES];  /**<  line[] is the actual structure array that contains all the data, *lin_ptr
+extern LinePtr line, *lin_ptr;  /**<  line[] is the actual structure array that contains all the data, *lin_ptr
                                    is an array which contains a frequency ordered set of ptrs to line */
                                 /**<  fast_line (added by SS August 05) is going to be a hypothetical
                                    rapid transition used in the macro atoms to stabilise level populations */
 extern struct lines fast_line;
+extern double *lin_pow;         /**<  The power in each line, in the order of lin_ptr, as last calculated in lum_lines.
+                                   This is kept apart from line[] so that line[] is never changed once it has been read */
 
-extern int nline_min, nline_max, nline_delt;   /**<  Used to select a range of lines in a frequency band from the lin_ptr array 
+extern THREAD_LOCAL int nline_min, nline_max, nline_delt;   /**<  Used to select a range of lines in a frequency band from the lin_ptr array 
                                            in situations where the frequency range of interest is limited, including for defining which
                                            lines come into play for resonant scattering along a line of sight, and in
                                            calculating band_limit luminosities.  The limits are established by the
@@ -310,7 +315,7 @@ typedef struct coll_stren
                                           */
 } Coll_stren, *Coll_strenptr;
 
-extern Coll_stren coll_stren[NLINES];
+extern Coll_stren *coll_stren;
 
 
 
@@ -368,11 +373,11 @@ typedef struct topbase_phot
   double f, log_f, sigma, log_sigma;            /**< last freq, last x-section and log versions*/
 } Topbase_phot, *TopPhotPtr;
 
-extern Topbase_phot phot_top[NLEVELS];
-extern TopPhotPtr phot_top_ptr[NLEVELS];       /**<  Pointers to phot_top in threshold frequency order - this */
+extern Topbase_phot *phot_top;
+extern TopPhotPtr *phot_top_ptr;       /**<  Pointers to phot_top in threshold frequency order - this */
 
-extern Topbase_phot inner_cross[N_INNER * NIONS];  /**< Pointer to inner shell cross sections which use the same structure type */
-extern TopPhotPtr inner_cross_ptr[N_INNER * NIONS];  /**< Pointer to inner shell cross sections in frequency order */
+extern Topbase_phot *inner_cross;      /**< Inner shell cross sections, which use the same structure type */
+extern TopPhotPtr *inner_cross_ptr;  /**< Pointer to inner shell cross sections in frequency order */
 
 
 
@@ -387,7 +392,7 @@ typedef struct inner_elec_yield
   double Ea;                    /**< Average electron energy */
 } Inner_elec_yield, Inner_elec_yieldPtr;
 
-extern Inner_elec_yield inner_elec_yield[N_INNER * NIONS];
+extern Inner_elec_yield *inner_elec_yield;
 
 /** This structure for the flourescent photon yield following inner shell ionization from Kaastra and Mewe*/
 typedef struct inner_fluor_yield
@@ -441,7 +446,7 @@ typedef struct dielectronic_recombination
 
 extern Drecomb drecomb[NIONS];  //set up the actual structure
 
-extern double dr_coeffs[NIONS]; //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. We may want to make this 2D and store the coefficients for a range of temperatures to interpolate.
+extern THREAD_LOCAL double dr_coeffs[NIONS]; //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. We may want to make this 2D and store the coefficients for a range of temperatures to interpolate.
 
 
 #define T_RR_PARAMS         6   //This is the number of parameters.
@@ -490,8 +495,8 @@ typedef struct dere_di_rate
 
 extern Dere_di_rate dere_di_rate[NIONS];        //Set up the structure
 
-extern double di_coeffs[NIONS]; //This is an array to store the di_coeffs 
-extern double qrecomb_coeffs[NIONS];    //JM 1508 analogous array for three body recombination 
+extern THREAD_LOCAL double di_coeffs[NIONS]; //This is an array to store the di_coeffs 
+extern THREAD_LOCAL double qrecomb_coeffs[NIONS];    //JM 1508 analogous array for three body recombination 
 
 #define MAX_GAUNT_N_GSQRD 100   //Space set aside for the number of parameters for scaled inverse temperature
 
@@ -526,12 +531,21 @@ typedef struct charge_exchange
 
 extern Charge_exchange charge_exchange[MAX_CHARGE_EXCHANGE];    //Set up the structure
 
-extern double charge_exchange_recomb_rates[NIONS];      //An array to store the actual recombination rates for a given temperature - 
+extern THREAD_LOCAL double charge_exchange_recomb_rates[NIONS];      //An array to store the actual recombination rates for a given temperature - 
 //there is an estimated rate for ions without an actual rate, so we need to dimneions for ions.
-extern double charge_exchange_ioniz_rates[MAX_CHARGE_EXCHANGE]; //An array to store the actual ionization rates for a given temperature
+extern THREAD_LOCAL double charge_exchange_ioniz_rates[MAX_CHARGE_EXCHANGE]; //An array to store the actual ionization rates for a given temperature
 
 
 
 /* a variable which controls whether to save a summary of atomic data
    this is defined in atomic.h, rather than the modes structure */
 extern int write_atomicdata;
+
+/* a variable which controls whether the atomic data is read from, and saved
+   in, a binary cache alongside the masterfile, see atomicdata_cache.c */
+extern int atomic_cache;
+
+/* a variable which is TRUE when line, phot_top, coll_stren, inner_cross and
+   inner_elec_yield are in memory shared by the processes on a node, rather
+   than allocated by init_atomic_data, see communicate_atomic.c */
+extern int atomic_data_shared;
@@ -24,11 +24,12 @@ ConfigPtr xconfig;
 
 AugerPtr auger_macro;
 
-LinePtr line, lin_ptr[NLINES];  /* line[] is the actual structure array that contains all the data, *lin_ptr
+LinePtr line, *lin_ptr;  /* line[] is the actual structure array that contains all the data, *lin_ptr
                                    is an array which contains a frequency ordered set of ptrs to line */
 struct lines fast_line;
+double *lin_pow;                /* The power in each line, in the order of lin_ptr, as last calculated in lum_lines */
 
-int nline_min, nline_max, nline_delt;   /* Used to select a range of lines in a frequency band from the lin_ptr array 
+THREAD_LOCAL int nline_min, nline_max, nline_delt;   /* Used to select a range of lines in a frequency band from the lin_ptr array 
                                            in situations where the frequency range of interest is limited, including for defining which
                                            lines come into play for resonant scattering along a line of sight, and in
                                            calculating band_limit luminosities.  The limits are established by the
@@ -37,7 +38,7 @@ int nline_min, nline_max, nline_delt;   /* Used to select a range of lines in a
 
 int n_coll_stren;
 
-Coll_stren coll_stren[NLINES];
+Coll_stren *coll_stren;
 
 int nxphot;                     /*The actual number of ions for which there are VFKY photoionization x-sections */
 double phot_freq_min;           /*The lowest frequency for which photoionization can occur */
@@ -46,13 +47,13 @@ double inner_freq_min;          /*The lowest frequency for which inner shell ion
 int ntop_phot;                  /* The actual number of TopBase photoionzation x-sections */
 int nphot_total;                /* total number of photoionzation x-sections = nxphot + ntop_phot */
 
-Topbase_phot phot_top[NLEVELS];
-TopPhotPtr phot_top_ptr[NLEVELS];       /* Pointers to phot_top in threshold frequency order - this */
+Topbase_phot *phot_top;
+TopPhotPtr *phot_top_ptr;       /* Pointers to phot_top in threshold frequency order - this */
 
-Topbase_phot inner_cross[N_INNER * NIONS];
-TopPhotPtr inner_cross_ptr[N_INNER * NIONS];
+Topbase_phot *inner_cross;
+TopPhotPtr *inner_cross_ptr;
 
-Inner_elec_yield inner_elec_yield[N_INNER * NIONS];
+Inner_elec_yield *inner_elec_yield;
 
 Inner_fluor_yield inner_fluor_yield[N_INNER * NIONS];
 
@@ -62,7 +63,7 @@ int ndrecomb;                   //This is the actual number of DR parameters
 
 Drecomb drecomb[NIONS];         //set up the actual structure
 
-double dr_coeffs[NIONS];        //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. We may want to make this 2D and store the coefficients for a range of temperatures to interpolate.
+THREAD_LOCAL double dr_coeffs[NIONS];        //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. We may want to make this 2D and store the coefficients for a range of temperatures to interpolate.
 
 int n_total_rr;
 
@@ -76,8 +77,8 @@ int n_dere_di_rate;
 
 Dere_di_rate dere_di_rate[NIONS];       //Set up the structure
 
-double di_coeffs[NIONS];        //This is an array to store the di_coeffs 
-double qrecomb_coeffs[NIONS];   //JM 1508 analogous array for three body recombination 
+THREAD_LOCAL double di_coeffs[NIONS];        //This is an array to store the di_coeffs 
+THREAD_LOCAL double qrecomb_coeffs[NIONS];   //JM 1508 analogous array for three body recombination 
 
 int gaunt_n_gsqrd;              //The actual number of scaled temperatures
 
@@ -87,7 +88,11 @@ int n_charge_exchange;          //The actual number of scaled temperatures
 
 Charge_exchange charge_exchange[MAX_CHARGE_EXCHANGE];   //Set up the structure
 
-double charge_exchange_recomb_rates[NIONS];     //An array to store the actual recombination rates for a given temperature - 
-double charge_exchange_ioniz_rates[MAX_CHARGE_EXCHANGE];        //An array to store the actual ionization rates for a given temperature
+THREAD_LOCAL double charge_exchange_recomb_rates[NIONS];     //An array to store the actual recombination rates for a given temperature - 
+THREAD_LOCAL double charge_exchange_ioniz_rates[MAX_CHARGE_EXCHANGE];        //An array to store the actual ionization rates for a given temperature
 
 int write_atomicdata;
+
+int atomic_cache = 1;           /* Use the binary cache of the atomic data unless --no-atomic-cache is given */
+
+int atomic_data_shared = 0;     /* The largest arrays of atomic data are in memory shared between processes */
@@ -1,5 +1,6 @@
 /* atomicdata.c */
 int get_atomic_data(char masterfile[]);
+int read_atomic_data(char masterfile[]);
 /* atomicdata_sub.c */
 int atomicdata2file(void);
 int index_lines(void);
@@ -8,6 +9,7 @@ int index_inner_cross(void);
 void indexx(int n, float arrin[], int indx[]);
 int limit_lines(double freqmin, double freqmax);
 int check_xsections(void);
+int check_phot_info(void);
 double q21(struct lines *line_ptr, double t);
 double q12(struct lines *line_ptr, double t);
 double a21(struct lines *line_ptr);
@@ -15,3 +17,10 @@ double upsilon(int n_coll, double u0);
 void skiplines(FILE *fptr, int nskip);
 /* atomicdata_init.c */
 int init_atomic_data(void);
+int atomic_data_reserve(int nline, int nlevel, int nphot, int ninner);
+int atomic_data_resize(int nline, int nlevel, int nphot, int ninner);
+/* atomicdata_cache.c */
+char *atomic_cache_pack(size_t *nbytes);
+int atomic_cache_unpack(char *image, int shared);
+int atomic_cache_read(char masterfile[]);
+int atomic_cache_write(char masterfile[]);
@@ -34,6 +34,35 @@
 
 
 
+/**********************************************************/
+/**
+ * @brief      get the atomic data for a run
+ *
+ * @param [in] char  masterfile[]   The name of the "masterfile" which refers to other files which contain the data
+ * @return     Always returns 0
+ *
+ * @details
+ * Normally every process reads the atomic data itself, with read_atomic_data.
+ * In parallel runs with the --shared-atomic switch, the data is instead read
+ * by one process, and the largest arrays are shared by all the processes on
+ * each node (see share_atomic_data).
+ *
+ **********************************************************/
+
+int
+get_atomic_data (masterfile)
+     char masterfile[];
+{
+#ifdef MPI_ON
+  if (modes.shared_atomic && np_mpi_global > 1)
+    return (share_atomic_data (masterfile));
+#endif
+
+  return (read_atomic_data (masterfile));
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      generalized subroutine for reading atomic data
@@ -45,7 +74,7 @@
  *
  * @details
  *
- * get_atomic_data reads in all the atomic data.  It also converts the data to cgs units unless
+ * read_atomic_data reads in all the atomic data.  It also converts the data to cgs units unless
  * 	otherwise noted, e.g ionization potentials are converted to ergs.
  *
  *
@@ -94,7 +123,7 @@
  **********************************************************/
 
 int
-get_atomic_data (masterfile)
+read_atomic_data (masterfile)
      char masterfile[];
 {
   FILE *fptr, *mptr;
@@ -162,9 +191,39 @@ get_atomic_data (masterfile)
   int z2, istate2;
   double delta_E_ovr_k;
   int ierr;
+  int nphot;                    //The number of photoionization records for which space is needed
   double dlambda;
 
 
+  /* If the data has been saved in a binary cache, and none of the files have changed since,
+     then read that instead of the ascii files */
+
+  if (atomic_cache_read (masterfile) == 0)
+  {
+    ierr = 0;
+    if (geo.ioniz_mode > 4)
+      ierr = check_phot_info ();
+
+#ifdef MPI_ON
+    if (rank_global == 0)
+    {
+#endif
+      if (write_atomicdata || ierr)
+        atomicdata2file ();
+#ifdef MPI_ON
+    }
+#endif
+
+    if (ierr)
+    {
+      Error ("atomicdata: Exiting because of inconsistencies in atomic data\n");
+      Exit (0);
+    }
+
+    check_xsections ();
+    return (0);
+  }
+
   /* Initialize the atomic data structures and various counters */
   init_atomic_data ();
 
@@ -236,6 +295,12 @@ structure does not have this property! */
       {
         lineno++;
 
+        /* Make sure there is space for one more of each type of record, since
+           no line of the file adds more than this */
+
+        nphot = ntop_phot + nxphot > nphot_total ? ntop_phot + nxphot : nphot_total;
+        atomic_data_reserve (nlines + 1, nlevels + 1, nphot + 1, n_inner_tot + 1);
+
         Debug ("0  %d %s", lineno, aline);
 
         strcpy (word, "");      /*For reasons which are not clear, word needs to be reinitialized every time to
@@ -2599,6 +2664,12 @@ SCUPS    1.132e-01   2.708e-01   5.017e-01   8.519e-01   1.478e+00
  */
 
   fclose (mptr);
+
+/* Release the space which was reserved for records which were never read */
+
+  nphot = ntop_phot + nxphot > nphot_total ? ntop_phot + nxphot : nphot_total;
+  atomic_data_resize (nlines, nlevels, nphot, n_inner_tot);
+
 /* OK now summarize the data that has been read*/
 
   n_elec_yield_tot = 0;         //Reset this numnber, we are now going to use it to check we have yields for all inner shells
@@ -2778,17 +2849,8 @@ or zero so that simple checks of true and false can be used for them */
 
   if (geo.ioniz_mode > 4)       //Only do this check if we are requiring an ionization mode that needs PI rates
   {
-    for (n = 0; n < nions; n++)
-    {
-      if (ion[n].phot_info < 0 && ion[n].istate != ion[n].z + 1)
-      {
-        Error
-          ("There is no PI rate associated with ion %d (element %d ion %d) - add PI rates and check that uppper level/ion is included in level population\n",
-           n, ion[n].z, ion[n].istate);
-        Error ("Also check masterfile to see that PI files appear after all of the level files for this atom\n");
-        ierr = 1;
-      }
-    }
+    if (check_phot_info ())
+      ierr = 1;
   }
 
 
@@ -2896,5 +2958,11 @@ or zero so that simple checks of true and false can be used for them */
 
   check_xsections ();           // debug routine, only prints if verbosity > 4
 
+  /* Save the data, so that it can be read more quickly next time */
+#ifdef MPI_ON
+  if (rank_global == 0)
+#endif
+    atomic_cache_write (masterfile);
+
   return (0);
 }
@@ -0,0 +1,613 @@
+/***********************************************************/
+/** @file  atomicdata_cache.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Save the atomic data in a binary file, from which it can be
+ * read much more quickly than from the ascii data files
+ *
+ * Reading the atomic data with get_atomic_data involves parsing many
+ * files, which for the larger data sets takes tens of seconds, and
+ * every process of a parallel run does this independently.
+ *
+ * So, once get_atomic_data has read and indexed the data, a copy of the
+ * structures in atomic.h is written to a binary file alongside the
+ * masterfile, e.g. data/standard80.dat.cache.  On subsequent runs
+ * get_atomic_data reads this instead, if it is valid.
+ *
+ * The file begins with a header, atomic_cache_header, which records a key
+ * and a checksum.  The key is a hash of the name, size and modification
+ * time of the masterfile and of each of the files it lists, and of the
+ * layout of the structures in atomic.h.  If any of these change, the key
+ * will not match, and the file is rewritten from the ascii data.  The checksum
+ * is of the data in the sections which follow the header, and guards against
+ * files which are truncated or corrupted.
+ *
+ * The header is followed by the sections listed in atomic_cache_section_enum,
+ * each aligned to ATOMIC_CACHE_ALIGN bytes, and each a copy of the filled
+ * part of one of the arrays in atomic.h.  The arrays of pointers which
+ * order the lines and photoionization cross sections by frequency are
+ * stored as indices.  Since the file contains the arrays as they are in
+ * memory, it is read by mapping it into memory, so that processes on the
+ * same node share the pages of a single copy.
+ *
+ * The same layout is used when the atomic data is shared between the
+ * processes on a node, see communicate_atomic.c.
+ *
+ * The file is written to a temporary file which is then renamed, so a
+ * process will never see a partially written file.  If the cache cannot
+ * be written, e.g. because the data directory is not writable, or
+ * it cannot be read, the data is simply read from the ascii files.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "atomic.h"
+#include "log.h"
+// If routines are added cproto > atomic_proto.h should be run
+#include "atomic_proto.h"
+
+#define ATOMIC_CACHE_MAGIC    "SIRATOM1"
+#define ATOMIC_CACHE_VERSION  1
+#define ATOMIC_CACHE_ALIGN    64        /* The alignment, in bytes, of each section of the file */
+#define ATOMIC_CACHE_LINE     500       /* The longest line in the masterfile */
+
+/** The sections of the cache, one for each array in atomic.h which is filled by get_atomic_data */
+enum atomic_cache_section_enum
+{ AC_ELE = 0, AC_ION, AC_XCONFIG, AC_AUGER_MACRO, AC_LINE, AC_LIN_PTR, AC_COLL_STREN, AC_PHOT_TOP,
+  AC_PHOT_TOP_PTR, AC_INNER_CROSS, AC_INNER_CROSS_PTR, AC_INNER_ELEC_YIELD, AC_GROUND_FRAC, AC_DRECOMB,
+  AC_TOTAL_RR, AC_BAD_GS_RR, AC_DERE_DI_RATE, AC_GAUNT_TOTAL, AC_CHARGE_EXCHANGE, NATOMIC_CACHE_SECTION
+};
+
+/** The counters in atomic.h, which are saved in the header */
+static int *atomic_cache_ints[] = {
+  &nelements, &nions, &nlevels, &nlte_levels, &nlevels_macro, &nlines, &nlines_macro, &n_inner_tot,
+  &nauger, &nauger_macro, &n_coll_stren, &nxphot, &ntop_phot, &nphot_total, &ndrecomb, &n_total_rr,
+  &n_bad_gs_rr, &n_dere_di_rate, &gaunt_n_gsqrd, &n_charge_exchange
+};
+
+#define NATOMIC_CACHE_INTS  ((int) (sizeof (atomic_cache_ints) / sizeof (int *)))
+
+typedef struct atomic_cache_header
+{
+  char magic[8];
+  int version;
+  int nsection;
+  uint64_t key;                 /* The hash of the inputs and the layout of the structures */
+  uint64_t checksum;            /* The checksum of the sections */
+  int64_t nbytes;               /* The size of the file */
+  int64_t offset[NATOMIC_CACHE_SECTION];        /* The start of each section */
+  int64_t count[NATOMIC_CACHE_SECTION]; /* The number of records in each section */
+  int64_t size[NATOMIC_CACHE_SECTION];  /* The size of each record */
+  int ints[NATOMIC_CACHE_INTS];
+  double rho2nh, phot_freq_min, inner_freq_min;
+} atomic_cache_header;
+
+/** Where the data for a section is, and how much of it there is */
+typedef struct atomic_cache_section
+{
+  void *data;
+  size_t size;
+  int64_t count;
+} atomic_cache_section;
+
+
+
+/**********************************************************/
+/**
+ * @brief      add a block of memory to a 64 bit FNV-1a hash
+ *
+ * @param [in] uint64_t  h   The hash so far
+ * @param [in] const void *  data   The data to add
+ * @param [in] size_t  n   The number of bytes
+ * @return     The new hash
+ *
+ * @details
+ * For speed, the data is added 8 bytes at a time, with any bytes
+ * left over added one by one.
+ *
+ **********************************************************/
+
+static uint64_t
+atomic_cache_hash (uint64_t h, const void *data, size_t n)
+{
+  const unsigned char *p = data;
+  uint64_t w;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+  {
+    memcpy (&w, p + i, 8);
+    h ^= w;
+    h *= 1099511628211ULL;
+  }
+  for (; i < n; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+
+  return (h);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      construct the key which identifies the inputs to get_atomic_data
+ *
+ * @param [in] char  masterfile[]   The masterfile
+ * @param [out] uint64_t *  key   The key
+ * @return     0 on success, or 1 if the masterfile or one of the files it
+ * lists could not be found
+ *
+ * @details
+ * The files are identified by their names, sizes and modification times,
+ * rather than their contents, so that checking the cache does not mean
+ * reading all of the data files.  The sizes of the structures and arrays
+ * in atomic.h are included, so that a cache written by a version of the
+ * program with a different layout is not used.
+ *
+ **********************************************************/
+
+static int
+atomic_cache_key (char masterfile[], uint64_t *key)
+{
+  FILE *mptr;
+  char aline[ATOMIC_CACHE_LINE], file[ATOMIC_CACHE_LINE];
+  struct stat st;
+  uint64_t h;
+  int64_t x;
+  int64_t layout[] = {
+    ATOMIC_CACHE_VERSION, sizeof (ele_dummy), sizeof (ion_dummy), sizeof (config_dummy), sizeof (auger_dummy),
+    sizeof (line_dummy), sizeof (Coll_stren), sizeof (Topbase_phot), sizeof (Inner_elec_yield), sizeof (struct ground_fracs),
+    sizeof (Drecomb), sizeof (Total_rr), sizeof (Bad_gs_rr), sizeof (Dere_di_rate), sizeof (Gaunt_total),
+    sizeof (Charge_exchange), NELEMENTS, NIONS, NLEVELS, NLINES, N_INNER, NAUGER_MACRO, MAX_GAUNT_N_GSQRD,
+    MAX_CHARGE_EXCHANGE
+  };
+
+  h = atomic_cache_hash (14695981039346656037ULL, layout, sizeof (layout));
+
+  if ((mptr = fopen (masterfile, "r")) == NULL || stat (masterfile, &st) != 0)
+  {
+    if (mptr != NULL)
+      fclose (mptr);
+    return (1);
+  }
+
+  h = atomic_cache_hash (h, masterfile, strlen (masterfile));
+  x = st.st_size;
+  h = atomic_cache_hash (h, &x, sizeof (x));
+  x = st.st_mtime;
+  h = atomic_cache_hash (h, &x, sizeof (x));
+
+  while (fgets (aline, ATOMIC_CACHE_LINE, mptr) != NULL)
+  {
+    if (sscanf (aline, "%s", file) == 1 && file[0] != '#')
+    {
+      if (stat (file, &st) != 0)
+      {
+        fclose (mptr);
+        return (1);
+      }
+      h = atomic_cache_hash (h, file, strlen (file));
+      x = st.st_size;
+      h = atomic_cache_hash (h, &x, sizeof (x));
+      x = st.st_mtime;
+      h = atomic_cache_hash (h, &x, sizeof (x));
+    }
+  }
+
+  fclose (mptr);
+  *key = h;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      describe the sections of the cache
+ *
+ * @param [out] atomic_cache_section *  s   The address, record size and number of records of each section
+ * @return     Always returns 0
+ *
+ * @details
+ * The arrays whose size depends on the number of ions are saved in full,
+ * since they are small and not all of them are filled in order.  For the
+ * large arrays, only the entries which have been filled are saved.  The
+ * number of records depends on the counters in atomic.h, so these must
+ * be set before this is called.
+ *
+ * The sections of pointers have no data here; they are converted to and
+ * from indices by the routines which read and write the file.
+ *
+ **********************************************************/
+
+static int
+atomic_cache_sections (atomic_cache_section * s)
+{
+  int nphot;
+
+  nphot = ntop_phot + nxphot > nphot_total ? ntop_phot + nxphot : nphot_total;
+
+  s[AC_ELE] = (atomic_cache_section) { ele, sizeof (ele_dummy), NELEMENTS };
+  s[AC_ION] = (atomic_cache_section) { ion, sizeof (ion_dummy), NIONS };
+  s[AC_XCONFIG] = (atomic_cache_section) { xconfig, sizeof (config_dummy), nlevels };
+  s[AC_AUGER_MACRO] = (atomic_cache_section) { auger_macro, sizeof (auger_dummy), nauger_macro };
+  s[AC_LINE] = (atomic_cache_section) { line, sizeof (line_dummy), nlines };
+  s[AC_LIN_PTR] = (atomic_cache_section) { NULL, sizeof (int), nlines };
+  s[AC_COLL_STREN] = (atomic_cache_section) { coll_stren, sizeof (Coll_stren), n_coll_stren };
+  s[AC_PHOT_TOP] = (atomic_cache_section) { phot_top, sizeof (Topbase_phot), nphot };
+  s[AC_PHOT_TOP_PTR] = (atomic_cache_section) { NULL, sizeof (int), ntop_phot + nxphot };
+  s[AC_INNER_CROSS] = (atomic_cache_section) { inner_cross, sizeof (Topbase_phot), n_inner_tot };
+  s[AC_INNER_CROSS_PTR] = (atomic_cache_section) { NULL, sizeof (int), n_inner_tot };
+  s[AC_INNER_ELEC_YIELD] = (atomic_cache_section) { inner_elec_yield, sizeof (Inner_elec_yield), n_inner_tot };
+  s[AC_GROUND_FRAC] = (atomic_cache_section) { ground_frac, sizeof (struct ground_fracs), NIONS };
+  s[AC_DRECOMB] = (atomic_cache_section) { drecomb, sizeof (Drecomb), NIONS };
+  s[AC_TOTAL_RR] = (atomic_cache_section) { total_rr, sizeof (Total_rr), NIONS };
+  s[AC_BAD_GS_RR] = (atomic_cache_section) { bad_gs_rr, sizeof (Bad_gs_rr), NIONS };
+  s[AC_DERE_DI_RATE] = (atomic_cache_section) { dere_di_rate, sizeof (Dere_di_rate), NIONS };
+  s[AC_GAUNT_TOTAL] = (atomic_cache_section) { gaunt_total, sizeof (Gaunt_total), MAX_GAUNT_N_GSQRD };
+  s[AC_CHARGE_EXCHANGE] = (atomic_cache_section) { charge_exchange, sizeof (Charge_exchange), MAX_CHARGE_EXCHANGE };
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      copy the atomic data into a single block of memory, laid out
+ * as in the cache file
+ *
+ * @param [out] size_t *  nbytes   The size of the block
+ * @return     The block, which the caller should free, or NULL if there
+ * was not enough memory
+ *
+ * @details
+ * This is used both to write the cache, and to share the atomic data
+ * between processes (see share_atomic_data).  The key in the header is
+ * left as 0, for atomic_cache_write to fill in.
+ *
+ **********************************************************/
+
+char *
+atomic_cache_pack (size_t *nbytes)
+{
+  atomic_cache_header header;
+  atomic_cache_section s[NATOMIC_CACHE_SECTION];
+  uint64_t h;
+  int64_t offset;
+  char *image;
+  int *index;
+  int n, i;
+
+  atomic_cache_sections (s);
+
+  /* Lay out the block */
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, ATOMIC_CACHE_MAGIC, 8);
+  header.version = ATOMIC_CACHE_VERSION;
+  header.nsection = NATOMIC_CACHE_SECTION;
+  for (n = 0; n < NATOMIC_CACHE_INTS; n++)
+    header.ints[n] = *atomic_cache_ints[n];
+  header.rho2nh = rho2nh;
+  header.phot_freq_min = phot_freq_min;
+  header.inner_freq_min = inner_freq_min;
+
+  offset = sizeof (header);
+  for (n = 0; n < NATOMIC_CACHE_SECTION; n++)
+  {
+    offset += (ATOMIC_CACHE_ALIGN - offset % ATOMIC_CACHE_ALIGN) % ATOMIC_CACHE_ALIGN;
+    header.offset[n] = offset;
+    header.count[n] = s[n].count;
+    header.size[n] = s[n].size;
+    offset += s[n].count * s[n].size;
+  }
+  header.nbytes = offset;
+
+  if ((image = calloc (header.nbytes, 1)) == NULL)
+    return (NULL);
+
+  /* Copy the sections, converting the pointers which order the data by frequency into indices */
+
+  for (n = 0; n < NATOMIC_CACHE_SECTION; n++)
+  {
+    if (s[n].data != NULL)
+      memcpy (image + header.offset[n], s[n].data, s[n].count * s[n].size);
+  }
+
+  index = (int *) (image + header.offset[AC_LIN_PTR]);
+  for (i = 0; i < nlines; i++)
+    index[i] = lin_ptr[i] - line;
+
+  index = (int *) (image + header.offset[AC_PHOT_TOP_PTR]);
+  for (i = 0; i < ntop_phot + nxphot; i++)
+    index[i] = phot_top_ptr[i] - phot_top;
+
+  index = (int *) (image + header.offset[AC_INNER_CROSS_PTR]);
+  for (i = 0; i < n_inner_tot; i++)
+    index[i] = inner_cross_ptr[i] - inner_cross;
+
+  h = 14695981039346656037ULL;
+  for (n = 0; n < NATOMIC_CACHE_SECTION; n++)
+    h = atomic_cache_hash (h, image + header.offset[n], header.count[n] * header.size[n]);
+  header.checksum = h;
+
+  memcpy (image, &header, sizeof (header));
+  *nbytes = header.nbytes;
+
+  return (image);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      check that a block of memory is a complete and uncorrupted
+ * copy of the atomic data
+ *
+ * @param [in] const char *  image   The block, e.g. the cache file mapped into memory
+ * @param [in] int64_t  nbytes   The size of the block
+ * @param [in] uint64_t  key   The key which the block should have
+ * @return     0 if the block is valid, 1 if it is not
+ *
+ **********************************************************/
+
+static int
+atomic_cache_check (const char *image, int64_t nbytes, uint64_t key)
+{
+  atomic_cache_header header;
+  uint64_t h;
+  int n;
+
+  if (nbytes < (int64_t) sizeof (header))
+    return (1);
+
+  memcpy (&header, image, sizeof (header));
+
+  if (strncmp (header.magic, ATOMIC_CACHE_MAGIC, 8) != 0 || header.version != ATOMIC_CACHE_VERSION
+      || header.nsection != NATOMIC_CACHE_SECTION || header.key != key || header.nbytes != nbytes)
+    return (1);
+
+  h = 14695981039346656037ULL;
+  for (n = 0; n < NATOMIC_CACHE_SECTION; n++)
+  {
+    if (header.offset[n] < (int64_t) sizeof (header) || header.count[n] < 0
+        || header.offset[n] + header.count[n] * header.size[n] > header.nbytes)
+      return (1);
+    h = atomic_cache_hash (h, image + header.offset[n], header.count[n] * header.size[n]);
+  }
+
+  return (h != header.checksum);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      set up the atomic data from a block of memory made by atomic_cache_pack
+ *
+ * @param [in] char *  image   The block
+ * @param [in] int  shared   If TRUE, the largest arrays are used where they
+ * are in the block, rather than being copied
+ * @return     0 on success, 1 if the block is inconsistent with the header
+ *
+ * @details
+ * The structures are initialized by init_atomic_data, and the arrays of
+ * lines, levels and cross sections are allocated with as many entries as
+ * are in the block, so that the entries which are not in the block have
+ * the values they would have if the data had been read from the ascii
+ * files.  The filled entries are then copied from it.
+ *
+ * If shared is TRUE, line, coll_stren, phot_top, inner_cross and inner_elec_yield
+ * point into the block, which must not be freed while the data is in use, and
+ * atomic_data_shared is set.  These arrays then only have as many entries as
+ * have been filled.  The pointers which order the data by frequency are private
+ * to each process, and are rebuilt from the indices in the block, since the
+ * block need not be at the same address in every process.
+ *
+ **********************************************************/
+
+int
+atomic_cache_unpack (char *image, int shared)
+{
+  atomic_cache_header header;
+  atomic_cache_section s[NATOMIC_CACHE_SECTION];
+  const int *index;
+  int n, i;
+
+  memcpy (&header, image, sizeof (header));
+
+  if (shared && atomic_data_shared == FALSE)
+  {
+    free (line);
+    free (coll_stren);
+    free (phot_top);
+    free (inner_cross);
+    free (inner_elec_yield);
+    line = NULL;
+    coll_stren = NULL;
+    phot_top = inner_cross = NULL;
+    inner_elec_yield = NULL;
+  }
+  atomic_data_shared = shared;
+
+  init_atomic_data ();
+
+  for (n = 0; n < NATOMIC_CACHE_INTS; n++)
+    *atomic_cache_ints[n] = header.ints[n];
+  rho2nh = header.rho2nh;
+  phot_freq_min = header.phot_freq_min;
+  inner_freq_min = header.inner_freq_min;
+
+  atomic_data_resize (nlines, nlevels, header.count[AC_PHOT_TOP], n_inner_tot);
+
+  if (shared)
+  {
+    line = (LinePtr) (image + header.offset[AC_LINE]);
+    coll_stren = (Coll_stren *) (image + header.offset[AC_COLL_STREN]);
+    phot_top = (Topbase_phot *) (image + header.offset[AC_PHOT_TOP]);
+    inner_cross = (Topbase_phot *) (image + header.offset[AC_INNER_CROSS]);
+    inner_elec_yield = (Inner_elec_yield *) (image + header.offset[AC_INNER_ELEC_YIELD]);
+  }
+
+  atomic_cache_sections (s);
+
+  for (n = 0; n < NATOMIC_CACHE_SECTION; n++)
+  {
+    if (header.count[n] != s[n].count || header.size[n] != (int64_t) s[n].size)
+    {
+      Error ("atomic_cache_unpack: Section %d of the atomic data is inconsistent with its header\n", n);
+      return (1);
+    }
+    if (s[n].data != NULL && s[n].data != image + header.offset[n])
+      memcpy (s[n].data, image + header.offset[n], s[n].count * s[n].size);
+  }
+
+  index = (const int *) (image + header.offset[AC_LIN_PTR]);
+  for (i = 0; i < nlines; i++)
+    lin_ptr[i] = &line[index[i]];
+
+  index = (const int *) (image + header.offset[AC_PHOT_TOP_PTR]);
+  for (i = 0; i < ntop_phot + nxphot; i++)
+    phot_top_ptr[i] = &phot_top[index[i]];
+
+  index = (const int *) (image + header.offset[AC_INNER_CROSS_PTR]);
+  for (i = 0; i < n_inner_tot; i++)
+    inner_cross_ptr[i] = &inner_cross[index[i]];
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      read the atomic data from the binary cache of a masterfile
+ *
+ * @param [in] char  masterfile[]   The masterfile
+ * @return     0 if the data was read, or 1 if there is no valid cache,
+ * in which case the data must be read from the ascii files
+ *
+ **********************************************************/
+
+int
+atomic_cache_read (char masterfile[])
+{
+  char cachefile[ATOMIC_CACHE_LINE + 10];
+  struct stat st;
+  uint64_t key;
+  char *map;
+  int fd, ierr;
+
+  if (atomic_cache == 0 || atomic_cache_key (masterfile, &key))
+    return (1);
+
+  snprintf (cachefile, sizeof (cachefile), "%s.cache", masterfile);
+
+  if ((fd = open (cachefile, O_RDONLY)) < 0)
+    return (1);
+
+  if (fstat (fd, &st) != 0 || st.st_size < (off_t) sizeof (atomic_cache_header)
+      || (map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    close (fd);
+    return (1);
+  }
+  close (fd);
+
+  if (atomic_cache_check (map, st.st_size, key))
+  {
+    if (strncmp (map, ATOMIC_CACHE_MAGIC, 8) == 0 && ((atomic_cache_header *) map)->key == key)
+      Error ("atomic_cache_read: %s is corrupted, so the atomic data will be read from %s\n", cachefile, masterfile);
+    munmap (map, st.st_size);
+    return (1);
+  }
+
+  ierr = atomic_cache_unpack (map, FALSE);
+  munmap (map, st.st_size);
+  if (ierr)
+    return (1);
+
+  Log ("Get_atomic_data: Read the atomic data for %s from %s\n", masterfile, cachefile);
+  Log ("Data of %3d elements, %3d ions, %5d levels, %5d lines, and %5d topbase records\n", nelements, nions, nlevels, nlines, ntop_phot);
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      write the atomic data to a binary cache for a masterfile
+ *
+ * @param [in] char  masterfile[]   The masterfile
+ * @return     0 if the cache was written, or 1 if it could not be
+ *
+ * @details
+ * This is called by get_atomic_data once the data has been read from the
+ * ascii files, and indexed.  In parallel runs only one process should
+ * call it.
+ *
+ **********************************************************/
+
+int
+atomic_cache_write (char masterfile[])
+{
+  char cachefile[ATOMIC_CACHE_LINE + 10], tmpfile[ATOMIC_CACHE_LINE + 40];
+  FILE *fptr;
+  uint64_t key;
+  size_t nbytes;
+  char *image;
+  int ok;
+
+  if (atomic_cache == 0 || atomic_cache_key (masterfile, &key))
+    return (1);
+
+  snprintf (cachefile, sizeof (cachefile), "%s.cache", masterfile);
+  snprintf (tmpfile, sizeof (tmpfile), "%s.tmp%ld", cachefile, (long) getpid ());
+
+  if ((image = atomic_cache_pack (&nbytes)) == NULL)
+  {
+    Error ("atomic_cache_write: Unable to allocate memory\n");
+    return (1);
+  }
+  ((atomic_cache_header *) image)->key = key;
+
+  /* Write the file, and then move it into place */
+
+  ok = 0;
+  if ((fptr = fopen (tmpfile, "wb")) != NULL)
+  {
+    ok = fwrite (image, 1, nbytes, fptr) == nbytes;
+    ok = (fclose (fptr) == 0) && ok;
+    if (ok)
+      ok = rename (tmpfile, cachefile) == 0;
+    if (!ok)
+      remove (tmpfile);
+  }
+
+  free (image);
+
+  if (!ok)
+  {
+    Log_silent ("atomic_cache_write: Could not save the atomic data in %s\n", cachefile);
+    return (1);
+  }
+
+  Log ("Get_atomic_data: Saved the atomic data in %s (%.1f MB)\n", cachefile, nbytes / 1048576.);
+
+  return (0);
+}
@@ -22,6 +22,12 @@
 
 #define LINELENGTH 400
 #define MAXWORDS    20
+#define ATOMIC_ALLOC_MIN 64     /* The smallest number of records allocated when an array is first grown */
+
+static int line_alloc = 0;      /* The number of lines for which space has been allocated */
+static int level_alloc = 0;     /* The number of levels for which space has been allocated */
+static int phot_alloc = 0;      /* The number of photoionization cross sections for which space has been allocated */
+static int inner_alloc = 0;     /* The number of inner shell cross sections for which space has been allocated */
 
 
 /**********************************************************/
@@ -41,6 +47,10 @@
  * to shorten that very long routine in July 2020.  Some
  * counters are still set in get_atomicdata
  *
+ * If atomic_data_shared is TRUE, the line, collision strength,
+ * photoionization and inner shell arrays are in memory shared
+ * with other processes, and are left alone.
+ *
  *
  **********************************************************/
 
@@ -48,7 +58,7 @@ int
 init_atomic_data ()
 {
 
-  int n, i, j;
+  int n, i;
   int n1;
 
 
@@ -92,41 +102,36 @@ init_atomic_data ()
   }
 
 
-  if (xconfig != NULL)
-  {
-    free (xconfig);
-  }
-  xconfig = (ConfigPtr) calloc (sizeof (config_dummy), NLEVELS);
+  /* The arrays whose size depends on the number of lines, levels and
+     photoionization cross sections are allocated by atomic_data_reserve and
+     atomic_data_resize once it is known how many there are.  The largest of
+     these are not freed here if they have been placed in memory shared between
+     processes, see communicate_atomic.c */
 
-  if (xconfig == NULL)
-  {
-    Error ("There is a problem in allocating memory for the config structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of     config totaling %10.1f Mb \n",
-       sizeof (config_dummy), NLEVELS, 1.e-6 * NLEVELS * sizeof (config_dummy));
-  }
+  free (xconfig);
+  free (lin_ptr);
+  free (lin_pow);
+  free (phot_top_ptr);
+  free (inner_cross_ptr);
+  xconfig = NULL;
+  lin_ptr = NULL;
+  lin_pow = NULL;
+  phot_top_ptr = inner_cross_ptr = NULL;
 
-  if (line != NULL)
+  if (atomic_data_shared == FALSE)
   {
     free (line);
+    free (coll_stren);
+    free (phot_top);
+    free (inner_cross);
+    free (inner_elec_yield);
+    line = NULL;
+    coll_stren = NULL;
+    phot_top = inner_cross = NULL;
+    inner_elec_yield = NULL;
   }
-  line = (LinePtr) calloc (sizeof (line_dummy), NLINES);
 
-  if (line == NULL)
-  {
-    Error ("There is a problem in allocating memory for the line structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of       line totaling %10.1f Mb \n",
-       sizeof (line_dummy), NLINES, 1.e-6 * NLINES * sizeof (line_dummy));
-  }
+  line_alloc = level_alloc = phot_alloc = inner_alloc = 0;
 
   if (auger_macro != NULL)
   {
@@ -201,85 +206,10 @@ init_atomic_data ()
   }
 
 
-  /*This initializes the top_phot array - it is used for all ionization processes so some elements
-     are only used in some circumstances
-   */
-
-  for (n = 0; n < NLEVELS; n++)
-  {
-    phot_top[n].nlev = (-1);
-    phot_top[n].uplev = (-1);
-    phot_top[n].nion = (-1);    //the ion to which this cross section belongs
-    phot_top[n].n_elec_yield = -1;      //pointer to the electron yield array (for inner shell)
-    phot_top[n].n = -1;         //pointer to shell (inner shell)
-    phot_top[n].l = -1;         //pointer to l subshell (inner shell only)
-    phot_top[n].z = (-1);       //atomic number
-    phot_top[n].np = (-1);      //number of points in the fit
-    phot_top[n].macro_info = (-1);      //Initialise - don't know if using Macro Atoms or not: set to -1 (SS)
-    for (j = 0; j < NCROSS; j++)        //initialise the crooss sectiond
-    {
-      phot_top[n].freq[j] = (-1);
-      phot_top[n].log_freq[j] = (-1);
-      phot_top[n].x[j] = (-1);
-      phot_top[n].log_x[j] = (-1);
-
-    }
-    phot_top[n].f = (-1);       //last frequency
-    phot_top[n].log_f = (-1);   //log of last frequency    
-    phot_top[n].sigma = 0.0;    //last cross section
-    phot_top[n].log_sigma = -1.0;       //log of last cross section
-
-  }
-
-
   for (n = 0; n < NIONS * N_INNER; n++) //Initialise atomic arrasy with dimension NIONS*NINNER
   {
-    inner_cross[n].nlev = (-1);
-    inner_cross[n].uplev = (-1);
-    inner_cross[n].nion = inner_elec_yield[n].nion = inner_fluor_yield[n].nion = (-1);
-    inner_cross[n].n_elec_yield = -1;
-    inner_cross[n].n = inner_elec_yield[n].n = inner_fluor_yield[n].n = (-1);
-    inner_cross[n].l = inner_elec_yield[n].l = inner_fluor_yield[n].l = (-1);
-    inner_cross[n].z = inner_elec_yield[n].z = inner_fluor_yield[n].z = (-1);
-    inner_elec_yield[n].I = inner_elec_yield[n].Ea = 0.0;
+    inner_fluor_yield[n].nion = inner_fluor_yield[n].n = inner_fluor_yield[n].l = inner_fluor_yield[n].z = (-1);
     inner_fluor_yield[n].freq = inner_fluor_yield[n].yield = 0.0;
-    for (j = 0; j < 10; j++)
-      inner_elec_yield[n].prob[j] = 0.0;
-    inner_cross[n].np = (-1);
-    inner_cross[n].macro_info = (-1);   //Initialise - don't know if using Macro Atoms or not: set to -1 (SS)
-    for (j = 0; j < NCROSS; j++)
-    {
-      inner_cross[n].freq[j] = (-1);
-      inner_cross[n].x[j] = (-1);
-      inner_cross[n].log_freq[j] = (-1);
-      inner_cross[n].log_x[j] = (-1);
-    }
-    inner_cross[n].f = (-1);
-    inner_cross[n].sigma = 0.0;
-    inner_cross[n].log_f = (-1);
-    inner_cross[n].log_sigma = 0.0;
-  }
-
-
-  for (i = 0; i < NLEVELS; i++)
-  {
-    xconfig[i].n_bbu_jump = 0;  // initialising the number of jumps from each level to 0. (SS)
-    xconfig[i].n_bbd_jump = 0;
-    xconfig[i].n_bfu_jump = 0;
-    xconfig[i].n_bfd_jump = 0;
-    xconfig[i].iauger = -1;
-    xconfig[i].nauger = 0;
-  }
-
-  for (n = 0; n < NLINES; n++)
-  {
-    line[n].freq = -1;
-    line[n].f = -1;
-    line[n].nion = -1;
-    line[n].gl = line[n].gu = 0;
-    line[n].el = line[n].eu = 0.0;
-    line[n].macro_info = -1;
-    line[n].coll_index = -999;
   }
 
   for (n = 0; n < NAUGER_MACRO; n++)
@@ -376,25 +306,268 @@ init_atomic_data ()
   }
 
 
-/* The following lines initialise the collision strengths */
-  for (n = 0; n < NLINES; n++)
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      set the size of the arrays which depend on the number of
+ * lines, levels, and photoionization and inner shell cross sections
+ *
+ * @param [in] int  nline   The number of lines (and collision strengths)
+ * @param [in] int  nlevel   The number of levels
+ * @param [in] int  nphot   The number of photoionization cross sections
+ * @param [in] int  ninner   The number of inner shell cross sections
+ * @return     Always returns 0
+ *
+ * @details
+ * Entries which are added are given the values which get_atomic_data
+ * expects for records which have not been read.  Entries beyond the
+ * new size are discarded.
+ *
+ * ### Notes ###
+ *
+ * Since the arrays may move, nothing may keep a pointer into line,
+ * phot_top or inner_cross across a call to this routine.  The pointers
+ * which order them by frequency are only set up after all the data has
+ * been read.
+ *
+ * If atomic_data_shared is TRUE, only the arrays which are private to
+ * each process are changed.
+ *
+ **********************************************************/
+
+static int
+atomic_data_alloc (int nline, int nlevel, int nphot, int ninner)
+{
+  int n, j;
+
+  /* Never ask for zero records, so that a NULL pointer always indicates a failure */
+  nline = nline > 0 ? nline : 1;
+  nlevel = nlevel > 0 ? nlevel : 1;
+  nphot = nphot > 0 ? nphot : 1;
+  ninner = ninner > 0 ? ninner : 1;
+
+  if (atomic_data_shared == FALSE)
+  {
+    line = (LinePtr) realloc (line, sizeof (line_dummy) * nline);
+    coll_stren = (Coll_stren *) realloc (coll_stren, sizeof (Coll_stren) * nline);
+    phot_top = (Topbase_phot *) realloc (phot_top, sizeof (Topbase_phot) * nphot);
+    inner_cross = (Topbase_phot *) realloc (inner_cross, sizeof (Topbase_phot) * ninner);
+    inner_elec_yield = (Inner_elec_yield *) realloc (inner_elec_yield, sizeof (Inner_elec_yield) * ninner);
+  }
+  xconfig = (ConfigPtr) realloc (xconfig, sizeof (config_dummy) * nlevel);
+  lin_ptr = (LinePtr *) realloc (lin_ptr, sizeof (LinePtr) * nline);
+  lin_pow = (double *) realloc (lin_pow, sizeof (double) * nline);
+  phot_top_ptr = (TopPhotPtr *) realloc (phot_top_ptr, sizeof (TopPhotPtr) * nphot);
+  inner_cross_ptr = (TopPhotPtr *) realloc (inner_cross_ptr, sizeof (TopPhotPtr) * ninner);
+
+  if ((atomic_data_shared == FALSE
+       && (line == NULL || coll_stren == NULL || phot_top == NULL || inner_cross == NULL || inner_elec_yield == NULL))
+      || xconfig == NULL || lin_ptr == NULL || lin_pow == NULL || phot_top_ptr == NULL || inner_cross_ptr == NULL)
+  {
+    Error ("There is a problem in allocating memory for %d lines, %d levels and %d photoionization cross sections\n", nline, nlevel,
+           nphot);
+    exit (0);
+  }
+
+  for (n = line_alloc; n < nline; n++)
   {
+    lin_ptr[n] = NULL;
+    lin_pow[n] = 0.0;
+  }
+
+  for (n = level_alloc; n < nlevel; n++)
+  {
+    memset (&xconfig[n], 0, sizeof (config_dummy));
+    xconfig[n].n_bbu_jump = 0;  // initialising the number of jumps from each level to 0. (SS)
+    xconfig[n].n_bbd_jump = 0;
+    xconfig[n].n_bfu_jump = 0;
+    xconfig[n].n_bfd_jump = 0;
+    xconfig[n].iauger = -1;
+    xconfig[n].nauger = 0;
+  }
+
+  for (n = phot_alloc; n < nphot; n++)
+    phot_top_ptr[n] = NULL;
+
+  for (n = inner_alloc; n < ninner; n++)
+    inner_cross_ptr[n] = NULL;
+
+  level_alloc = nlevel;
+
+  /* The remaining arrays are in shared memory, and so are never added to */
+
+  if (atomic_data_shared)
+  {
+    line_alloc = nline;
+    phot_alloc = nphot;
+    inner_alloc = ninner;
+    return (0);
+  }
+
+  for (n = line_alloc; n < nline; n++)
+  {
+    memset (&line[n], 0, sizeof (line_dummy));
+    line[n].freq = -1;
+    line[n].f = -1;
+    line[n].nion = -1;
+    line[n].gl = line[n].gu = 0;
+    line[n].el = line[n].eu = 0.0;
+    line[n].macro_info = -1;
+    line[n].coll_index = -999;
+
+    memset (&coll_stren[n], 0, sizeof (Coll_stren));
     coll_stren[n].n = -1;       //Internal index
     coll_stren[n].lower = -1;   //The lower energy level - this is in Chianti notation and is currently unused
     coll_stren[n].upper = -1;   //The upper energy level - this is in Chianti notation and is currently unused
-    coll_stren[n].energy = 0.0; //The energy of the transition
-    coll_stren[n].gf = 0.0;
-    coll_stren[n].hi_t_lim = 0.0;       //The high temperature limit
-    coll_stren[n].n_points = 0; //The number of points in the spline fit
     coll_stren[n].type = -1;    //The type of fit, this defines how one computes the scaled temperature and scaled coll strength
-    coll_stren[n].scaling_param = 0.0;  //The scaling parameter C used in the Burgess and Tully calculations
-    for (n1 = 0; n1 < N_COLL_STREN_PTS; n1++)
+  }
+
+  /* The phot_top array is used for all ionization processes so some elements
+     are only used in some circumstances */
+
+  for (n = phot_alloc; n < nphot; n++)
+  {
+    memset (&phot_top[n], 0, sizeof (Topbase_phot));
+    phot_top[n].nlev = (-1);
+    phot_top[n].uplev = (-1);
+    phot_top[n].nion = (-1);    //the ion to which this cross section belongs
+    phot_top[n].n_elec_yield = -1;      //pointer to the electron yield array (for inner shell)
+    phot_top[n].n = -1;         //pointer to shell (inner shell)
+    phot_top[n].l = -1;         //pointer to l subshell (inner shell only)
+    phot_top[n].z = (-1);       //atomic number
+    phot_top[n].np = (-1);      //number of points in the fit
+    phot_top[n].macro_info = (-1);      //Initialise - don't know if using Macro Atoms or not: set to -1 (SS)
+    phot_top[n].f = (-1);       //last frequency
+    phot_top[n].log_f = (-1);   //log of last frequency    
+    phot_top[n].sigma = 0.0;    //last cross section
+    phot_top[n].log_sigma = -1.0;       //log of last cross section
+    for (j = 0; j < NCROSS; j++)
+    {
+      phot_top[n].freq[j] = (-1);
+      phot_top[n].log_freq[j] = (-1);
+      phot_top[n].x[j] = (-1);
+      phot_top[n].log_x[j] = (-1);
+    }
+  }
+
+  for (n = inner_alloc; n < ninner; n++)
+  {
+    memset (&inner_cross[n], 0, sizeof (Topbase_phot));
+    memset (&inner_elec_yield[n], 0, sizeof (Inner_elec_yield));
+    inner_cross[n].nlev = (-1);
+    inner_cross[n].uplev = (-1);
+    inner_cross[n].nion = inner_elec_yield[n].nion = (-1);
+    inner_cross[n].n_elec_yield = -1;
+    inner_cross[n].n = inner_elec_yield[n].n = (-1);
+    inner_cross[n].l = inner_elec_yield[n].l = (-1);
+    inner_cross[n].z = inner_elec_yield[n].z = (-1);
+    inner_cross[n].np = (-1);
+    inner_cross[n].macro_info = (-1);   //Initialise - don't know if using Macro Atoms or not: set to -1 (SS)
+    inner_cross[n].f = (-1);
+    inner_cross[n].sigma = 0.0;
+    inner_cross[n].log_f = (-1);
+    inner_cross[n].log_sigma = 0.0;
+    for (j = 0; j < NCROSS; j++)
     {
-      coll_stren[n].sct[n1] = 0.0;      //The scaled temperature points in the fit
-      coll_stren[n].scups[n1] = 0.0;
+      inner_cross[n].freq[j] = (-1);
+      inner_cross[n].x[j] = (-1);
+      inner_cross[n].log_freq[j] = (-1);
+      inner_cross[n].log_x[j] = (-1);
     }
   }
 
+  line_alloc = nline;
+  phot_alloc = nphot;
+  inner_alloc = ninner;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      make sure there is space for at least the given numbers of
+ * lines, levels, and photoionization and inner shell cross sections
+ *
+ * @param [in] int  nline   The number of lines (and collision strengths)
+ * @param [in] int  nlevel   The number of levels
+ * @param [in] int  nphot   The number of photoionization cross sections
+ * @param [in] int  ninner   The number of inner shell cross sections
+ * @return     Always returns 0
+ *
+ * @details
+ * This is called by get_atomic_data before each record is read.  Arrays
+ * which are too small are doubled in size, so that the cost of copying
+ * them is small however many records there are, and are trimmed to the
+ * number of records actually read by atomic_data_resize at the end.
+ *
+ **********************************************************/
+
+int
+atomic_data_reserve (int nline, int nlevel, int nphot, int ninner)
+{
+  if (nline <= line_alloc && nlevel <= level_alloc && nphot <= phot_alloc && ninner <= inner_alloc)
+    return (0);
+
+  if (nline > line_alloc)
+    nline = nline > 2 * line_alloc ? (nline > ATOMIC_ALLOC_MIN ? nline : ATOMIC_ALLOC_MIN) : 2 * line_alloc;
+  else
+    nline = line_alloc;
+  if (nlevel > level_alloc)
+    nlevel = nlevel > 2 * level_alloc ? (nlevel > ATOMIC_ALLOC_MIN ? nlevel : ATOMIC_ALLOC_MIN) : 2 * level_alloc;
+  else
+    nlevel = level_alloc;
+  if (nphot > phot_alloc)
+    nphot = nphot > 2 * phot_alloc ? (nphot > ATOMIC_ALLOC_MIN ? nphot : ATOMIC_ALLOC_MIN) : 2 * phot_alloc;
+  else
+    nphot = phot_alloc;
+  if (ninner > inner_alloc)
+    ninner = ninner > 2 * inner_alloc ? (ninner > ATOMIC_ALLOC_MIN ? ninner : ATOMIC_ALLOC_MIN) : 2 * inner_alloc;
+  else
+    ninner = inner_alloc;
+
+  return (atomic_data_alloc (nline, nlevel, nphot, ninner));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      set the arrays of lines, levels, and photoionization and inner
+ * shell cross sections to exactly the given sizes
+ *
+ * @param [in] int  nline   The number of lines (and collision strengths)
+ * @param [in] int  nlevel   The number of levels
+ * @param [in] int  nphot   The number of photoionization cross sections
+ * @param [in] int  ninner   The number of inner shell cross sections
+ * @return     Always returns 0
+ *
+ * @details
+ * This is used once the numbers of records are known, either at the
+ * end of get_atomic_data, or when the data is taken from the binary
+ * cache, so that the memory used depends on the atomic data actually
+ * in use, rather than on the limits in atomic.h.
+ *
+ **********************************************************/
+
+int
+atomic_data_resize (int nline, int nlevel, int nphot, int ninner)
+{
+  double nbytes;
+
+  atomic_data_alloc (nline, nlevel, nphot, ninner);
+
+  nbytes = (double) line_alloc * (sizeof (line_dummy) + sizeof (Coll_stren) + sizeof (LinePtr) + sizeof (double))
+    + (double) level_alloc * sizeof (config_dummy) + (double) phot_alloc * (sizeof (Topbase_phot) + sizeof (TopPhotPtr))
+    + (double) inner_alloc * (sizeof (Topbase_phot) + sizeof (TopPhotPtr) + sizeof (Inner_elec_yield));
+
+  Log_silent ("Allocated %10.1f Mb for %d lines, %d levels, %d photoionization and %d inner shell cross sections\n",
+              1.e-6 * nbytes, line_alloc, level_alloc, phot_alloc, inner_alloc);
 
   return (0);
 }
@@ -160,8 +160,8 @@ index_lines ()
   void indexx ();
 
   /* Allocate memory for some modestly large arrays */
-  freqs = calloc (sizeof (foo), NLINES + 2);
-  index = calloc (sizeof (ioo), NLINES + 2);
+  freqs = calloc (sizeof (foo), nlines + 2);
+  index = calloc (sizeof (ioo), nlines + 2);
 
   freqs[0] = 0;
   for (n = 0; n < nlines; n++)
@@ -534,11 +534,48 @@ check_xsections ()
 }
 
 
+
+/**********************************************************/
+/**
+ * @brief      Check that every ion which can be ionized has photoionization
+ * cross sections
+ *
+ * @return     0 if all the ions have cross sections, 1 otherwise
+ *
+ * @details
+ * This is only needed for ionization modes which calculate photoionization
+ * rates, so it is not part of reading the data, and is also done when the data
+ * is read from the binary cache.
+ *
+ **********************************************************/
+
+int
+check_phot_info ()
+{
+  int n, ierr;
+
+  ierr = 0;
+  for (n = 0; n < nions; n++)
+  {
+    if (ion[n].phot_info < 0 && ion[n].istate != ion[n].z + 1)
+    {
+      Error
+        ("There is no PI rate associated with ion %d (element %d ion %d) - add PI rates and check that uppper level/ion is included in level population\n",
+         n, ion[n].z, ion[n].istate);
+      Error ("Also check masterfile to see that PI files appear after all of the level files for this atom\n");
+      ierr = 1;
+    }
+  }
+
+  return (ierr);
+}
+
+
 /// (8*PI)/(sqrt(3) *nu_1Rydberg
 #define ECS_CONSTANT 4.773691e16
 
-struct lines *q21_line_ptr;
-double q21_a, q21_t_old;
+THREAD_LOCAL struct lines *q21_line_ptr;
+THREAD_LOCAL double q21_a, q21_t_old;
 
 
 /**********************************************************/
@@ -665,8 +702,8 @@ q12 (line_ptr, t)
 
 #define A21_CONSTANT 7.429297e-22       // 8 * PI * PI * E * E / (MELEC * C * C * C)
 
-struct lines *a21_line_ptr;
-double a21_a;
+THREAD_LOCAL struct lines *a21_line_ptr;
+THREAD_LOCAL double a21_a;
 
 
 /**********************************************************/
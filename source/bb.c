@@ -43,13 +43,8 @@
 
 int ninit_planck = 0;           //A flag to say wether we have computed our stored blackbody integral
 
-double bb_old_t = 0;
-double bb_old_freqmin = 0;
-double bb_old_freqmax = 0;
-double alphamin, alphamax;
 double cdf_bb_lo, cdf_bb_hi, cdf_bb_tot;        // The precise boundaries in the the bb cdf
-double cdf_bb_ylo, cdf_bb_yhi;  // The places in the CDF defined by freqmin & freqmax
-double lo_freq_alphamin, lo_freq_alphamax, hi_freq_alphamin, hi_freq_alphamax;  //  the limits to use for the low and high frequency values
+struct bb_limits bb_now;        // The limits for the last temperature and frequency range planck was called with
 
 
 /**********************************************************/
@@ -71,6 +66,139 @@ int error_bb_hi = 0;
 int error_bb_lo = 0;
 
 
+/**********************************************************/
+/**
+ * @brief      create the cdf of the dimensionless bb function
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * This is done the first time planck or planck_limits is called.
+ * The cdf is created for values between ALPHAMIN and ALPHAMAX where
+ * ALPHA=h nu/kT.
+ *
+ **********************************************************/
+
+static int
+planck_init ()
+{
+  int echeck;
+
+  if (ninit_planck)
+    return (0);
+
+  if ((echeck = cdf_gen_from_func (&cdf_bb, &planck_d_2, ALPHAMIN, ALPHAMAX, 21, bb_set)) != 0)
+  {
+    Error ("Planck: on return from cdf_gen_from_func %d\n", echeck);
+  }
+  /* We need the integral of the bb function outside of the regions of interest as well
+   *
+   * cdf_bb_lo is the position in the full cdf of the low frequcny boundary
+   * cdf_bb_hi is position in the full cdf of the hi frequcny boundary
+   * */
+
+
+  cdf_bb_tot = num_int (planck_d, 0, ALPHABIG, 1e-8);
+  cdf_bb_lo = num_int (planck_d, 0, ALPHAMIN, 1e-8) / cdf_bb_tot;
+  cdf_bb_hi = 1. - num_int (planck_d, ALPHAMAX, ALPHABIG, 1e-8) / cdf_bb_tot;
+
+
+  ninit_planck++;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      calculate the portions of the bb cdf to use for a given
+ * temperature and frequency range
+ *
+ * @param [in] double  t   The temperature of the bb
+ * @param [in] double  freqmin   The minimum frequency for the photon
+ * @param [in] double  freqmax   The maximum frequency for the photon
+ * @param [out] BbLimitsPtr  lim   The limits
+ * @return     Always returns 0
+ *
+ * @details
+ * This contains the part of planck which depends on the temperature and
+ * the frequency range but not on the random numbers, and which requires
+ * two numerical integrations and a search of cdf_bb.  Routines which draw
+ * photons from many bbs, such as photo_gen_disk, can save the limits for
+ * each and pass them to planck_from_limits.
+ *
+ **********************************************************/
+
+int
+planck_limits (t, freqmin, freqmax, lim)
+     double t, freqmin, freqmax;
+     BbLimitsPtr lim;
+{
+  double alphamin, alphamax;
+
+  planck_init ();
+
+  lim->t = t;
+  lim->freqmin = freqmin;
+  lim->freqmax = freqmax;
+
+  lim->alphamin = alphamin = PLANCK * freqmin / (BOLTZMANN * t);
+  lim->alphamax = alphamax = PLANCK * freqmax / (BOLTZMANN * t);
+
+  lim->ylo = lim->yhi = 1.0;
+
+  if (alphamin < ALPHABIG)      //check to make sure we get a sensible number - planck_d(ALPHAMAX is too small to sensibly integrate)
+  {
+    lim->ylo = num_int (planck_d, 0, alphamin, 1e-8) / cdf_bb_tot;      //position in the full cdf of current low frequency boundary
+
+    if (lim->ylo > 1.0)
+      lim->ylo = 1.0;
+  }
+  if (alphamax < ALPHABIG)      //again, check to see that the integral will be sensible
+  {
+    lim->yhi = num_int (planck_d, 0, alphamax, 1e-8) / cdf_bb_tot;      //position in the full cdf of currnet hi frequency boundary
+
+    if (lim->yhi > 1.0)
+      lim->yhi = 1.0;
+  }
+
+/* These variables are not always used */
+
+  lim->lo_alphamin = alphamin;  //Set the minimum frequency to use the low frequency approximation to the lower band limit
+  lim->lo_alphamax = alphamax;  //Set to a default value
+
+  if (lim->lo_alphamax > ALPHAMIN)      //If the upper alpha for this band is above the loew frequency approximation lower limit
+    lim->lo_alphamax = ALPHAMIN;        //Set the maximum alpha we will use the low frequency approximation to the default value
+
+  lim->hi_alphamax = alphamax;  //Set the maximum frequency to use the high frequency approximation to to the upper band limit
+  lim->hi_alphamin = alphamin;  //Set to a default value
+  if (lim->hi_alphamin < ALPHAMAX)      //If the lower band limit is less than the high frequency limit
+    lim->hi_alphamin = ALPHAMAX;        //Se the minimum alpha value to use the high frequency limit to the default value
+
+
+/* Check whether the limits for alpha min and max are within the 'normal' bb range and if so
+* set the portion of the full cdf to use.
+*
+* Note that alphamin is always less than alphamax.
+*/
+
+  lim->use_cdf = FALSE;
+  if (alphamin < ALPHAMAX && alphamax > ALPHAMIN)
+  {
+    cdf_limit (&cdf_bb, alphamin, alphamax);
+    lim->use_cdf = TRUE;
+    lim->limit1 = cdf_bb.limit1;
+    lim->limit2 = cdf_bb.limit2;
+    lim->x1 = cdf_bb.x1;
+    lim->x2 = cdf_bb.x2;
+  }
+
+  return (0);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      returns the frequency for a photon which follows a Planck distribution
@@ -96,7 +224,9 @@ int error_bb_lo = 0;
  *
  * On subseqent entries, when the temperature
  * or frequency limits are changed, we use standard routines to limit
- * what portion of the dimensionless cdf to use.
+ * what portion of the dimensionless cdf to use.  Routines which alternate between
+ * many temperatures should save these limits with planck_limits and call
+ * planck_from_limits instead.
  *
  * If the frequency range and temperature for a photon falls outside of ALPHAMIN
  * and ALPHAMAX special routines are used to sample the distribution there.
@@ -110,104 +240,57 @@ double
 planck (t, freqmin, freqmax)
      double t, freqmin, freqmax;
 {
-  double freq, alpha, y;
-  int echeck;
-
-
   if (t <= 0)
   {
     Error ("planck: A value of %e for t is unphysical\n", t);
     return (freqmin);
   }
-  /*First time through create the array containing the proper boundaries for the integral
-   * of the BB function, Note calling cdf_gen_from func also defines ylo and yhi */
-
-  if (ninit_planck == 0)
-  {                             /* First time through p_alpha must be initialized */
-    if ((echeck = cdf_gen_from_func (&cdf_bb, &planck_d_2, ALPHAMIN, ALPHAMAX, 21, bb_set)) != 0)
-    {
-      Error ("Planck: on return from cdf_gen_from_func %d\n", echeck);
-    }
-    /* We need the integral of the bb function outside of the regions of interest as well
-     *
-     * cdf_bb_lo is the position in the full cdf of the low frequcny boundary
-     * cdf_bb_hi is position in the full cdf of the hi frequcny boundary
-     * */
-
-
-    cdf_bb_tot = num_int (planck_d, 0, ALPHABIG, 1e-8);
-    cdf_bb_lo = num_int (planck_d, 0, ALPHAMIN, 1e-8) / cdf_bb_tot;
-    cdf_bb_hi = 1. - num_int (planck_d, ALPHAMAX, ALPHABIG, 1e-8) / cdf_bb_tot;
-
-
-    ninit_planck++;
-
-  }
-
 
 /* If temperatures or frequencies have changed since the last call to planck
  * redefine various limits, including the portion of the cdf to be used
 */
 
-  if (t != bb_old_t || freqmin != bb_old_freqmin || freqmax != bb_old_freqmax)
+  if (t != bb_now.t || freqmin != bb_now.freqmin || freqmax != bb_now.freqmax)
   {
+    planck_limits (t, freqmin, freqmax, &bb_now);
+  }
 
-    alphamin = PLANCK * freqmin / (BOLTZMANN * t);
-    alphamax = PLANCK * freqmax / (BOLTZMANN * t);
-
-    bb_old_t = t;
-    bb_old_freqmin = freqmin;
-    bb_old_freqmax = freqmax;
-
-    cdf_bb_ylo = cdf_bb_yhi = 1.0;
-
-    if (alphamin < ALPHABIG)    //check to make sure we get a sensible number - planck_d(ALPHAMAX is too small to sensibly integrate)
-    {
-      cdf_bb_ylo = num_int (planck_d, 0, alphamin, 1e-8) / cdf_bb_tot;  //position in the full cdf of current low frequency boundary
-
-      if (cdf_bb_ylo > 1.0)
-        cdf_bb_ylo = 1.0;
-    }
-    if (alphamax < ALPHABIG)    //again, check to see that the integral will be sensible
-    {
-      cdf_bb_yhi = num_int (planck_d, 0, alphamax, 1e-8) / cdf_bb_tot;  //position in the full cdf of currnet hi frequency boundary
-
-      if (cdf_bb_yhi > 1.0)
-        cdf_bb_yhi = 1.0;
-    }
-
-/* These variables are not always used */
-
-    lo_freq_alphamin = alphamin;        //Set the minimum frequency to use the low frequency approximation to the lower band limit
-    lo_freq_alphamax = alphamax;        //Set to a default value
-
-    if (lo_freq_alphamax > ALPHAMIN)    //If the upper alpha for this band is above the loew frequency approximation lower limit
-      lo_freq_alphamax = ALPHAMIN;      //Set the maximum alpha we will use the low frequency approximation to the default value
+  return (planck_from_limits (&bb_now));
+}
 
-    hi_freq_alphamax = alphamax;        //Set the maximum frequency to use the high frequency approximation to to the upper band limit
-    hi_freq_alphamin = alphamin;        //Set to a default value
-    if (hi_freq_alphamin < ALPHAMAX)    //If the lower band limit is less than the high frequency limit
-      hi_freq_alphamin = ALPHAMAX;      //Se the minimum alpha value to use the high frequency limit to the default value
 
 
-/* Check whether the limits for alpha min and max are within the 'normal' bb range and if so
-* set the portion of the full cdf to use.
-*
-* Note that alphamin is always less than alphamax.
-*/
+/**********************************************************/
+/**
+ * @brief      returns the frequency for a photon which follows a Planck distribution,
+ * given the limits calculated by planck_limits
+ *
+ * @param [in] BbLimitsPtr  lim   The limits for the temperature and frequency range of interest
+ * @return     The frequency drawn randomly from a BB function
+ *
+ * @details
+ * The random numbers drawn, and the frequency returned, are the same as those of
+ * planck (lim->t, lim->freqmin, lim->freqmax).
+ *
+ **********************************************************/
 
-    if (alphamin < ALPHAMAX && alphamax > ALPHAMIN)
-    {
-      cdf_limit (&cdf_bb, alphamin, alphamax);
-    }
+double
+planck_from_limits (lim)
+     BbLimitsPtr lim;
+{
+  double freq, alpha, y;
 
+  if (lim->use_cdf)
+  {
+    cdf_bb.limit1 = lim->limit1;
+    cdf_bb.limit2 = lim->limit2;
+    cdf_bb.x1 = lim->x1;
+    cdf_bb.x2 = lim->x2;
   }
-  /* End of section redefining limits */
-
 
   y = random_number (0.0, 1.0); //We get a random number between 0 and 1 (excl)
 
-  y = cdf_bb_ylo * (1. - y) + cdf_bb_yhi * y;   // y is now in an allowed place in the cdf
+  y = lim->ylo * (1. - y) + lim->yhi * y;       // y is now in an allowed place in the cdf
 
 
 /* There are 3 cases to worry about
@@ -217,23 +300,23 @@ planck (t, freqmin, freqmax)
  *	in the normal regime
 */
 
-  if (y <= cdf_bb_lo || alphamax < ALPHAMIN)    //we are in the low frequency limit
+  if (y <= cdf_bb_lo || lim->alphamax < ALPHAMIN)       //we are in the low frequency limit
   {
-    alpha = get_rand_pow (lo_freq_alphamin, lo_freq_alphamax, 2.);
+    alpha = get_rand_pow (lim->lo_alphamin, lim->lo_alphamax, 2.);
   }
-  else if (y >= cdf_bb_hi || alphamin > ALPHAMAX)       //We are in the high frequency limit
+  else if (y >= cdf_bb_hi || lim->alphamin > ALPHAMAX)  //We are in the high frequency limit
   {
-    alpha = get_rand_exp (hi_freq_alphamin, hi_freq_alphamax);
+    alpha = get_rand_exp (lim->hi_alphamin, lim->hi_alphamax);
   }
   else
   {
     alpha = cdf_get_rand_limit (&cdf_bb);       //We are in the region where we use the BB function
   }
 
-  freq = BOLTZMANN * t / PLANCK * alpha;
-  if (freq < freqmin || freqmax < freq)
+  freq = BOLTZMANN * lim->t / PLANCK * alpha;
+  if (freq < lim->freqmin || lim->freqmax < freq)
   {
-    Error ("planck: freq %g out of range %g %g\n", freq, freqmin, freqmax);
+    Error ("planck: freq %g out of range %g %g\n", freq, lim->freqmin, lim->freqmax);
   }
   return (freq);
 }
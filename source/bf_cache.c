@@ -0,0 +1,638 @@
+/***********************************************************/
+/** @file  bf_cache.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Tables of the bound-free opacity in each cell, which are
+ * used in macro-atom mode in place of a direct calculation
+ *
+ * In macro-atom mode, kappa_bf is called for every path a photon
+ * takes through a cell, and each call loops over all of the
+ * bound-free processes which kbf_need has selected for the cell,
+ * looking up the density of the lower level and interpolating the
+ * cross section.  The level populations do not change during a
+ * cycle, so the opacity of a cell is a fixed function of frequency,
+ * which is tabulated here once per cycle.
+ *
+ * All cells share a grid of frequencies, which is uniform in
+ * log(frequency) with BF_CACHE_PER_DECADE points per decade, to which
+ * the threshold and the maximum frequency of every cross section are
+ * added twice, once for the opacity just below the edge and once for
+ * the opacity just above it.  Intervals across which any cross section
+ * is far from linear, e.g. because of a resonance, are then bisected.
+ * For each cell, and each frequency of the grid, the table contains
+ * the cumulative opacity of the processes in the order given by
+ * kbf_use.  The last of these is the total opacity
+ * and the rest are used to choose which process is responsible when
+ * a photon is scattered by the continuum.  Between grid points the
+ * opacities are interpolated linearly in frequency.
+ *
+ * The tables are built (see bf_cache_build) at the end of kbf_need,
+ * for as many cells as fit into the memory budget set with the
+ * --bf-cache command line switch.  The opacity of the remaining cells,
+ * and at frequencies outside the grid, is calculated directly.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+#define BF_CACHE_PER_DECADE 50  /* The number of grid points per decade of frequency */
+#define BF_CACHE_EDGE_DELTA 1e-9        /* The fractional offset used to evaluate the opacity on
+                                           either side of an edge */
+#define BF_CACHE_REFINE     2e-3        /* The accuracy with which the grid represents each cross section */
+#define BF_CACHE_MAXDEPTH   8   /* The maximum number of times an interval of the grid is bisected */
+#define BF_CACHE_NCHECK     10  /* The number of cells in which the tables are checked */
+#define BF_CACHE_TOLERANCE  1e-2        /* The fractional error in the total opacity which is accepted */
+
+static int bf_nfreq = 0;        /* The number of points in the frequency grid */
+static double *bf_freq = NULL;  /* The frequencies of the grid */
+static double *bf_eval = NULL;  /* The frequencies at which the opacity is evaluated for each point */
+static double **bf_table = NULL;        /* For each plasma cell, bf_nfreq x kbf_nuse cumulative opacities, or NULL */
+static int bf_ntable = 0;       /* The number of plasma cells for which bf_table is allocated */
+
+/* The interpolation for the last cell and frequency for which the opacity was
+   obtained from the tables. kap_bf is not filled in for these, so bf_lo is
+   set to NULL whenever kap_bf is valid */
+
+static THREAD_LOCAL double *bf_lo = NULL;
+static THREAD_LOCAL double *bf_hi = NULL;
+static THREAD_LOCAL double bf_frac = 0.0;
+static THREAD_LOCAL int bf_nplasma = -1;
+
+
+/* The points from which the grid is constructed. These are sorted so that the point
+   below an edge is before the point above it */
+
+struct bf_point
+{
+  double freq;
+  double eval;
+};
+
+static struct bf_point *bf_points = NULL;
+static int bf_npoints = 0;
+static int bf_nalloc = 0;
+
+static int
+compare_bf_points (const void *a, const void *b)
+{
+  const struct bf_point *x = a, *y = b;
+
+  if (x->freq < y->freq)
+    return (-1);
+  if (x->freq > y->freq)
+    return (1);
+  if (x->eval < y->eval)
+    return (-1);
+  if (x->eval > y->eval)
+    return (1);
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      add a point to the list from which the frequency grid is constructed
+ *
+ * @param [in] double  freq   The frequency of the point
+ * @param [in] double  eval   The frequency at which the opacity is evaluated
+ * @return     The number of points in the list
+ *
+ **********************************************************/
+
+static int
+bf_cache_add_point (double freq, double eval)
+{
+  if (bf_npoints == bf_nalloc)
+  {
+    bf_nalloc = (bf_nalloc == 0) ? 1024 : 2 * bf_nalloc;
+    if ((bf_points = realloc (bf_points, bf_nalloc * sizeof (struct bf_point))) == NULL)
+    {
+      Error ("bf_cache_add_point: Unable to allocate memory for %d points\n", bf_nalloc);
+      Exit (0);
+    }
+  }
+
+  bf_points[bf_npoints].freq = freq;
+  bf_points[bf_npoints].eval = eval;
+
+  return (++bf_npoints);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      add points to an interval of the frequency grid until the
+ * cross sections are close to linear across each part of it
+ *
+ * @param [in] double  e1   The frequency at which the opacity is evaluated at the start of the interval
+ * @param [in] double  e2   The frequency at which the opacity is evaluated at the end of the interval
+ * @param [in] int  depth   The number of times the interval has already been bisected
+ * @return     The number of points which were added
+ *
+ * @details
+ * Many cross sections, particularly those from TOPbase, have resonances which
+ * are much narrower than the spacing of the logarithmic grid.  An interval is
+ * bisected if linear interpolation between its ends misrepresents the cross section
+ * of any process at its midpoint by more than BF_CACHE_REFINE, up to BF_CACHE_MAXDEPTH
+ * times.
+ *
+ **********************************************************/
+
+static int
+bf_cache_refine (double e1, double e2, int depth)
+{
+  double emid, s1, s2, smid;
+  int n, nadd;
+
+  if (depth >= BF_CACHE_MAXDEPTH)
+    return (0);
+
+  emid = 0.5 * (e1 + e2);
+
+  for (n = 0; n < nphot_total; n++)
+  {
+    if (phot_top[n].freq[0] < e1 && e2 < phot_top[n].freq[phot_top[n].np - 1])
+    {
+      s1 = sigma_phot (&phot_top[n], e1);
+      s2 = sigma_phot (&phot_top[n], e2);
+      smid = sigma_phot (&phot_top[n], emid);
+      if (fabs (0.5 * (s1 + s2) - smid) > BF_CACHE_REFINE * smid)
+        break;
+    }
+  }
+
+  if (n == nphot_total)
+    return (0);
+
+  bf_cache_add_point (emid, emid);
+  nadd = 1;
+  nadd += bf_cache_refine (e1, emid, depth + 1);
+  nadd += bf_cache_refine (emid, e2, depth + 1);
+
+  return (nadd);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      construct the frequency grid shared by all cells
+ *
+ * @param [in] double  fmin   The lowest frequency of the grid
+ * @param [in] double  fmax   The highest frequency of the grid
+ * @return     The number of points in the grid
+ *
+ **********************************************************/
+
+static int
+bf_cache_grid (double fmin, double fmax)
+{
+  double ndecades, edge;
+  int nlog, nbase, n, i, j;
+
+  ndecades = log10 (fmax / fmin);
+  nlog = (int) (ndecades * BF_CACHE_PER_DECADE) + 2;
+
+  bf_npoints = 0;
+  for (i = 0; i < nlog; i++)
+  {
+    edge = fmin * pow (10., ndecades * i / (nlog - 1));
+    bf_cache_add_point (edge, edge);
+  }
+
+  for (n = 0; n < nphot_total; n++)
+  {
+    for (j = 0; j < 2; j++)
+    {
+      edge = (j == 0) ? phot_top[n].freq[0] : phot_top[n].freq[phot_top[n].np - 1];
+      if (edge > fmin && edge < fmax)
+      {
+        bf_cache_add_point (edge, edge * (1. - BF_CACHE_EDGE_DELTA));
+        bf_cache_add_point (edge, edge * (1. + BF_CACHE_EDGE_DELTA));
+      }
+    }
+  }
+
+  qsort (bf_points, bf_npoints, sizeof (struct bf_point), compare_bf_points);
+
+  nbase = bf_npoints;
+  for (i = 0; i < nbase - 1; i++)
+  {
+    if (bf_points[i + 1].freq > bf_points[i].freq)
+    {
+      bf_cache_refine (bf_points[i].eval, bf_points[i + 1].eval, 0);
+    }
+  }
+
+  qsort (bf_points, bf_npoints, sizeof (struct bf_point), compare_bf_points);
+
+  free (bf_freq);
+  free (bf_eval);
+  bf_freq = calloc (bf_npoints, sizeof (double));
+  bf_eval = calloc (bf_npoints, sizeof (double));
+  if (bf_freq == NULL || bf_eval == NULL)
+  {
+    Error ("bf_cache_grid: Unable to allocate memory for %d points\n", bf_npoints);
+    Exit (0);
+  }
+
+  for (i = 0; i < bf_npoints; i++)
+  {
+    bf_freq[i] = bf_points[i].freq;
+    bf_eval[i] = bf_points[i].eval;
+  }
+
+  return (bf_npoints);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      find the interval of the frequency grid containing a frequency
+ *
+ * @param [in] double  freq   The frequency
+ * @return     i such that bf_freq[i] <= freq < bf_freq[i+1], or -1 if freq is
+ * outside the grid
+ *
+ **********************************************************/
+
+static int
+bf_cache_interval (double freq)
+{
+  int lo, hi, mid;
+
+  if (bf_nfreq < 2 || freq < bf_freq[0] || freq >= bf_freq[bf_nfreq - 1])
+    return (-1);
+
+  lo = 0;
+  hi = bf_nfreq - 1;
+  while (hi - lo > 1)
+  {
+    mid = (lo + hi) / 2;
+    if (bf_freq[mid] <= freq)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return (lo);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      compare the tabulated and directly calculated opacities
+ *
+ * @param [out] int *  nworst   The plasma cell with the largest error
+ * @param [out] double *  fworst   The frequency of the largest error
+ * @return     The largest fractional error in the total opacity
+ *
+ * @details
+ * The total opacity is compared at the midpoint of every interval of the
+ * grid, in up to BF_CACHE_NCHECK tabulated cells spread through the grid.
+ *
+ **********************************************************/
+
+static double
+bf_cache_check (int *nworst, double *fworst)
+{
+  PlasmaPtr xplasma;
+  double freq, direct, tabulated, err, errmax, fill;
+  int nplasma, nchecked, nstep, i, nn;
+
+  errmax = 0.0;
+  *nworst = -1;
+  *fworst = 0.0;
+  nchecked = 0;
+  nstep = NPLASMA / BF_CACHE_NCHECK + 1;
+
+  for (nplasma = 0; nplasma < NPLASMA && nchecked < BF_CACHE_NCHECK; nplasma += nstep)
+  {
+    if (bf_table[nplasma] == NULL)
+      continue;
+
+    xplasma = &plasmamain[nplasma];
+    fill = zdom[wmain[xplasma->nwind].ndom].fill;
+
+    for (i = 0; i < bf_nfreq - 1; i++)
+    {
+      if (bf_freq[i + 1] <= bf_freq[i])
+        continue;
+
+      freq = 0.5 * (bf_freq[i] + bf_freq[i + 1]);
+
+      direct = 0.0;
+      for (nn = 0; nn < xplasma->kbf_nuse; nn++)
+      {
+        direct += kappa_bf_process (xplasma, xplasma->kbf_use[nn], freq, fill);
+      }
+
+      tabulated = bf_cache_kappa (xplasma, freq, 0);
+
+      if (direct > 0.0)
+      {
+        err = fabs (tabulated - direct) / direct;
+        if (err > errmax)
+        {
+          errmax = err;
+          *nworst = nplasma;
+          *fworst = freq;
+        }
+      }
+    }
+    nchecked++;
+  }
+
+  bf_lo = NULL;
+
+  return (errmax);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      tabulate the bound-free opacity in each cell
+ *
+ * @param [in] double  freq_min   The lowest frequency of interest
+ * @param [in] double  freq_max   The highest frequency of interest
+ * @return     The number of cells which were tabulated
+ *
+ * @details
+ * This is called by kbf_need, once the processes which are
+ * important in each cell are known.  Cells are tabulated in order
+ * until the memory budget, modes.bf_cache_mb, is used up.
+ *
+ * ### Notes ###
+ * The grid extends a factor of two beyond freq_min and freq_max, so that
+ * photons which are Doppler shifted out of the band are still covered.
+ *
+ **********************************************************/
+
+int
+bf_cache_build (double freq_min, double freq_max)
+{
+  PlasmaPtr xplasma;
+  double budget, used, bytes, fill, errmax, fworst;
+  double density, scale;
+  double *sigma, *table;
+  int nplasma, ncached, i, nn, n, nuse, nworst;
+
+  bf_nfreq = bf_cache_grid (0.5 * freq_min, 2.0 * freq_max);
+
+  if (bf_ntable != NPLASMA)
+  {
+    bf_cache_free ();
+    bf_table = calloc (NPLASMA, sizeof (double *));
+    if (bf_table == NULL)
+    {
+      Error ("bf_cache_build: Unable to allocate memory for %d cells\n", NPLASMA);
+      Exit (0);
+    }
+    bf_ntable = NPLASMA;
+  }
+
+  budget = modes.bf_cache_mb * 1024. * 1024.;
+  used = 0.0;
+  ncached = 0;
+
+  /* The cross sections are the same in every cell, so they are evaluated once */
+
+  if ((sigma = calloc ((size_t) nphot_total * bf_nfreq, sizeof (double))) == NULL)
+  {
+    Error ("bf_cache_build: Unable to allocate memory for the cross sections\n");
+    Exit (0);
+  }
+
+  for (n = 0; n < nphot_total; n++)
+  {
+    for (i = 0; i < bf_nfreq; i++)
+    {
+      if (bf_eval[i] > phot_top[n].freq[0] && bf_eval[i] < phot_top[n].freq[phot_top[n].np - 1])
+      {
+        sigma[n * bf_nfreq + i] = sigma_phot (&phot_top[n], bf_eval[i]);
+      }
+    }
+  }
+
+  for (nplasma = 0; nplasma < NPLASMA; nplasma++)
+  {
+    xplasma = &plasmamain[nplasma];
+    nuse = xplasma->kbf_nuse;
+    bytes = (double) bf_nfreq *nuse * sizeof (double);
+
+    free (bf_table[nplasma]);
+    bf_table[nplasma] = NULL;
+
+    if (nuse == 0 || used + bytes > budget)
+      continue;
+
+    if ((table = bf_table[nplasma] = malloc (bytes)) == NULL)
+      continue;
+
+    used += bytes;
+    ncached++;
+
+    fill = zdom[wmain[xplasma->nwind].ndom].fill;
+
+    /* This follows kappa_bf_process, which is used for the direct calculation */
+
+    for (nn = 0; nn < nuse; nn++)
+    {
+      n = xplasma->kbf_use[nn];
+      density = den_config (xplasma, phot_top[n].nlev);
+      scale = (density > DENSITY_PHOT_MIN || phot_top[n].macro_info == TRUE) ? density * fill : 0.0;
+
+      for (i = 0; i < bf_nfreq; i++)
+      {
+        table[i * nuse + nn] = sigma[n * bf_nfreq + i] * scale;
+        if (nn > 0)
+          table[i * nuse + nn] += table[i * nuse + nn - 1];
+      }
+    }
+  }
+
+  free (sigma);
+
+  bf_lo = NULL;
+
+  errmax = bf_cache_check (&nworst, &fworst);
+
+  Log ("bf_cache_build: Tabulated the bound-free opacity of %d of %d cells at %d frequencies (%.1f MB)\n",
+       ncached, NPLASMA, bf_nfreq, used / 1024. / 1024.);
+  Log ("bf_cache_build: The largest fractional error in the tabulated opacities was %.2e (at %.3e Hz in plasma cell %d)\n", errmax,
+       fworst, nworst);
+
+  if (errmax > BF_CACHE_TOLERANCE)
+  {
+    Error ("bf_cache_build: The tabulated bound-free opacities differ by up to %.2e from the direct calculation\n", errmax);
+  }
+
+  if (ncached < NPLASMA)
+  {
+    Log ("bf_cache_build: The opacity of the remaining cells will be calculated directly; use a larger --bf-cache to tabulate them\n");
+  }
+
+  return (ncached);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      interpolate the total bound-free opacity of a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell of interest
+ * @param [in] double  freq   The frequency (in the CMF)
+ * @param [in] int  macro_all   As for kappa_bf; only 0, all processes, is tabulated
+ * @return     The total bf opacity, or -1 if it has to be calculated directly
+ *
+ * @details
+ * On success, the interpolation is remembered, so that bf_cache_select
+ * and bf_cache_expand can use it.
+ *
+ **********************************************************/
+
+double
+bf_cache_kappa (PlasmaPtr xplasma, double freq, int macro_all)
+{
+  double *table;
+  int i, nuse;
+
+  bf_lo = NULL;
+
+  if (macro_all != 0 || bf_table == NULL || (table = bf_table[xplasma->nplasma]) == NULL)
+    return (-1.0);
+
+  if ((i = bf_cache_interval (freq)) < 0)
+    return (-1.0);
+
+  nuse = xplasma->kbf_nuse;
+  bf_lo = &table[i * nuse];
+  bf_hi = &table[(i + 1) * nuse];
+  bf_frac = (freq - bf_freq[i]) / (bf_freq[i + 1] - bf_freq[i]);
+  bf_nplasma = xplasma->nplasma;
+
+  return ((1. - bf_frac) * bf_lo[nuse - 1] + bf_frac * bf_hi[nuse - 1]);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      choose the bound-free process responsible for a continuum scatter
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell of interest
+ * @param [in] double  threshold   A random fraction of the total bf opacity
+ * @return     The index in kbf_use of the process, or -1 if the last opacity
+ * for this cell was not obtained from the tables
+ *
+ * @details
+ * The process is the first one for which the cumulative opacity exceeds
+ * threshold, which is found by bisection.
+ *
+ **********************************************************/
+
+int
+bf_cache_select (PlasmaPtr xplasma, double threshold)
+{
+  int lo, hi, mid;
+
+  if (bf_lo == NULL || bf_nplasma != xplasma->nplasma)
+    return (-1);
+
+  lo = 0;
+  hi = xplasma->kbf_nuse - 1;
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if ((1. - bf_frac) * bf_lo[mid] + bf_frac * bf_hi[mid] > threshold)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return (lo);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      fill in kap_bf from the last interpolation in the tables
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * When the opacity comes from the tables, the opacities of the individual
+ * processes are only calculated if they are needed, e.g. by
+ * bf_estimators_increment.
+ *
+ **********************************************************/
+
+int
+bf_cache_expand (void)
+{
+  double x, last;
+  int nn, nuse;
+
+  if (bf_lo == NULL)
+    return (0);
+
+  if (kap_bf_size < nphot_total)
+    kappa_bf_work ();
+
+  nuse = plasmamain[bf_nplasma].kbf_nuse;
+  last = 0.0;
+  for (nn = 0; nn < nuse; nn++)
+  {
+    x = (1. - bf_frac) * bf_lo[nn] + bf_frac * bf_hi[nn];
+    kap_bf[nn] = x - last;
+    last = x;
+  }
+
+  bf_lo = NULL;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      release the memory used by the tables
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+bf_cache_free (void)
+{
+  int n;
+
+  if (bf_table != NULL)
+  {
+    for (n = 0; n < bf_ntable; n++)
+    {
+      free (bf_table[n]);
+    }
+    free (bf_table);
+  }
+
+  bf_table = NULL;
+  bf_ntable = 0;
+  bf_lo = NULL;
+
+  return (0);
+}
@@ -674,6 +674,33 @@ cdf_gen_from_array (cdf, x, y, n_xy, xmin, xmax)
  * @return   x  a random value fronm the cdf between xmin and xmax
  *
  * @details
+ * This is cdf_get_rand_array applied to the arrays in the structure.
+ *
+ **********************************************************/
+
+double
+cdf_get_rand (cdf)
+     CdfPtr cdf;
+{
+  return (cdf_get_rand_array (cdf->x, cdf->y, cdf->d, cdf->ncdf));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Generate a single sample from a cdf stored as separate arrays
+ *
+ * @param [in] double *  x   The positions at which the cdf is given
+ * @param [in] double *  y   The value of the cdf at x
+ * @param [in] double *  d   The rate of change of the cdf at x
+ * @param [in] int  ncdf   The index of the last point, so there are ncdf+1 points
+ *
+ * @return   x  a random value fronm the cdf between xmin and xmax
+ *
+ * @details
+ * This allows cdfs which are kept in arrays of exactly the size needed, rather than
+ * in a Cdf structure, to be sampled.
  *
  * ### Notes ###
  *
@@ -684,8 +711,9 @@ cdf_gen_from_array (cdf, x, y, n_xy, xmin, xmax)
  **********************************************************/
 
 double
-cdf_get_rand (cdf)
-     CdfPtr cdf;
+cdf_get_rand_array (xcdf, ycdf, dcdf, ncdf)
+     double *xcdf, *ycdf, *dcdf;
+     int ncdf;
 {
   double x, r;
   int i, j;
@@ -695,7 +723,7 @@ cdf_get_rand (cdf)
 
 /* Gnerate a random number and then find the interval n the cdf in which x lies */
   r = random_number (0.0, 1.0); //This *excludes* 0.0 and 1.0.
-  i = gsl_interp_bsearch (cdf->y, r, 0, cdf->ncdf);
+  i = gsl_interp_bsearch (ycdf, r, 0, ncdf);
 
 /* Now calculate a place within that interval - we use the gradient of the 
  * CDF to get a more accurate value between the CDF points
@@ -705,11 +733,11 @@ cdf_get_rand (cdf)
  */
   q = random_number (0.0, 1.0);
 
-  if (fabs (a = (cdf->d[i + 1] - cdf->d[i])) > 1.e-6)
+  if (fabs (a = (dcdf[i + 1] - dcdf[i])) > 1.e-6)
   {
     a *= 0.5;
-    b = cdf->d[i];
-    c = (-0.5) * (cdf->d[i + 1] + cdf->d[i]) * q;
+    b = dcdf[i];
+    c = (-0.5) * (dcdf[i + 1] + dcdf[i]) * q;
 
     if ((j = quadratic (a, b, c, s)) < 0)
     {
@@ -725,9 +753,9 @@ cdf_get_rand (cdf)
     }
   }
 
-  x = cdf->x[i] * (1. - q) + cdf->x[i + 1] * q;
+  x = xcdf[i] * (1. - q) + xcdf[i + 1] * q;
 
-  if (!(cdf->x[0] <= x && x <= cdf->x[cdf->ncdf]))
+  if (!(xcdf[0] <= x && x <= xcdf[ncdf]))
   {
     Error ("cdf_get_rand: %g %d %g %g\n", r, i, q, x);
   }
@@ -0,0 +1,168 @@
+/***********************************************************/
+/** @file  communicate_atomic.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief Functions for sharing the atomic data between ranks
+ *
+ * Normally every rank reads the atomic data itself, and keeps its own copy.
+ * With the --shared-atomic switch, only rank 0 reads the data.  It is then
+ * packed into a single block, laid out as in the binary cache (see
+ * atomicdata_cache.c), and broadcast to one rank on each node, which places
+ * it in an MPI-3 shared memory window.  Every rank on the node then takes its
+ * small structures, e.g. ele and ion, from the window, but uses the largest
+ * arrays, line, coll_stren, phot_top, inner_cross and inner_elec_yield, where
+ * they are, so there is only one copy of these on each node.
+ *
+ * The arrays of pointers which order the lines and cross sections by
+ * frequency are stored in the window as indices, because the window is not
+ * at the same address in every rank, and each rank rebuilds its own pointers
+ * from them.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+#define SHARE_ATOMIC_CHUNK 1073741824   /* The largest number of bytes sent in a single broadcast */
+
+#ifdef MPI_ON
+static MPI_Win atomic_win = MPI_WIN_NULL;       /* The window containing the shared atomic data */
+#endif
+
+
+
+/**********************************************************/
+/**
+ * @brief Release the shared atomic data
+ *
+ * @return Always returns 0
+ *
+ * @details
+ * This is collective over all ranks, and is needed before the atomic data
+ * can be read again, e.g. when a run is restarted.
+ *
+ **********************************************************/
+
+static int
+share_atomic_data_free (void)
+{
+#ifdef MPI_ON
+  if (atomic_win != MPI_WIN_NULL)
+  {
+    line = NULL;
+    coll_stren = NULL;
+    phot_top = inner_cross = NULL;
+    inner_elec_yield = NULL;
+    atomic_data_shared = FALSE;
+    MPI_Win_free (&atomic_win);
+  }
+#endif
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief Read the atomic data on rank 0, and share it with the other ranks
+ *
+ * @param [in] char  masterfile[]   The masterfile
+ * @return Always returns 0
+ *
+ * @details
+ * This must be called by all ranks.  Rank 0 reads the data with
+ * read_atomic_data, so it uses, and if need be writes, the binary cache as
+ * usual, and carries out all of the checks on the data.
+ *
+ * Once the window has been filled, it is made read only in each rank, where
+ * the system allows this, so that any attempt to change the shared data
+ * fails immediately rather than affecting the other ranks.
+ *
+ **********************************************************/
+
+int
+share_atomic_data (char masterfile[])
+{
+#ifdef MPI_ON
+  MPI_Comm node_comm, leader_comm;
+  MPI_Aint win_size;
+  char *image, *base;
+  size_t nbytes, offset, n;
+  uintptr_t page;
+  int node_rank, node_size, disp_unit;
+  double t0;
+
+  t0 = timer ();
+
+  share_atomic_data_free ();
+
+  MPI_Comm_split_type (MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank_global, MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank (node_comm, &node_rank);
+  MPI_Comm_size (node_comm, &node_size);
+  MPI_Comm_split (MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank_global, &leader_comm);
+
+  image = NULL;
+  nbytes = 0;
+  if (rank_global == 0)
+  {
+    read_atomic_data (masterfile);
+    if ((image = atomic_cache_pack (&nbytes)) == NULL)
+    {
+      Error ("share_atomic_data: Unable to allocate memory to pack the atomic data\n");
+      Exit (1);
+    }
+  }
+
+  MPI_Bcast (&nbytes, sizeof (nbytes), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+  /* Rank 0 is the first rank on its node, and so is also rank 0 of leader_comm */
+
+  MPI_Win_allocate_shared (node_rank == 0 ? nbytes : 0, 1, MPI_INFO_NULL, node_comm, &base, &atomic_win);
+  MPI_Win_shared_query (atomic_win, 0, &win_size, &disp_unit, &base);
+
+  if (node_rank == 0)
+  {
+    if (rank_global == 0)
+    {
+      memcpy (base, image, nbytes);
+      free (image);
+    }
+    for (offset = 0; offset < nbytes; offset += n)
+    {
+      n = nbytes - offset < SHARE_ATOMIC_CHUNK ? nbytes - offset : SHARE_ATOMIC_CHUNK;
+      MPI_Bcast (base + offset, (int) n, MPI_BYTE, 0, leader_comm);
+    }
+    MPI_Comm_free (&leader_comm);
+  }
+
+  MPI_Barrier (node_comm);
+
+  if (atomic_cache_unpack (base, TRUE))
+  {
+    Error ("share_atomic_data: The shared atomic data is inconsistent\n");
+    Exit (1);
+  }
+
+  page = sysconf (_SC_PAGESIZE);
+  if ((uintptr_t) base % page == 0)
+    mprotect (base, nbytes / page * page, PROT_READ);
+
+  MPI_Barrier (node_comm);
+  MPI_Comm_free (&node_comm);
+
+  Log ("Get_atomic_data: Sharing %.1f MB of atomic data between the %d ranks on this node\n", nbytes / 1048576., node_size);
+  Log ("Data of %3d elements, %3d ions, %5d levels, %5d lines, and %5d topbase records\n", nelements, nions, nlevels, nlines, ntop_phot);
+  Log_silent ("share_atomic_data: The atomic data was shared in %.2f s\n", timer () - t0);
+#endif
+
+  return (0);
+}
@@ -0,0 +1,593 @@
+/***********************************************************/
+/** @file  communicate_cells.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief Functions for exchanging the properties of wind, plasma
+ * and macro-atom cells between MPI ranks
+ *
+ * Many of the calculations that update the cells of the wind are
+ * divided between the MPI ranks, with each rank dealing with a
+ * contiguous range of cells, or for the wind update a list of cells
+ * chosen to balance the work, after which the updated cells have to be
+ * sent to all of the other ranks.  The routines here carry out this
+ * exchange for a list of fields which is set up by the caller, e.g.
+ *
+ *   struct comm_cells comm;
+ *
+ *   comm_cells_init (&comm, "wind cooling");
+ *   COMM_ADD_VALUE (&comm, plasmamain, plasma_dummy, cool_tot);
+ *   COMM_ADD_ARRAY (&comm, plasmamain, plasma_dummy, density, nions);
+ *   communicate_cells (&comm, n_start, n_stop);
+ *
+ * The fields of each cell are copied into a single contiguous block,
+ * and the blocks from all of the ranks are exchanged with one call to
+ * MPI_Allgatherv, rather than each rank packing its cells field by
+ * field and broadcasting them in turn.  Fields which are adjacent
+ * in the cell structure are copied as a single block.
+ *
+ * The amount of data which has been exchanged, and the time this took,
+ * are recorded and written to the log at the end of each cycle by
+ * report_cell_communication.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+static double comm_cells_bytes = 0;     /* The number of bytes received by this rank since the last report */
+static double comm_cells_time = 0;      /* The time spent exchanging cells since the last report */
+static int comm_cells_calls = 0;        /* The number of exchanges since the last report */
+
+
+
+/**********************************************************/
+/**
+ * @brief      Initialise the description of an exchange of cells
+ *
+ * @param [out] CommCellsPtr  comm   The description to initialise
+ * @param [in] char *  name   A short description of the exchange
+ * @return     Nothing
+ *
+ **********************************************************/
+
+void
+comm_cells_init (CommCellsPtr comm, char *name)
+{
+  strncpy (comm->name, name, LINELENGTH - 1);
+  comm->name[LINELENGTH - 1] = '\0';
+  comm->nfields = 0;
+  comm->nbytes = 0;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Append a new field to the list of those which are exchanged
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int  type   COMM_VALUE, COMM_ARRAY or COMM_MATRIX
+ * @param [in] void *  cells   The first element of the array of cell structures
+ * @param [in] size_t  stride   The size of one cell structure
+ * @param [in] size_t  offset   The offset of the field (or the pointer to it)
+ * in the cell structure
+ * @param [in] size_t  nbytes   The number of bytes in the field
+ * @return     A pointer to the new field
+ *
+ **********************************************************/
+
+static CommFieldPtr
+comm_cells_new_field (CommCellsPtr comm, int type, void *cells, size_t stride, size_t offset, size_t nbytes)
+{
+  CommFieldPtr field;
+
+  if (comm->nfields == NCOMM_FIELDS)
+  {
+    Error ("comm_cells_new_field: Too many fields (%d) in the exchange of %s\n", NCOMM_FIELDS, comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  field = &comm->field[comm->nfields];
+  field->type = type;
+  field->cells = (char *) cells;
+  field->stride = stride;
+  field->offset = offset;
+  field->nbytes = nbytes;
+  field->conditional = FALSE;
+  field->flag_offset = 0;
+
+  comm->nfields++;
+  comm->nbytes += nbytes;
+
+  return (field);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add a field to the list of those which are exchanged
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int  type   COMM_VALUE, COMM_ARRAY or COMM_MATRIX
+ * @param [in] void *  cells   The first element of the array of cell structures
+ * @param [in] size_t  stride   The size of one cell structure
+ * @param [in] size_t  offset   The offset of the field (or the pointer to it)
+ * in the cell structure
+ * @param [in] size_t  nbytes   The number of bytes in the field
+ * @return     Nothing
+ *
+ * @details
+ * This is normally called via the COMM_ADD_VALUE and COMM_ADD_ARRAY macros
+ * defined in sirocco.h.  If the field directly follows the previous field
+ * in the same cell structure, the two are merged, so that members of a
+ * structure which are listed in the order in which they are declared are
+ * copied with a single call to memcpy.
+ *
+ **********************************************************/
+
+void
+comm_cells_add (CommCellsPtr comm, int type, void *cells, size_t stride, size_t offset, size_t nbytes)
+{
+  CommFieldPtr last;
+
+  if (nbytes == 0)
+    return;
+
+  if (comm->nfields > 0 && type == COMM_VALUE)
+  {
+    last = &comm->field[comm->nfields - 1];
+    if (last->type == COMM_VALUE && last->conditional == FALSE && last->cells == (char *) cells && last->offset + last->nbytes == offset)
+    {
+      last->nbytes += nbytes;
+      comm->nbytes += nbytes;
+      return;
+    }
+  }
+
+  comm_cells_new_field (comm, type, cells, stride, offset, nbytes);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add a field which is only exchanged for cells in which
+ * a flag is set
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int  type   COMM_VALUE, COMM_ARRAY or COMM_MATRIX
+ * @param [in] void *  cells   The first element of the array of cell structures
+ * @param [in] size_t  stride   The size of one cell structure
+ * @param [in] size_t  offset   The offset of the field (or the pointer to it)
+ * in the cell structure
+ * @param [in] size_t  nbytes   The number of bytes in the field
+ * @param [in] size_t  flag_offset   The offset in the cell structure of an int
+ * which is TRUE if the field is to be exchanged for that cell
+ * @return     Nothing
+ *
+ * @details
+ * This is used for arrays which are only allocated in some cells, such as
+ * the macro-atom matrices, where the pointer in the remaining cells cannot
+ * be relied on to be NULL, e.g. after the wind has been read from a file.
+ * Space for the field is still reserved in the block for every cell.
+ *
+ **********************************************************/
+
+void
+comm_cells_add_conditional (CommCellsPtr comm, int type, void *cells, size_t stride, size_t offset, size_t nbytes, size_t flag_offset)
+{
+  CommFieldPtr field;
+
+  if (nbytes == 0)
+    return;
+
+  field = comm_cells_new_field (comm, type, cells, stride, offset, nbytes);
+  field->conditional = TRUE;
+  field->flag_offset = flag_offset;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the memory associated with a field of one cell
+ *
+ * @param [in] CommFieldPtr  field   The field
+ * @param [in] int  n   The cell
+ * @return     A pointer to the start of the field, or NULL if an
+ * array or matrix has not been allocated for this cell
+ *
+ **********************************************************/
+
+static char *
+comm_field_address (CommFieldPtr field, int n)
+{
+  char *member;
+  double **rows;
+
+  if (field->conditional && *(int *) (field->cells + (size_t) n * field->stride + field->flag_offset) != TRUE)
+  {
+    return (NULL);
+  }
+
+  member = field->cells + (size_t) n *field->stride + field->offset;
+
+  if (field->type == COMM_ARRAY)
+  {
+    return (*(char **) member);
+  }
+  else if (field->type == COMM_MATRIX)
+  {
+    rows = *(double ***) member;
+    return (rows == NULL ? NULL : (char *) rows[0]);
+  }
+
+  return (member);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy the fields of a list of cells into a buffer
+ *
+ * @param [in] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int *  cells   The cells to copy
+ * @param [in] int  n_cells   The number of cells to copy
+ * @param [out] char *  buffer   The buffer
+ * @return     Nothing
+ *
+ * @details
+ * The fields of each cell occupy a contiguous block of comm->nbytes.  Arrays
+ * which have not been allocated for a cell are sent as zeros.
+ *
+ **********************************************************/
+
+static void
+comm_cells_pack (CommCellsPtr comm, const int *cells, int n_cells, char *buffer)
+{
+  int n, i;
+  char *src;
+
+  for (n = 0; n < n_cells; n++)
+  {
+    for (i = 0; i < comm->nfields; i++)
+    {
+      src = comm_field_address (&comm->field[i], cells[n]);
+      if (src != NULL)
+        memcpy (buffer, src, comm->field[i].nbytes);
+      else
+        memset (buffer, 0, comm->field[i].nbytes);
+      buffer += comm->field[i].nbytes;
+    }
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy the fields of a list of cells out of a buffer
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int *  cells   The cells to copy
+ * @param [in] int  n_cells   The number of cells to copy
+ * @param [in] char *  buffer   The buffer filled by comm_cells_pack
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+comm_cells_unpack (CommCellsPtr comm, const int *cells, int n_cells, char *buffer)
+{
+  int n, i;
+  char *dest;
+
+  for (n = 0; n < n_cells; n++)
+  {
+    for (i = 0; i < comm->nfields; i++)
+    {
+      dest = comm_field_address (&comm->field[i], cells[n]);
+      if (dest != NULL)
+        memcpy (dest, buffer, comm->field[i].nbytes);
+      buffer += comm->field[i].nbytes;
+    }
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Exchange the cells updated by each rank, once every rank
+ * knows which cells the others have updated
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int *  all_cells   The cells updated by every rank, those
+ * of rank n starting at all_cells[first[n]]
+ * @param [in] int *  n_cells   The number of cells updated by each rank
+ * @param [in] int *  first   The position in all_cells of the first cell of each rank
+ * @param [in] double  t_start   The time at which the exchange began
+ * @return     Nothing
+ *
+ * @details
+ * The cells are exchanged in a series of rounds, with each rank contributing
+ * up to n_round cells per round, chosen so that the buffer which receives the
+ * cells from all ranks is no larger than COMM_BUFFER_MAX.
+ *
+ **********************************************************/
+
+#ifdef MPI_ON
+static void
+comm_cells_exchange (CommCellsPtr comm, const int *all_cells, const int *n_cells, const int *first, double t_start)
+{
+  int *counts, *displs;
+  int n, n_max, n_round, nrounds, iround;
+  char *send_buffer, *recv_buffer;
+  double t0, nbytes;
+
+  t0 = prof_start ();
+
+  counts = calloc (np_mpi_global, sizeof (int));
+  displs = calloc (np_mpi_global, sizeof (int));
+  if (counts == NULL || displs == NULL)
+  {
+    Error ("communicate_cells: Unable to allocate memory to exchange %s\n", comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  n_max = 0;
+  for (n = 0; n < np_mpi_global; n++)
+  {
+    if (n_cells[n] > n_max)
+      n_max = n_cells[n];
+  }
+
+  n_round = COMM_BUFFER_MAX / (np_mpi_global * comm->nbytes);
+  if (n_round < 1)
+    n_round = 1;
+  if (n_round > n_max)
+    n_round = n_max;
+  nrounds = n_round > 0 ? (n_max + n_round - 1) / n_round : 0;
+
+  send_buffer = malloc (n_round * comm->nbytes + 1);
+  recv_buffer = malloc (np_mpi_global * n_round * comm->nbytes + 1);
+  if (send_buffer == NULL || recv_buffer == NULL)
+  {
+    Error ("communicate_cells: Unable to allocate %.1f MB to exchange %s\n", 1e-6 * (np_mpi_global + 1) * n_round * comm->nbytes,
+           comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  nbytes = 0;
+  for (iround = 0; iround < nrounds; iround++)
+  {
+    for (n = 0; n < np_mpi_global; n++)
+    {
+      counts[n] = n_cells[n] - iround * n_round;
+      if (counts[n] > n_round)
+        counts[n] = n_round;
+      if (counts[n] < 0)
+        counts[n] = 0;
+      counts[n] *= comm->nbytes;
+      displs[n] = n * n_round * comm->nbytes;
+    }
+
+    comm_cells_pack (comm, &all_cells[first[rank_global] + iround * n_round], counts[rank_global] / comm->nbytes, send_buffer);
+
+    MPI_Allgatherv (send_buffer, counts[rank_global], MPI_BYTE, recv_buffer, counts, displs, MPI_BYTE, MPI_COMM_WORLD);
+
+    for (n = 0; n < np_mpi_global; n++)
+    {
+      if (n != rank_global && counts[n] > 0)
+      {
+        comm_cells_unpack (comm, &all_cells[first[n] + iround * n_round], counts[n] / comm->nbytes, recv_buffer + displs[n]);
+        nbytes += counts[n];
+      }
+    }
+  }
+
+  free (send_buffer);
+  free (recv_buffer);
+  free (displs);
+  free (counts);
+
+  comm_cells_bytes += nbytes;
+  comm_cells_time += MPI_Wtime () - t_start;
+  comm_cells_calls++;
+  prof_stop (PROF_COMM, t0);
+
+  Log_silent ("communicate_cells: Received %.3f MB of %s (%d fields, %d bytes per cell) in %d rounds in %.3f s\n", 1e-6 * nbytes,
+              comm->name, comm->nfields, (int) comm->nbytes, nrounds, MPI_Wtime () - t_start);
+}
+#endif
+
+
+
+/**********************************************************/
+/**
+ * @brief      Send the cells updated by this rank to all other ranks, and
+ * receive the cells updated by the other ranks
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int  n_start   The first cell updated by this rank
+ * @param [in] int  n_stop   One more than the last cell updated by this rank
+ * @return     Nothing
+ *
+ * @details
+ * Each rank must call this routine with the same list of fields.  The ranks
+ * first exchange the ranges of cells they have updated, so these need not be
+ * the same size.
+ *
+ * ### Notes ###
+ *
+ * The cells are sent as bytes, which assumes that the ranks all use the
+ * same representation of ints and doubles.
+ *
+ **********************************************************/
+
+void
+communicate_cells (CommCellsPtr comm, const int n_start, const int n_stop)
+{
+#ifdef MPI_ON
+  int range[2], *ranges;
+  int *n_cells, *first, *all_cells;
+  int n, i, ntot;
+  double t_start;
+
+  if (np_mpi_global == 1 || comm->nbytes == 0)
+    return;
+
+  t_start = MPI_Wtime ();
+
+  ranges = calloc (2 * np_mpi_global, sizeof (int));
+  n_cells = calloc (np_mpi_global, sizeof (int));
+  first = calloc (np_mpi_global, sizeof (int));
+  if (ranges == NULL || n_cells == NULL || first == NULL)
+  {
+    Error ("communicate_cells: Unable to allocate memory to exchange %s\n", comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  range[0] = n_start;
+  range[1] = n_stop - n_start;
+  MPI_Allgather (range, 2, MPI_INT, ranges, 2, MPI_INT, MPI_COMM_WORLD);
+
+  ntot = 0;
+  for (n = 0; n < np_mpi_global; n++)
+  {
+    n_cells[n] = ranges[2 * n + 1];
+    first[n] = ntot;
+    ntot += n_cells[n];
+  }
+
+  if ((all_cells = calloc (ntot + 1, sizeof (int))) == NULL)
+  {
+    Error ("communicate_cells: Unable to allocate memory to exchange %s\n", comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  for (n = 0; n < np_mpi_global; n++)
+  {
+    for (i = 0; i < n_cells[n]; i++)
+      all_cells[first[n] + i] = ranges[2 * n] + i;
+  }
+
+  comm_cells_exchange (comm, all_cells, n_cells, first, t_start);
+
+  free (all_cells);
+  free (first);
+  free (n_cells);
+  free (ranges);
+#endif
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Send a list of cells updated by this rank to all other ranks,
+ * and receive the cells updated by the other ranks
+ *
+ * @param [in, out] CommCellsPtr  comm   The description of the exchange
+ * @param [in] int *  cells   The cells updated by this rank
+ * @param [in] int  n_cells_rank   The number of cells updated by this rank
+ * @return     Nothing
+ *
+ * @details
+ * This is the same as communicate_cells, except that the cells updated by a
+ * rank need not be contiguous, or in order, e.g. when they have been chosen by
+ * get_parallel_ncost.  The lists of cells are exchanged first, so that each
+ * rank knows where the cells it receives belong.
+ *
+ **********************************************************/
+
+void
+communicate_cell_list (CommCellsPtr comm, const int *cells, const int n_cells_rank)
+{
+#ifdef MPI_ON
+  int *n_cells, *first, *all_cells;
+  int n, ntot;
+  double t_start;
+
+  if (np_mpi_global == 1 || comm->nbytes == 0)
+    return;
+
+  t_start = MPI_Wtime ();
+
+  n_cells = calloc (np_mpi_global, sizeof (int));
+  first = calloc (np_mpi_global, sizeof (int));
+  if (n_cells == NULL || first == NULL)
+  {
+    Error ("communicate_cell_list: Unable to allocate memory to exchange %s\n", comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  MPI_Allgather (&n_cells_rank, 1, MPI_INT, n_cells, 1, MPI_INT, MPI_COMM_WORLD);
+
+  ntot = 0;
+  for (n = 0; n < np_mpi_global; n++)
+  {
+    first[n] = ntot;
+    ntot += n_cells[n];
+  }
+
+  if ((all_cells = calloc (ntot + 1, sizeof (int))) == NULL)
+  {
+    Error ("communicate_cell_list: Unable to allocate memory to exchange %s\n", comm->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  MPI_Allgatherv (cells, n_cells_rank, MPI_INT, all_cells, n_cells, first, MPI_INT, MPI_COMM_WORLD);
+
+  comm_cells_exchange (comm, all_cells, n_cells, first, t_start);
+
+  free (all_cells);
+  free (first);
+  free (n_cells);
+#endif
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Log the amount of cell data exchanged between ranks since
+ * the last call, and the time this took
+ *
+ * @return     Nothing
+ *
+ * @details
+ * This is called at the end of each ionization and spectral cycle.
+ * The totals are summed over the ranks, and reset.
+ *
+ **********************************************************/
+
+void
+report_cell_communication (void)
+{
+#ifdef MPI_ON
+  double local[2], total[2];
+
+  local[0] = comm_cells_bytes;
+  local[1] = comm_cells_time;
+  MPI_Reduce (local, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+  if (rank_global == 0 && comm_cells_calls > 0)
+  {
+    Log ("Cell communication: %d exchanges moved %.3f MB between %d ranks, taking %.3f s per rank\n", comm_cells_calls, 1e-6 * total[0],
+         np_mpi_global, total[1] / np_mpi_global);
+  }
+
+  comm_cells_bytes = 0;
+  comm_cells_time = 0;
+  comm_cells_calls = 0;
+#endif
+}
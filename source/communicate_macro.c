@@ -9,28 +9,27 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
 
 #include "atomic.h"
 #include "sirocco.h"
 
+#define MACRO_ARRAY(comm, member, n) COMM_ADD_ARRAY (comm, macromain, macro_dummy, member, n)
+#define MACRO_VALUE(comm, member) COMM_ADD_VALUE (comm, macromain, macro_dummy, member)
+
 /**********************************************************/
 /**
  * @brief  Communicate the macro atom emissivities
  *
- * @param [in] int n_start       The index of the first cell updated by this rank
- * @param [in] int n_stop        The index of the last cell updated by this rank
+ * @param [in] int *cells        The cells updated by this rank
  * @param [in] int n_cells_rank  The number of cells this rank updated
  *
  * @details
  *
- * The communication pattern and how the size of the communication buffer is
- * determined is documented in
+ * The exchange is carried out by communicate_cell_list, see
  * $SIROCCO/docs/sphinx/source/developer/mpi_comms.rst.
- * To communicate a new variable, the communication buffer needs to be made
- * bigger and a new `MPI_Pack` and `MPI_Unpack` call need to be added. See the
- * developer documentation for more details.
  *
  **********************************************************/
 
@@ -38,55 +37,15 @@ void
 broadcast_macro_atom_emissivities (const int n_start, const int n_stop, const int n_cells_rank)
 {
 #ifdef MPI_ON
-  int i;
-  int n_plasma;
-  int current_rank;
-  int num_comm;
-  int position;
+  struct comm_cells comm;
 
   d_xsignal (files.root, "%-20s Begin macro atom emissivity communication\n", "NOK");
-  const int n_cells_max = get_max_cells_per_rank (NPLASMA);
-  const int comm_buffer_size = calculate_comm_buffer_size (1 + n_cells_max, n_cells_max * (1 + nlevels_macro));
-
-  char *comm_buffer = malloc (comm_buffer_size);
-  if (comm_buffer == NULL)
-  {
-    Error ("broadcast_macro_atom_emissivities: Error in allocating memory for comm_buffer\n");
-    Exit (EXIT_FAILURE);
-  }
-
-  for (current_rank = 0; current_rank < np_mpi_global; current_rank++)
-  {
-    position = 0;
-
-    if (rank_global == current_rank)
-    {
-      MPI_Pack (&n_cells_rank, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-      for (n_plasma = n_start; n_plasma < n_stop; ++n_plasma)
-      {
-        MPI_Pack (&n_plasma, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (&plasmamain[n_plasma].kpkt_emiss, 1, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].matom_emiss, nlevels_macro, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-      }
-    }
-
-    MPI_Bcast (comm_buffer, comm_buffer_size, MPI_PACKED, current_rank, MPI_COMM_WORLD);
-
-    position = 0;
 
-    if (rank_global != current_rank)
-    {
-      MPI_Unpack (comm_buffer, comm_buffer_size, &position, &num_comm, 1, MPI_INT, MPI_COMM_WORLD);
-      for (i = 0; i < num_comm; i++)
-      {
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &n_plasma, 1, MPI_INT, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &plasmamain[n_plasma].kpkt_emiss, 1, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].matom_emiss, nlevels_macro, MPI_DOUBLE, MPI_COMM_WORLD);
-      }
-    }
-  }
+  comm_cells_init (&comm, "macro atom emissivities");
+  COMM_ADD_VALUE (&comm, plasmamain, plasma_dummy, kpkt_emiss);
+  MACRO_ARRAY (&comm, matom_emiss, nlevels_macro);
+  communicate_cells (&comm, n_start, n_stop);
 
-  free (comm_buffer);
   d_xsignal (files.root, "%-20s Finished macro atom emissivity communication\n", "OK");
 #endif
 }
@@ -95,18 +54,13 @@ broadcast_macro_atom_emissivities (const int n_start, const int n_stop, const in
 /**
  * @brief  Communicate the macro atom recombination properties between ranks
  *
- * @param [in] int n_start       The index of the first cell updated by this rank
- * @param [in] int n_stop        The index of the last cell updated by this rank
+ * @param [in] int *cells        The cells updated by this rank
  * @param [in] int n_cells_rank  The number of cells this rank updated
  *
  * @details
  *
- * The communication pattern and how the size of the communication buffer is
- * determined is documented in
+ * The exchange is carried out by communicate_cell_list, see
  * $SIROCCO/docs/sphinx/source/developer/mpi_comms.rst.
- * To communicate a new variable, the communication buffer needs to be made
- * bigger and a new `MPI_Pack` and `MPI_Unpack` call need to be added. See the
- * developer documentation for more details.
  *
  **********************************************************/
 
@@ -114,76 +68,20 @@ void
 broadcast_macro_atom_recomb (const int n_start, const int n_stop, const int n_cells_rank)
 {
 #ifdef MPI_ON
-  int i;
-  int n_plasma;
-  int current_rank;
-  int position;
-  int num_comm;
+  struct comm_cells comm;
 
   d_xsignal (files.root, "%-20s Begin macro atom recombination communication\n", "NOK");
-  const int n_cells_max = get_max_cells_per_rank (NPLASMA);
-  const int comm_buffer_size = calculate_comm_buffer_size (1 + n_cells_max, n_cells_max * (2 * size_alpha_est + 2 * nphot_total));
 
-  char *const comm_buffer = malloc (comm_buffer_size);
-  if (comm_buffer == NULL)
+  comm_cells_init (&comm, "macro atom recombination");
+  if (nlevels_macro > 0)
   {
-    Error ("broadcast_macro_atom_recomb: Error in allocating memory for comm_buffer\n");
-    Exit (EXIT_FAILURE);
+    MACRO_ARRAY (&comm, recomb_sp, size_alpha_est);
+    MACRO_ARRAY (&comm, recomb_sp_e, size_alpha_est);
   }
+  COMM_ADD_ARRAY (&comm, plasmamain, plasma_dummy, recomb_simple, nphot_total);
+  COMM_ADD_ARRAY (&comm, plasmamain, plasma_dummy, recomb_simple_upweight, nphot_total);
+  communicate_cells (&comm, n_start, n_stop);
 
-  for (current_rank = 0; current_rank < np_mpi_global; ++current_rank)
-  {
-    position = 0;
-
-    if (rank_global == current_rank)
-    {
-      MPI_Pack (&n_cells_rank, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);   // how many cells to unpack
-      for (n_plasma = n_start; n_plasma < n_stop; ++n_plasma)
-      {
-        MPI_Pack (&n_plasma, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);     // which cell we're working on
-        if (nlevels_macro > 0)
-        {
-          MPI_Pack (macromain[n_plasma].recomb_sp, size_alpha_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-          MPI_Pack (macromain[n_plasma].recomb_sp_e, size_alpha_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        }
-        if (nphot_total > 0)
-        {
-          MPI_Pack (plasmamain[n_plasma].recomb_simple, nphot_total, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-          MPI_Pack (plasmamain[n_plasma].recomb_simple_upweight, nphot_total, MPI_DOUBLE, comm_buffer, comm_buffer_size,
-                    &position, MPI_COMM_WORLD);
-        }
-      }
-    }
-
-    MPI_Bcast (comm_buffer, comm_buffer_size, MPI_PACKED, current_rank, MPI_COMM_WORLD);
-
-    position = 0;
-
-    if (rank_global != current_rank)
-    {
-      MPI_Unpack (comm_buffer, comm_buffer_size, &position, &num_comm, 1, MPI_INT, MPI_COMM_WORLD);
-      for (i = 0; i < num_comm; ++i)
-      {
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &n_plasma, 1, MPI_INT, MPI_COMM_WORLD);
-
-        if (nlevels_macro > 0)
-        {
-          MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].recomb_sp, size_alpha_est, MPI_DOUBLE, MPI_COMM_WORLD);
-          MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].recomb_sp_e,
-                      size_alpha_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        }
-        if (nphot_total > 0)
-        {
-          MPI_Unpack (comm_buffer, comm_buffer_size, &position, plasmamain[n_plasma].recomb_simple,
-                      nphot_total, MPI_DOUBLE, MPI_COMM_WORLD);
-          MPI_Unpack (comm_buffer, comm_buffer_size, &position, plasmamain[n_plasma].recomb_simple_upweight,
-                      nphot_total, MPI_DOUBLE, MPI_COMM_WORLD);
-        }
-      }
-    }
-  }
-
-  free (comm_buffer);
   d_xsignal (files.root, "%-20s Finished macro atom recombination communication\n", "OK");
 #endif
 }
@@ -192,90 +90,37 @@ broadcast_macro_atom_recomb (const int n_start, const int n_stop, const int n_ce
 /**
  * @brief  Communicate the macro atom properties updated in `wind_update`
  *
- * @param [in] int n_start       The index of the first cell updated by this rank
- * @param [in] int n_stop        The index of the last cell updated by this rank
+ * @param [in] int *cells        The cells updated by this rank
  * @param [in] int n_cells_rank  The number of cells this rank updated
  *
  * @details
  *
- * The communication pattern and how the size of the communication buffer is
- * determined is documented in
+ * The exchange is carried out by communicate_cell_list, see
  * $SIROCCO/docs/sphinx/source/developer/mpi_comms.rst.
- * To communicate a new variable, the communication buffer needs to be made
- * bigger and a new `MPI_Pack` and `MPI_Unpack` call need to be added. See the
- * developer documentation for more details.
  *
  **********************************************************/
 
 int
-broadcast_updated_macro_atom_properties (const int n_start, const int n_stop, const int n_cells_rank)
+broadcast_updated_macro_atom_properties (const int *cells, const int n_cells_rank)
 {
 #ifdef MPI_ON
-  int i;
-  int n_plasma;
-  int current_rank;
-  int position;
-  int num_comm;
+  struct comm_cells comm;
 
   d_xsignal (files.root, "%-20s Begin macro atom updated properties communication\n", "NOK");
-  const int n_cells_max = get_max_cells_per_rank (NPLASMA);
-  const int comm_buffer_size = calculate_comm_buffer_size (1 + 3 * n_cells_max, n_cells_max * (6 * size_gamma_est + 2 * size_Jbar_est));
 
-  char *const comm_buffer = malloc (comm_buffer_size);
-  if (comm_buffer == NULL)
-  {
-    Error ("broadcast_updated_macro_atom_properties: Error in allocating memory for comm_buffer\n");
-    Exit (EXIT_FAILURE);
-  }
+  comm_cells_init (&comm, "updated macro atom properties");
+  MACRO_ARRAY (&comm, jbar, size_Jbar_est);
+  MACRO_ARRAY (&comm, jbar_old, size_Jbar_est);
+  MACRO_ARRAY (&comm, gamma, size_gamma_est);
+  MACRO_ARRAY (&comm, gamma_old, size_gamma_est);
+  MACRO_ARRAY (&comm, gamma_e, size_gamma_est);
+  MACRO_ARRAY (&comm, gamma_e_old, size_gamma_est);
+  MACRO_ARRAY (&comm, alpha_st, size_gamma_est);
+  MACRO_ARRAY (&comm, alpha_st_old, size_gamma_est);
+  MACRO_VALUE (&comm, kpkt_rates_known);
+  MACRO_VALUE (&comm, matrix_rates_known);
+  communicate_cell_list (&comm, cells, n_cells_rank);
 
-  for (current_rank = 0; current_rank < np_mpi_global; ++current_rank)
-  {
-    position = 0;
-
-    if (rank_global == current_rank)
-    {
-      MPI_Pack (&n_cells_rank, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-      for (n_plasma = n_start; n_plasma < n_stop; ++n_plasma)
-      {
-        MPI_Pack (&n_plasma, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].jbar, size_Jbar_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].jbar_old, size_Jbar_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].gamma, size_gamma_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].gamma_old, size_gamma_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].gamma_e, size_gamma_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].gamma_e_old, size_gamma_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].alpha_st, size_gamma_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (macromain[n_plasma].alpha_st_old, size_gamma_est, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (&macromain[n_plasma].kpkt_rates_known, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-        MPI_Pack (&macromain[n_plasma].matrix_rates_known, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-      }
-    }
-
-    MPI_Bcast (comm_buffer, comm_buffer_size, MPI_PACKED, current_rank, MPI_COMM_WORLD);
-
-    position = 0;
-
-    if (rank_global != current_rank)
-    {
-      MPI_Unpack (comm_buffer, comm_buffer_size, &position, &num_comm, 1, MPI_INT, MPI_COMM_WORLD);
-      for (i = 0; i < num_comm; ++i)
-      {
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &n_plasma, 1, MPI_INT, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].jbar, size_Jbar_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].jbar_old, size_Jbar_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].gamma, size_gamma_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].gamma_old, size_gamma_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].gamma_e, size_gamma_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].gamma_e_old, size_gamma_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].alpha_st, size_gamma_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n_plasma].alpha_st_old, size_gamma_est, MPI_DOUBLE, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &macromain[n_plasma].kpkt_rates_known, 1, MPI_INT, MPI_COMM_WORLD);
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &macromain[n_plasma].matrix_rates_known, 1, MPI_INT, MPI_COMM_WORLD);
-      }
-    }
-  }
-
-  free (comm_buffer);
   d_xsignal (files.root, "%-20s Finished macro atom updated properties communication\n", "OK");
 #endif
   return EXIT_SUCCESS;
@@ -286,17 +131,14 @@ broadcast_updated_macro_atom_properties (const int n_start, const int n_stop, co
  * @brief communicates the macro-atom B matrices between threads
  *
  *
- * @details communicates the macro-atom B matrices between threads
- * using MPI_Reduce. Only does anything if MPI_ON flag is on,
+ * @details communicates the macro-atom B matrices between threads.
+ * Only does anything if MPI_ON flag is on,
  * and should only be called if geo.rt_mode == RT_MODE_MACRO
  * and nlevels_macro > 0
  *
- * The communication pattern and how the size of the communication buffer is
- * determined is documented in
+ * The matrices are only communicated for cells in which they are
+ * stored.  The exchange is carried out by communicate_cells, see
  * $SIROCCO/docs/sphinx/source/developer/mpi_comms.rst.
- * To communicate a new variable, the communication buffer needs to be made
- * bigger and a new `MPI_Pack` and `MPI_Unpack` call need to be added. See the
- * developer documentation for more details.
  *
  **********************************************************/
 
@@ -304,63 +146,15 @@ int
 broadcast_macro_atom_state_matrix (int n_start, int n_stop, int n_cells_rank)
 {
 #ifdef MPI_ON
-  int n_mpi, n_mpi2, num_comm;
-  int n, position;
-
-  d_xsignal (files.root, "%-20s Begin macro atom state matrix communication\n", "NOK");
+  struct comm_cells comm;
   const int matrix_size = nlevels_macro + 1;
-  const int n_cells_max = get_max_cells_per_rank (NPLASMA);
-  const int comm_buffer_size = calculate_comm_buffer_size (1 + n_cells_max, n_cells_max * (matrix_size * matrix_size));
 
-  char *comm_buffer = malloc (comm_buffer_size);
-  if (comm_buffer == NULL)
-  {
-    Error ("broadcast_macro_atom_state_matrix: Error in allocating memory for comm_buffer\n");
-    Exit (EXIT_FAILURE);
-  }
-
-  for (n_mpi = 0; n_mpi < np_mpi_global; n_mpi++)
-  {
-    position = 0;
-
-    if (rank_global == n_mpi)
-    {
-      MPI_Pack (&n_cells_rank, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-      for (n = n_start; n < n_stop; n++)
-      {
-        MPI_Pack (&n, 1, MPI_INT, comm_buffer, comm_buffer_size, &position, MPI_COMM_WORLD);
-
-        /* we only communicate the matrix if it is being stored in this cell */
-        if (macromain[n].store_matom_matrix == TRUE)
-        {
-          MPI_Pack (macromain[n].matom_matrix[0], matrix_size * matrix_size, MPI_DOUBLE, comm_buffer, comm_buffer_size, &position,
-                    MPI_COMM_WORLD);
-        }
-      }
-    }
-
-    MPI_Bcast (comm_buffer, comm_buffer_size, MPI_PACKED, n_mpi, MPI_COMM_WORLD);
-
-    position = 0;
+  d_xsignal (files.root, "%-20s Begin macro atom state matrix communication\n", "NOK");
 
-    if (rank_global != n_mpi)
-    {
-      MPI_Unpack (comm_buffer, comm_buffer_size, &position, &num_comm, 1, MPI_INT, MPI_COMM_WORLD);
-      for (n_mpi2 = 0; n_mpi2 < num_comm; n_mpi2++)
-      {
-        MPI_Unpack (comm_buffer, comm_buffer_size, &position, &n, 1, MPI_INT, MPI_COMM_WORLD);
-
-        /* we only communicate the matrix if it is being stored in this cell */
-        if (macromain[n].store_matom_matrix == TRUE)
-        {
-          MPI_Unpack (comm_buffer, comm_buffer_size, &position, macromain[n].matom_matrix[0], matrix_size * matrix_size, MPI_DOUBLE,
-                      MPI_COMM_WORLD);
-        }
-      }
-    }
-  }
+  comm_cells_init (&comm, "macro atom state matrices");
+  COMM_ADD_MATRIX (&comm, macromain, macro_dummy, matom_matrix, matrix_size * matrix_size, store_matom_matrix);
+  communicate_cells (&comm, n_start, n_stop);
 
-  free (comm_buffer);
   d_xsignal (files.root, "%-20s Finished macro atom state matrix communication\n", "OK");
 #endif
   return (0);
@@ -0,0 +1,249 @@
+/***********************************************************/
+/** @file  communicate_photons.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief Functions for sharing the transport of photons between
+ * MPI ranks
+ *
+ * Normally each rank generates and transports NPHOT photons, where
+ * NPHOT is the number of photons per cycle divided by the number
+ * of ranks.  If the ranks run at different speeds, or some ranks
+ * generate photons which take much longer to transport, the faster
+ * ranks are left idle at the end of each cycle.  With the --steal
+ * switch, the photons belonging to each rank are divided into
+ * batches which any rank can claim, so that ranks which finish their
+ * own photons transport batches belonging to the slower ranks.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+
+
+/**********************************************************/
+/**
+ * @brief      Transport the photons of all ranks, with each rank
+ * claiming batches of photons until none are left
+ *
+ * @param [in] WindPtr  w   The entire wind domain
+ * @param [in, out] PhotPtr  p   The photons belonging to this rank
+ * @param [in] int  iextract   Whether photons are also to be extracted in
+ * specific directions
+ * @param [in] int  nthreads   The number of threads to use within each batch
+ * @param [out] int *  nbatch_stolen   The number of batches this rank took
+ * from other ranks
+ * @return     The number of photons transported by this rank
+ *
+ * @details
+ * The photons in each rank are divided into batches of modes.nphot_batch
+ * photons.  Each rank exposes a counter of the next unclaimed batch, and its
+ * photon array, with MPI one-sided communication.  A rank first claims its
+ * own batches, by atomically incrementing its own counter, and once these
+ * are exhausted it tries each of the other ranks in turn.  A batch taken
+ * from another rank is copied to this rank, transported and copied back, so
+ * that when the routine returns each rank holds the transported versions
+ * of the photons it generated, exactly as if it had transported
+ * them itself.
+ *
+ * ### Notes ###
+ *
+ * Photons are generated by the rank which owns them, so the
+ * photons which are created do not depend on the scheduling.  The
+ * random numbers used to transport a batch are however those of the
+ * rank which claims it, so runs are not reproducible when
+ * photons are scheduled in this way.
+ *
+ * The estimators accumulated by a rank while transporting a stolen batch
+ * are combined with those of the other ranks by the usual reductions,
+ * which do not care which rank transported a photon.  The exceptions
+ * are the luminosities of the photons which hit the star and disk,
+ * which are reduced here.
+ *
+ **********************************************************/
+
+int
+trans_phot_dynamic (WindPtr w, PhotPtr p, int iextract, int nthreads, int *nbatch_stolen)
+{
+  int nphot_done = 0;
+#ifdef MPI_ON
+  MPI_Win win_batch, win_phot;
+  MPI_Datatype mpi_photon;
+  int next_batch, ibatch, one;
+  int nbatch, nphot_batch, nstart, nstop, nreport;
+  int victim, nvictims;
+  double lum_back[2], lum_back_sum[2];
+  PhotPtr pbatch;
+
+  nphot_batch = modes.nphot_batch;
+  if (nphot_batch <= 0)
+  {
+    nphot_batch = NPHOT / 100;
+  }
+  if (nphot_batch < 1)
+  {
+    nphot_batch = 1;
+  }
+  nbatch = (NPHOT + nphot_batch - 1) / nphot_batch;
+  nreport = NPHOT / 10;
+
+  Log ("trans_phot_dynamic: Sharing %d batches of %d photons per rank between %d ranks\n", nbatch, nphot_batch, np_mpi_global);
+
+  pbatch = calloc (nphot_batch, sizeof (p_dummy));
+  if (pbatch == NULL)
+  {
+    Error ("trans_phot_dynamic: Could not allocate memory for a batch of %d photons\n", nphot_batch);
+    Exit (1);
+  }
+
+  MPI_Type_contiguous (sizeof (p_dummy), MPI_BYTE, &mpi_photon);
+  MPI_Type_commit (&mpi_photon);
+
+  next_batch = 0;
+  MPI_Win_create (&next_batch, sizeof (int), sizeof (int), MPI_INFO_NULL, MPI_COMM_WORLD, &win_batch);
+  MPI_Win_create (p, (MPI_Aint) NPHOT * sizeof (p_dummy), sizeof (p_dummy), MPI_INFO_NULL, MPI_COMM_WORLD, &win_phot);
+  MPI_Win_lock_all (0, win_batch);
+  MPI_Win_lock_all (0, win_phot);
+
+  *nbatch_stolen = 0;
+  one = 1;
+  victim = rank_global;
+  nvictims = 0;
+
+  while (nvictims < np_mpi_global)
+  {
+    MPI_Fetch_and_op (&one, &ibatch, MPI_INT, victim, 0, MPI_SUM, win_batch);
+    MPI_Win_flush (victim, win_batch);
+
+    if (ibatch >= nbatch)
+    {
+      victim = (victim + 1) % np_mpi_global;
+      nvictims++;
+      continue;
+    }
+
+    nstart = ibatch * nphot_batch;
+    nstop = nstart + nphot_batch;
+    if (nstop > NPHOT)
+    {
+      nstop = NPHOT;
+    }
+
+    if (victim == rank_global)
+    {
+      trans_phot_batch (w, &p[nstart], nstop - nstart, iextract, nthreads, 0);
+    }
+    else
+    {
+      MPI_Get (pbatch, nstop - nstart, mpi_photon, victim, nstart, nstop - nstart, mpi_photon, win_phot);
+      MPI_Win_flush (victim, win_phot);
+      trans_phot_batch (w, pbatch, nstop - nstart, iextract, nthreads, 0);
+      MPI_Put (pbatch, nstop - nstart, mpi_photon, victim, nstart, nstop - nstart, mpi_photon, win_phot);
+      MPI_Win_flush (victim, win_phot);
+      (*nbatch_stolen)++;
+    }
+
+    if (nreport > 0 && (nphot_done + nstop - nstart) / nreport > nphot_done / nreport)
+    {
+      trans_phot_progress (nphot_done + nstop - nstart);
+    }
+    nphot_done += nstop - nstart;
+  }
+
+  MPI_Win_unlock_all (win_phot);
+  MPI_Win_unlock_all (win_batch);
+  MPI_Barrier (MPI_COMM_WORLD);
+  MPI_Win_free (&win_phot);
+  MPI_Win_free (&win_batch);
+  MPI_Type_free (&mpi_photon);
+  free (pbatch);
+
+  /* The luminosity of photons striking the star and disk is accumulated by the rank which
+   * transported them, so average this over the ranks in the same way as the other
+   * estimators */
+
+  lum_back[0] = geo.lum_star_back;
+  lum_back[1] = geo.lum_disk_back;
+  MPI_Allreduce (lum_back, lum_back_sum, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  geo.lum_star_back = lum_back_sum[0] / np_mpi_global;
+  geo.lum_disk_back = lum_back_sum[1] / np_mpi_global;
+#else
+  (void) nthreads;
+  *nbatch_stolen = 0;
+  trans_phot_batch (w, p, NPHOT, iextract, nthreads, NPHOT / 10);
+  nphot_done = NPHOT;
+#endif
+
+  return (nphot_done);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Log the time each rank spent transporting photons, and
+ * the time it spent waiting for the other ranks to finish
+ *
+ * @param [in] double  t_busy   The time this rank spent transporting photons
+ * @param [in] double  t_idle   The time this rank then waited for the other ranks
+ * @param [in] int  nphot_done   The number of photons this rank transported
+ * @param [in] int  nbatch_stolen   The number of batches of photons this rank
+ * transported for other ranks
+ * @return     Nothing
+ *
+ * @details
+ * The numbers are gathered by the master rank, which writes a table with one
+ * line per rank.  The fraction of the cycle which was spent idle is a
+ * measure of how well the photon transport is balanced between
+ * the ranks.
+ *
+ **********************************************************/
+
+void
+report_transport_load (double t_busy, double t_idle, int nphot_done, int nbatch_stolen)
+{
+  double load[4];
+  double *load_all;
+  int n;
+  double t_busy_tot, t_idle_tot;
+
+  load[0] = t_busy;
+  load[1] = t_idle;
+  load[2] = nphot_done;
+  load[3] = nbatch_stolen;
+
+#ifdef MPI_ON
+  load_all = calloc (4 * np_mpi_global, sizeof (double));
+  MPI_Gather (load, 4, MPI_DOUBLE, load_all, 4, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#else
+  load_all = load;
+#endif
+
+  if (rank_global == 0)
+  {
+    t_busy_tot = t_idle_tot = 0;
+    Log ("Photon transport load balance: %4s %10s %10s %10s %8s\n", "rank", "busy(s)", "idle(s)", "photons", "stolen");
+    for (n = 0; n < np_mpi_global; n++)
+    {
+      Log ("Photon transport load balance: %4d %10.2f %10.2f %10.0f %8.0f\n", n, load_all[4 * n], load_all[4 * n + 1],
+           load_all[4 * n + 2], load_all[4 * n + 3]);
+      t_busy_tot += load_all[4 * n];
+      t_idle_tot += load_all[4 * n + 1];
+    }
+    if (t_busy_tot + t_idle_tot > 0)
+    {
+      Log ("Photon transport load balance: ranks were idle for %.1f per cent of the time\n",
+           100. * t_idle_tot / (t_busy_tot + t_idle_tot));
+    }
+  }
+
+#ifdef MPI_ON
+  free (load_all);
+#endif
+}
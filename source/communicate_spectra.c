@@ -36,6 +36,9 @@ normalize_spectra_across_ranks (void)
   int nspec;
   int size_of_commbuffer;;
   double *spectrum_buffer;
+  double t0;
+
+  t0 = prof_start ();
 
   d_xsignal (files.root, "%-20s Begin spectrum reduction\n", "NOK");
 
@@ -78,6 +81,7 @@ normalize_spectra_across_ranks (void)
   }
 
   free (spectrum_buffer);
+  prof_stop (PROF_COMM, t0);
   d_xsignal (files.root, "%-20s Finished spectrum reduction\n", "OK");
 #endif
   return (0);
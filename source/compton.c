@@ -15,7 +15,7 @@
 #include "atomic.h"
 #include "sirocco.h"
 
-PlasmaPtr xplasma;              /// Pointer to current plasma cell
+THREAD_LOCAL PlasmaPtr xplasma; /// Pointer to current plasma cell
 
 
 
@@ -41,11 +41,13 @@ compton_scatter (p)
 {
   double t_e;
   double vel[3];
-  double v;
+  double v, t0;
 
 
   WindPtr one;
   PlasmaPtr xplasma;
+
+  t0 = prof_start ();
   one = &wmain[p->grid];
   xplasma = &plasmamain[one->nplasma];
 
@@ -121,6 +123,7 @@ compton_scatter (p)
   rescale (velocity_electron, -1, vel);
   lorentz_transform (p, p, vel);
 
+  prof_stop (PROF_COMPTON, t0);
 
   return (0);
 }
@@ -383,9 +386,9 @@ klein_nishina (nu)
 
 //External variables to allow zero_find to search for the correct fractional energy change
 
-double sigma_rand;              //The randomised cross section that our photon will see
-double sigma_max;               //The cross section for the maxmimum energy loss
-double x1;                      //The ratio of photon eneergy to electron energy
+THREAD_LOCAL double sigma_rand; //The randomised cross section that our photon will see
+THREAD_LOCAL double sigma_max;  //The cross section for the maxmimum energy loss
+THREAD_LOCAL double x1;         //The ratio of photon eneergy to electron energy
 
 /** ****************************************************************************
  *
@@ -448,6 +451,9 @@ set_comp_func_values (double rand_cs, double max_cs, double energy_ratio)
  * vs energy change function. So we work out what energy change and hence direction
  * is implied by our random cross section.
  *
+ * If --compton-table is set, the energy change is interpolated from a table
+ * (see compton_table_f) rather than found with zero_find.
+ *
  **********************************************************/
 
 int
@@ -482,14 +488,21 @@ compton_dir (p)
        0 and 1. This is essentually the chance of a photon scattering through 180 degrees - or the angle giving the maximum energy loss
        Find the zero that represents our randomised fractional energy loss z_rand.
      */
-    sigma_rand = random_number (0.0, 1.0);
-    f_min = 1.;
-    f_max = 1. + (2. * x1);
-    sigma_max = sigma_compton_partial (f_max, x1);
-    f = zero_find (compton_func, f_min, f_max, 1e-8, &ierr);
-    if (ierr)
+    if (modes.compton_table)
     {
-      Error ("compton_dir: zero_find failed\n");
+      f = compton_table_f (x1, random_number (0.0, 1.0));
+    }
+    else
+    {
+      sigma_rand = random_number (0.0, 1.0);
+      f_min = 1.;
+      f_max = 1. + (2. * x1);
+      sigma_max = sigma_compton_partial (f_max, x1);
+      f = zero_find (compton_func, f_min, f_max, 1e-8, &ierr);
+      if (ierr)
+      {
+        Error ("compton_dir: zero_find failed\n");
+      }
     }
 /*We now have the fractional energy change f - we use the 'normal' equation for Compton scattering 
   to obtain the angle cosine n=cos(\theta)	for the scattering direction*/
@@ -498,20 +511,47 @@ compton_dir (p)
 
     if (isfinite (len = sqrt (1. - (n * n))) == 0)      //Compute the length of the other angle cosines - the isfinite is to take care of the very rare occasion where n=1!
       len = 0.0;                // If n=1, then the photon has either been undeflected or bounced straight back. Both are vanishingly unlikely but need to be treated.
-    phi = 0.0;                  //no need to randomise phi, the random rotation of the vector generating the basis function takes care of this
+    if (modes.compton_table)
+    {
+      /* Rotate by a random azimuth about the original direction, using the two unit vectors
+         perpendicular to it that are obtained by crossing it with the coordinate axis it is
+         least aligned with, rather than constructing a basis from a random vector */
+      phi = 2. * PI * random_number (0.0, 1.0);
+      l = len * cos (phi);
+      m = len * sin (phi);
+
+      dummy[0] = dummy[1] = dummy[2] = 0.0;
+      if (fabs (p->lmn[0]) <= fabs (p->lmn[1]) && fabs (p->lmn[0]) <= fabs (p->lmn[2]))
+        dummy[0] = 1.0;
+      else if (fabs (p->lmn[1]) <= fabs (p->lmn[2]))
+        dummy[1] = 1.0;
+      else
+        dummy[2] = 1.0;
+      cross (p->lmn, dummy, c);
+      renorm (c, 1.0);
+      cross (p->lmn, c, dummy);
+
+      lmn[0] = n * p->lmn[0] + l * c[0] + m * dummy[0];
+      lmn[1] = n * p->lmn[1] + l * c[1] + m * dummy[1];
+      lmn[2] = n * p->lmn[2] + l * c[2] + m * dummy[2];
+    }
+    else
+    {
+      phi = 0.0;                //no need to randomise phi, the random rotation of the vector generating the basis function takes care of this
 
-    l = len * cos (phi);
-    m = len * sin (phi);
+      l = len * cos (phi);
+      m = len * sin (phi);
 
-    randvec (dummy, 1.0);
-    cross (dummy, p->lmn, c);   //c will be perpendicular to p->lmn (the original photon direction) *and* the random vector just computed
-    create_basis (p->lmn, c, &nbasis);  //create a basis with the first axis in the direction of the original photon direction, c will be perpendicular to the photon direction. Orientaion of the y/z axes are will give  arandomization of the phi axis
+      randvec (dummy, 1.0);
+      cross (dummy, p->lmn, c); //c will be perpendicular to p->lmn (the original photon direction) *and* the random vector just computed
+      create_basis (p->lmn, c, &nbasis);        //create a basis with the first axis in the direction of the original photon direction, c will be perpendicular to the photon direction. Orientaion of the y/z axes are will give  arandomization of the phi axis
 
-    x[0] = n;                   //This is the cosine direction of the new photon direction, in the frame of reference where the first axis is in the original photon direction
-    x[1] = l;
-    x[2] = m;
+      x[0] = n;                 //This is the cosine direction of the new photon direction, in the frame of reference where the first axis is in the original photon direction
+      x[1] = l;
+      x[2] = m;
 
-    project_from (&nbasis, x, lmn);     /* Project the vector from the FOR of the original photon into the observer frame */
+      project_from (&nbasis, x, lmn);   /* Project the vector from the FOR of the original photon into the observer frame */
+    }
     renorm (lmn, 1.0);          //Make sure the length of the direction vector is equal to 1
     stuff_v (lmn, p->lmn);      //Put the new photon direction into the photon structure
 
@@ -574,12 +614,26 @@ compton_get_thermal_velocity (t, v)
 
   if (init_cdf_thermal)
   {
-    double dummy[2] = { 0, 1 };
-    cdf_gen_from_func (&cdf_thermal, &pdf_thermal, 0, 5, 0, dummy);
-    init_cdf_thermal = FALSE;
+    OMP_PRAGMA (omp critical (cdf_gen))
+    {
+      if (init_cdf_thermal)
+      {
+        double dummy[2] = { 0, 1 };
+        cdf_gen_from_func (&cdf_thermal, &pdf_thermal, 0, 5, 0, dummy);
+        OMP_PRAGMA (omp flush)
+        init_cdf_thermal = FALSE;
+      }
+    }
   }
 
-  vel = cdf_get_rand (&cdf_thermal);
+  if (modes.compton_table)
+  {
+    vel = thermal_table_speed (random_number (0.0, 1.0));
+  }
+  else
+  {
+    vel = cdf_get_rand (&cdf_thermal);
+  }
 
   vel *= sqrt ((2. * BOLTZMANN / MELEC) * t);
 
@@ -666,6 +720,290 @@ sigma_compton_partial (f, x)
 
 }
 
+/* The tables used to sample the Klein-Nishina and Maxwell-Boltzmann distributions if --compton-table is set */
+
+#define COMP_TABLE_LXMIN  -4.0  /* log10 of the smallest photon to electron energy ratio in the table */
+#define COMP_TABLE_LXMAX  3.0   /* log10 of the largest ratio; zero_find is used above this */
+#define COMP_TABLE_NX     141   /* The number of energy ratios */
+#define COMP_TABLE_NU     512   /* The number of intervals in the random cross section */
+#define THERMAL_TABLE_NU  4096  /* The number of intervals in the cdf of the thermal speed */
+#define THERMAL_XMAX      5.0   /* The largest speed, in units of the most probable speed, as for cdf_thermal */
+
+static double comp_table[COMP_TABLE_NX][COMP_TABLE_NU + 1];     /* (f-1)/(f_max-1) for each energy ratio and cross section */
+static double thermal_table[THERMAL_TABLE_NU + 1];      /* The speed for each value of the cdf */
+THREAD_LOCAL double thermal_target;     /* The value of the cdf sought by thermal_func */
+static int init_comp_table = TRUE;
+
+
+
+/**********************************************************/
+/** 
+ * @brief      the cdf of the thermal speed of electrons
+ *
+ * @param [in] double  x   The speed in units of the most probable speed
+ * @return     The fraction of electrons with speeds less than x
+ *
+ * @details
+ * This is the integral of pdf_thermal, normalized so that it is 1 at
+ * THERMAL_XMAX, the largest speed for which cdf_thermal is defined.
+ *
+ **********************************************************/
+
+double
+thermal_cdf (double x)
+{
+  double norm;
+
+  norm = 0.25 * sqrt (PI) * erf (THERMAL_XMAX) - 0.5 * THERMAL_XMAX * exp (-THERMAL_XMAX * THERMAL_XMAX);
+
+  return ((0.25 * sqrt (PI) * erf (x) - 0.5 * x * exp (-x * x)) / norm);
+}
+
+
+static double
+thermal_func (double x, void *params)
+{
+  return (thermal_cdf (x) - thermal_target);
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      the speed of an electron for a given value of the cdf of the thermal speed,
+ * found by solving for the root of thermal_func
+ *
+ * @param [in] double  u   The value of the cdf, between 0 and 1
+ * @return     The speed in units of the most probable speed
+ *
+ **********************************************************/
+
+static double
+thermal_solve_speed (double u)
+{
+  int ierr = FALSE;
+
+  thermal_target = u;
+  return (zero_find (thermal_func, 0.0, THERMAL_XMAX, 1e-10, &ierr));
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      the fractional energy change for a given random cross section by
+ * solving for the root of compton_func
+ *
+ * @param [in] double  x   The ratio of the photon energy to the electron rest mass energy
+ * @param [in] double  u   The random cross section, between 0 and 1
+ * @return     The fractional energy change, E_old/E_new
+ *
+ **********************************************************/
+
+static double
+compton_solve_f (double x, double u)
+{
+  double f;
+  int ierr = FALSE;
+
+  x1 = x;
+  sigma_rand = u;
+  sigma_max = sigma_compton_partial (1. + 2. * x, x);
+  f = zero_find (compton_func, 1., 1. + 2. * x, 1e-10, &ierr);
+  if (ierr)
+  {
+    Error ("compton_solve_f: zero_find failed for x %e u %e\n", x, u);
+  }
+
+  return (f);
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      create the tables used to sample the Klein-Nishina and
+ * Maxwell-Boltzmann distributions
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * For each of COMP_TABLE_NX photon to electron energy ratios x, spaced
+ * logarithmically between 10**COMP_TABLE_LXMIN and 10**COMP_TABLE_LXMAX,
+ * the fractional energy change f is found for COMP_TABLE_NU+1 equally spaced
+ * values of the random cross section, and stored as (f-1)/(2x), which varies
+ * smoothly with x.  The speeds of electrons for THERMAL_TABLE_NU+1 equally spaced
+ * values of the cdf of the Maxwell-Boltzmann distribution are stored similarly.
+ *
+ * The largest difference between the interpolated values and the exact ones at
+ * the midpoints of the intervals in the tables is logged.  For the energy change
+ * this is the fractional error in f.  For the thermal speed it is the error in the
+ * cdf, which is the largest difference between the cdfs of the tabulated and exact
+ * distributions.  The last interval of the thermal table, where the speed changes
+ * rapidly with the cdf, is not interpolated.
+ *
+ * ### Notes ###
+ * This is called the first time a table is used.  It uses the globals that
+ * compton_func uses, so saves and restores them.
+ *
+ **********************************************************/
+
+int
+compton_table_init (void)
+{
+  double x_save, sigma_rand_save, sigma_max_save;
+  double x, u, f, g, err, err_max, err_thermal;
+  double dlx = (COMP_TABLE_LXMAX - COMP_TABLE_LXMIN) / (COMP_TABLE_NX - 1);
+  int i, j;
+
+  OMP_PRAGMA (omp critical (cdf_gen))
+  {
+    if (init_comp_table)
+    {
+      x_save = x1;
+      sigma_rand_save = sigma_rand;
+      sigma_max_save = sigma_max;
+
+      for (i = 0; i < COMP_TABLE_NX; i++)
+      {
+        x = pow (10., COMP_TABLE_LXMIN + i * dlx);
+        comp_table[i][0] = 0.0;
+        comp_table[i][COMP_TABLE_NU] = 1.0;
+        for (j = 1; j < COMP_TABLE_NU; j++)
+        {
+          comp_table[i][j] = (compton_solve_f (x, (double) j / COMP_TABLE_NU) - 1.) / (2. * x);
+        }
+      }
+
+      thermal_table[0] = 0.0;
+      thermal_table[THERMAL_TABLE_NU] = THERMAL_XMAX;
+      for (j = 1; j < THERMAL_TABLE_NU; j++)
+      {
+        thermal_table[j] = thermal_solve_speed ((double) j / THERMAL_TABLE_NU);
+      }
+
+      /* Check the interpolation at the midpoints of the intervals */
+
+      err_max = 0.0;
+      for (i = 0; i < COMP_TABLE_NX - 1; i++)
+      {
+        x = pow (10., COMP_TABLE_LXMIN + (i + 0.5) * dlx);
+        for (j = 0; j < COMP_TABLE_NU; j++)
+        {
+          u = (j + 0.5) / COMP_TABLE_NU;
+          f = compton_solve_f (x, u);
+          g = 0.25 * (comp_table[i][j] + comp_table[i][j + 1] + comp_table[i + 1][j] + comp_table[i + 1][j + 1]);
+          err = fabs (1. + 2. * x * g - f) / f;
+          if (err > err_max)
+            err_max = err;
+        }
+      }
+
+      err_thermal = 0.0;
+      for (j = 0; j < THERMAL_TABLE_NU - 1; j++)
+      {
+        u = (j + 0.5) / THERMAL_TABLE_NU;
+        err = fabs (thermal_cdf (0.5 * (thermal_table[j] + thermal_table[j + 1])) - u);
+        if (err > err_thermal)
+          err_thermal = err;
+      }
+
+      Log ("compton_table_init: Largest errors in the tabulated fractional energy change %.1e and thermal speed cdf %.1e\n",
+           err_max, err_thermal);
+
+      x1 = x_save;
+      sigma_rand = sigma_rand_save;
+      sigma_max = sigma_max_save;
+
+      OMP_PRAGMA (omp flush)
+      init_comp_table = FALSE;
+    }
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      the fractional energy change of a photon undergoing Compton scattering,
+ * interpolated from the tables created by compton_table_init
+ *
+ * @param [in] double  x   The ratio of the photon energy to the electron rest mass energy
+ * @param [in] double  u   The random cross section, between 0 and 1
+ * @return     The fractional energy change, E_old/E_new
+ *
+ * @details
+ * This is the tabulated equivalent of the zero_find in compton_dir. Values
+ * of x outside the table are clamped at the low end, where the scattering
+ * is close to Thomson, and solved for directly at the high end.
+ *
+ **********************************************************/
+
+double
+compton_table_f (double x, double u)
+{
+  double lx, qx, qu, g;
+  int i, j;
+
+  if (init_comp_table)
+    compton_table_init ();
+
+  lx = log10 (x);
+  if (lx >= COMP_TABLE_LXMAX)
+    return (compton_solve_f (x, u));
+
+  qx = (lx - COMP_TABLE_LXMIN) / (COMP_TABLE_LXMAX - COMP_TABLE_LXMIN) * (COMP_TABLE_NX - 1);
+  if (qx < 0.0)
+    qx = 0.0;
+  i = (int) qx;
+  if (i > COMP_TABLE_NX - 2)
+    i = COMP_TABLE_NX - 2;
+  qx -= i;
+
+  qu = u * COMP_TABLE_NU;
+  j = (int) qu;
+  if (j > COMP_TABLE_NU - 1)
+    j = COMP_TABLE_NU - 1;
+  qu -= j;
+
+  g = (1. - qx) * ((1. - qu) * comp_table[i][j] + qu * comp_table[i][j + 1])
+    + qx * ((1. - qu) * comp_table[i + 1][j] + qu * comp_table[i + 1][j + 1]);
+
+  return (1. + 2. * x * g);
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      the speed of an electron drawn from a Maxwell-Boltzmann distribution,
+ * interpolated from the table created by compton_table_init
+ *
+ * @param [in] double  u   The value of the cdf, between 0 and 1
+ * @return     The speed in units of the most probable speed
+ *
+ **********************************************************/
+
+double
+thermal_table_speed (double u)
+{
+  double q;
+  int j;
+
+  if (init_comp_table)
+    compton_table_init ();
+
+  q = u * THERMAL_TABLE_NU;
+  j = (int) q;
+  if (j >= THERMAL_TABLE_NU - 1)
+    return (thermal_solve_speed (u));
+  q -= j;
+
+  return ((1. - q) * thermal_table[j] + q * thermal_table[j + 1]);
+}
+
 /**********************************************************/
 /** 
  * @brief      The 'heating' cross section correction to Thompson scattering
@@ -0,0 +1,372 @@
+/***********************************************************/
+/** @file  cycle_stream.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  An append-only binary file of selected quantities for each
+ * cell, with one record for each ionization cycle
+ *
+ * Following the evolution of a few quantities, such as t_e, t_r, ne and
+ * the convergence of each cell, through a long run used to require
+ * either a copy of the windsave file for each cycle
+ * (keep_ioncycle_windsaves) or a full set of tables for each cycle
+ * (make_ioncycle_tables), both of which are written by rank 0 while the
+ * other ranks wait.  Instead, with Diag.save_cycle_stream, the quantities
+ * in Diag.cycle_stream_columns are appended to rootname.cycles.bin at the
+ * end of each cycle.
+ *
+ * The columns are resolved once, with the routines in
+ * windsave2table_columns.c, so any column that can be written by
+ * windsave2table -c can be used.  The record is filled on rank 0, and
+ * then written by a helper thread while the next cycle proceeds.
+ *
+ * The file consists of a cycle_stream_header, CSTREAM_NDOM integers for
+ * each domain (nstart, ndim2, coord_type, ndim, mdim), the names of the
+ * columns, each WTAB_NAMELEN characters long, and then the records.
+ * Each record is a cycle_stream_record followed by the values of each
+ * column in turn for all NDIM2 cells.  The file is written in the
+ * native byte order.  The routine read_cycle_stream in
+ * py_progs/py_read_output.py reads these files.
+ *
+ * ### Notes ###
+ *
+ * When a run is restarted, records are appended to the existing file if
+ * it has the same columns and cells, after removing any incomplete record
+ * at the end.  Otherwise the file is started again.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+static struct cycle_stream
+{
+  char filename[LINELENGTH];
+  FILE *fptr;                   /* NULL until the file has been opened */
+  WindTableColumnPtr columns;
+  int ncols;
+  long long record_size;
+  char *fill;                   /* The record which is being filled */
+  char *pending;                /* The record which is being written by the helper thread */
+  pthread_t thread;
+  int active;                   /* TRUE while the helper thread is running */
+  int nerr;                     /* The number of failed writes */
+  int failed;                   /* TRUE if the stream could not be opened */
+} stream;
+
+
+
+/**********************************************************/
+/**
+ * @brief      Check whether an existing file can be appended to
+ *
+ * @param [in] FILE *  fptr   The file, positioned at the start
+ * @param [in] struct cycle_stream_header *  header   The header the file should have
+ * @param [in] int *  domains   The description of each domain
+ * @param [in] char *  names   The names of the columns
+ * @return     The number of bytes in the file up to the end of the last
+ * complete record, or -1 if the file does not match
+ *
+ **********************************************************/
+
+static long long
+cycle_stream_check (FILE *fptr, struct cycle_stream_header *header, int *domains, char *names)
+{
+  struct cycle_stream_header old;
+  struct stat st;
+  int *old_domains;
+  char *old_names;
+  long long nstart;
+  int ok;
+
+  if (fread (&old, sizeof old, 1, fptr) != 1 || memcmp (&old, header, sizeof old) != 0)
+    return (-1);
+
+  old_domains = calloc (header->ndomain * CSTREAM_NDOM, sizeof (int));
+  old_names = calloc (header->ncols, WTAB_NAMELEN);
+
+  ok = fread (old_domains, sizeof (int), header->ndomain * CSTREAM_NDOM, fptr) == (size_t) header->ndomain * CSTREAM_NDOM
+    && memcmp (old_domains, domains, header->ndomain * CSTREAM_NDOM * sizeof (int)) == 0
+    && fread (old_names, WTAB_NAMELEN, header->ncols, fptr) == (size_t) header->ncols
+    && memcmp (old_names, names, header->ncols * WTAB_NAMELEN) == 0;
+
+  free (old_domains);
+  free (old_names);
+
+  if (!ok || fstat (fileno (fptr), &st) != 0)
+    return (-1);
+
+  nstart = sizeof old + header->ndomain * CSTREAM_NDOM * sizeof (int) + (long long) header->ncols * WTAB_NAMELEN;
+
+  return (nstart + (st.st_size - nstart) / header->record_size * header->record_size);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Open the stream, and resolve the columns which are written
+ *
+ * @param [in] char *  filename   The name of the file
+ * @param [in] char *  list   The columns, see parse_table_columns
+ * @return     0 on success, -1 if the columns could not be resolved or
+ * the file could not be opened
+ *
+ * @details
+ * If this is a restart, and the file already contains records for the
+ * same columns and cells, the new records are appended.
+ *
+ **********************************************************/
+
+int
+cycle_stream_open (char *filename, char *list)
+{
+  struct cycle_stream_header header;
+  FILE *fptr;
+  int *domains;
+  char *names;
+  int n, ndom;
+  long long nbytes;
+
+  if ((stream.ncols = parse_table_columns (list, 0, &stream.columns)) <= 0)
+  {
+    Error ("cycle_stream_open: No columns could be resolved from %s\n", list);
+    return (-1);
+  }
+
+  memset (&header, 0, sizeof header);
+  strcpy (header.magic, CSTREAM_MAGIC);
+  header.format = CSTREAM_FORMAT;
+  header.byte_order = WINDSAVE_BYTE_ORDER;
+  header.ndomain = geo.ndomain;
+  header.ncells = NDIM2;
+  header.ncols = stream.ncols;
+  header.record_size = sizeof (struct cycle_stream_record) + (long long) stream.ncols * NDIM2 * sizeof (double);
+  stream.record_size = header.record_size;
+
+  domains = calloc (geo.ndomain * CSTREAM_NDOM, sizeof (int));
+  for (ndom = 0; ndom < geo.ndomain; ndom++)
+  {
+    domains[ndom * CSTREAM_NDOM] = zdom[ndom].nstart;
+    domains[ndom * CSTREAM_NDOM + 1] = zdom[ndom].ndim2;
+    domains[ndom * CSTREAM_NDOM + 2] = zdom[ndom].coord_type;
+    domains[ndom * CSTREAM_NDOM + 3] = zdom[ndom].ndim;
+    domains[ndom * CSTREAM_NDOM + 4] = zdom[ndom].mdim;
+  }
+
+  names = calloc (stream.ncols, WTAB_NAMELEN);
+  for (n = 0; n < stream.ncols; n++)
+    strncpy (&names[n * WTAB_NAMELEN], stream.columns[n].name, WTAB_NAMELEN - 1);
+
+  strncpy (stream.filename, filename, LINELENGTH - 1);
+  stream.fptr = NULL;
+
+  if (geo.run_type == RUN_TYPE_RESTART && (fptr = fopen (filename, "r+")) != NULL)
+  {
+    if ((nbytes = cycle_stream_check (fptr, &header, domains, names)) > 0 && ftruncate (fileno (fptr), nbytes) == 0
+        && fseek (fptr, 0, SEEK_END) == 0)
+    {
+      stream.fptr = fptr;
+      Log ("cycle_stream_open: Appending to %s\n", filename);
+    }
+    else
+    {
+      fclose (fptr);
+      Error ("cycle_stream_open: %s does not contain the same columns and cells, so it will be replaced\n", filename);
+    }
+  }
+
+  if (stream.fptr == NULL)
+  {
+    if ((stream.fptr = fopen (filename, "w")) == NULL)
+    {
+      Error ("cycle_stream_open: Unable to open %s\n", filename);
+      free (domains);
+      free (names);
+      return (-1);
+    }
+    if (fwrite (&header, sizeof header, 1, stream.fptr) != 1
+        || fwrite (domains, sizeof (int), geo.ndomain * CSTREAM_NDOM, stream.fptr) != (size_t) geo.ndomain * CSTREAM_NDOM
+        || fwrite (names, WTAB_NAMELEN, stream.ncols, stream.fptr) != (size_t) stream.ncols)
+      stream.nerr++;
+  }
+
+  free (domains);
+  free (names);
+
+  stream.fill = malloc (stream.record_size);
+  stream.pending = malloc (stream.record_size);
+  if (stream.fill == NULL || stream.pending == NULL)
+  {
+    Error ("cycle_stream_open: Unable to allocate %lld bytes for the records\n", stream.record_size);
+    Exit (1);
+  }
+
+  Log ("cycle_stream_open: Writing %d columns for %d cells to %s each cycle\n", stream.ncols, NDIM2, filename);
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write the pending record, in the helper thread
+ *
+ * @param [in] void *  arg   Not used
+ * @return     NULL
+ *
+ **********************************************************/
+
+static void *
+cycle_stream_thread_main (void *arg)
+{
+  (void) arg;
+
+  if (fwrite (stream.pending, stream.record_size, 1, stream.fptr) != 1 || fflush (stream.fptr) != 0)
+    stream.nerr++;
+
+  return (NULL);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Wait until the last record has been written
+ *
+ * @return     Nothing
+ *
+ **********************************************************/
+
+void
+cycle_stream_wait (void)
+{
+  if (stream.active)
+  {
+    pthread_join (stream.thread, NULL);
+    stream.active = FALSE;
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Append the record for a cycle to the stream
+ *
+ * @param [in] int  cycle   The number of ionization cycles which have been completed
+ * @return     0 on success, -1 if the stream could not be opened
+ *
+ * @details
+ * The stream is opened the first time this is called.  The values for
+ * all of the cells are filled, and the record is then written by a
+ * helper thread, so the routine returns before the record is on disk.
+ *
+ * ### Notes ###
+ * This is called by rank 0 only, once the plasma structure has been
+ * gathered at the end of a cycle.
+ *
+ **********************************************************/
+
+int
+cycle_stream_write (int cycle)
+{
+  struct cycle_stream_record record;
+  double **values, *data;
+  char *swap;
+  char filename[LINELENGTH];
+  int n, ndom;
+
+  if (stream.fptr == NULL)
+  {
+    if (stream.failed)
+      return (-1);
+
+    snprintf (filename, LINELENGTH, "%.*s.cycles.bin", LINELENGTH - 12, files.root);
+    if (cycle_stream_open (filename, modes.cycle_stream_columns))
+    {
+      stream.failed = TRUE;
+      return (-1);
+    }
+  }
+
+  record.cycle = cycle;
+  record.ncols = stream.ncols;
+  record.time = timer ();
+  memcpy (stream.fill, &record, sizeof record);
+
+  data = (double *) (stream.fill + sizeof record);
+  values = calloc (stream.ncols, sizeof (double *));
+  for (ndom = 0; ndom < geo.ndomain; ndom++)
+  {
+    for (n = 0; n < stream.ncols; n++)
+      values[n] = &data[(long long) n * NDIM2 + zdom[ndom].nstart];
+    fill_table_columns (ndom, stream.columns, stream.ncols, FALSE, 0, zdom[ndom].ndim2, values);
+  }
+  free (values);
+
+  /* Swap the records, once the previous record has been written */
+
+  cycle_stream_wait ();
+  swap = stream.pending;
+  stream.pending = stream.fill;
+  stream.fill = swap;
+
+  if (pthread_create (&stream.thread, NULL, cycle_stream_thread_main, NULL) == 0)
+  {
+    stream.active = TRUE;
+  }
+  else
+  {
+    cycle_stream_thread_main (NULL);
+  }
+
+  Log_silent ("cycle_stream_write: Wrote cycle %d to %s\n", cycle, stream.filename);
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Finish writing the stream and close the file
+ *
+ * @return     The number of failed writes
+ *
+ * @details
+ * This must be called before the program ends.  It does nothing if
+ * the stream was never opened.
+ *
+ **********************************************************/
+
+int
+cycle_stream_close (void)
+{
+  int nerr;
+
+  cycle_stream_wait ();
+
+  if (stream.fptr != NULL && fclose (stream.fptr) != 0)
+    stream.nerr++;
+
+  if (stream.nerr)
+    Error ("cycle_stream_close: %d writes to %s failed\n", stream.nerr, stream.filename);
+
+  nerr = stream.nerr;
+
+  free (stream.columns);
+  free (stream.fill);
+  free (stream.pending);
+  memset (&stream, 0, sizeof stream);
+
+  return (nerr);
+}
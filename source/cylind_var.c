@@ -470,7 +470,7 @@ cylvar_cell_volume (WindPtr w)
 }
 
 
-int cylvar_n_approx;
+THREAD_LOCAL int cylvar_n_approx;
 int ierr_cylvar_where_in_grid = 0;
 
 
@@ -137,11 +137,10 @@ create_macro_grid (void)
 
   for (n_plasma = n_start; n_plasma < n_stop; ++n_plasma)
   {
-    macromain[n_plasma].store_matom_matrix = modes.store_matom_matrix;
     macromain[n_plasma].matom_transition_mode = geo.matom_transition_mode;
   }
 
-  calloc_matom_matrix (NPLASMA);
+  set_matom_matrix_storage ();
 }
 
 /**********************************************************/
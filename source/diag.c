@@ -180,6 +180,15 @@ get_extra_diagnostics ()
   strcpy (answer, "no");
   n += modes.make_tables = rdchoice ("@Diag.make_ioncycle_tables(yes,no)", "1,0", answer);
 
+  strcpy (answer, "no");
+  n += modes.save_cycle_stream = rdchoice ("@Diag.save_cycle_stream(yes,no)", "1,0", answer);
+
+  if (modes.save_cycle_stream)
+  {
+    strcpy (modes.cycle_stream_columns, CSTREAM_COLUMNS);
+    rdstr ("@Diag.cycle_stream_columns", modes.cycle_stream_columns);
+  }
+
   strcpy (answer, "no");
   n += modes.save_photons = rdchoice ("@Diag.save_photons(yes,no)", "1,0", answer);
 
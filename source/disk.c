@@ -290,7 +290,7 @@ zdisk (r)
 
 
 int ds_to_disk_init = 0;
-struct photon ds_to_disk_photon;
+THREAD_LOCAL struct photon ds_to_disk_photon;
 struct plane diskplane, disktop, diskbottom;
 
 
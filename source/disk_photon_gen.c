@@ -23,6 +23,8 @@
 
 /* THE NEXT FEW ROUTINES PERTAIN ONLY TO THE DISK */
 
+static struct bb_limits disk_bb[NRINGS];       /* The limits planck uses for each ring, see photo_gen_disk */
+
 
 
 
@@ -43,6 +45,11 @@
  *
  * ### Notes ###
  *
+ * For bb spectra, the limits within which planck samples the bb cdf for
+ * each ring are saved in disk_bb, and only recalculated when the temperature
+ * of the ring or the frequency range changes, since otherwise nearly every
+ * photon would require the numerical integrations in planck_limits.
+ *
  **********************************************************/
 
 int
@@ -60,7 +67,7 @@ photo_gen_disk (p, weight, f1, f2, spectype, istart, nphot)
   double r, z, theta, phi;
   int nring = 0;
   double north[3];
-  double fcol;
+  double t;
 
   if ((iend = istart + nphot) > NPHOT)
   {
@@ -183,14 +190,24 @@ photo_gen_disk (p, weight, f1, f2, spectype, istart, nphot)
      * possilbe this should be collected into a single routine   080518 -ksl
      */
 
-    if (spectype == SPECTYPE_BB)
-    {
-      p[i].freq = planck (disk.t[nring], freqmin, freqmax);
-    }
-    else if (spectype == SPECTYPE_BB_FCOL)
+    if (spectype == SPECTYPE_BB || spectype == SPECTYPE_BB_FCOL)
     {
-      fcol = disk_colour_correction (disk.t[nring]);
-      p[i].freq = planck (fcol * disk.t[nring], freqmin, freqmax);
+      t = disk.t[nring];
+      if (spectype == SPECTYPE_BB_FCOL)
+        t *= disk_colour_correction (disk.t[nring]);
+
+      if (t <= 0)
+      {
+        p[i].freq = planck (t, freqmin, freqmax);
+      }
+      else
+      {
+        if (t != disk_bb[nring].t || freqmin != disk_bb[nring].freqmin || freqmax != disk_bb[nring].freqmax)
+        {
+          planck_limits (t, freqmin, freqmax, &disk_bb[nring]);
+        }
+        p[i].freq = planck_from_limits (&disk_bb[nring]);
+      }
     }
     else if (spectype == SPECTYPE_UNIFORM)
     {
@@ -136,6 +136,9 @@ wind_luminosity (double f1, double f2, int mode)
     geo.lum_ff = lum_free_free;
   }
 
+  emission_sampler_init (SAMPLE_WIND);
+  emission_cdf_reset ();
+
   return (total_lum);
 }
 
@@ -256,19 +259,18 @@ total_emission (xplasma, f1, f2)
  * This logic was adopted for speed related reasons.
  *
  * First the routine determines how many photons should be generated in each (plasma) cell
- * of each type
+ * of each type.  The cell is found from the table of the running sum of the luminosity
+ * constructed by wind_luminosity (see emission_sampler.c).
  *
- * Then it generates the photons on a cell by cell basis.
+ * The spectra of the cells from which photons are to be generated are then
+ * made, if they are not already up to date (see emission_cdf.c), and the
+ * photons are generated on a cell by cell basis.
  *
  * If photo_gen_wind tries to create more photons than exist in the photon structure the
  * program will stop (rather than continue incorrectly or start blasting away memory.)
  *
  **********************************************************/
 
-#define FREE_FREE  0
-#define FREE_BOUND 1
-#define BOUND_BOUND 2
-
 int
 photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
      PhotPtr p;
@@ -276,20 +278,18 @@ photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
      double freqmin, freqmax;
      int photstart, nphot;
 {
-  int nn, np;
+  int np;
   int kkk;
   int photstop;
-  double xlum, xlumsum, lum, dt_cmf;
-  int icell, icell_old;
+  double xlum, xlumsum, lum;
   int nplasma = 0;
   int nnscat;
-  int ptype[NPLASMA][3];        //Store for the types of photons to be generated in each cell, ff first, fb next, line third
-  dt_cmf = 0.0;
+  int (*ptype)[NSPEC_CELL];     //Store for the types of photons to be generated in each cell, ff first, fb next, line third
 
-  for (nplasma = 0; nplasma < NPLASMA; nplasma++)
+  if ((ptype = calloc (NPLASMA, sizeof (*ptype))) == NULL)
   {
-    for (nn = 0; nn < 3; nn++)
-      ptype[nplasma][nn] = 0;
+    Error ("photo_gen_wind: Unable to allocate memory for %d cells\n", NPLASMA);
+    Exit (1);
   }
 
   limit_lines (freqmin, freqmax);
@@ -310,22 +310,7 @@ photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
 
     xlum = random_number (0.0, 1.0) * geo.f_wind;
 
-    xlumsum = 0;
-    nplasma = 0;
-
-    while (xlumsum < xlum)
-    {
-      dt_cmf = 1.0 / plasmamain[nplasma].xgamma;
-      xlumsum += plasmamain[nplasma].lum_tot * dt_cmf;
-      nplasma++;
-    }
-    nplasma--;
-
-    if (nplasma == NPLASMA)
-    {
-      Error ("photo_gen_wind: Generating photon in a cell that should not be in wind (%.2e > %.2e) geo.f_wind %.2e\n", xlumsum, xlum,
-             geo.f_wind);
-    }
+    nplasma = emission_sampler_cell (SAMPLE_WIND, xlum, NULL);
 
     /* At this point we know the cell in which the photon will be generated */
 
@@ -341,37 +326,36 @@ photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
 
     if ((xlumsum += plasmamain[nplasma].lum_ff) > xlum)
     {
-      ptype[nplasma][FREE_FREE]++;
+      ptype[nplasma][SPEC_FF]++;
     }
     else if ((xlumsum += plasmamain[nplasma].lum_rr) > xlum)
     {
-      ptype[nplasma][FREE_BOUND]++;
+      ptype[nplasma][SPEC_FB]++;
     }
     else
     {
-      ptype[nplasma][BOUND_BOUND]++;
+      ptype[nplasma][SPEC_LINE]++;
     }
   }
 
+  /* Make the spectra of the cells from which photons are to be generated */
 
+  emission_cdf_init (ptype, freqmin, freqmax);
 
 /* Now generate the photons looping over the Plasma cells */
 
   photstop = photstart;
 
-  icell_old = (-1);
   for (nplasma = 0; nplasma < NPLASMA; nplasma++)
   {
 
     photstart = photstop;
-    photstop = photstart + ptype[nplasma][FREE_FREE] + ptype[nplasma][FREE_BOUND] + ptype[nplasma][BOUND_BOUND];
-
-    icell = plasmamain[nplasma].nplasma;
+    photstop = photstart + ptype[nplasma][SPEC_FF] + ptype[nplasma][SPEC_FB] + ptype[nplasma][SPEC_LINE];
 
     for (np = photstart; np < photstop; np++)
     {
 
-      if (np < photstart + ptype[nplasma][FREE_FREE])
+      if (np < photstart + ptype[nplasma][SPEC_FF])
       {
         p[np].freq = one_ff (&plasmamain[nplasma], freqmin, freqmax);
         if (p[np].freq <= 0.0)
@@ -381,23 +365,12 @@ photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
           p[np].freq = 0.0;
         }
       }
-      else if (np < photstart + ptype[nplasma][FREE_FREE] + ptype[nplasma][FREE_BOUND])
+      else if (np < photstart + ptype[nplasma][SPEC_FF] + ptype[nplasma][SPEC_FB])
       {
         p[np].freq = one_fb (&plasmamain[nplasma], freqmin, freqmax);
       }
       else
       {
-
-        /* fill the lin_ptr->pow array. This must be done because it is not stored for all cells.
-           The if statement is intended to prevent recalculating the power if more than one
-           line photon is generated from this cell in this cycle.
-         */
-        if (icell != icell_old)
-        {
-          lum_lines (&plasmamain[nplasma], nline_min, nline_max);
-          icell_old = icell;
-        }
-
         p[np].freq = one_line (&plasmamain[nplasma], &p[np].nres);
         if (p[np].freq == 0)
         {
@@ -457,6 +430,7 @@ photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
     }
   }
 
+  free (ptype);
 
   return (nphot);
 }
@@ -479,7 +453,8 @@ photo_gen_wind (p, weight, freqmin, freqmax, photstart, nphot)
  * the transition that was excited
  *
  * ### Notes ###
- *
+ * The power in each line of the cell is kept with the other spectra of
+ * the cell (see emission_cdf.c), so lin_pow need not be filled first.
  *
  **********************************************************/
 
@@ -488,8 +463,6 @@ one_line (xplasma, nres)
      PlasmaPtr xplasma;
      int *nres;
 {
-  double xlum, xlumsum;
-  int m;
   /* Put in a bunch of checks */
   if (xplasma->lum_lines <= 0)
   {
@@ -503,18 +476,7 @@ one_line (xplasma, nres)
   }
 
 
-  xlum = xplasma->lum_lines * random_number (0.0, 1.0);
-
-  xlumsum = 0;
-  m = nline_min;
-  while (xlumsum < xlum && m < nline_max)
-  {
-    xlumsum += lin_ptr[m]->pow;
-    m++;
-  }
-  m--;
-  *nres = m;
-  return (lin_ptr[m]->freq);
+  return (emission_cdf_rand (xplasma, SPEC_LINE, 0.0, 0.0, nres));
 }
 
 
@@ -635,16 +597,16 @@ total_free (xplasma, t_e, f1, f2)
  *
  * ### Notes ###
  *
- * Within sirocco, this routine is accessed through one_ff
+ * Within sirocco, this routine is accessed through ff_cdf
  *
  * Most of the computation in this routine arises from calculating
  * a the gaunt factor, so this version of the code checks to
  * see if that can be avoided.
  **********************************************************/
 
-double ff_constant = 0;
-int ff_nplasma = -100;
-double ff_t_e = -100.;
+static THREAD_LOCAL double ff_constant = 0;
+static THREAD_LOCAL int ff_nplasma = -100;
+static THREAD_LOCAL double ff_t_e = -100.;
 
 double
 ff (xplasma, t_e, freq)
@@ -709,11 +671,53 @@ ff (xplasma, t_e, freq)
 
 
 
-/// We initialise the arrays that will contain the unscaled PDF
-double ff_x[ARRAY_PDF], ff_y[ARRAY_PDF];
+/**********************************************************/
+/**
+ * @brief      constructs the cdf of the ff emission of a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   A specific plasma cell
+ * @param [in] double  f1   The minimum frequency
+ * @param [in] double  f2   The maximum frequency
+ * @param [out] CdfPtr  cdf   The cdf
+ * @return     Always returns 0
+ *
+ * @details
+ * The emissivity is calculated on a grid of ARRAY_PDF equally spaced
+ * frequencies between f1 and f2.
+ *
+ **********************************************************/
+
+int
+ff_cdf (xplasma, f1, f2, cdf)
+     PlasmaPtr xplasma;
+     double f1, f2;
+     CdfPtr cdf;
+{
+  double x[ARRAY_PDF], y[ARRAY_PDF];
+  double dfreq;
+  int n;
+  int echeck;
+
+  dfreq = (f2 - f1) / (ARRAY_PDF - 1);
+  for (n = 0; n < ARRAY_PDF - 1; n++)
+  {
+    x[n] = f1 + dfreq * n;
+    y[n] = ff (xplasma, xplasma->t_e, x[n]);
+  }
+
+  x[ARRAY_PDF - 1] = f2;
+  y[ARRAY_PDF - 1] = ff (xplasma, xplasma->t_e, x[ARRAY_PDF - 1]);
+  if ((echeck = cdf_gen_from_array (cdf, x, y, ARRAY_PDF, f1, f2)) != 0)
+  {
+    Error
+      ("ff_cdf: cdf_gen_from_array error %d : nplasma %d f1 %g f2 %g te %g ne %g nh %g vol %g\n",
+       echeck, xplasma->nplasma, f1, f2, xplasma->t_e, xplasma->ne, xplasma->density[1], xplasma->vol);
+    Exit (0);
+  }
+
+  return (0);
+}
 
-/// Old values
-double one_ff_f1, one_ff_f2, one_ff_te;
 
 
 /**********************************************************/
@@ -730,14 +734,9 @@ double one_ff_f1, one_ff_f2, one_ff_te;
  * @details
  *
  * ### Notes ###
- * one is the windcell where the photon will be created.  It is needed
- * only for the temperature.  The code would be simplified
- * if simply the temperature were transmitted.
- *
- * The routine creeates a cdf given the conditions specified and then
- * samples this.  When the routine is re-entered it checks if the
- * conditions are the same as previously.  Given this it is desirable
- * to generate all of the photons in a single cell in one go.
+ * The frequency is drawn from the cdf of the ff emission of the cell,
+ * which is constructed by ff_cdf the first time it is needed after the
+ * luminosities of the cells have been calculated (see emission_cdf.c).
  *
  **********************************************************/
 
@@ -746,42 +745,13 @@ one_ff (xplasma, f1, f2)
      PlasmaPtr xplasma;         /* a single cell */
      double f1, f2;             /* freqmin and freqmax */
 {
-  double freq, dfreq;
-  int n;
-  int echeck;
-
   if (f2 < f1)
   {
     Error ("one_ff: Bad inputs f2 %g < f1 %g returning 0.0  t_e %g\n", f2, f1, xplasma->t_e);
     return (-1.0);
   }
 
-  /* Check to see if we have already generated a pdf */
-
-  if (xplasma->t_e != one_ff_te || f1 != one_ff_f1 || f2 != one_ff_f2)
-  {                             /* Generate a new pdf */
-    dfreq = (f2 - f1) / (ARRAY_PDF - 1);
-    for (n = 0; n < ARRAY_PDF - 1; n++)
-    {
-      ff_x[n] = f1 + dfreq * n;
-      ff_y[n] = ff (xplasma, xplasma->t_e, ff_x[n]);
-    }
-
-    ff_x[ARRAY_PDF - 1] = f2;
-    ff_y[ARRAY_PDF - 1] = ff (xplasma, xplasma->t_e, ff_x[ARRAY_PDF - 1]);
-    if ((echeck = cdf_gen_from_array (&cdf_ff, ff_x, ff_y, ARRAY_PDF, f1, f2)) != 0)
-    {
-      Error
-        ("one_ff: cdf_gen_from_array error %d : nplasma %d f1 %g f2 %g te %g ne %g nh %g vol %g\n",
-         echeck, xplasma->nplasma, f1, f2, xplasma->t_e, xplasma->ne, xplasma->density[1], xplasma->vol);
-      Exit (0);
-    }
-    one_ff_te = xplasma->t_e;
-    one_ff_f1 = f1;
-    one_ff_f2 = f2;
-  }
-  freq = cdf_get_rand (&cdf_ff);
-  return (freq);
+  return (emission_cdf_rand (xplasma, SPEC_FF, f1, f2, NULL));
 }
 
 
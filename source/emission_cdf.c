@@ -0,0 +1,453 @@
+/***********************************************************/
+/** @file  emission_cdf.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  The spectra of the free-free, free-bound and line emission of
+ * each cell, from which the frequencies of wind photons are drawn
+ *
+ * The frequency of a ff or fb photon is drawn from a cdf of the emission of
+ * the cell, and that of a line photon from the power in each line.  These
+ * used to be made in single global structures, which were remade whenever
+ * a photon was needed from a different cell, or, for fb emission, one whose
+ * temperature differed by more than 1%.  This is slow when photons come
+ * from many cells in turn, e.g. k-packets which are destroyed by ff
+ * emission during the transport.
+ *
+ * Instead, the spectra of each cell are made once, the first time they are
+ * needed after the luminosities of the cells have been calculated, and kept
+ * until the luminosities are calculated again.  Before the photons are
+ * generated, photo_gen_wind makes the spectra of all of the cells which
+ * emit, in parallel if more than one thread is available.
+ *
+ * Each spectrum is kept in arrays of exactly the size needed.  For lines,
+ * only those with non-zero power are kept, with the running sum of the
+ * power, so the line is found by a binary search.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+/* One of the spectra of a cell.  For ff and fb emission this is a cdf, with
+   the positions, values and gradients in consecutive blocks of n + 1 elements
+   of cdf.  For lines, cdf is the running sum of the power of the n lines which
+   emit, and line their positions in lin_ptr. */
+
+struct cell_spectrum
+{
+  int gen;                      /* The value of emission_cdf_gen when this was made */
+  double t_e, f1, f2;           /* The temperature and frequency limits for which it was made */
+  int nmin, nmax;               /* For lines, the range of lin_ptr for which it was made */
+  int n;                        /* The number of points (ff and fb) or lines */
+  double *cdf;
+  int *line;
+};
+
+static struct cell_spectrum *cell_spec = NULL;  /* NSPEC_CELL spectra for each plasma cell */
+static int cell_spec_nplasma = 0;       /* The number of cells for which cell_spec was allocated */
+static int emission_cdf_gen = 1;        /* This changes each time the luminosities of the cells are calculated */
+static double cell_spec_bytes = 0;      /* The memory used by the spectra */
+
+/* Work space for making the spectra, which is kept for each thread */
+
+static THREAD_LOCAL struct Cdf *spec_work_cdf = NULL;
+static THREAD_LOCAL double *spec_work_pow = NULL;
+static THREAD_LOCAL int spec_work_nlines = -1;
+
+
+
+/**********************************************************/
+/**
+ * @brief      allocate the work space used to make the spectra
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+static int
+emission_cdf_work (void)
+{
+  if (spec_work_cdf == NULL)
+  {
+    if ((spec_work_cdf = calloc (1, sizeof (struct Cdf))) == NULL)
+    {
+      Error ("emission_cdf_work: Unable to allocate memory for a cdf\n");
+      Exit (1);
+    }
+  }
+
+  if (spec_work_nlines != nlines)
+  {
+    free (spec_work_pow);
+    if ((spec_work_pow = calloc (nlines > 0 ? nlines : 1, sizeof (double))) == NULL)
+    {
+      Error ("emission_cdf_work: Unable to allocate memory for %d lines\n", nlines);
+      Exit (1);
+    }
+    spec_work_nlines = nlines;
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      allocate the spectra for each cell
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+static int
+emission_cdf_alloc (void)
+{
+  if (cell_spec != NULL && cell_spec_nplasma == NPLASMA)
+    return (0);
+
+  emission_cdf_free ();
+
+  if ((cell_spec = calloc ((size_t) NPLASMA * NSPEC_CELL, sizeof (struct cell_spectrum))) == NULL)
+  {
+    Error ("emission_cdf_alloc: Unable to allocate memory for the spectra of %d cells\n", NPLASMA);
+    Exit (1);
+  }
+  cell_spec_nplasma = NPLASMA;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      mark the spectra of all of the cells as out of date
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * This is called by wind_luminosity, whenever the luminosities of the
+ * cells are calculated.
+ *
+ **********************************************************/
+
+int
+emission_cdf_reset (void)
+{
+  emission_cdf_gen++;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      check whether a spectrum of a cell is up to date
+ *
+ **********************************************************/
+
+static int
+cell_spectrum_current (struct cell_spectrum *s, PlasmaPtr xplasma, int type, double f1, double f2)
+{
+  if (s->gen != emission_cdf_gen || s->t_e != xplasma->t_e)
+    return (FALSE);
+  if (type == SPEC_LINE)
+    return (s->nmin == nline_min && s->nmax == nline_max);
+  return (s->f1 == f1 && s->f2 == f2);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      the memory used by one of the spectra of a cell
+ *
+ **********************************************************/
+
+static double
+cell_spectrum_bytes (struct cell_spectrum *s, int type)
+{
+  if (type == SPEC_LINE)
+    return ((double) s->n * (sizeof (double) + sizeof (int)));
+  return (3. * s->n * sizeof (double));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      make one of the spectra of a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell
+ * @param [in] int  type   SPEC_FF, SPEC_FB or SPEC_LINE
+ * @param [in] double  f1   The minimum frequency
+ * @param [in] double  f2   The maximum frequency
+ * @return     Always returns 0
+ *
+ * @details
+ * For lines, the range of lines is that set by the last call to
+ * limit_lines, rather than f1 and f2.
+ *
+ **********************************************************/
+
+static int
+make_cell_spectrum (PlasmaPtr xplasma, int type, double f1, double f2)
+{
+  struct cell_spectrum *s;
+  double xlumsum, nbytes;
+  int n, m;
+
+  emission_cdf_work ();
+
+  s = &cell_spec[xplasma->nplasma * NSPEC_CELL + type];
+  nbytes = -cell_spectrum_bytes (s, type);
+  free (s->cdf);
+  free (s->line);
+  s->cdf = NULL;
+  s->line = NULL;
+  s->n = 0;
+
+  if (type == SPEC_LINE)
+  {
+    line_power (xplasma, nline_min, nline_max, spec_work_pow);
+
+    for (m = nline_min; m < nline_max; m++)
+    {
+      if (spec_work_pow[m] != 0)
+        s->n++;
+    }
+
+    s->cdf = calloc (s->n > 0 ? s->n : 1, sizeof (double));
+    s->line = calloc (s->n > 0 ? s->n : 1, sizeof (int));
+    if (s->cdf == NULL || s->line == NULL)
+    {
+      Error ("make_cell_spectrum: Unable to allocate memory for %d lines\n", s->n);
+      Exit (1);
+    }
+
+    /* The sum is accumulated over all of the lines in order, so that the line which is
+       chosen is the same as if the power of each line were added in turn */
+
+    xlumsum = 0;
+    n = 0;
+    for (m = nline_min; m < nline_max; m++)
+    {
+      xlumsum += spec_work_pow[m];
+      if (spec_work_pow[m] != 0)
+      {
+        s->cdf[n] = xlumsum;
+        s->line[n++] = m;
+      }
+    }
+    s->nmin = nline_min;
+    s->nmax = nline_max;
+  }
+  else
+  {
+    if (type == SPEC_FF)
+      ff_cdf (xplasma, f1, f2, spec_work_cdf);
+    else
+      fb_cdf (xplasma, f1, f2, spec_work_cdf);
+
+    s->n = spec_work_cdf->ncdf + 1;
+    if ((s->cdf = calloc (3 * s->n, sizeof (double))) == NULL)
+    {
+      Error ("make_cell_spectrum: Unable to allocate memory for a cdf of %d points\n", s->n);
+      Exit (1);
+    }
+    memcpy (s->cdf, spec_work_cdf->x, s->n * sizeof (double));
+    memcpy (s->cdf + s->n, spec_work_cdf->y, s->n * sizeof (double));
+    memcpy (s->cdf + 2 * s->n, spec_work_cdf->d, s->n * sizeof (double));
+    s->f1 = f1;
+    s->f2 = f2;
+  }
+
+  s->t_e = xplasma->t_e;
+  s->gen = emission_cdf_gen;
+
+  nbytes += cell_spectrum_bytes (s, type);
+  OMP_PRAGMA (omp atomic)
+  cell_spec_bytes += nbytes;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      make the spectra of the cells from which photons are to be
+ * generated
+ *
+ * @param [in] int  need[][NSPEC_CELL]   The number of photons of each type to be generated in each plasma cell
+ * @param [in] double  f1   The minimum frequency
+ * @param [in] double  f2   The maximum frequency
+ * @return     The number of cells for which spectra were made
+ *
+ * @details
+ * Only the spectra which are needed, and are not up to date, are made.  The
+ * cells are shared between the threads given by --threads.  limit_lines
+ * must have been called for f1 and f2.
+ *
+ **********************************************************/
+
+int
+emission_cdf_init (int need[][NSPEC_CELL], double f1, double f2)
+{
+  int *cells;
+  int n, ncells, nspec, nthreads, type;
+  double t0;
+
+  t0 = timer ();
+
+  emission_cdf_alloc ();
+
+  if ((cells = calloc (NPLASMA > 0 ? NPLASMA : 1, sizeof (int))) == NULL)
+  {
+    Error ("emission_cdf_init: Unable to allocate memory for %d cells\n", NPLASMA);
+    Exit (1);
+  }
+
+  ncells = nspec = 0;
+  for (n = 0; n < NPLASMA; n++)
+  {
+    for (type = 0; type < NSPEC_CELL; type++)
+    {
+      if (need[n][type] > 0 && !cell_spectrum_current (&cell_spec[n * NSPEC_CELL + type], &plasmamain[n], type, f1, f2))
+      {
+        nspec++;
+        if (ncells == 0 || cells[ncells - 1] != n)
+          cells[ncells++] = n;
+      }
+    }
+  }
+
+  nthreads = get_update_threads ();
+
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 1) private (n, type))
+  for (n = 0; n < ncells; n++)
+  {
+    for (type = 0; type < NSPEC_CELL; type++)
+    {
+      if (need[cells[n]][type] > 0
+          && !cell_spectrum_current (&cell_spec[cells[n] * NSPEC_CELL + type], &plasmamain[cells[n]], type, f1, f2))
+        make_cell_spectrum (&plasmamain[cells[n]], type, f1, f2);
+    }
+  }
+
+  free (cells);
+
+  Log_silent ("emission_cdf_init: Made %d spectra for %d cells with %d threads in %.2f s; the spectra use %.1f MB\n",
+              nspec, ncells, nthreads, timer () - t0, cell_spec_bytes / 1048576.);
+
+  return (ncells);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      draw the frequency of a photon from one of the spectra of a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell
+ * @param [in] int  type   SPEC_FF, SPEC_FB or SPEC_LINE
+ * @param [in] double  f1   The minimum frequency
+ * @param [in] double  f2   The maximum frequency
+ * @param [out] int *  nres   For lines, the line which was chosen
+ * @return     The frequency of the photon
+ *
+ * @details
+ * The spectrum is made here if it is not up to date.  For lines, the line is
+ * chosen with a probability proportional to its power, from the lines
+ * selected by the last call to limit_lines.
+ *
+ **********************************************************/
+
+double
+emission_cdf_rand (PlasmaPtr xplasma, int type, double f1, double f2, int *nres)
+{
+  struct cell_spectrum *s;
+  double xlum;
+  int ilo, ihi, imid;
+
+  if (cell_spec == NULL || cell_spec_nplasma != NPLASMA)
+  {
+    OMP_PRAGMA (omp critical (emission_cdf))
+    emission_cdf_alloc ();
+  }
+
+  s = &cell_spec[xplasma->nplasma * NSPEC_CELL + type];
+
+  if (!cell_spectrum_current (s, xplasma, type, f1, f2))
+  {
+    OMP_PRAGMA (omp critical (emission_cdf))
+    {
+      if (!cell_spectrum_current (s, xplasma, type, f1, f2))
+        make_cell_spectrum (xplasma, type, f1, f2);
+    }
+  }
+
+  if (type != SPEC_LINE)
+    return (cdf_get_rand_array (s->cdf, s->cdf + s->n, s->cdf + 2 * s->n, s->n - 1));
+
+  if (s->n == 0)
+  {
+    Error ("emission_cdf_rand: No lines with any power in cell %d\n", xplasma->nplasma);
+    *nres = -1;
+    return (0);
+  }
+
+  xlum = xplasma->lum_lines * random_number (0.0, 1.0);
+
+  ilo = 0;
+  ihi = s->n - 1;
+  while (ilo < ihi)
+  {
+    imid = (ilo + ihi) / 2;
+    if (s->cdf[imid] < xlum)
+      ilo = imid + 1;
+    else
+      ihi = imid;
+  }
+
+  *nres = s->line[ilo];
+  return (lin_ptr[*nres]->freq);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      release the memory used by the spectra
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+emission_cdf_free (void)
+{
+  int n;
+
+  if (cell_spec != NULL)
+  {
+    for (n = 0; n < cell_spec_nplasma * NSPEC_CELL; n++)
+    {
+      free (cell_spec[n].cdf);
+      free (cell_spec[n].line);
+    }
+    free (cell_spec);
+  }
+  cell_spec = NULL;
+  cell_spec_nplasma = 0;
+  cell_spec_bytes = 0;
+
+  return (0);
+}
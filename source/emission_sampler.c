@@ -0,0 +1,284 @@
+/***********************************************************/
+/** @file  emission_sampler.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Selection of the cells in which wind, k-packet and macro-atom
+ * photons are generated
+ *
+ * Each photon generated by the wind is assigned to a cell with a probability
+ * proportional to the luminosity of that cell.  This was done by summing the
+ * luminosities of the cells until the sum exceeded a random fraction of the
+ * total, which for every photon is a loop over the entire grid.  With a large
+ * grid this dominates the time taken to generate the photons.
+ *
+ * Instead, the running sum of the luminosities is stored for each type of
+ * emission, whenever the luminosities are calculated, and the cell is found by
+ * a binary search of this table.  The sums are accumulated in exactly the same
+ * order as the loops they replace, so the same cell is chosen for the same
+ * random number.
+ *
+ * For macro atoms, the table holds the running sum at the end of each cell,
+ * and the level which is deactivated is then found by summing over the levels
+ * of that cell alone.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+static struct emission_sampler
+{
+  int n;                        /* The number of cells in the table */
+  int nalloc;                   /* The number of cells for which space has been allocated */
+  double *cum;                  /* The running sum of the luminosity at the end of each cell */
+  int *nplasma;                 /* The plasma cell corresponding to each entry */
+} sampler[NSAMPLER];
+
+
+
+/**********************************************************/
+/**
+ * @brief      construct the table for one type of emission
+ *
+ * @param [in] int  type   SAMPLE_WIND, SAMPLE_KPKT or SAMPLE_MATOM
+ * @return     The number of cells in the table
+ *
+ * @details
+ * This is called each time the luminosities of the cells are calculated, by
+ * wind_luminosity for SAMPLE_WIND, get_kpkt_f and get_kpkt_heating_f for
+ * SAMPLE_KPKT, and get_matom_f and get_matom_f_accelerate for SAMPLE_MATOM.
+ *
+ * ### Notes ###
+ * The wind table is ordered by plasma cell, and the observer frame luminosity
+ * lum_tot / xgamma is used, as in photo_gen_wind.  The k-packet and macro-atom
+ * tables are ordered by wind cell, skipping cells which are not in the wind,
+ * as the loops in photo_gen_kpkt and photo_gen_matom were.
+ *
+ **********************************************************/
+
+int
+emission_sampler_init (int type)
+{
+  struct emission_sampler *s;
+  double xlumsum, dt_cmf;
+  int n, nwind, nplasma, upper;
+
+  s = &sampler[type];
+
+  if (s->nalloc < NPLASMA)
+  {
+    free (s->cum);
+    free (s->nplasma);
+    s->cum = calloc (NPLASMA, sizeof (double));
+    s->nplasma = calloc (NPLASMA, sizeof (int));
+    if (s->cum == NULL || s->nplasma == NULL)
+    {
+      Error ("emission_sampler_init: Unable to allocate memory for %d cells\n", NPLASMA);
+      Exit (1);
+    }
+    s->nalloc = NPLASMA;
+  }
+
+  xlumsum = 0;
+  n = 0;
+
+  if (type == SAMPLE_WIND)
+  {
+    for (nplasma = 0; nplasma < NPLASMA; nplasma++)
+    {
+      dt_cmf = 1.0 / plasmamain[nplasma].xgamma;
+      xlumsum += plasmamain[nplasma].lum_tot * dt_cmf;
+      s->cum[n] = xlumsum;
+      s->nplasma[n++] = nplasma;
+    }
+  }
+  else
+  {
+    for (nwind = 0; nwind < NDIM2 && n < NPLASMA; nwind++)
+    {
+      if (wmain[nwind].inwind < 0)
+        continue;
+
+      nplasma = wmain[nwind].nplasma;
+      if (type == SAMPLE_KPKT)
+      {
+        xlumsum += plasmamain[nplasma].kpkt_emiss;
+      }
+      else
+      {
+        for (upper = 0; upper < nlevels_macro; upper++)
+          xlumsum += macromain[nplasma].matom_emiss[upper];
+      }
+      s->cum[n] = xlumsum;
+      s->nplasma[n++] = nplasma;
+    }
+  }
+
+  s->n = n;
+
+  return (n);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      find the cell in which a photon is generated
+ *
+ * @param [in] int  type   SAMPLE_WIND, SAMPLE_KPKT or SAMPLE_MATOM
+ * @param [in] double  xlum   A random fraction of the total luminosity
+ * @param [out] int *  level   For SAMPLE_MATOM, the macro-atom level which is deactivated
+ * @return     The plasma cell in which the photon is generated
+ *
+ * @details
+ * This is the first cell at which the running sum of the luminosity reaches
+ * xlum.  If xlum exceeds the total, which can happen because the total used
+ * to normalise the random number is summed differently, the last cell which
+ * emits is used.
+ *
+ **********************************************************/
+
+int
+emission_sampler_cell (int type, double xlum, int *level)
+{
+  struct emission_sampler *s;
+  double xlumsum;
+  int ilo, ihi, imid, nplasma, upper;
+
+  s = &sampler[type];
+
+  if (s->n == 0)
+  {
+    Error ("emission_sampler_cell: No cells have been tabulated for emission type %d\n", type);
+    Exit (1);
+  }
+
+  if (xlum > s->cum[s->n - 1])
+  {
+    Error ("emission_sampler_cell: Luminosity %.6e exceeds the total %.6e for emission type %d\n", xlum, s->cum[s->n - 1], type);
+    xlum = s->cum[s->n - 1];
+  }
+
+  ilo = 0;
+  ihi = s->n - 1;
+  while (ilo < ihi)
+  {
+    imid = (ilo + ihi) / 2;
+    if (s->cum[imid] < xlum)
+      ilo = imid + 1;
+    else
+      ihi = imid;
+  }
+
+  nplasma = s->nplasma[ilo];
+
+  if (type == SAMPLE_MATOM && level != NULL)
+  {
+    xlumsum = ilo > 0 ? s->cum[ilo - 1] : 0;
+    for (upper = 0; upper < nlevels_macro - 1; upper++)
+    {
+      if ((xlumsum += macromain[nplasma].matom_emiss[upper]) >= xlum)
+        break;
+    }
+    *level = upper;
+  }
+
+  return (nplasma);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      choose the cells in which a number of photons are generated,
+ * ordered by cell
+ *
+ * @param [in] int  type   SAMPLE_KPKT or SAMPLE_MATOM
+ * @param [in] double  ftot   The total luminosity of this type of emission
+ * @param [in] int  nphot   The number of photons
+ * @param [out] int *  cells   The plasma cell of each photon
+ * @param [out] int *  levels   For SAMPLE_MATOM, the level deactivated for each photon, or NULL
+ * @return     The number of photons
+ *
+ * @details
+ * The cells are drawn first for all of the photons, and then sorted, so
+ * that the photons from each cell can be generated together.  Within a
+ * cell, the photons are in the order in which they were drawn.
+ *
+ **********************************************************/
+
+int
+emission_sampler_draw (int type, double ftot, int nphot, int *cells, int *levels)
+{
+  int *ncell, *xcells, *xlevels;
+  int n, nplasma, level;
+
+  ncell = calloc (NPLASMA + 1, sizeof (int));
+  xcells = calloc (nphot, sizeof (int));
+  xlevels = calloc (nphot, sizeof (int));
+  if (ncell == NULL || xcells == NULL || xlevels == NULL)
+  {
+    Error ("emission_sampler_draw: Unable to allocate memory for %d photons\n", nphot);
+    Exit (1);
+  }
+
+  level = 0;
+  for (n = 0; n < nphot; n++)
+  {
+    nplasma = emission_sampler_cell (type, random_number (0.0, 1.0) * ftot, &level);
+    xcells[n] = nplasma;
+    xlevels[n] = level;
+    ncell[nplasma + 1]++;
+  }
+
+  /* Sort the photons by cell, keeping the order within each cell */
+
+  for (nplasma = 0; nplasma < NPLASMA; nplasma++)
+    ncell[nplasma + 1] += ncell[nplasma];
+
+  for (n = 0; n < nphot; n++)
+  {
+    nplasma = xcells[n];
+    cells[ncell[nplasma]] = nplasma;
+    if (levels != NULL)
+      levels[ncell[nplasma]] = xlevels[n];
+    ncell[nplasma]++;
+  }
+
+  free (ncell);
+  free (xcells);
+  free (xlevels);
+
+  return (nphot);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      release the memory used by the tables
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+emission_sampler_free (void)
+{
+  int n;
+
+  for (n = 0; n < NSAMPLER; n++)
+  {
+    free (sampler[n].cum);
+    free (sampler[n].nplasma);
+    sampler[n].cum = NULL;
+    sampler[n].nplasma = NULL;
+    sampler[n].n = sampler[n].nalloc = 0;
+  }
+
+  return (0);
+}
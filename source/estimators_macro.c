@@ -29,9 +29,9 @@
 
 
 /* A couple of external things for use in the routines for computing gamma's below. */
-struct topbase_phot *cont_ext_ptr2;     //continuum pointer passed externally
-double temp_ext2;               //temperature passed externally
-double temp_ext_rad;            //radiation temperature passed externally 
+THREAD_LOCAL struct topbase_phot *cont_ext_ptr2;        //continuum pointer passed externally
+THREAD_LOCAL double temp_ext2;  //temperature passed externally
+THREAD_LOCAL double temp_ext_rad;       //radiation temperature passed externally 
 
 #define ALPHA_SP_CONSTANT 5.79618e-36   //
 
@@ -115,6 +115,10 @@ bf_estimators_increment (one, p, ds)
 
 
 
+  /* kap_bf has not been filled in if the opacity was interpolated from the tables in bf_cache.c */
+
+  bf_cache_expand ();
+
   for (nn = 0; nn < xplasma->kbf_nuse; nn++)
   {
     n = xplasma->kbf_use[nn];
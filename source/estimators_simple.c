@@ -69,10 +69,10 @@
    are ionizing photons
 */
 
-int previous_nioniz_nplasma = -1;
-int previous_nioniz_np = -1;
-int previous_nplasma = -1;
-int previous_np = -1;
+THREAD_LOCAL int previous_nioniz_nplasma = -1;
+THREAD_LOCAL int previous_nioniz_np = -1;
+THREAD_LOCAL int previous_nplasma = -1;
+THREAD_LOCAL int previous_np = -1;
 
 int
 update_banded_estimators (xplasma, p, ds, w_ave, ndom)
@@ -16,6 +16,116 @@
 #include "atomic.h"
 #include "sirocco.h"
 
+static long extract_nray[MSPEC + NSPEC];        /* The number of rays extracted with extract_batch for each spectrum */
+static long extract_nterm[MSPEC + NSPEC];       /* The number of these which were terminated early */
+
+
+/**********************************************************/
+/**
+ * @brief      Increment the spectrum with a photon which has escaped
+ *
+ * @param [in] PhotPtr  pp  The photon at the point it escaped (in the observer frame)
+ * @param [in, out] PhotPtr  pstart  The photon at the point it was extracted
+ * @param [in] double  tau   The optical depth along the line of sight
+ * @param [in] int  nspec   the spectrum which will be incremented
+ * @return     Always returns 0
+ *
+ * @details
+ * This is the part of extract_one which is carried out once a photon
+ * has escaped; it is shared with extract_batch.  pstart is used
+ * to record the photon in reverberation mode, and is modified.
+ *
+ **********************************************************/
+
+static int
+extract_tally (pp, pstart, tau, nspec)
+     PhotPtr pp, pstart;
+     double tau;
+     int nspec;
+{
+  int k, k1;
+  double lfreqmin, lfreqmax, ldfreq;
+
+  if (!(0 <= tau && tau < 1.e4))
+    Error_silent ("Warning: extract_one: ignoring very high tau  %8.2e at %g\n", tau, pp->freq);
+  else
+  {
+    k = (int) ((pp->freq - xxspec[nspec].freqmin) / xxspec[nspec].dfreq);
+
+    /*
+     * Force the frequency to be in range of that
+     * recorded in the spectrum
+     */
+
+    if (k < 0)
+      k = 0;
+    else if (k > NWAVE_EXTRACT - 1)
+      k = NWAVE_EXTRACT - 1;
+
+
+    lfreqmin = log10 (xxspec[nspec].freqmin);
+    lfreqmax = log10 (xxspec[nspec].freqmax);
+    ldfreq = (lfreqmax - lfreqmin) / NWAVE_EXTRACT;
+
+    k1 = (int) ((log10 (pp->freq) - log10 (xxspec[nspec].freqmin)) / ldfreq);
+    if (k1 < 0)
+    {
+      k1 = 0;
+    }
+    if (k1 > NWAVE_EXTRACT - 1)
+    {
+      k1 = NWAVE_EXTRACT - 1;
+    }
+    /*
+     * Increment the spectrum.  Note that the photon
+     * weight has not been diminished by its passage
+     * through th wind, even though it may have
+     * encounterd a number of resonance, and so the
+     * weight must be reduced by tau
+     */
+
+    OMP_PRAGMA (omp atomic)
+    xxspec[nspec].f[k] += pp->w * exp (-(tau));
+    OMP_PRAGMA (omp atomic)
+    xxspec[nspec].lf[k1] += pp->w * exp (-(tau));
+
+
+
+    /*
+     * If this photon was a wind photon, then also
+     * increment the "reflected" spectrum
+     */
+    if (pp->origin == PTYPE_WIND || pp->origin == PTYPE_WIND_MATOM || pp->nscat > 0)
+    {
+
+      OMP_PRAGMA (omp atomic)
+      xxspec[nspec].f_wind[k] += pp->w * exp (-(tau));
+      OMP_PRAGMA (omp atomic)
+      xxspec[nspec].lf_wind[k1] += pp->w * exp (-(tau));
+
+    }
+    /*
+     * Records the total distance travelled by extracted
+     * photon if in reverberation mode
+     */
+    if (geo.reverb != REV_NONE)
+    {
+      if (geo.reverb_filter_lines == -2 || pstart->nscat > 0 || pstart->origin > 9 || (pstart->nres > -1 && pstart->nres < nlines))
+      {
+        /*If this photon has scattered, been reprocessed, 
+           or originated in the wind it 's important
+         */
+        pstart->w = pp->w * exp (-(tau));
+        stuff_v (xxspec[nspec].lmn, pstart->lmn);
+        delay_dump_single (pstart, nspec);
+      }
+    }
+  }
+
+  return (0);
+}
+
+
 
 /**********************************************************/
 /**
@@ -54,6 +164,10 @@
  * 	Pc/Pw=12 cos(theta)*(1+b cos(theta)/(3+2b) where b=1.5 corresponds to the
  * Eddington approximation.
  *
+ * If the --extract-batch option is set, the photons for all of the
+ * angles are extracted together by extract_batch rather than one at a
+ * time by extract_one.
+ *
  * Usually, Python constructs a spectrum of all photons, but there are
  * advanced options which allone to restrict the spectrum created to
  * those produced with a certain number of scatters or from photons
@@ -99,9 +213,13 @@ extract (w, p, itype)
   int ishell;
   double vel[3];
   double weight_scale;
-  double w_orig;
+  double w_orig, t0;
+  struct photon batch[NSPEC];
+  int nspec_batch[NSPEC];
+  int nbatch;
 
   tau = 0.0;
+  nbatch = 0;
 
 
 
@@ -401,11 +519,29 @@ extract (w, p, itype)
       continue;
     }
 
-    /* If one has reached this point, we extract the photon and increment the spectrum */
+    /* If one has reached this point, we extract the photon and increment the spectrum,
+       or, if --extract-batch is set, save it to be extracted with the photons for the
+       other angles */
 
+    if (modes.extract_batch && nbatch < NSPEC)
+    {
+      stuff_phot (&pp, &batch[nbatch]);
+      nspec_batch[nbatch++] = n;
+    }
+    else
+    {
+      t0 = prof_start ();
+      extract_one (w, &pp, n);
+      prof_stop (PROF_EXTRACT, t0);
+    }
 
-    extract_one (w, &pp, n);
+  }
 
+  if (nbatch > 0)
+  {
+    t0 = prof_start ();
+    extract_batch (w, batch, nspec_batch, nbatch);
+    prof_stop (PROF_EXTRACT, t0);
   }
 
 
@@ -455,9 +591,7 @@ extract_one (w, pp, nspec)
   struct photon pdummy, pdummy_orig;
   double weight_min;
   int icell;
-  int k, k1;
   double tau;
-  double lfreqmin, lfreqmax, ldfreq;
   double normal[3];
 
   /*
@@ -530,86 +664,212 @@ extract_one (w, pp, nspec)
 
   if (istat == P_ESCAPE)
   {
+    extract_tally (pp, &pstart, tau, nspec);
+  }
+  if (istat > -1 && istat < 9)
+  {
+    OMP_PRAGMA (omp atomic)
+    xxspec[nspec].nphot[istat]++;
+  }
+  else
+    Error
+      ("Extract: Abnormal photon %5d  %d %9.2e %9.2e %9.2e %9.2e %9.2e %9.2e\n",
+       pp->np, istat, pp->x[0], pp->x[1], pp->x[2], pp->lmn[0], pp->lmn[1], pp->lmn[2]);
 
-    if (!(0 <= tau && tau < 1.e4))
-      Error_silent ("Warning: extract_one: ignoring very high tau  %8.2e at %g\n", tau, pp->freq);
-    else
-    {
-      k = (int) ((pp->freq - xxspec[nspec].freqmin) / xxspec[nspec].dfreq);
+  return (istat);
+}
 
-      /*
-       * Force the frequency to be in range of that
-       * recorded in the spectrum
-       */
 
-      if (k < 0)
-        k = 0;
-      else if (k > NWAVE_EXTRACT - 1)
-        k = NWAVE_EXTRACT - 1;
 
+/**********************************************************/
+/**
+ * @brief      Reduce the weights of the photons extracted along all of the
+ * lines of sight from a single point.
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in, out] PhotPtr  batch  The photons to be extracted (in the observer frame)
+ * @param [in] int *  nspec   the spectrum which will be incremented by each photon
+ * @param [in] int  nbatch   the number of photons in the batch
+ * @return     The number of photons which escaped
+ *
+ * @details
+ * This is the alternative to extract_one used when the --extract-batch option
+ * is set.  The photons, one for each observer, are advanced together one
+ * step of translate and walls at a time, so that the plasma cells and
+ * the opacities (in macro-atom mode, the tables of bound-free opacities
+ * if --bf-cache is set) which are used are shared by photons that
+ * are still close together.
+ *
+ * The difference from extract_one is that a photon is abandoned as soon as
+ * its contribution to the spectrum is negligible, that is once the optical
+ * depth along the line of sight exceeds modes.extract_tau_max, or once
+ * pp->w exp(-tau) falls below EPSILON times the original weight.  The number
+ * of photons abandoned for each spectrum is recorded, and reported by
+ * extract_report.
+ *
+ * ### Notes ###
+ * extract_one follows the photon until its optical depth reaches 20, at which
+ * point its contribution is a factor of 2e-9 smaller than it would have been
+ * without the wind. With the default value of 10 for modes.extract_tau_max,
+ * the contribution of the photons which are abandoned is less than 5e-5 of
+ * their weight.
+ *
+ **********************************************************/
+
+int
+extract_batch (w, batch, nspec, nbatch)
+     WindPtr w;
+     PhotPtr batch;
+     int *nspec;
+     int nbatch;
+{
+  struct photon pstart[NSPEC];
+  double tau[NSPEC], weight_min[NSPEC];
+  int istat[NSPEC];
+  double normal[3];
+  int i, nres, nactive, nescape, nterm;
+  PhotPtr pp;
+
+  for (i = 0; i < nbatch; i++)
+  {
+    pp = &batch[i];
+    check_frame (pp, F_OBSERVER, "extract_batch: photon not in observer frame at start");
+    weight_min[i] = EPSILON * pp->w;
+    tau[i] = 0.0;
+    pp->ds = 0;
+    stuff_phot (pp, &pstart[i]);
+    istat[i] = P_INWIND;
+  }
+
+  nactive = nbatch;
+  while (nactive > 0)
+  {
+    nactive = 0;
+    for (i = 0; i < nbatch; i++)
+    {
+      if (istat[i] != P_INWIND)
+        continue;
 
-      lfreqmin = log10 (xxspec[nspec].freqmin);
-      lfreqmax = log10 (xxspec[nspec].freqmax);
-      ldfreq = (lfreqmax - lfreqmin) / NWAVE_EXTRACT;
+      pp = &batch[i];
+      translate (w, pp, modes.extract_tau_max, &tau[i], &nres);
+      istat[i] = walls (pp, &pstart[i], normal);
 
-      k1 = (int) ((log10 (pp->freq) - log10 (xxspec[nspec].freqmin)) / ldfreq);
-      if (k1 < 0)
+      if (istat[i] == -1)
       {
-        k1 = 0;
+        Error ("extract_batch: Abnormal return from translate of phot no %5d\n", pp->np);
+        Error ("extract_batch: start %10.3e %10.3e %10.3e %10.3e %10.3e %10.3e\n",
+               pstart[i].x[0], pstart[i].x[1], pstart[i].x[2], pstart[i].lmn[0], pstart[i].lmn[1], pstart[i].lmn[2]);
+        Error ("extract_batch:    is %10.3e %10.3e %10.3e %10.3e %10.3e %10.3e\n",
+               pp->x[0], pp->x[1], pp->x[2], pp->lmn[0], pp->lmn[1], pp->lmn[2]);
       }
-      if (k1 > NWAVE_EXTRACT - 1)
+      else if (istat[i] == P_INWIND && pp->w * exp (-tau[i]) < weight_min[i])
       {
-        k1 = NWAVE_EXTRACT - 1;
+        istat[i] = P_ABSORB;
       }
-      /*
-       * Increment the spectrum.  Note that the photon
-       * weight has not been diminished by its passage
-       * through th wind, even though it may have
-       * encounterd a number of resonance, and so the
-       * weight must be reduced by tau
-       */
+      else if (istat[i] == P_INWIND)
+      {
+        nactive++;
+      }
+    }
+  }
 
-      xxspec[nspec].f[k] += pp->w * exp (-(tau));
-      xxspec[nspec].lf[k1] += pp->w * exp (-(tau));
+  nescape = 0;
+  for (i = 0; i < nbatch; i++)
+  {
+    pp = &batch[i];
+    nterm = FALSE;
 
+    if (istat[i] == P_ESCAPE)
+    {
+      extract_tally (pp, &pstart[i], tau[i], nspec[i]);
+      nescape++;
+    }
+    else if (istat[i] == P_SCAT || (istat[i] == P_ABSORB && pp->w >= weight_min[i]))
+    {
+      nterm = TRUE;
+    }
 
+    if (istat[i] > -1 && istat[i] < 9)
+    {
+      OMP_PRAGMA (omp atomic)
+      xxspec[nspec[i]].nphot[istat[i]]++;
+    }
+    else
+      Error
+        ("extract_batch: Abnormal photon %5d  %d %9.2e %9.2e %9.2e %9.2e %9.2e %9.2e\n",
+         pp->np, istat[i], pp->x[0], pp->x[1], pp->x[2], pp->lmn[0], pp->lmn[1], pp->lmn[2]);
 
-      /*
-       * If this photon was a wind photon, then also
-       * increment the "reflected" spectrum
-       */
-      if (pp->origin == PTYPE_WIND || pp->origin == PTYPE_WIND_MATOM || pp->nscat > 0)
-      {
+    OMP_PRAGMA (omp atomic)
+    extract_nray[nspec[i]]++;
+    if (nterm)
+    {
+      OMP_PRAGMA (omp atomic)
+      extract_nterm[nspec[i]]++;
+    }
+  }
 
-        xxspec[nspec].f_wind[k] += pp->w * exp (-(tau));
-        xxspec[nspec].lf_wind[k1] += pp->w * exp (-(tau));
+  return (nescape);
+}
 
-      }
-      /*
-       * Records the total distance travelled by extracted
-       * photon if in reverberation mode
-       */
-      if (geo.reverb != REV_NONE)
-      {
-        if (geo.reverb_filter_lines == -2 || pstart.nscat > 0 || pstart.origin > 9 || (pstart.nres > -1 && pstart.nres < nlines))
-        {
-          /*If this photon has scattered, been reprocessed, 
-             or originated in the wind it 's important
-           */
-          pstart.w = pp->w * exp (-(tau));
-          stuff_v (xxspec[nspec].lmn, pstart.lmn);
-          delay_dump_single (&pstart, nspec);
-        }
-      }
-    }
 
+
+/**********************************************************/
+/**
+ * @brief      Report the number of photons abandoned by extract_batch
+ *
+ * @return     The total number of photons abandoned
+ *
+ * @details
+ * This is called at the end of each spectral cycle.  The numbers of
+ * photons extracted and abandoned for each observer are summed over
+ * all of the processes, written to the log, and reset.  It does
+ * nothing unless the --extract-batch option is set.
+ *
+ **********************************************************/
+
+long
+extract_report (void)
+{
+  int n;
+  long nterm_tot;
+#ifdef MPI_ON
+  long counts[2 * (MSPEC + NSPEC)];
+#endif
+
+  if (modes.extract_batch == FALSE)
+    return (0);
+
+#ifdef MPI_ON
+
+  for (n = 0; n < MSPEC + NSPEC; n++)
+  {
+    counts[n] = extract_nray[n];
+    counts[n + MSPEC + NSPEC] = extract_nterm[n];
   }
-  if (istat > -1 && istat < 9)
-    xxspec[nspec].nphot[istat]++;
-  else
-    Error
-      ("Extract: Abnormal photon %5d  %d %9.2e %9.2e %9.2e %9.2e %9.2e %9.2e\n",
-       pp->np, istat, pp->x[0], pp->x[1], pp->x[2], pp->lmn[0], pp->lmn[1], pp->lmn[2]);
 
-  return (istat);
+  MPI_Allreduce (MPI_IN_PLACE, counts, 2 * (MSPEC + NSPEC), MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+  for (n = 0; n < MSPEC + NSPEC; n++)
+  {
+    extract_nray[n] = counts[n];
+    extract_nterm[n] = counts[n + MSPEC + NSPEC];
+  }
+#endif
+
+  nterm_tot = 0;
+  for (n = MSPEC; n < nspectra; n++)
+  {
+    Log ("extract_report: %-20s %10ld of %10ld extracted photons (%5.1f%%) abandoned at tau > %.1f\n",
+         xxspec[n].name, extract_nterm[n], extract_nray[n],
+         extract_nray[n] > 0 ? 100. * extract_nterm[n] / extract_nray[n] : 0.0, modes.extract_tau_max);
+    nterm_tot += extract_nterm[n];
+  }
+
+  for (n = 0; n < MSPEC + NSPEC; n++)
+  {
+    extract_nray[n] = 0;
+    extract_nterm[n] = 0;
+  }
+
+  return (nterm_tot);
 }
@@ -230,26 +230,7 @@ calloc_plasma (nelem)
        sizeof (plasma_dummy), (nelem + 1), 1.e-6 * (nelem + 1) * sizeof (plasma_dummy));
   }
 
-  /* Now allocate space for storing photon frequencies -- 57h */
-  if (photstoremain != NULL)
-  {
-    free (photstoremain);
-  }
-  photstoremain = (PhotStorePtr) calloc (sizeof (photon_store_dummy), (nelem + 1));
-
-  if (photstoremain == NULL)
-  {
-    Error ("There is a problem in allocating memory for the photonstore structure\n");
-    Exit (0);
-  }
-  else
-  {
-    Log
-      ("Allocated %10d bytes for each of %5d elements of photonstore totaling %10.1f Mb \n",
-       sizeof (photon_store_dummy), (nelem + 1), 1.e-6 * (nelem + 1) * sizeof (photon_store_dummy));
-  }
-
-  /* Repeat above for matom storage photon frequencies -- 82h */
+  /* Now allocate space for storing macro atom photon frequencies -- 82h */
   if (matomphotstoremain != NULL)
   {
     free (matomphotstoremain);
@@ -736,6 +717,88 @@ calloc_matom_matrix (nelem)
   return (0);
 }
 
+/**********************************************************/
+/**
+ * @brief  Decide in which cells the macro-atom matrices are stored, and
+ * allocate or free the matrices accordingly
+ *
+ * @return  The number of cells in which the matrix is stored
+ *
+ * @details
+ * If modes.store_matom_matrix is TRUE, matrices are stored for as many cells
+ * as fit into modes.store_matom_matrix_mb MB, or for all of the cells if this
+ * is zero (the default).  In the remaining cells, the matrix is calculated
+ * whenever it is needed.
+ *
+ * ### Notes ###
+ * The value of store_matom_matrix in macromain on entry is assumed to record
+ * whether the matrix for the cell has been allocated, as it is when the
+ * structure has been read from a windsave file.
+ *
+ **********************************************************/
+
+int
+set_matom_matrix_storage (void)
+{
+  int nrows = nlevels_macro + 1;
+  int n, nstore, store;
+  double bytes;
+
+  bytes = (double) nrows *nrows * sizeof (double) + nrows * sizeof (double *);
+  nstore = NPLASMA;
+  if (modes.store_matom_matrix == FALSE)
+  {
+    nstore = 0;
+  }
+  else if (modes.store_matom_matrix_mb > 0 && modes.store_matom_matrix_mb * 1024. * 1024. < bytes * NPLASMA)
+  {
+    nstore = (int) (modes.store_matom_matrix_mb * 1024. * 1024. / bytes);
+  }
+
+  if (nlevels_macro == 0 && geo.nmacro == 0)
+  {
+    for (n = 0; n < NPLASMA; n++)
+    {
+      macromain[n].store_matom_matrix = modes.store_matom_matrix;
+    }
+    return (0);
+  }
+
+  for (n = 0; n < NPLASMA; n++)
+  {
+    store = (n < nstore);
+    if (store == TRUE && macromain[n].store_matom_matrix != TRUE)
+    {
+      allocate_macro_matrix (&macromain[n].matom_matrix, nrows);
+    }
+    else if (store == FALSE && macromain[n].store_matom_matrix == TRUE)
+    {
+      free (macromain[n].matom_matrix[0]);
+      free (macromain[n].matom_matrix);
+    }
+
+    if (store == FALSE)
+    {
+      macromain[n].matom_matrix = NULL;
+      macromain[n].matrix_rates_known = FALSE;
+    }
+    macromain[n].store_matom_matrix = store;
+  }
+
+  if (nstore > 0)
+  {
+    Log ("Storing macro-atom matrices for %d of %d cells (%.1f MB)\n", nstore, NPLASMA, bytes * nstore / 1024. / 1024.);
+  }
+  if (modes.store_matom_matrix == TRUE && nstore < NPLASMA)
+  {
+    Log ("Macro-atom matrices will be calculated when they are needed in the remaining cells\n");
+  }
+
+  return (nstore);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief  Allocate memory for a square matom_matrix array
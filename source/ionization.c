@@ -353,7 +353,22 @@ check_convergence (void)
 
 
 /* An externall pointer reference used by zero_emit.  */
-PlasmaPtr xxxplasma;
+THREAD_LOCAL PlasmaPtr xxxplasma;
+
+/* Statistics on the cost and accuracy of calc_te, reported by calc_te_summary.  These are
+   shared by the threads which update the wind, so are only changed atomically */
+
+long te_ncalls = 0;             /* The number of calls to calc_te */
+long te_nevals = 0;             /* The number of evaluations of the cooling by zero_emit */
+double te_time = 0.0;           /* The time spent in calc_te */
+long te_ngrid = 0;              /* The number of cells in which the temperature was found with the grid */
+long te_ncheck = 0;             /* The number of these which were checked against zero_find */
+double te_dt_sum = 0.0;         /* The sum of the absolute differences between the two */
+double te_dt_max = 0.0;         /* The largest of these differences */
+
+#define TE_GRID_MAX    16       /* The maximum number of temperatures at which the cooling is evaluated */
+#define TE_GRID_TOL    50.      /* The accuracy required of the temperature, as for zero_find */
+#define TE_GRID_CHECK  50       /* One in this many cells is also solved with zero_find */
 
 
 /**********************************************************/
@@ -486,8 +501,13 @@ double
 calc_te (PlasmaPtr xplasma, double tmin, double tmax)
 {
   double z1, z2;
+  double t_start, t_check, t_exact, dt;
+  long igrid;
   int ierr = FALSE;
 
+  t_start = timer ();
+  t_exact = -1.0;
+
 
   /* we assign a plasma pointer here to a fixed structure because
    * we need to call zbrent and we cannot pass the xplasma ptr directly
@@ -507,9 +527,33 @@ calc_te (PlasmaPtr xplasma, double tmin, double tmax)
    * the estimated temperature, but if not we chose the best direction
    */
 
-  if ((z1 * z2 < 0.0))
+  if ((z1 * z2 < 0.0) && modes.te_grid)
+  {                             // Then the interval is bracketed, but use the grid
+    OMP_PRAGMA (omp atomic capture)
+    igrid = te_ngrid++;
+    if (igrid % TE_GRID_CHECK == 0)
+    {
+      t_check = timer ();
+      t_exact = zero_find (zero_emit2, tmin, tmax, TE_GRID_TOL, &ierr);
+      OMP_PRAGMA (omp atomic)
+      te_ncheck++;
+      t_start += timer () - t_check;    /* Do not count the check in the time spent */
+    }
+    xplasma->t_e = calc_te_grid (tmin, z1, tmax, z2);
+    if (t_exact > 0.0)
+    {
+      dt = fabs (xplasma->t_e - t_exact);
+      OMP_PRAGMA (omp critical (calc_te_stats))
+      {
+        te_dt_sum += dt;
+        if (dt > te_dt_max)
+          te_dt_max = dt;
+      }
+    }
+  }
+  else if ((z1 * z2 < 0.0))
   {                             // Then the interval is bracketed
-    xplasma->t_e = zero_find (zero_emit2, tmin, tmax, 50., &ierr);
+    xplasma->t_e = zero_find (zero_emit2, tmin, tmax, TE_GRID_TOL, &ierr);
     if (ierr)
     {
       Error ("calc_te: zero_find failed to find a temperature\n");
@@ -554,6 +598,10 @@ calc_te (PlasmaPtr xplasma, double tmin, double tmax)
   xplasma->heat_tot += xplasma->heat_photo_macro;
   xplasma->heat_photo += xplasma->heat_photo_macro;
 
+  OMP_PRAGMA (omp atomic)
+  te_ncalls++;
+  OMP_PRAGMA (omp atomic)
+  te_time += timer () - t_start;
 
   return (xplasma->t_e);
 
@@ -562,6 +610,216 @@ calc_te (PlasmaPtr xplasma, double tmin, double tmax)
 
 
 
+/**********************************************************/
+/**
+ * @brief  evaluate the polynomial through a set of points
+ *
+ * @param [in] double *  t   The temperatures of the points
+ * @param [in] double *  z   The values at these temperatures
+ * @param [in] int  n   The number of points
+ * @param [in] double  x   The temperature at which the polynomial is required
+ * @param [out] double *  dzdx   The derivative of the polynomial at x
+ * @return     The value of the polynomial at x
+ *
+ **********************************************************/
+
+static double
+te_grid_poly (double *t, double *z, int n, double x, double *dzdx)
+{
+  double p, dp, l, dl, term;
+  int i, j, k;
+
+  p = dp = 0.0;
+  for (i = 0; i < n; i++)
+  {
+    l = 1.0;
+    dl = 0.0;
+    for (j = 0; j < n; j++)
+    {
+      if (j == i)
+        continue;
+      l *= (x - t[j]) / (t[i] - t[j]);
+      term = 1.0 / (t[i] - t[j]);
+      for (k = 0; k < n; k++)
+      {
+        if (k != i && k != j)
+          term *= (x - t[k]) / (t[i] - t[k]);
+      }
+      dl += term;
+    }
+    p += z[i] * l;
+    dp += z[i] * dl;
+  }
+
+  *dzdx = dp;
+  return (p);
+}
+
+
+
+
+/**********************************************************/
+/**
+ * @brief  find the temperature at which heating and cooling balance
+ * by interpolating on a grid of temperatures
+ *
+ * @param [in] double  tmin   The lower end of the bracketing interval
+ * @param [in] double  z1   The value of zero_emit at tmin
+ * @param [in] double  tmax   The upper end of the bracketing interval
+ * @param [in] double  z2   The value of zero_emit at tmax
+ * @return     The temperature where heating and cooling match
+ *
+ * @details
+ * This is the alternative to zero_find used by calc_te when the --te-grid
+ * switch is given.  The heating and cooling (i.e. zero_emit) are
+ * evaluated at modes.te_grid points spaced uniformly in log T between tmin and
+ * tmax, and the root of the cubic through the (up to) four points closest to
+ * the interval in which zero_emit changes sign is found.  zero_emit is then
+ * evaluated once more at this temperature, and the root is corrected by a
+ * Newton step using the derivative of the interpolant.  If the correction is
+ * larger than TE_GRID_TOL, the new point is added to the grid and the
+ * process repeated.
+ *
+ * ### Notes ###
+ * zero_emit is smooth over the range spanned by tmin and tmax in one_shot,
+ * so usually a single polishing step is needed, and the cooling is calculated
+ * at fewer temperatures than by zero_find, which also recalculates it at the
+ * ends of the interval.
+ *
+ * The differences between the temperatures found with the grid and with
+ * zero_find are checked in one in TE_GRID_CHECK cells, and reported by
+ * calc_te_summary.
+ *
+ **********************************************************/
+
+double
+calc_te_grid (double tmin, double z1, double tmax, double z2)
+{
+  double t[TE_GRID_MAX], z[TE_GRID_MAX];
+  double lo, hi, x, zx, dzdx, dt, tnew, znew;
+  int n, i, k, kmin, kmax, iter;
+
+  n = modes.te_grid;
+  if (n < 2)
+    n = 2;
+  else if (n > TE_GRID_MAX / 2)
+    n = TE_GRID_MAX / 2;
+
+  t[0] = tmin;
+  z[0] = z1;
+  t[n - 1] = tmax;
+  z[n - 1] = z2;
+  for (i = 1; i < n - 1; i++)
+  {
+    t[i] = tmin * pow (tmax / tmin, (double) i / (n - 1));
+    z[i] = zero_emit (t[i]);
+  }
+
+  tnew = 0.5 * (tmin + tmax);
+  while (TRUE)
+  {
+    /* Find the interval in which zero_emit changes sign */
+
+    for (k = 0; k < n - 2; k++)
+    {
+      if (z[k] * z[k + 1] <= 0.0)
+        break;
+    }
+
+    if (z[k] == 0.0)
+      return (t[k]);
+    if (z[k + 1] == 0.0)
+      return (t[k + 1]);
+
+    /* Find the root of the interpolating polynomial in this interval by bisection */
+
+    kmin = k > 0 ? k - 1 : 0;
+    kmax = k + 2 < n - 1 ? k + 2 : n - 1;
+
+    lo = t[k];
+    hi = t[k + 1];
+    for (iter = 0; iter < 40; iter++)
+    {
+      x = 0.5 * (lo + hi);
+      zx = te_grid_poly (&t[kmin], &z[kmin], kmax - kmin + 1, x, &dzdx);
+      if ((zx < 0.0) == (z[k] < 0.0))
+        lo = x;
+      else
+        hi = x;
+    }
+    x = 0.5 * (lo + hi);
+    te_grid_poly (&t[kmin], &z[kmin], kmax - kmin + 1, x, &dzdx);
+
+    /* Polish the root with the exact value of zero_emit */
+
+    znew = zero_emit (x);
+    dt = dzdx != 0.0 ? -znew / dzdx : 0.0;
+    tnew = x + dt;
+    if (tnew < t[k])
+      tnew = t[k];
+    else if (tnew > t[k + 1])
+      tnew = t[k + 1];
+
+    if (fabs (dt) < TE_GRID_TOL || n == TE_GRID_MAX)
+      break;
+
+    /* Otherwise add the point to the grid, and try again */
+
+    for (i = n; i > k + 1; i--)
+    {
+      t[i] = t[i - 1];
+      z[i] = z[i - 1];
+    }
+    t[k + 1] = x;
+    z[k + 1] = znew;
+    n++;
+  }
+
+  return (tnew);
+}
+
+
+
+
+/**********************************************************/
+/**
+ * @brief  report the cost, and the accuracy, of the calculation of
+ * the electron temperatures in a cycle
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * This is called at the end of wind_update, and resets the statistics.
+ * If the --te-grid switch is given, the differences between the temperatures
+ * found with the grid and with zero_find, in the cells which were checked,
+ * are also reported.
+ *
+ **********************************************************/
+
+int
+calc_te_summary (void)
+{
+  if (te_ncalls == 0)
+    return (0);
+
+  Log ("calc_te: %ld cells, with %.1f evaluations of the cooling per cell, in %.2f s, with %s\n",
+       te_ncalls, (double) te_nevals / te_ncalls, te_time, modes.te_grid ? "a temperature grid" : "zero_find");
+
+  if (te_ncheck > 0)
+  {
+    Log ("calc_te: In %ld of the %ld cells found with the grid, temperatures differ from those found with zero_find by %.1f K on average, and at most %.1f K\n",
+         te_ncheck, te_ngrid, te_dt_sum / te_ncheck, te_dt_max);
+  }
+
+  te_ncalls = te_nevals = te_ngrid = te_ncheck = 0;
+  te_time = te_dt_sum = te_dt_max = 0.0;
+
+  return (0);
+}
+
+
+
+
 /**********************************************************/
 /**
  * @brief      Compute the cooling for a cell given a temperature t, and compare it
@@ -607,6 +865,8 @@ zero_emit (double t)
 
   /*Original method */
   xxxplasma->t_e = t;
+  OMP_PRAGMA (omp atomic)
+  te_nevals++;
 
 
   /* Correct heat_tot for the change in temperature. SS June 04. */
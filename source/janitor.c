@@ -107,6 +107,8 @@ free_plasma_grid (void)
   }
 
   free (plasmamain);
+  emission_sampler_free ();
+  emission_cdf_free ();
 }
 
 /**********************************************************/
@@ -149,6 +151,8 @@ free_macro_grid (void)
   }
 
   free (macromain);
+  matom_fingerprint_free ();
+  matom_jump_free ();
 }
 
 /**********************************************************/
@@ -162,7 +166,6 @@ free_macro_grid (void)
 void
 free_photons (void)
 {
-  free (photstoremain);
   free (matomphotstoremain);
   free (photmain);
 }
@@ -181,8 +184,24 @@ free_atomic_data (void)
   free (ele);
   free (ion);
   free (xconfig);
-  free (line);
   free (auger_macro);
+  free (lin_ptr);
+  free (lin_pow);
+  free (phot_top_ptr);
+  free (inner_cross_ptr);
+
+  /* Shared memory is released by MPI_Finalize */
+
+  if (atomic_data_shared == FALSE)
+  {
+    free (line);
+    free (coll_stren);
+    free (phot_top);
+    free (inner_cross);
+    free (inner_elec_yield);
+  }
+  matrix_ion_free ();
+  rate_table_free ();
 }
 
 /**********************************************************/
@@ -0,0 +1,364 @@
+/***********************************************************/
+/** @file  line_lists.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Lists of the lines which can contribute to the opacity
+ * of each cell
+ *
+ * In calculate_ds, all of the lines between the co-moving frequencies
+ * at the ends of a path are visited, and the Sobolev optical depth of
+ * each is calculated.  With large line lists, most of these lines
+ * belong to ions whose density in a particular cell is so small that
+ * the optical depth is negligible.
+ *
+ * line_need is the line counterpart of kbf_need.  At the start of
+ * each cycle it constructs, for each plasma cell, a list of the lines
+ * whose Sobolev optical depth, evaluated with the average velocity
+ * gradient of the cell and the largest density of the ion in any cell
+ * used to interpolate the density within it, exceeds LINE_TAU_MIN.
+ * The frequencies and the indices in lin_ptr of these lines are stored
+ * in contiguous arrays, in order of increasing frequency, so that the
+ * resonances along a path can be found without dereferencing the line
+ * structures of lines which are not significant.
+ *
+ * Lines of macro atoms are always retained, since the estimators for
+ * these lines do not vanish as the optical depth does.
+ *
+ * The lists are only used if the --prune-lines switch is given.  They
+ * are constructed for as many cells as fit into the memory budget;
+ * all of the lines are considered in the remaining cells.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+#define LINE_TAU_MIN  1e-6      /* The optical depth below which a line is ignored */
+
+static LineListPtr line_lists = NULL;   /* The list for each plasma cell */
+static int nline_lists = 0;     /* The number of plasma cells for which line_lists is allocated */
+
+static double *line_strength = NULL;    /* PI_E2_OVER_M f / freq for each line in lin_ptr */
+static int *line_nion = NULL;   /* The ion of each line in lin_ptr */
+static int *line_keep = NULL;   /* TRUE for lines which are always retained */
+
+
+
+/**********************************************************/
+/**
+ * @brief      find the largest density of each ion in the cells which are
+ * used to interpolate the density within a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell of interest
+ * @param [out] double *  den_max   The largest density of each ion
+ * @return     Always returns 0
+ *
+ * @details
+ * get_ion_density interpolates between the centres of a cell and its
+ * neighbours, so the density of an ion along a path through a cell is no
+ * larger than its largest value in the cell and its neighbours.
+ *
+ **********************************************************/
+
+static int
+line_den_max (PlasmaPtr xplasma, double *den_max)
+{
+  int ndom, nwind, i, j, di, dj, m, nion;
+  PlasmaPtr neighbour;
+
+  nwind = xplasma->nwind;
+  ndom = wmain[nwind].ndom;
+  i = (nwind - zdom[ndom].nstart) / zdom[ndom].mdim;
+  j = (nwind - zdom[ndom].nstart) % zdom[ndom].mdim;
+
+  for (nion = 0; nion < nions; nion++)
+  {
+    den_max[nion] = xplasma->density[nion];
+  }
+
+  for (di = -1; di <= 1; di++)
+  {
+    for (dj = -1; dj <= 1; dj++)
+    {
+      if (i + di < 0 || i + di >= zdom[ndom].ndim || j + dj < 0 || j + dj >= zdom[ndom].mdim)
+        continue;
+
+      m = zdom[ndom].nstart + (i + di) * zdom[ndom].mdim + (j + dj);
+      if (wmain[m].nplasma < 0 || wmain[m].nplasma >= NPLASMA)
+        continue;
+
+      neighbour = &plasmamain[wmain[m].nplasma];
+      for (nion = 0; nion < nions; nion++)
+      {
+        if (neighbour->density[nion] > den_max[nion])
+          den_max[nion] = neighbour->density[nion];
+      }
+    }
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      construct the list of significant lines for each plasma cell
+ *
+ * @return     The number of cells for which a list was constructed
+ *
+ * @details
+ * This is called at the start of each cycle, after the ionization state
+ * has been updated, at the same points as kbf_need.  Lists are constructed
+ * for cells in order until the memory budget, modes.prune_lines_mb, is used up.
+ *
+ * ### Notes ###
+ * The criterion is that used by sobolev, with the population of the lower
+ * level replaced by the (larger) density of the ion, and the velocity gradient
+ * along the path by the average velocity gradient in the cell.
+ *
+ **********************************************************/
+
+int
+line_need (void)
+{
+  PlasmaPtr xplasma;
+  LineListPtr list;
+  double *den_max, fill, dvds, budget, used, bytes;
+  int *keep;
+  int nplasma, n, nuse, nbuilt;
+  long long nkept;
+
+  if (nlines == 0)
+    return (0);
+
+  if (line_strength == NULL)
+  {
+    line_strength = calloc (nlines, sizeof (double));
+    line_nion = calloc (nlines, sizeof (int));
+    line_keep = calloc (nlines, sizeof (int));
+    if (line_strength == NULL || line_nion == NULL || line_keep == NULL)
+    {
+      Error ("line_need: Unable to allocate memory for %d lines\n", nlines);
+      Exit (0);
+    }
+  }
+
+  for (n = 0; n < nlines; n++)
+  {
+    line_strength[n] = PI_E2_OVER_M * lin_ptr[n]->f / lin_ptr[n]->freq;
+    line_nion[n] = lin_ptr[n]->nion;
+    line_keep[n] = (lin_ptr[n]->macro_info == TRUE && geo.rt_mode == RT_MODE_MACRO && geo.macro_simple == FALSE);
+  }
+
+  if (nline_lists != NPLASMA)
+  {
+    line_lists_free ();
+    if ((line_lists = calloc (NPLASMA, sizeof (line_list_dummy))) == NULL)
+    {
+      Error ("line_need: Unable to allocate memory for %d cells\n", NPLASMA);
+      Exit (0);
+    }
+    nline_lists = NPLASMA;
+  }
+
+  den_max = calloc (nions, sizeof (double));
+  keep = calloc (nlines, sizeof (int));
+  if (den_max == NULL || keep == NULL)
+  {
+    Error ("line_need: Unable to allocate memory\n");
+    Exit (0);
+  }
+
+  budget = modes.prune_lines_mb * 1024. * 1024.;
+  used = 0.0;
+  nbuilt = 0;
+  nkept = 0;
+
+  for (nplasma = 0; nplasma < NPLASMA; nplasma++)
+  {
+    xplasma = &plasmamain[nplasma];
+    list = &line_lists[nplasma];
+
+    free (list->freq);
+    free (list->nline);
+    list->freq = NULL;
+    list->nline = NULL;
+    list->nuse = -1;
+
+    dvds = wmain[xplasma->nwind].dvds_ave;
+    if (dvds <= 0.0)
+      continue;
+
+    fill = zdom[wmain[xplasma->nwind].ndom].fill;
+    line_den_max (xplasma, den_max);
+
+    nuse = 0;
+    for (n = 0; n < nlines; n++)
+    {
+      if (line_keep[n] || line_strength[n] * den_max[line_nion[n]] * fill / dvds > LINE_TAU_MIN)
+      {
+        keep[nuse++] = n;
+      }
+    }
+
+    bytes = (double) nuse *(sizeof (double) + sizeof (int));
+    if (used + bytes > budget)
+      continue;
+
+    list->freq = calloc (nuse > 0 ? nuse : 1, sizeof (double));
+    list->nline = calloc (nuse > 0 ? nuse : 1, sizeof (int));
+    if (list->freq == NULL || list->nline == NULL)
+    {
+      free (list->freq);
+      free (list->nline);
+      list->freq = NULL;
+      list->nline = NULL;
+      continue;
+    }
+
+    for (n = 0; n < nuse; n++)
+    {
+      list->nline[n] = keep[n];
+      list->freq[n] = lin_ptr[keep[n]]->freq;
+    }
+    list->nuse = nuse;
+
+    used += bytes;
+    nkept += nuse;
+    nbuilt++;
+  }
+
+  free (den_max);
+  free (keep);
+
+  Log ("line_need: Constructed line lists for %d of %d cells, with on average %.0f of %d lines (%.1f MB)\n",
+       nbuilt, NPLASMA, nbuilt > 0 ? (double) nkept / nbuilt : 0.0, nlines, used / 1024. / 1024.);
+
+  if (nbuilt < NPLASMA)
+  {
+    Log ("line_need: All lines will be considered in the remaining cells\n");
+  }
+
+  return (nbuilt);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      get the list of significant lines in a plasma cell
+ *
+ * @param [in] int  nplasma   The plasma cell of interest
+ * @return     The list, or NULL if all lines should be considered
+ *
+ **********************************************************/
+
+LineListPtr
+cell_lines (int nplasma)
+{
+  if (line_lists == NULL || nplasma < 0 || nplasma >= nline_lists || line_lists[nplasma].nuse < 0)
+    return (NULL);
+
+  return (&line_lists[nplasma]);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      define the lines in the list for a cell that are close to a given frequency
+ *
+ * @param [in] LineListPtr  list   The list of lines for the cell, or NULL for all lines
+ * @param [in] double  freqmin   The minimum frequency of interest
+ * @param [in] double  freqmax   The maximum frequency of interest
+ * @return     The number of lines in the range
+ *
+ * @details
+ * This is the equivalent of limit_lines for the lists constructed by line_need.
+ * nline_min and nline_max are set to the range (inclusive) of indices into the list,
+ * rather than into lin_ptr, and nline_delt to the number of lines.  If list is NULL,
+ * limit_lines is called.
+ *
+ **********************************************************/
+
+int
+limit_cell_lines (LineListPtr list, double freqmin, double freqmax)
+{
+  int nmin, nmax, n;
+
+  if (list == NULL)
+    return (limit_lines (freqmin, freqmax));
+
+  if (list->nuse == 0 || freqmin > list->freq[list->nuse - 1] || freqmax < list->freq[0])
+  {
+    nline_min = 0;
+    nline_max = 0;
+    nline_delt = 0;
+    return (0);
+  }
+
+  nmin = 0;
+  nmax = list->nuse - 1;
+  n = (nmin + nmax) >> 1;
+  while (n != nmin)
+  {
+    if (list->freq[n] < freqmin)
+      nmin = n;
+    else
+      nmax = n;
+    n = (nmin + nmax) >> 1;
+  }
+  nline_min = nmin;
+
+  nmin = 0;
+  nmax = list->nuse - 1;
+  n = (nmin + nmax) >> 1;
+  while (n != nmin)
+  {
+    if (list->freq[n] <= freqmax)
+      nmin = n;
+    else
+      nmax = n;
+    n = (nmin + nmax) >> 1;
+  }
+  nline_max = nmax;
+
+  return (nline_delt = nline_max - nline_min + 1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      release the memory used by the line lists
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+line_lists_free (void)
+{
+  int n;
+
+  if (line_lists != NULL)
+  {
+    for (n = 0; n < nline_lists; n++)
+    {
+      free (line_lists[n].freq);
+      free (line_lists[n].nline);
+    }
+    free (line_lists);
+  }
+
+  line_lists = NULL;
+  nline_lists = 0;
+
+  return (0);
+}
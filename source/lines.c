@@ -96,7 +96,7 @@ total_line_emission (xplasma, f1, f2)
  * total line luminosity.
  *
  * ### Notes ###
- * The individual line luminosities are stored in lin_ptr[n]->pow
+ * The individual line luminosities are stored in lin_pow[n]
  *
  * This is a co-moving frame calculation.                            
  *
@@ -106,6 +106,35 @@ double
 lum_lines (xplasma, nmin, nmax)
      PlasmaPtr xplasma;
      int nmin, nmax;            /* The min and max index in lptr array for which the power is to be calculated */
+{
+  return (line_power (xplasma, nmin, nmax, lin_pow));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Calculate the luminosity of each line between
+ * nmin and nmax of the frequency ordered list of lines
+ *
+ * @param [in] PlasmaPtr  xplasma   A plasma cell
+ * @param [in] int  nmin   The minimum number of a line in the frequency ordered list
+ * @param [in] int  nmax   The maximum number of a line in the frequency ordered list
+ * @param [out] double *  lpow   The luminosity of each line, in the order of lin_ptr
+ * @return     The total line luminosity between element nmin and nmax of the frequncy
+ * ordered list of lines
+ *
+ * @details
+ * This is lum_lines, but with the luminosities stored in lpow rather than
+ * lin_pow, so that several cells can be done at once by different threads.
+ *
+ **********************************************************/
+
+double
+line_power (xplasma, nmin, nmax, lpow)
+     PlasmaPtr xplasma;
+     int nmin, nmax;
+     double *lpow;
 {
   int n;
   double lum, x, z;
@@ -141,7 +170,7 @@ lum_lines (xplasma, nmin, nmax)
         foo4 = 0.0;             // Added to prevent compilation warning
       }
 
-      lum += lin_ptr[n]->pow = x;
+      lum += lpow[n] = x;
       if (x < 0)
       {
         Log
@@ -155,7 +184,7 @@ lum_lines (xplasma, nmin, nmax)
     }
     else
     {
-      lin_ptr[n]->pow = 0;
+      lpow[n] = 0;
     }
   }
 
@@ -165,9 +194,9 @@ lum_lines (xplasma, nmin, nmax)
 
 
 
-struct lines *old_line_ptr;
-double old_ne, old_te, old_w, old_tr, old_dd;
-double old_d1, old_d2, old_n2_over_n1;
+THREAD_LOCAL struct lines *old_line_ptr;
+THREAD_LOCAL double old_ne, old_te, old_w, old_tr, old_dd;
+THREAD_LOCAL double old_d1, old_d2, old_n2_over_n1;
 
 /**********************************************************/
 /**
@@ -204,6 +233,45 @@ two_level_atom (line_ptr, xplasma, d1, d2)
      struct lines *line_ptr;
      PlasmaPtr xplasma;
      double *d1, *d2;
+{
+  return (two_level_atom_ion (line_ptr, xplasma, xplasma->density[line_ptr->nion], d1, d2));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      calculates the ratio n2/n1 and the individual
+ * densities for the states of a two level atom, given
+ * the density of the ion
+ *
+ * @param [in] struct lines *  line_ptr   The line of interest
+ * @param [in] PlasmaPtr  xplasma   The plasma cell of interest
+ * @param [in] double  den_ion   The density of the ion associated with the line
+ * @param [out] double *  d1   The calculated density of the lower level for the line of interest
+ * @param [out] double *  d2   The calculated density of the upper levl
+ * @return     The density ratio d2/d1
+ *
+ * @details
+ * This is the routine which does the work for two_level_atom.  It is
+ * called directly by sobolev, which uses an ion density that is
+ * interpolated to the position of the photon rather than the one
+ * stored for the cell.
+ *
+ * ### Notes ###
+ * Previously sobolev temporarily overwrote xplasma->density in order
+ * to pass the interpolated density to two_level_atom, which is not
+ * safe when several threads are transporting photons through
+ * the same cell.
+ *
+ **********************************************************/
+
+double
+two_level_atom_ion (line_ptr, xplasma, den_ion, d1, d2)
+     struct lines *line_ptr;
+     PlasmaPtr xplasma;
+     double den_ion;
+     double *d1, *d2;
 {
   double a, a21 ();
   double q, q21 (), c12, c21;
@@ -233,7 +301,7 @@ two_level_atom (line_ptr, xplasma, d1, d2)
   tr = xplasma->t_r;
   w = xplasma->w;
   nion = line_ptr->nion;
-  dd = xplasma->density[nion];
+  dd = den_ion;
 
   /* Calculate the number density of the lower level for the transition using the partition function */
   ;
@@ -473,9 +541,9 @@ scattering_fraction (line_ptr, xplasma)
 
 
 
-struct lines *pe_line_ptr;
-double pe_ne, pe_te, pe_dd, pe_dvds, pe_w, pe_tr;
-double pe_escape;
+THREAD_LOCAL struct lines *pe_line_ptr;
+THREAD_LOCAL double pe_ne, pe_te, pe_dd, pe_dvds, pe_w, pe_tr;
+THREAD_LOCAL double pe_escape;
 
 /**********************************************************/
 /**
@@ -1,36 +1,356 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
 #include <sys/time.h>
 #include <time.h>
 
 #include "atomic.h"
 #include "sirocco.h"
 
+#define MATOM_PROB_MIN 1e-10    /* Changes in jump probabilities smaller than this are ignored when
+                                   deciding whether a matrix needs to be recalculated */
+
+/* The pattern of the transitions which can occur between macro-atom levels and the k-packet
+   pool, stored row by row (the diagonal, which is always 1, is excluded), and the partition
+   of the levels into blocks which are only connected to one another via the k-packet pool.
+   These depend only on the atomic data, and so are constructed once by matom_pattern_init */
+
+static int matom_pattern_rows = 0;
+static int *matom_pattern_start = NULL;
+static int *matom_pattern_col = NULL;
+static int matom_nblocks = 0;
+static int *matom_block_start = NULL;
+static int *matom_block_level = NULL;
+
+/* The transition probabilities used the last time the matrix of each plasma cell was
+   calculated, which are used to decide whether it needs to be recalculated */
+
+static double **matom_fingerprint = NULL;
+static int matom_nfingerprint = 0;
+
+/* Work space for calc_matom_matrix, which is reused from one cell to the next */
+
+static THREAD_LOCAL double *matom_work = NULL;
+static THREAD_LOCAL int matom_work_rows = 0;
+
+/* The matrix used by matom_deactivation_from_matrix in cells where it is not stored */
+
+static THREAD_LOCAL double **matom_scratch = NULL;
+static THREAD_LOCAL int matom_scratch_rows = 0;
+
+
+
 /**********************************************************/
 /**
- * @brief calculate the matrix of probabilities for the accelerated macro-atom scheme
+ * @brief find the levels to which a macro-atom level, or the
+ * k-packet pool, can jump
+ *
+ * @param [in] int  uplvl   The level, or nlevels_macro for the k-packet pool
+ * @param [out] int *  target   The levels (which may be repeated), or NULL to just count them
+ * @return  The number of targets
+ *
+ * @details
+ * The jumps are those for which calc_matom_rates can assign a non-zero probability.
+ * Every level can also jump to the k-packet pool.
+ *
+ **********************************************************/
+
+static int
+matom_targets (int uplvl, int *target)
+{
+  int n, i, ntarget;
+  struct auger *auger_ptr;
+
+  ntarget = 0;
+
+  if (uplvl == nlevels_macro)
+  {
+    for (i = 0; i < nlines; i++)
+    {
+      if (line[i].macro_info == 1 && geo.macro_simple == 0)
+      {
+        if (target != NULL)
+          target[ntarget] = line[i].nconfigu;
+        ntarget++;
+      }
+    }
+    for (i = 0; i < nphot_total; i++)
+    {
+      if (phot_top[i].macro_info == 1 && geo.macro_simple == 0)
+      {
+        if (target != NULL)
+          target[ntarget] = phot_top[i].uplev;
+        ntarget++;
+      }
+    }
+    return (ntarget);
+  }
+
+  if (target != NULL)
+  {
+    for (n = 0; n < xconfig[uplvl].n_bbd_jump; n++)
+      target[ntarget++] = line[xconfig[uplvl].bbd_jump[n]].nconfigl;
+    if (xconfig[uplvl].iauger >= 0)
+    {
+      auger_ptr = &auger_macro[xconfig[uplvl].iauger];
+      for (n = 0; n < xconfig[uplvl].nauger; n++)
+        target[ntarget++] = auger_ptr->nconfig_target[n];
+    }
+    for (n = 0; n < xconfig[uplvl].n_bfd_jump; n++)
+      target[ntarget++] = phot_top[xconfig[uplvl].bfd_jump[n]].nlev;
+    for (n = 0; n < xconfig[uplvl].n_bbu_jump; n++)
+      target[ntarget++] = line[xconfig[uplvl].bbu_jump[n]].nconfigu;
+    for (n = 0; n < xconfig[uplvl].n_bfu_jump; n++)
+      target[ntarget++] = phot_top[xconfig[uplvl].bfu_jump[n]].uplev;
+    target[ntarget++] = nlevels_macro;
+  }
+  else
+  {
+    ntarget = xconfig[uplvl].n_bbd_jump + xconfig[uplvl].n_bfd_jump + xconfig[uplvl].n_bbu_jump + xconfig[uplvl].n_bfu_jump + 1;
+    if (xconfig[uplvl].iauger >= 0)
+      ntarget += xconfig[uplvl].nauger;
+  }
+
+  return (ntarget);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief find the root of the set containing a level
+ *
+ **********************************************************/
+
+static int
+matom_root (int *parent, int n)
+{
+  while (parent[n] != n)
+  {
+    parent[n] = parent[parent[n]];
+    n = parent[n];
+  }
+  return (n);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief construct the pattern of possible transitions between macro-atom
+ * levels, and divide the levels into blocks
+ *
+ * @return  The number of blocks
+ *
+ * @details
+ * Two levels are in the same block if a chain of bound-bound, bound-free or
+ * Auger jumps connects them.  Since transitions between different blocks can
+ * only take place through the k-packet pool, the matrix N = I - Q is block
+ * diagonal apart from the row and column of the k-packet pool, which is what
+ * matom_solve_blocks exploits.  Each block normally contains the levels of a
+ * single element.
+ *
+ **********************************************************/
+
+static int
+matom_pattern_init (void)
+{
+  int nrows, uplvl, n, m, ntarget, nnz, nb;
+  int *target, *mark, *parent, *block, *count;
+
+  nrows = nlevels_macro + 1;
+
+  free (matom_pattern_start);
+  free (matom_pattern_col);
+  free (matom_block_start);
+  free (matom_block_level);
+
+  ntarget = 0;
+  for (uplvl = 0; uplvl < nrows; uplvl++)
+  {
+    n = matom_targets (uplvl, NULL);
+    if (n > ntarget)
+      ntarget = n;
+  }
+
+  target = calloc (ntarget + 1, sizeof (int));
+  mark = calloc (nrows, sizeof (int));
+  parent = calloc (nrows, sizeof (int));
+  block = calloc (nrows, sizeof (int));
+  count = calloc (nrows + 1, sizeof (int));
+  matom_pattern_start = calloc (nrows + 1, sizeof (int));
+  if (target == NULL || mark == NULL || parent == NULL || block == NULL || count == NULL || matom_pattern_start == NULL)
+  {
+    Error ("matom_pattern_init: Unable to allocate memory for %d levels\n", nrows);
+    Exit (0);
+  }
+
+  for (n = 0; n < nrows; n++)
+  {
+    mark[n] = -1;
+    parent[n] = n;
+  }
+
+  /* Count the distinct targets of each row, and join the levels they connect */
+
+  nnz = 0;
+  for (uplvl = 0; uplvl < nrows; uplvl++)
+  {
+    matom_pattern_start[uplvl] = nnz;
+    ntarget = matom_targets (uplvl, target);
+    for (n = 0; n < ntarget; n++)
+    {
+      m = target[n];
+      if (m == uplvl || mark[m] == uplvl)
+        continue;
+      mark[m] = uplvl;
+      nnz++;
+      if (uplvl < nlevels_macro && m < nlevels_macro)
+        parent[matom_root (parent, m)] = matom_root (parent, uplvl);
+    }
+  }
+  matom_pattern_start[nrows] = nnz;
+
+  matom_pattern_col = calloc (nnz > 0 ? nnz : 1, sizeof (int));
+  if (matom_pattern_col == NULL)
+  {
+    Error ("matom_pattern_init: Unable to allocate memory for %d transitions\n", nnz);
+    Exit (0);
+  }
+
+  for (n = 0; n < nrows; n++)
+    mark[n] = -1;
+
+  nnz = 0;
+  for (uplvl = 0; uplvl < nrows; uplvl++)
+  {
+    ntarget = matom_targets (uplvl, target);
+    for (n = 0; n < ntarget; n++)
+    {
+      m = target[n];
+      if (m == uplvl || mark[m] == uplvl)
+        continue;
+      mark[m] = uplvl;
+      matom_pattern_col[nnz++] = m;
+    }
+  }
+
+  /* Number the blocks in order of their first level, and list the levels in each */
+
+  nb = 0;
+  for (n = 0; n < nlevels_macro; n++)
+    mark[n] = -1;
+  for (n = 0; n < nlevels_macro; n++)
+  {
+    m = matom_root (parent, n);
+    if (mark[m] < 0)
+      mark[m] = nb++;
+    block[n] = mark[m];
+    count[block[n] + 1]++;
+  }
+
+  matom_block_start = calloc (nb + 1, sizeof (int));
+  matom_block_level = calloc (nlevels_macro > 0 ? nlevels_macro : 1, sizeof (int));
+  if (matom_block_start == NULL || matom_block_level == NULL)
+  {
+    Error ("matom_pattern_init: Unable to allocate memory for %d blocks\n", nb);
+    Exit (0);
+  }
+
+  for (n = 0; n < nb; n++)
+    matom_block_start[n + 1] = matom_block_start[n] + count[n + 1];
+
+  for (n = 0; n < nb; n++)
+    count[n] = matom_block_start[n];
+  for (n = 0; n < nlevels_macro; n++)
+    matom_block_level[count[block[n]]++] = n;
+
+  matom_nblocks = nb;
+  matom_pattern_rows = nrows;
+
+  m = 0;
+  for (n = 0; n < nb; n++)
+  {
+    if (matom_block_start[n + 1] - matom_block_start[n] > m)
+      m = matom_block_start[n + 1] - matom_block_start[n];
+  }
+  Log ("matom_pattern_init: %d macro-atom levels with %d possible jumps form %d blocks, the largest with %d levels\n",
+       nlevels_macro, nnz, nb, m);
+
+  free (target);
+  free (mark);
+  free (parent);
+  free (block);
+  free (count);
+
+  return (nb);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief get the work space for calc_matom_matrix
+ *
+ * @param [in] int  nrows   The number of rows of the matrix
+ * @return  A pointer to space for 4 nrows x nrows matrices, followed by
+ * 4 vectors of length nrows.  These hold, in order, N = I - Q, its inverse,
+ * the work space of matom_solve_blocks, R and Q_norm.
+ *
+ * @details
+ * The space is allocated the first time that it is needed (by each thread),
+ * and then reused for every cell.  The pattern of transitions is also
+ * constructed the first time that it is needed.
+ *
+ **********************************************************/
+
+static double *
+matom_workspace (int nrows)
+{
+  if (matom_pattern_rows != nrows)
+  {
+    OMP_PRAGMA (omp critical (matom_pattern))
+    {
+      if (matom_pattern_rows != nrows)
+        matom_pattern_init ();
+    }
+  }
+
+  if (matom_work_rows != nrows)
+  {
+    free (matom_work);
+    matom_work = calloc (4 * (size_t) nrows * nrows + 4 * (size_t) nrows, sizeof (double));
+    if (matom_work == NULL)
+    {
+      Error ("matom_workspace: Unable to allocate work space for a matrix with %d rows\n", nrows);
+      Exit (0);
+    }
+    matom_work_rows = nrows;
+  }
+
+  return (matom_work);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief calculate the normalised jump and emission probabilities
+ * of the macro-atom levels in a cell
  *
  * @param [in] PlasmaPtr  xplasma
- * @param [in,out] double **matom_matrix
- *        the 2D matrix array we will populate with normalised probabilities
+ * @param [out] double *  N   The matrix N = I - Q, stored by rows
+ * @param [out] double *  R   The diagonal of the matrix R
+ * @param [out] double *  Q_norm   The total rate out of each level
  *
  * @details
- * given an activation state, this routine calculates the probability that a packet
- * will deactivate from a given state. Let's suppose that the \f$(i,j)\f$-th element of matrix
- * \f$Q\f$ contains the **jumping** probability from state i to state j, and the diagonals
- * \f$(i,i)\f$ of matrix \f$R\f$ contain the emission probabilities from each state, then it
- * can be shown that (see short notes from Vogl, or
- * <a href="Ergon et al. 2018">https://ui.adsabs.harvard.edu/abs/2018A%26A...620A.156E</a>)
- * the quantity we want is then \f$B = N R\f$, where \f$N = (I - Q)^{-1}\f$, where \f$I\f$
- * is the identity matrix. This routine does this calculation.
+ * This is the first part of calc_matom_matrix; see there for the notation.
  *
  **********************************************************/
 
-void
-calc_matom_matrix (xplasma, matom_matrix)
-     PlasmaPtr xplasma;
-     double **matom_matrix;
+static void
+calc_matom_rates (PlasmaPtr xplasma, double *N, double *R, double *Q_norm)
 {
   MacroPtr mplasma;
   double t_e, ne;
@@ -41,40 +361,26 @@ calc_matom_matrix (xplasma, matom_matrix)
   struct auger *auger_ptr;
   struct topbase_phot *cont_ptr;
   double rad_rate, coll_rate;
-  int n, i, nn, mm, iauger, nauger;
+  int n, i, iauger, nauger;
   double Qcont_kpkt, bb_cont, sp_rec_rate, bf_cont, lower_density, density_ratio;
   double kpacket_to_rpacket_rate, norm, Rcont, auger_rate;
-  int matrix_error;
-  double *a_data, *a_inverse;
-  mplasma = &macromain[xplasma->nplasma];       //telling us where in the matom structure we are
   struct photon pdummy;
+  int nrows = nlevels_macro + 1;
+
+  mplasma = &macromain[xplasma->nplasma];       //telling us where in the matom structure we are
 
   t_e = xplasma->t_e;           //electron temperature
   ne = xplasma->ne;             //electron number density
 
-  /* allocate arrays for matrices and normalsiations
-     we want to include all macro-atom levels + 1 kpacket levels */
-  int nrows = nlevels_macro + 1;
-  double **R_matrix = (double **) calloc (sizeof (double *), nrows);
-  double **Q_matrix = (double **) calloc (sizeof (double *), nrows);
-  double *Q_norm = (double *) calloc (sizeof (double), nrows);
-
-  for (i = 0; i < nrows; i++)
-  {
-    R_matrix[i] = (double *) calloc (sizeof (double), nrows);
-    Q_matrix[i] = (double *) calloc (sizeof (double), nrows);
-  }
-
-  /* initialise everything to zero */
+  /* initialise everything to zero; Q is accumulated in N */
   norm = 0.0;
   for (uplvl = 0; uplvl < nrows; uplvl++)
   {
     Q_norm[uplvl] = 0.0;
+    R[uplvl] = 0.0;
     for (target_level = 0; target_level < nrows; target_level++)
     {
-      Q_matrix[uplvl][target_level] = 0.0;
-      R_matrix[uplvl][target_level] = 0.0;
-      matom_matrix[uplvl][target_level] = 0.0;
+      N[uplvl * nrows + target_level] = 0.0;
     }
   }
 
@@ -102,13 +408,13 @@ calc_matom_matrix (xplasma, matom_matrix)
       target_level = line_ptr->nconfigl;
 
       //internal jump to another macro atom level
-      Q_matrix[uplvl][target_level] += Qcont = bb_cont * xconfig[target_level].ex;      //energy of lower state
+      N[uplvl * nrows + target_level] += Qcont = bb_cont * xconfig[target_level].ex;    //energy of lower state
 
       //jump to the k-packet pool (we used to call this "deactivation")
-      Q_matrix[uplvl][nlevels_macro] += Qcont_kpkt = (coll_rate * ne) * (xconfig[uplvl].ex - xconfig[target_level].ex); //energy of lower state
+      N[uplvl * nrows + nlevels_macro] += Qcont_kpkt = (coll_rate * ne) * (xconfig[uplvl].ex - xconfig[target_level].ex);       //energy of lower state
 
       //deactivation back to r-packet
-      R_matrix[uplvl][uplvl] += Rcont = rad_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);      //energy difference
+      R[uplvl] += Rcont = rad_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);    //energy difference
 
       Q_norm[uplvl] += Qcont + Qcont_kpkt + Rcont;
     }
@@ -124,10 +430,10 @@ calc_matom_matrix (xplasma, matom_matrix)
         auger_rate = auger_ptr->Avalue_auger * auger_ptr->branching_ratio[n];
 
         //internal jump to another macro atom level
-        Q_matrix[uplvl][target_level] += Qcont = auger_rate * xconfig[target_level].ex; //energy of lower state
+        N[uplvl * nrows + target_level] += Qcont = auger_rate * xconfig[target_level].ex;       //energy of lower state
 
         //jump to the k-packet pool (we used to call this "deactivation")
-        Q_matrix[uplvl][nlevels_macro] += Qcont_kpkt = auger_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);     //energy of lower state
+        N[uplvl * nrows + nlevels_macro] += Qcont_kpkt = auger_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);   //energy of lower state
 
         //deactivation back to r-packet isn't possible for the Auger process
         Q_norm[uplvl] += Qcont + Qcont_kpkt;
@@ -149,13 +455,13 @@ calc_matom_matrix (xplasma, matom_matrix)
       {
 
         //internal jump to another macro atom level
-        Q_matrix[uplvl][target_level] += Qcont = bf_cont * xconfig[target_level].ex;    //energy of lower state
+        N[uplvl * nrows + target_level] += Qcont = bf_cont * xconfig[target_level].ex;  //energy of lower state
 
         //jump to the k-packet pool (we used to call this "deactivation")
-        Q_matrix[uplvl][nlevels_macro] += Qcont_kpkt = q_recomb (cont_ptr, t_e) * ne * ne * (xconfig[uplvl].ex - xconfig[target_level].ex);     //energy difference
+        N[uplvl * nrows + nlevels_macro] += Qcont_kpkt = q_recomb (cont_ptr, t_e) * ne * ne * (xconfig[uplvl].ex - xconfig[target_level].ex);   //energy difference
 
         //deactivation back to r-packet
-        R_matrix[uplvl][uplvl] += Rcont = ne * sp_rec_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);    //energy difference
+        R[uplvl] += Rcont = ne * sp_rec_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);  //energy difference
 
         Q_norm[uplvl] += Qcont + Qcont_kpkt + Rcont;
       }
@@ -172,7 +478,7 @@ calc_matom_matrix (xplasma, matom_matrix)
       coll_rate = q12 (line_ptr, t_e);  // this is multiplied by ne below
 
       target_level = line[xconfig[uplvl].bbu_jump[n]].nconfigu;
-      Q_matrix[uplvl][target_level] += Qcont = ((rad_rate) + (coll_rate * ne)) * xconfig[uplvl].ex;     //energy of lower state
+      N[uplvl * nrows + target_level] += Qcont = ((rad_rate) + (coll_rate * ne)) * xconfig[uplvl].ex;   //energy of lower state
 
       Q_norm[uplvl] += Qcont;
     }
@@ -205,7 +511,7 @@ calc_matom_matrix (xplasma, matom_matrix)
         Qcont = 0.0;
 
       }
-      Q_matrix[uplvl][target_level] += Qcont;
+      N[uplvl * nrows + target_level] += Qcont;
       Q_norm[uplvl] += Qcont;
     }
 
@@ -225,7 +531,7 @@ calc_matom_matrix (xplasma, matom_matrix)
     if (line[i].macro_info == 1 && geo.macro_simple == 0)       //line is for a macro atom
     {
       target_level = line[i].nconfigu;
-      Q_matrix[nlevels_macro][target_level] += Qcont = mplasma->cooling_bb[i];
+      N[nlevels_macro * nrows + target_level] += Qcont = mplasma->cooling_bb[i];
       Q_norm[nlevels_macro] += Qcont;
     }
     else
@@ -241,7 +547,7 @@ calc_matom_matrix (xplasma, matom_matrix)
     if (phot_top[i].macro_info == 1 && geo.macro_simple == 0)   //part of macro atom
     {
       target_level = phot_top[i].uplev;
-      Q_matrix[nlevels_macro][target_level] += Qcont = mplasma->cooling_bf_col[i];
+      N[nlevels_macro * nrows + target_level] += Qcont = mplasma->cooling_bf_col[i];
       Q_norm[nlevels_macro] += Qcont;
 
     }
@@ -257,13 +563,13 @@ calc_matom_matrix (xplasma, matom_matrix)
   kpacket_to_rpacket_rate += mplasma->cooling_bftot;
   kpacket_to_rpacket_rate += mplasma->cooling_adiabatic;
   kpacket_to_rpacket_rate += mplasma->cooling_ff + mplasma->cooling_ff_lofreq;
-  R_matrix[nlevels_macro][nlevels_macro] += Rcont = kpacket_to_rpacket_rate;
+  R[nlevels_macro] += Rcont = kpacket_to_rpacket_rate;
   Q_norm[nlevels_macro] += Rcont;
 
   /* end kpacket */
 
   /* now in one step, we multiply by the identity matrix and normalise the probabilities
-     this means that what is now stored in Q_matrix is no longer Q, but N=(I - Q) using Vogl
+     this means that what is now stored in N is no longer Q, but N=(I - Q) using Vogl
      notation. We check that Q_norm is 0, because some states (ground states) can have 0
      jumping probabilities and so zero normalisation too */
   for (uplvl = 0; uplvl < nrows; uplvl++)
@@ -272,25 +578,24 @@ calc_matom_matrix (xplasma, matom_matrix)
     {
       if (Q_norm[uplvl] > 0.0)
       {
-        Q_matrix[uplvl][target_level] = -1. * Q_matrix[uplvl][target_level] / Q_norm[uplvl];
+        N[uplvl * nrows + target_level] = -1. * N[uplvl * nrows + target_level] / Q_norm[uplvl];
       }
     }
-    Q_matrix[uplvl][uplvl] = 1.0;
+    N[uplvl * nrows + uplvl] = 1.0;
 
     if (Q_norm[uplvl] > 0.0)
     {
-      R_matrix[uplvl][uplvl] = R_matrix[uplvl][uplvl] / Q_norm[uplvl];
+      R[uplvl] = R[uplvl] / Q_norm[uplvl];
     }
   }
 
-  /* Check normalisation of the matrix. the diagonals of R, minus N which is now stored in
-     Q_matrix, should be zero */
+  /* Check normalisation of the matrix. the diagonals of R, minus N, should be zero */
   for (uplvl = 0; uplvl < nrows; uplvl++)
   {
-    norm = R_matrix[uplvl][uplvl];
+    norm = R[uplvl];
     for (target_level = 0; target_level < nlevels_macro + 1; target_level++)
     {
-      norm -= Q_matrix[uplvl][target_level];
+      norm -= N[uplvl * nrows + target_level];
     }
 
     /* throw an error if this normalisation is not zero */
@@ -298,28 +603,324 @@ calc_matom_matrix (xplasma, matom_matrix)
     if ((fabs (norm) > 1e-14 && uplvl != ion[xconfig[uplvl].nion].first_nlte_level) || sane_check (norm))
       Error ("calc_matom_matrix: matom accelerator matrix has bad normalisation for level %d: %8.4e\n", norm, uplvl);
   }
+}
 
-  /* This next line produces an array of the correct size to hold the rate matrix */
-  a_data = (double *) calloc (nrows * nrows, sizeof (double));
-  a_inverse = (double *) calloc (nrows * nrows, sizeof (double));
 
-  /* We now copy our rate matrix into the prepared matrix */
-  for (mm = 0; mm < nrows; mm++)
+
+/**********************************************************/
+/**
+ * @brief invert the matrix N = I - Q using its block structure
+ *
+ * @param [in] double *  N   The matrix N, stored by rows
+ * @param [out] double *  inverse   The inverse of N, stored by rows
+ * @param [in] double *  work   Work space for 2 nrows x nrows matrices and 2 vectors
+ * @return  0 on success, or a non-zero value if the inversion failed
+ *
+ * @details
+ * Write N as
+ *
+ *     N = | A    u |
+ *         | v^T  d |
+ *
+ * where the last row and column belong to the k-packet pool, and A is block
+ * diagonal, with the blocks found by matom_pattern_init.  Then with
+ * w = A^-1 u, z^T = v^T A^-1 and s = d - v^T A^-1 u, the inverse is
+ *
+ *     N^-1 = | A^-1 + w z^T / s   -w / s |
+ *            | -z^T / s            1 / s |
+ *
+ * so only the blocks of A need to be inverted.
+ *
+ **********************************************************/
+
+static int
+matom_solve_blocks (double *N, double *inverse, double *work)
+{
+  int nrows, k, b, i, j, m, li, lj, *level, error;
+  double *a_block, *a_inverse, *w, *z, s;
+
+  nrows = nlevels_macro + 1;
+  k = nlevels_macro;
+  a_block = work;
+  a_inverse = work + (size_t) nrows * nrows;
+  w = a_inverse + (size_t) nrows * nrows;
+  z = w + nrows;
+
+  for (i = 0; i < nrows * nrows; i++)
+    inverse[i] = 0.0;
+
+  /* Invert each block of A, and store it in place in the inverse */
+
+  for (b = 0; b < matom_nblocks; b++)
   {
-    for (nn = 0; nn < nrows; nn++)
+    m = matom_block_start[b + 1] - matom_block_start[b];
+    level = &matom_block_level[matom_block_start[b]];
+
+    if (m == 1)
+    {
+      li = level[0];
+      if (N[li * nrows + li] == 0.0)
+        return (EXIT_FAILURE);
+      inverse[li * nrows + li] = 1. / N[li * nrows + li];
+      continue;
+    }
+
+    for (i = 0; i < m; i++)
+      for (j = 0; j < m; j++)
+        a_block[i * m + j] = N[level[i] * nrows + level[j]];
+
+    if ((error = invert_matrix (a_block, a_inverse, m)) != EXIT_SUCCESS)
+      return (error);
+
+    for (i = 0; i < m; i++)
+      for (j = 0; j < m; j++)
+        inverse[level[i] * nrows + level[j]] = a_inverse[i * m + j];
+  }
+
+  /* Now w = A^-1 u and z^T = v^T A^-1, which only involve the blocks */
+
+  s = N[k * nrows + k];
+  for (b = 0; b < matom_nblocks; b++)
+  {
+    m = matom_block_start[b + 1] - matom_block_start[b];
+    level = &matom_block_level[matom_block_start[b]];
+    for (i = 0; i < m; i++)
+    {
+      li = level[i];
+      w[li] = 0.0;
+      z[li] = 0.0;
+      for (j = 0; j < m; j++)
+      {
+        lj = level[j];
+        w[li] += inverse[li * nrows + lj] * N[lj * nrows + k];
+        z[li] += N[k * nrows + lj] * inverse[lj * nrows + li];
+      }
+    }
+  }
+
+  for (i = 0; i < k; i++)
+    s -= N[k * nrows + i] * w[i];
+
+  if (sane_check (s) || fabs (s) < DBL_EPSILON)
+    return (EXIT_FAILURE);
+
+  for (i = 0; i < k; i++)
+  {
+    for (j = 0; j < k; j++)
     {
-      a_data[mm * nrows + nn] = Q_matrix[mm][nn];       /* row-major */
+      inverse[i * nrows + j] += w[i] * z[j] / s;
     }
+    inverse[i * nrows + k] = -w[i] / s;
+    inverse[k * nrows + i] = -z[i] / s;
   }
+  inverse[k * nrows + k] = 1. / s;
+
+  return (EXIT_SUCCESS);
+}
 
-  matrix_error = invert_matrix (a_data, a_inverse, nrows);
+
+
+/**********************************************************/
+/**
+ * @brief check whether the jump probabilities in a cell have changed since
+ * its matrix was last calculated
+ *
+ * @param [in] int  nplasma   The plasma cell
+ * @param [in] double *  N   The matrix N = I - Q, stored by rows
+ * @param [in] double *  R   The diagonal of the matrix R
+ * @return  TRUE if no probability has changed by more than a fraction
+ * modes.matom_matrix_tol, FALSE otherwise
+ *
+ * @details
+ * If the probabilities have changed, they are saved, to be compared with those
+ * in the next cycle.  Changes in probabilities smaller than MATOM_PROB_MIN
+ * are ignored.
+ *
+ **********************************************************/
+
+static int
+matom_rates_unchanged (int nplasma, double *N, double *R)
+{
+  int nrows, uplvl, n, nnz, unchanged;
+  double *old, x, y;
+
+  nrows = nlevels_macro + 1;
+  nnz = matom_pattern_start[nrows];
+
+  if (matom_nfingerprint != NPLASMA)
+  {
+    matom_fingerprint_free ();
+    if ((matom_fingerprint = calloc (NPLASMA, sizeof (double *))) == NULL)
+    {
+      Error ("matom_rates_unchanged: Unable to allocate memory for %d cells\n", NPLASMA);
+      Exit (0);
+    }
+    matom_nfingerprint = NPLASMA;
+  }
+
+  unchanged = TRUE;
+  if ((old = matom_fingerprint[nplasma]) == NULL)
+  {
+    if ((old = matom_fingerprint[nplasma] = calloc (nnz + nrows, sizeof (double))) == NULL)
+    {
+      Error ("matom_rates_unchanged: Unable to allocate memory for cell %d\n", nplasma);
+      Exit (0);
+    }
+    unchanged = FALSE;
+  }
+
+  for (uplvl = 0; uplvl < nrows && unchanged; uplvl++)
+  {
+    for (n = matom_pattern_start[uplvl]; n < matom_pattern_start[uplvl + 1]; n++)
+    {
+      x = N[uplvl * nrows + matom_pattern_col[n]];
+      y = old[n];
+      if (fabs (x - y) > MATOM_PROB_MIN && fabs (x - y) > modes.matom_matrix_tol * fabs (y))
+      {
+        unchanged = FALSE;
+        break;
+      }
+    }
+    x = R[uplvl];
+    y = old[nnz + uplvl];
+    if (fabs (x - y) > MATOM_PROB_MIN && fabs (x - y) > modes.matom_matrix_tol * fabs (y))
+      unchanged = FALSE;
+  }
+
+  if (unchanged == FALSE)
+  {
+    for (uplvl = 0; uplvl < nrows; uplvl++)
+    {
+      for (n = matom_pattern_start[uplvl]; n < matom_pattern_start[uplvl + 1]; n++)
+      {
+        old[n] = N[uplvl * nrows + matom_pattern_col[n]];
+      }
+      old[nnz + uplvl] = R[uplvl];
+    }
+  }
+
+  return (unchanged);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief release the memory used to record the probabilities used
+ * for the matrix in each cell
+ *
+ * @return  Always returns 0
+ *
+ **********************************************************/
+
+int
+matom_fingerprint_free (void)
+{
+  int n;
+
+  if (matom_fingerprint != NULL)
+  {
+    for (n = 0; n < matom_nfingerprint; n++)
+      free (matom_fingerprint[n]);
+    free (matom_fingerprint);
+  }
+  matom_fingerprint = NULL;
+  matom_nfingerprint = 0;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief calculate the matrix of probabilities for the accelerated macro-atom scheme
+ *
+ * @param [in] PlasmaPtr  xplasma
+ * @param [in,out] double **matom_matrix
+ *        the 2D matrix array we will populate with normalised probabilities
+ *
+ * @details
+ * given an activation state, this routine calculates the probability that a packet
+ * will deactivate from a given state. Let's suppose that the \f$(i,j)\f$-th element of matrix
+ * \f$Q\f$ contains the **jumping** probability from state i to state j, and the diagonals
+ * \f$(i,i)\f$ of matrix \f$R\f$ contain the emission probabilities from each state, then it
+ * can be shown that (see short notes from Vogl, or
+ * <a href="Ergon et al. 2018">https://ui.adsabs.harvard.edu/abs/2018A%26A...620A.156E</a>)
+ * the quantity we want is then \f$B = N R\f$, where \f$N = (I - Q)^{-1}\f$, where \f$I\f$
+ * is the identity matrix. This routine does this calculation.
+ *
+ * ### Notes ###
+ * The matrices are built in work space which is reused from one cell to the next.
+ * If --matrix-sparse is set, \f$(I - Q)\f$ is inverted by matom_solve_blocks, which
+ * only inverts the diagonal blocks belonging to each element, rather than by inverting
+ * the whole matrix.
+ *
+ **********************************************************/
+
+void
+calc_matom_matrix (xplasma, matom_matrix)
+     PlasmaPtr xplasma;
+     double **matom_matrix;
+{
+  int nrows = nlevels_macro + 1;
+  double *N, *R, *Q_norm;
+
+  N = matom_workspace (nrows);
+  R = N + 4 * (size_t) nrows * nrows + 2 * nrows;
+  Q_norm = R + nrows;
+
+  calc_matom_rates (xplasma, N, R, Q_norm);
+  calc_matom_matrix_from_rates (xplasma, N, R, matom_matrix);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief calculate the matrix of probabilities for the accelerated macro-atom
+ * scheme from the jump and emission probabilities
+ *
+ * @param [in] PlasmaPtr  xplasma
+ * @param [in] double *  N   The matrix N = I - Q, stored by rows; this is overwritten
+ * @param [in] double *  R   The diagonal of the matrix R
+ * @param [in,out] double **matom_matrix
+ *        the 2D matrix array we will populate with normalised probabilities
+ *
+ * @details
+ * This is the second part of calc_matom_matrix.  N and R must be in the work
+ * space returned by matom_workspace.
+ *
+ **********************************************************/
+
+void
+calc_matom_matrix_from_rates (xplasma, N, R, matom_matrix)
+     PlasmaPtr xplasma;
+     double *N, *R;
+     double **matom_matrix;
+{
+  int nrows = nlevels_macro + 1;
+  int mm, nn;
+  int matrix_error;
+  double *a_inverse;
+
+  a_inverse = N + (size_t) nrows * nrows;
+
+  matrix_error = EXIT_FAILURE;
+  if (modes.matom_matrix_sparse && matom_nblocks > 1)
+  {
+    matrix_error = matom_solve_blocks (N, a_inverse, a_inverse + (size_t) nrows * nrows);
+  }
 
   if (matrix_error != EXIT_SUCCESS)
   {
-    Error ("calc_matom_matrix: error %d whilst inverting Q_matrix in plasma cell %d\n", matrix_error, xplasma->nplasma);
+    matrix_error = invert_matrix (N, a_inverse, nrows);
   }
 
-  free (a_data);
+  if (matrix_error != EXIT_SUCCESS)
+  {
+    Error ("calc_matom_matrix: error %d whilst inverting Q_matrix in plasma cell %d\n", matrix_error, xplasma->nplasma);
+  }
 
   /* We now copy our rate matrix into the prepared matrix */
   for (mm = 0; mm < nrows; mm++)
@@ -329,22 +930,57 @@ calc_matom_matrix (xplasma, matom_matrix)
       /* in Christian Vogl's notation this is doing his equation 3: B = (N * R)
          where N is the inverse matrix we have just calculated. */
       /* the reason this matrix multiplication is so simple here is because R is a diagonal matrix */
-      matom_matrix[mm][nn] = a_inverse[mm * nrows + nn] * R_matrix[nn][nn];
+      matom_matrix[mm][nn] = a_inverse[mm * nrows + nn] * R[nn];
     }
   }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief calculate the matrix of probabilities which is stored for a cell,
+ * unless the probabilities have not changed significantly
+ *
+ * @param [in] PlasmaPtr  xplasma
+ * @return  TRUE if the matrix was calculated, FALSE if the stored matrix was kept
+ *
+ * @details
+ * If modes.matom_matrix_tol is zero (the default), the matrix is always
+ * calculated.  Otherwise, the existing matrix is kept if none of the jump or
+ * emission probabilities have changed by more than a fraction modes.matom_matrix_tol
+ * since it was calculated, see --matrix-tol.
+ *
+ **********************************************************/
+
+int
+calc_stored_matom_matrix (xplasma)
+     PlasmaPtr xplasma;
+{
+  int nrows = nlevels_macro + 1;
+  double *N, *R, *Q_norm;
+  MacroPtr mplasma;
+
+  mplasma = &macromain[xplasma->nplasma];
+
+  if (modes.matom_matrix_tol <= 0.0)
+  {
+    calc_matom_matrix (xplasma, mplasma->matom_matrix);
+    return (TRUE);
+  }
 
-  free (a_inverse);
+  N = matom_workspace (nrows);
+  R = N + 4 * (size_t) nrows * nrows + 2 * nrows;
+  Q_norm = R + nrows;
 
-  /* need to free each calloc-ed row of the matrixes */
-  for (i = 0; i < nrows; i++)
+  calc_matom_rates (xplasma, N, R, Q_norm);
+  if (matom_rates_unchanged (xplasma->nplasma, N, R))
   {
-    free (R_matrix[i]);
-    free (Q_matrix[i]);
+    return (FALSE);
   }
 
-  free (R_matrix);
-  free (Q_matrix);
-  free (Q_norm);
+  calc_matom_matrix_from_rates (xplasma, N, R, mplasma->matom_matrix);
+  return (TRUE);
 }
 
 
@@ -371,9 +1007,9 @@ fill_kpkt_rates (xplasma, escape, p)
 
   int i;
   int ulvl;
-  double cooling_bf[nphot_total];
-  double cooling_bf_col[nphot_total];   //collisional cooling in bf transitions
-  double cooling_bb[NLINES];
+  double cooling_bf;
+  double cooling_bf_col;        //collisional cooling in bf transitions
+  double cooling_bb;
   double cooling_adiabatic;
   struct topbase_phot *cont_ptr;
   struct lines *line_ptr;
@@ -430,43 +1066,43 @@ fill_kpkt_rates (xplasma, escape, p)
       if (cont_ptr->macro_info == TRUE && geo.macro_simple == FALSE)
       {
         upper_density = den_config (xplasma, ulvl);
-        cooling_bf[i] = mplasma->cooling_bf[i] =
+        cooling_bf = mplasma->cooling_bf[i] =
           upper_density * PLANCK * cont_ptr->freq[0] * (mplasma->recomb_sp_e[xconfig[ulvl].bfd_indx_first + cont_ptr->down_index]);
       }
       else
       {
         upper_density = xplasma->density[cont_ptr->nion + 1];
 
-        cooling_bf[i] = mplasma->cooling_bf[i] = upper_density * PLANCK * cont_ptr->freq[0] * (xplasma->recomb_simple[i]);
+        cooling_bf = mplasma->cooling_bf[i] = upper_density * PLANCK * cont_ptr->freq[0] * (xplasma->recomb_simple[i]);
       }
 
-      if (cooling_bf[i] < 0)
+      if (cooling_bf < 0)
       {
         Error ("kpkt: phot %d bf cooling rate negative. Density was %g\n", p->np, upper_density);
         Error ("alpha_sp(cont_ptr, xplasma,2) %g \n", alpha_sp (cont_ptr, xplasma, 2));
         Error ("i, ulvl, nphot_total, nion %d %d %d %d\n", i, ulvl, nphot_total, cont_ptr->nion);
         Error ("nlev, z, istate %d %d %d \n", cont_ptr->nlev, cont_ptr->z, cont_ptr->istate);
         Error ("freq[0] %g\n", cont_ptr->freq[0]);
-        cooling_bf[i] = mplasma->cooling_bf[i] = 0.0;
+        cooling_bf = mplasma->cooling_bf[i] = 0.0;
       }
       else
       {
-        cooling_bftot += cooling_bf[i];
+        cooling_bftot += cooling_bf;
       }
 
-      cooling_normalisation += cooling_bf[i];
+      cooling_normalisation += cooling_bf;
 
       if (cont_ptr->macro_info == TRUE && geo.macro_simple == FALSE)
       {
         /* Include collisional ionization as a cooling term in macro atoms, but not simple atoms.  */
 
         lower_density = den_config (xplasma, cont_ptr->nlev);
-        cooling_bf_col[i] = mplasma->cooling_bf_col[i] =
+        cooling_bf_col = mplasma->cooling_bf_col[i] =
           lower_density * PLANCK * cont_ptr->freq[0] * q_ioniz (cont_ptr, electron_temperature);
 
-        cooling_bf_coltot += cooling_bf_col[i];
+        cooling_bf_coltot += cooling_bf_col;
 
-        cooling_normalisation += cooling_bf_col[i];
+        cooling_normalisation += cooling_bf_col;
 
       }
 
@@ -480,7 +1116,7 @@ fill_kpkt_rates (xplasma, escape, p)
       line_ptr = &line[i];
       if (line_ptr->macro_info == TRUE && geo.macro_simple == FALSE)
       {
-        cooling_bb[i] = mplasma->cooling_bb[i] =
+        cooling_bb = mplasma->cooling_bb[i] =
           den_config (xplasma, line_ptr->nconfigl) * q12 (line_ptr, electron_temperature) * line_ptr->freq * PLANCK;
 
       }
@@ -490,7 +1126,7 @@ fill_kpkt_rates (xplasma, escape, p)
 
         coll_rate = q21 (line_ptr, electron_temperature) * (1. - exp (-H_OVER_K * line_ptr->freq / electron_temperature));
 
-        cooling_bb[i] =
+        cooling_bb =
           (lower_density * line_ptr->gu / line_ptr->gl -
            upper_density) * coll_rate / (exp (H_OVER_K * line_ptr->freq / electron_temperature) - 1.) * line_ptr->freq * PLANCK;
 
@@ -500,20 +1136,20 @@ fill_kpkt_rates (xplasma, escape, p)
            the photon actually escapes - we don't to waste time by exciting a two-level macro atom only so that
            it makes another k-packet for us! (SS May 04) */
 
-        cooling_bb[i] *= rad_rate / (rad_rate + (coll_rate * xplasma->ne));
-        mplasma->cooling_bb[i] = cooling_bb[i];
-        mplasma->cooling_bb_simple_tot += cooling_bb[i];
+        cooling_bb *= rad_rate / (rad_rate + (coll_rate * xplasma->ne));
+        mplasma->cooling_bb[i] = cooling_bb;
+        mplasma->cooling_bb_simple_tot += cooling_bb;
       }
 
-      if (cooling_bb[i] < 0)
+      if (cooling_bb < 0)
       {
-        cooling_bb[i] = mplasma->cooling_bb[i] = 0.0;
+        cooling_bb = mplasma->cooling_bb[i] = 0.0;
       }
       else
       {
-        cooling_bbtot += cooling_bb[i];
+        cooling_bbtot += cooling_bb;
       }
-      cooling_normalisation += cooling_bb[i];
+      cooling_normalisation += cooling_bb;
     }
 
     /* end of BB calculation  */
@@ -953,40 +1589,38 @@ matom_deactivation_from_matrix (xplasma, uplvl)
      int uplvl;
 {
   double z, total;
-  int j, i;
+  int j;
   int nrows = nlevels_macro + 1;
   double **matom_matrix;
   MacroPtr mplasma;
 
   mplasma = &macromain[xplasma->nplasma];
 
-  if (mplasma->matrix_rates_known == FALSE)
+  if (mplasma->store_matom_matrix == FALSE)
   {
-    if (mplasma->store_matom_matrix == FALSE)
+    /* we aren't storing the macro-atom matrix, so we need to calculate it, in
+       space which is kept for the next cell */
+    if (matom_scratch_rows != nrows)
     {
-      /* we aren't storing the macro-atom matrix, so we need to allocate and calculate it */
-      matom_matrix = (double **) calloc (sizeof (double *), nrows);
-      for (i = 0; i < nrows; i++)
+      if (matom_scratch != NULL)
       {
-        matom_matrix[i] = (double *) calloc (sizeof (double), nrows);
+        free (matom_scratch[0]);
+        free (matom_scratch);
       }
+      allocate_macro_matrix (&matom_scratch, nrows);
+      matom_scratch_rows = nrows;
     }
-    else
-    {
-      matom_matrix = mplasma->matom_matrix;
-    }
-
+    matom_matrix = matom_scratch;
     calc_matom_matrix (xplasma, matom_matrix);
-
-    /* if we are storing the matrix, flag that we know the rates now */
-    if (mplasma->store_matom_matrix == TRUE)
-    {
-      mplasma->matrix_rates_known = TRUE;
-    }
   }
-//OLD  else if (mplasma->store_matom_matrix == TRUE)
   else
   {
+    if (mplasma->matrix_rates_known == FALSE)
+    {
+      calc_stored_matom_matrix (xplasma);
+      /* flag that we know the rates now */
+      mplasma->matrix_rates_known = TRUE;
+    }
     matom_matrix = mplasma->matom_matrix;
   }
 
@@ -1007,16 +1641,6 @@ matom_deactivation_from_matrix (xplasma, uplvl)
     j = j - 1;
   }
 
-  if (mplasma->store_matom_matrix == FALSE)
-  {
-    /* need to free each calloc-ed row of the matrixes */
-    for (i = 0; i < nrows; i++)
-    {
-      free (matom_matrix[i]);
-    }
-    free (matom_matrix);
-  }
-
   return (j);
 }
 
@@ -1034,7 +1658,7 @@ matom_deactivation_from_matrix (xplasma, uplvl)
 int
 calc_all_matom_matrices (void)
 {
-  int ndo, my_nmin, my_nmax, n;
+  int ndo, my_nmin, my_nmax, n, ncalc, nstored;
   struct timeval timer_t0;
   char message[LINELENGTH];
   MacroPtr mplasma;
@@ -1049,6 +1673,7 @@ calc_all_matom_matrices (void)
 
   timer_t0 = init_timer_t0 ();
 
+  ncalc = nstored = 0;
   for (n = my_nmin; n < my_nmax; n++)
   {
     xplasma = &plasmamain[n];
@@ -1056,21 +1681,27 @@ calc_all_matom_matrices (void)
 
     if (mplasma->store_matom_matrix == TRUE)
     {
-      calc_matom_matrix (xplasma, mplasma->matom_matrix);
+      nstored++;
+      ncalc += calc_stored_matom_matrix (xplasma);
     }
   }
 
   /* print the time taken for this thread to complete */
-  sprintf (message, "calc_all_matom_matrices: thread %d calculated %d matrices in", rank_global, ndo);
+  sprintf (message, "calc_all_matom_matrices: thread %d calculated %d matrices in", rank_global, ncalc);
   print_timer_duration (message, timer_t0);
+  if (ncalc < nstored)
+  {
+    Log ("calc_all_matom_matrices: %d of %d matrices were unchanged to within %g and were not recalculated\n",
+         nstored - ncalc, nstored, modes.matom_matrix_tol);
+  }
 
   /* this deals with communicating the matrices between threads (does nothing in serial mode) */
   broadcast_macro_atom_state_matrix (my_nmin, my_nmax, ndo);
 
-  /* flag the matrix rates as known */
+  /* flag the matrix rates as known in the cells where the matrix is stored */
   for (n = 0; n < NPLASMA; n++)
   {
-    macromain[n].matrix_rates_known = TRUE;
+    macromain[n].matrix_rates_known = macromain[n].store_matom_matrix;
   }
 
   return (0);
@@ -168,7 +168,7 @@ get_matom_f (mode)
              that energy re-appears in the frequency range we want and from which macro atom
              level it is re-emitted (or if it appears via a k-packet). */
 
-          for (mm = 0; mm < NLEVELS_MACRO; mm++)
+          for (mm = 0; mm < nlevels_macro; mm++)
           {
             level_emit[mm] = 0;
           }
@@ -351,6 +351,7 @@ get_matom_f (mode)
   }
 
   geo.matom_radiation = 1;
+  emission_sampler_init (SAMPLE_MATOM);
 
   return (lum);
 }
@@ -415,7 +416,7 @@ get_matom_f_accelerate (mode)
     /* We'll be using a pointer arithmetic trick to allocate a contiguous chunk
      * or memory -- see `calloc_matom_matrix()` in gridwind.c. It has to be allocated
      * like this as MPI expects contiguous memory blocks */
-    double **matom_matrix;
+    double **matom_matrix, **b_matrix;
     allocate_macro_matrix (&matom_matrix, matrix_size);
 
     /* add the non-radiative k-packet heating to the kpkt_abs quantity */
@@ -476,7 +477,19 @@ get_matom_f_accelerate (mode)
 
       /* use the accelerated macro-atom scheme */
       xplasma = &plasmamain[n];
-      calc_matom_matrix (xplasma, matom_matrix);
+      if (macromain[n].store_matom_matrix == TRUE)
+      {
+        /* calculate the stored matrix, so it need not be recalculated when
+           the first photon is absorbed in this cell in the spectral cycles */
+        calc_stored_matom_matrix (xplasma);
+        macromain[n].matrix_rates_known = TRUE;
+        b_matrix = macromain[n].matom_matrix;
+      }
+      else
+      {
+        calc_matom_matrix (xplasma, matom_matrix);
+        b_matrix = matom_matrix;
+      }
       /* before we calculate the emissivities we need to know what fraction of the energy
          from each level comes out in the frequency band we care about */
 
@@ -493,18 +506,18 @@ get_matom_f_accelerate (mode)
       {
         for (j = 0; j < nlevels_macro; j++)
         {
-          macromain[n].matom_emiss[j] += macromain[n].matom_abs[i] * matom_matrix[i][j];
+          macromain[n].matom_emiss[j] += macromain[n].matom_abs[i] * b_matrix[i][j];
         }
-        plasmamain[n].kpkt_emiss += macromain[n].matom_abs[i] * matom_matrix[i][nlevels_macro];
+        plasmamain[n].kpkt_emiss += macromain[n].matom_abs[i] * b_matrix[i][nlevels_macro];
       }
 
       /* do the same for the thermal pool. we also normalise by banded_emiss_frac here */
       for (j = 0; j < nlevels_macro; j++)
       {
-        macromain[n].matom_emiss[j] += plasmamain[n].kpkt_abs * matom_matrix[nlevels_macro][j];
+        macromain[n].matom_emiss[j] += plasmamain[n].kpkt_abs * b_matrix[nlevels_macro][j];
         macromain[n].matom_emiss[j] *= (1.0 * level_emit_doub[j]);
       }
-      plasmamain[n].kpkt_emiss += plasmamain[n].kpkt_abs * matom_matrix[nlevels_macro][nlevels_macro];
+      plasmamain[n].kpkt_emiss += plasmamain[n].kpkt_abs * b_matrix[nlevels_macro][nlevels_macro];
       plasmamain[n].kpkt_emiss *= (1.0 * kpkt_emit_doub);
     }
 
@@ -531,6 +544,7 @@ get_matom_f_accelerate (mode)
   }
 
   geo.matom_radiation = 1;
+  emission_sampler_init (SAMPLE_MATOM);
 
   return (lum);
 }
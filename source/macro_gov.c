@@ -64,6 +64,7 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
   int n_jump_tot = 0;
   int n_loop = 0;
   int new_uplvl, uplvl;
+  double t0;
   PlasmaPtr xplasma;
   MacroPtr mplasma;
   WindPtr one;
@@ -164,7 +165,9 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
       uplvl = nlevels_macro;
     }
 
+    t0 = prof_start ();
     new_uplvl = matom_deactivation_from_matrix (xplasma, uplvl);
+    prof_stop (PROF_MATOM, t0);
 
     if (xconfig[new_uplvl].nauger > 0)
     {
@@ -175,7 +178,9 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
     if (new_uplvl == nlevels_macro)
     {
       /* XMACRO improve this so that kpkt only deals with k->r in certain modes */
+      t0 = prof_start ();
       kpkt (p, nres, &escape, KPKT_MODE_CONT_PLUS_ADIABATIC);
+      prof_stop (PROF_KPKT, t0);
 
       *which_out = KPKT;
     }
@@ -207,7 +212,9 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
         /* if it's a bb transition of a full macro atom  */
         if (*nres > (-1) && *nres < NLINES && geo.macro_simple == FALSE && lin_ptr[*nres]->macro_info == TRUE)
         {
+          t0 = prof_start ();
           n_jump = matom (p, nres, &escape);
+          prof_stop (PROF_MATOM, t0);
 
           if (escape == TRUE)
           {
@@ -226,7 +233,9 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
         /* if it's bf transition of a full macro atom. */
         else if (*nres > NLINES && phot_top[*nres - NLINES - 1].macro_info == TRUE && geo.macro_simple == FALSE)
         {
+          t0 = prof_start ();
           n_jump = matom (p, nres, &escape);
+          prof_stop (PROF_MATOM, t0);
 
           if (escape == TRUE)
           {
@@ -260,7 +269,9 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
          section of the loop that deals with kpts */
       else if (matom_or_kpkt == KPKT)
       {
+        t0 = prof_start ();
         kpkt (p, nres, &escape, KPKT_MODE_ALL); // 1 implies include the possibility of deactivation due to non-thermal processes
+        prof_stop (PROF_KPKT, t0);
 
         /* if it did not escape then the k-packet must have been
            destroyed by collisionally exciting a macro atom so...
@@ -307,6 +318,55 @@ macro_gov (p, nres, matom_or_kpkt, which_out)
   return (0);
 }
 
+/* Work space for macro_pops, which is reused from one cell to the next.  It is
+   kept for each thread, and has room for all of the macro levels */
+
+static THREAD_LOCAL double *macro_pops_rates = NULL;    /* the rate matrix */
+static THREAD_LOCAL int *macro_pops_flags = NULL;       /* the flags for radiatively linked levels */
+static THREAD_LOCAL int *macro_pops_conf = NULL;        /* the map from levels to rows of the matrix */
+static THREAD_LOCAL int macro_pops_nlevels = -1;        /* The number of levels for which the work space was allocated */
+
+
+
+/**********************************************************/
+/**
+ * @brief      allocate the work space used by macro_pops
+ *
+ * @return     The dimension of the work space, which is the number of
+ *             macro levels, or 1 if there are none
+ *
+ **********************************************************/
+
+static int
+macro_pops_work (void)
+{
+  int nlev;
+
+  nlev = nlevels_macro > 0 ? nlevels_macro : 1;
+
+  if (macro_pops_nlevels == nlev)
+    return (nlev);
+
+  free (macro_pops_rates);
+  free (macro_pops_flags);
+  free (macro_pops_conf);
+
+  macro_pops_rates = calloc ((size_t) nlev * nlev, sizeof (double));
+  macro_pops_flags = calloc ((size_t) nlev * nlev, sizeof (int));
+  macro_pops_conf = calloc (nlev, sizeof (int));
+
+  if (macro_pops_rates == NULL || macro_pops_flags == NULL || macro_pops_conf == NULL)
+  {
+    Error ("macro_pops_work: Unable to allocate memory for %d macro levels\n", nlev);
+    Exit (EXIT_FAILURE);
+  }
+
+  macro_pops_nlevels = nlev;
+  return (nlev);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      uses the Monte Carlo estimators to compute a set
@@ -343,9 +403,10 @@ macro_pops (xplasma, xne)
   int n_iterations, n_inversions;
   double *a_data, *b_data;
   double *populations;
-  double rate_matrix[NLEVELS_MACRO][NLEVELS_MACRO];
-  int radiative_flag[NLEVELS_MACRO][NLEVELS_MACRO];     // array to flag if two levels are radiatively linked
-  int conf_to_matrix[NLEVELS_MACRO];    // links config number to elements in arrays
+  int nlev = macro_pops_work ();
+  double (*rate_matrix)[nlev] = (double (*)[nlev]) macro_pops_rates;
+  int (*radiative_flag)[nlev] = (int (*)[nlev]) macro_pops_flags;       // array to flag if two levels are radiatively linked
+  int *conf_to_matrix = macro_pops_conf;        // links config number to elements in arrays
   MacroPtr mplasma = &macromain[xplasma->nplasma];
 
   /*
@@ -367,9 +428,9 @@ macro_pops (xplasma, xne)
   {
     /* Zero all elements of the matrix before doing anything else. */
 
-    for (i = 0; i < NLEVELS_MACRO; i++)
+    for (i = 0; i < nlev; i++)
     {
-      for (j = 0; j < NLEVELS_MACRO; j++)
+      for (j = 0; j < nlev; j++)
       {
         rate_matrix[j][i] = 0.0;
         radiative_flag[j][i] = 0;
@@ -396,7 +457,8 @@ macro_pops (xplasma, xne)
            to do is work out how many levels we are dealing with in total. This is
            easily done by summing up the number of levels of each ion. */
 
-        n_macro_lvl = macro_pops_fill_rate_matrix (mplasma, xplasma, xne, index_element, rate_matrix, radiative_flag, conf_to_matrix);
+        n_macro_lvl =
+          macro_pops_fill_rate_matrix (mplasma, xplasma, xne, index_element, nlev, rate_matrix, radiative_flag, conf_to_matrix);
 
         /* The rate matrix is now filled up. Since the problem is not closed as it stands, the next
            thing is to replace one of the rows of the matrix (say the first row) with the constraint
@@ -463,7 +525,7 @@ macro_pops (xplasma, xne)
             }
           }
 
-          n_inversions = macro_pops_check_for_population_inversion (index_element, populations, radiative_flag, conf_to_matrix);
+          n_inversions = macro_pops_check_for_population_inversion (index_element, populations, nlev, radiative_flag, conf_to_matrix);
 
           if (n_inversions > 0)
             Debug ("macro_pops: iteration %d: there were %d levels which were cleaned due to population inversions in plasma cell %d\n",
@@ -516,6 +578,7 @@ macro_pops (xplasma, xne)
  * @param[in] PlasmaPtr xplasma       The current plasma cell
  * @param[in] double xne              The current value of the electron density
  * @param[in] int index_element       The index of the current element to populate
+ * @param[in] int nlev                The dimensions of the arrays, at least nlevels_macro
  * @param[out] double rate_matrix     The populated rate matrix for the current element
  * @param[out] double radiative_flag  Flags for if two levels are radiatively linked
  * @param[out] int conf_to_matrix     A map to link congfiruation number to elements in
@@ -533,9 +596,8 @@ macro_pops (xplasma, xne)
  **********************************************************/
 
 int
-macro_pops_fill_rate_matrix (MacroPtr mplasma, PlasmaPtr xplasma, double xne, int index_element,
-                             double rate_matrix[NLEVELS_MACRO][NLEVELS_MACRO], int radiative_flag[NLEVELS_MACRO][NLEVELS_MACRO],
-                             int conf_to_matrix[NLEVELS_MACRO])
+macro_pops_fill_rate_matrix (MacroPtr mplasma, PlasmaPtr xplasma, double xne, int index_element, int nlev,
+                             double rate_matrix[nlev][nlev], int radiative_flag[nlev][nlev], int conf_to_matrix[nlev])
 {
   int index_bbu, index_bbd;
   int index_bfu, index_bfd;
@@ -754,6 +816,7 @@ macro_pops_fill_rate_matrix (MacroPtr mplasma, PlasmaPtr xplasma, double xne, in
  *
  * @param[in]  int index_element     The index for the element
  * @param[in]  double *populations   The calculated population densities
+ * @param[in]  int nlev              The dimensions of radiative_flag
  * @param[in]  int **radiative_flag  Flags for if two levels are radiatively linked
  * @param[in]  int *conf_to_matrix   A map to link congfiruation number to elements in
  *                                    the populations matrix
@@ -768,8 +831,8 @@ macro_pops_fill_rate_matrix (MacroPtr mplasma, PlasmaPtr xplasma, double xne, in
  **********************************************************/
 
 int
-macro_pops_check_for_population_inversion (int index_element, double *populations, int radiative_flag[NLEVELS_MACRO][NLEVELS_MACRO],
-                                           int conf_to_matrix[NLEVELS_MACRO])
+macro_pops_check_for_population_inversion (int index_element, double *populations, int nlev, int radiative_flag[nlev][nlev],
+                                           int conf_to_matrix[nlev])
 {
   int i, index_ion, index_lvl;
   double inversion_test;
@@ -821,7 +884,7 @@ macro_pops_check_for_population_inversion (int index_element, double *population
 
 int
 macro_pops_check_densities_for_numerical_errors (PlasmaPtr xplasma, int index_element, double *populations,
-                                                 int conf_to_matrix[NLEVELS_MACRO], int n_iterations)
+                                                 int *conf_to_matrix, int n_iterations)
 {
   int index_ion, index_lvl;
   double this_ion_density, ion_density_temp;
@@ -885,7 +948,7 @@ macro_pops_check_densities_for_numerical_errors (PlasmaPtr xplasma, int index_el
  **********************************************************/
 
 void
-macro_pops_copy_to_xplasma (PlasmaPtr xplasma, int index_element, double *populations, int conf_to_matrix[NLEVELS_MACRO])
+macro_pops_copy_to_xplasma (PlasmaPtr xplasma, int index_element, double *populations, int *conf_to_matrix)
 {
   int index_ion, index_lvl;
   double this_ion_density, fractional_population;
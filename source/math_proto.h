@@ -11,6 +11,7 @@ double vcos(double x, void *params);
 int randvdipole(double lmn[], double north[]);
 double vdipole(double cos_theta, void *params);
 int init_rand(int seed);
+int init_rand_threads(int nthreads);
 void init_rng_directory(char *root, int rank);
 void save_gsl_rng_state(void);
 void reload_gsl_rng_state(void);
@@ -20,6 +21,7 @@ int cdf_gen_from_func(CdfPtr cdf, double (*func)(double, void *), double xmin, d
 double gen_array_from_func(double (*func)(double, void *), double xmin, double xmax, int pdfsteps);
 int cdf_gen_from_array(CdfPtr cdf, double x[], double y[], int n_xy, double xmin, double xmax);
 double cdf_get_rand(CdfPtr cdf);
+double cdf_get_rand_array(double *xcdf, double *ycdf, double *dcdf, int ncdf);
 int cdf_limit(CdfPtr cdf, double xmin, double xmax);
 double cdf_get_rand_limit(CdfPtr cdf);
 int cdf_to_file(CdfPtr cdf, char comment[]);
@@ -14,14 +14,270 @@
 #include "atomic.h"
 #include "sirocco.h"
 
-/* External variables for use in matom */
+/* The jump and emission probabilities of the levels of the macro atom being
+   followed, which are kept until the packet moves to another cell or element.
+   There is a row of matom_known_stride values for each macro level, and a
+   set of these for each thread */
+
+static THREAD_LOCAL double *jprbs_known = NULL, *eprbs_known = NULL;
+static THREAD_LOCAL double *pjnorm_known = NULL, *penorm_known = NULL;
+static THREAD_LOCAL int *prbs_known = NULL;
+static THREAD_LOCAL int matom_known_nlevels = -1;
+static THREAD_LOCAL int matom_known_stride = 0;
+static THREAD_LOCAL int matom_cell = -1;
+static THREAD_LOCAL int matom_z = -1;
+static THREAD_LOCAL int matom_cycle = -1;
+
+
+
+/**********************************************************/
+/**
+ * @brief allocate the space in which matom keeps the probabilities of
+ * the jumps from each level
+ *
+ * @return Always returns 0
+ *
+ * @details
+ * Each row is long enough for all the jumps from the level with the
+ * most jumps, rather than for NBBJUMPS and NBFJUMPS of each kind.
+ *
+***********************************************************/
+
+static int
+matom_known_work (void)
+{
+  int n, njump;
+
+  if (matom_known_nlevels == nlevels_macro)
+    return (0);
+
+  free (jprbs_known);
+  free (eprbs_known);
+  free (pjnorm_known);
+  free (penorm_known);
+  free (prbs_known);
+
+  /* One more than the most jumps from any level, so there is always a zero after the last one */
+  matom_known_stride = 1;
+  for (n = 0; n < nlevels_macro; n++)
+  {
+    njump = xconfig[n].n_bbd_jump + xconfig[n].n_bfd_jump + xconfig[n].nauger + xconfig[n].n_bbu_jump + xconfig[n].n_bfu_jump + 1;
+    if (njump > matom_known_stride)
+      matom_known_stride = njump;
+  }
+
+  n = nlevels_macro > 0 ? nlevels_macro : 1;
+  jprbs_known = calloc ((size_t) n * matom_known_stride, sizeof (double));
+  eprbs_known = calloc ((size_t) n * matom_known_stride, sizeof (double));
+  pjnorm_known = calloc (n, sizeof (double));
+  penorm_known = calloc (n, sizeof (double));
+  prbs_known = calloc (n, sizeof (int));
+
+  if (jprbs_known == NULL || eprbs_known == NULL || pjnorm_known == NULL || penorm_known == NULL || prbs_known == NULL)
+  {
+    Error ("matom_known_work: Unable to allocate memory for %d macro levels\n", nlevels_macro);
+    Exit (0);
+  }
+
+  matom_known_nlevels = nlevels_macro;
+  matom_z = matom_cell = matom_cycle = -1;
+
+  return (0);
+}
+
+/**********************************************************/
+/**
+ * @brief calculate the probabilities of the jumps from, and the emission by, a level of a macro atom
+ *
+ * @param [in]  PlasmaPtr xplasma   the plasma cell
+ * @param [in]  int uplvl   the level of the macro atom
+ * @param [out]  double *jprbs   the jump probabilities, for the downward bb, downward bf, Auger,
+ *                                 upward bb and upward bf jumps from the level in that order
+ * @param [out]  double *eprbs   the emission probabilities, for the downward bb, bf and Auger jumps
+ * @param [out]  double *pjnorm_out   the total jump probability
+ * @param [out]  double *penorm_out   the total emission probability
+ * @return the number of jumps from the level
+ *
+ * @details
+ * This is the calculation matom makes for each level it visits, following Lucy.
+ * jprbs must have room for all the jumps from the level, and eprbs for the
+ * number of downward jumps.
+ *
+***********************************************************/
+
+int
+matom_jump_prbs (xplasma, uplvl, jprbs, eprbs, pjnorm_out, penorm_out)
+     PlasmaPtr xplasma;
+     int uplvl;
+     double *jprbs, *eprbs;
+     double *pjnorm_out, *penorm_out;
+{
+  struct lines *line_ptr;
+  struct topbase_phot *cont_ptr;
+  struct auger *auger_ptr;
+  double pjnorm, penorm;
+  double sp_rec_rate;
+  int n, m;
+  int nbbd, nbbu, nbfd, nbfu;
+  double t_e, ne;
+  double bb_cont, bf_cont;
+  double rad_rate, coll_rate, lower_density, density_ratio;
+  MacroPtr mplasma;
+  int nauger, iauger, target_level;
+  double auger_rate;
+
+  mplasma = &macromain[xplasma->nplasma];
+
+  t_e = xplasma->t_e;
+  ne = xplasma->ne;
+
+  nbbd = xconfig[uplvl].n_bbd_jump;     // number of bb downward jumps
+  nbbu = xconfig[uplvl].n_bbu_jump;     // number of bb upward jump from this configuration
+  nbfd = xconfig[uplvl].n_bfd_jump;     // number of bf downward jumps from this transition
+  nbfu = xconfig[uplvl].n_bfu_jump;     // number of bf upward jumps from this transiion
+  nauger = xconfig[uplvl].nauger;       // number of auger jumps
+  iauger = xconfig[uplvl].iauger;
+
+  m = 0;                    //m counts the total number of possible ways to leave the level
+  pjnorm = 0.0;             //stores the total jump probability
+  penorm = 0.0;             //stores the total emission probability
+
+  for (n = 0; n < nbbd + nbfd; n++)
+  {
+    eprbs[n] = 0;   //zero the individual emission probabilities
+    jprbs[n] = 0;   //zero  the individual jump probabilities
+  }
+  for (n = nbbd + nbfd; n < nbbd + nbfd + nbbu + nbfu; n++)
+  {
+    jprbs[n] = 0;   /*slots for upward jumps */
+  }
+
+
+  /* bb */
+
+  /* First downward jumps. (I.e. those that have emission probabilities. */
+
+  /* For bound-bound decays the jump probability is A-coeff * escape-probability * energy */
+  /* At present the escape probability is only approximated (p_escape). This should be improved. */
+  /* The collisional contribution to both the jumping and deactivation probabilities are now added (SS, Apr04) */
+
+  for (n = 0; n < nbbd; n++)
+  {
+    line_ptr = &line[xconfig[uplvl].bbd_jump[n]];
+
+    rad_rate = (a21 (line_ptr) * p_escape (line_ptr, xplasma));
+    coll_rate = ne * q21 (line_ptr, t_e);
+
+
+    bb_cont = rad_rate + coll_rate;
+    jprbs[m] = bb_cont * xconfig[line_ptr->nconfigl].ex;    //energy of lower state
+
+    eprbs[m] = bb_cont * (xconfig[uplvl].ex - xconfig[line[xconfig[uplvl].bbd_jump[n]].nconfigl].ex);       //energy difference
+
+
+    pjnorm += jprbs[m];
+    penorm += eprbs[m];
+    m++;
+  }
+
+  /* bf */
+  for (n = 0; n < nbfd; n++)
+  {
+
+    cont_ptr = &phot_top[xconfig[uplvl].bfd_jump[n]];       //pointer to continuum
+
+    sp_rec_rate = mplasma->recomb_sp[xconfig[uplvl].bfd_indx_first + n];
+    bf_cont = (sp_rec_rate + q_recomb (cont_ptr, t_e) * ne) * ne;
+
+    jprbs[m] = bf_cont * xconfig[phot_top[xconfig[uplvl].bfd_jump[n]].nlev].ex;     //energy of lower state
+    eprbs[m] = bf_cont * (xconfig[uplvl].ex - xconfig[phot_top[xconfig[uplvl].bfd_jump[n]].nlev].ex);       //energy difference
+    pjnorm += jprbs[m];
+    penorm += eprbs[m];
+    m++;
+  }
+
+  /* Auger ionization */
+  if (iauger >= 0)
+  {
+    auger_ptr = &auger_macro[iauger];
+
+    for (n = 0; n < nauger; n++)
+    {
+      target_level = auger_ptr->nconfig_target[n];
+      auger_rate = auger_ptr->Avalue_auger * auger_ptr->branching_ratio[n];
+
+      jprbs[m] = auger_rate * xconfig[target_level].ex;     //energy of lower state
+      eprbs[m] = auger_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);       //energy difference
+
+      pjnorm += jprbs[m];
+      penorm += eprbs[m];
+      m++;
+    }
+  }
+
+  /* Now upwards jumps. */
+
+  /* bb */
+  /* For bound-bound excitation the jump probability is B-coeff times Jbar with a correction
+     for stimulated emission. To avoid the need for recalculation all the time, the code will
+     be designed to include the stimulated correction in Jbar - i.e. the stimulated correction
+     factor will NOT be included here. (SS) */
+  /* There is no emission probability for upwards transitions. */
+  /* Collisional contribution to jumping probability added. (SS,Apr04) */
+
+  for (n = 0; n < nbbu; n++)
+  {
+    line_ptr = &line[xconfig[uplvl].bbu_jump[n]];
+    rad_rate = (b12 (line_ptr) * mplasma->jbar_old[xconfig[uplvl].bbu_indx_first + n]);
+
+    coll_rate = ne * q12 (line_ptr, t_e);   // this is multiplied by ne below
+
+
+    jprbs[m] = (rad_rate + coll_rate) * xconfig[uplvl].ex;  //energy of lower state
+
+
+    pjnorm += jprbs[m];
+    m++;
+  }
+
+  /* bf */
+  for (n = 0; n < nbfu; n++)
+  {
+    /* For bf ionization the jump probability is just gamma * energy
+       gamma is the photoionisation rate. Stimulated recombination also included. */
+    cont_ptr = &phot_top[xconfig[uplvl].bfu_jump[n]];       //pointer to continuum
+
+    /* first let us take care of the situation where the lower level is zero or close to zero */
+    lower_density = den_config (xplasma, cont_ptr->nlev);
+    if (lower_density >= DENSITY_PHOT_MIN)
+    {
+      density_ratio = den_config (xplasma, cont_ptr->uplev) / lower_density;
+    }
+    else
+      density_ratio = 0.0;
+
+    jprbs[m] = (mplasma->gamma_old[xconfig[uplvl].bfu_indx_first + n] - (mplasma->alpha_st_old[xconfig[uplvl].bfu_indx_first + n] * xplasma->ne * density_ratio) + (q_ioniz (cont_ptr, t_e) * ne)) * xconfig[uplvl].ex;     //energy of lower state
+
+    /* this error condition can happen in unconverged hot cells where T_R >> T_E.
+       for the moment we set to 0 and hope spontaneous recombiantion takes care of things */
+    /* note that we check and report this in check_stimulated_recomb() in estimators.c once a cycle */
+    if (jprbs[m] < 0.)      //test (can be deleted eventually SS)
+    {
+      //Error ("Negative probability (matom, 6). Abort?\n");
+      jprbs[m] = 0.0;
+
+    }
+    pjnorm += jprbs[m];
+    m++;
+  }
+
+  *pjnorm_out = pjnorm;
+  *penorm_out = penorm;
+
+  return (m);
+}
+
 
-double jprbs_known[NLEVELS_MACRO][2 * (NBBJUMPS + NBFJUMPS)], eprbs_known[NLEVELS_MACRO][2 * (NBBJUMPS + NBFJUMPS)];
-double pjnorm_known[NLEVELS_MACRO], penorm_known[NLEVELS_MACRO];
-int prbs_known[NLEVELS_MACRO];
-int matom_cell = -1;
-int matom_z = -1;
-int matom_cycle = -1;
 
 /**********************************************************/
 /**
@@ -59,7 +315,11 @@ int matom_cycle = -1;
  * is the *actual* number of lines. So, actually, it's not just nres = NLINES that's never used, but
  * the entire range of nlines <= nres <= NLINES]
  *
- *
+ * The probabilities for each level are calculated by matom_jump_prbs.  By
+ * default they are saved until the packet moves to another cell or element.
+ * If --matom-tables is set, they are instead taken from the alias tables in
+ * matom_tables.c, which persist for the cycle, and a jump is chosen in a time
+ * independent of the number of possible jumps.
  *
 ***********************************************************/
 
@@ -71,26 +331,22 @@ matom (p, nres, escape)
 {
   struct lines *line_ptr;
   struct topbase_phot *cont_ptr;
-  struct auger *auger_ptr;
   int uplvl, uplvl_old;
 //OLD  int icheck;
-  double jprbs[2 * (NBBJUMPS + NBFJUMPS)];
-  double eprbs[NBBJUMPS + NBFJUMPS];
   double pjnorm, penorm;
   double threshold, run_tot;
-  double sp_rec_rate;
-  int n, m;
+  int n;
   int njumps;
   int nbbd, nbbu, nbfd, nbfu;
   double t_e, ne;
-  double bb_cont, choice, bf_cont;
+  double choice;
   WindPtr one;
-  double rad_rate, coll_rate, lower_density, density_ratio;
+  double rad_rate, coll_rate;
   PlasmaPtr xplasma;
   MacroPtr mplasma;
+  MatomJumpsPtr jumps = NULL;
   int z;
-  int nauger, iauger, target_level;
-  double auger_rate;
+  int nauger, iauger;
 
 
   one = &wmain[p->grid];
@@ -106,9 +362,6 @@ matom (p, nres, escape)
   t_e = xplasma->t_e;
   ne = xplasma->ne;
 
-  /* these are used later for stimulated recomb */
-  lower_density = density_ratio = 0.0;
-
 
   /* The first step is to identify the configuration that has been excited.
    * If *nres < NLINES the level will have been excited by a bb transioion
@@ -136,9 +389,11 @@ matom (p, nres, escape)
     return (-1);
   }
 
+  matom_known_work ();
+
   if (z != matom_z || p->grid != matom_cell || geo.wcycle != matom_cycle)
   {
-    for (n = 0; n < NLEVELS_MACRO; n++)
+    for (n = 0; n < nlevels_macro; n++)
     {
       prbs_known[n] = FALSE;
     }
@@ -163,153 +418,28 @@ matom (p, nres, escape)
     nauger = xconfig[uplvl].nauger;     // number of auger jumps
     iauger = xconfig[uplvl].iauger;
 
-    if (prbs_known[uplvl] == FALSE)
+    if (modes.matom_tables)
     {
-
-      m = 0;                    //m counts the total number of possible ways to leave the level
-      pjnorm = 0.0;             //stores the total jump probability
-      penorm = 0.0;             //stores the total emission probability
-
-      for (n = 0; n < nbbd + nbfd; n++)
-      {
-        eprbs_known[uplvl][n] = eprbs[n] = 0;   //zero the individual emission probabilities
-        jprbs_known[uplvl][n] = jprbs[n] = 0;   //zero  the individual jump probabilities
-      }
-      for (n = nbbd + nbfd; n < nbbd + nbfd + nbbu + nbfu; n++)
-      {
-        jprbs_known[uplvl][n] = jprbs[n] = 0;   /*slots for upward jumps */
-      }
-
-
-      /* bb */
-
-      /* First downward jumps. (I.e. those that have emission probabilities. */
-
-      /* For bound-bound decays the jump probability is A-coeff * escape-probability * energy */
-      /* At present the escape probability is only approximated (p_escape). This should be improved. */
-      /* The collisional contribution to both the jumping and deactivation probabilities are now added (SS, Apr04) */
-
-      for (n = 0; n < nbbd; n++)
-      {
-        line_ptr = &line[xconfig[uplvl].bbd_jump[n]];
-
-        rad_rate = (a21 (line_ptr) * p_escape (line_ptr, xplasma));
-        coll_rate = ne * q21 (line_ptr, t_e);
-
-
-        bb_cont = rad_rate + coll_rate;
-        jprbs_known[uplvl][m] = jprbs[m] = bb_cont * xconfig[line_ptr->nconfigl].ex;    //energy of lower state
-
-        eprbs_known[uplvl][m] = eprbs[m] = bb_cont * (xconfig[uplvl].ex - xconfig[line[xconfig[uplvl].bbd_jump[n]].nconfigl].ex);       //energy difference
-
-
-        pjnorm += jprbs[m];
-        penorm += eprbs[m];
-        m++;
-      }
-
-      /* bf */
-      for (n = 0; n < nbfd; n++)
-      {
-
-        cont_ptr = &phot_top[xconfig[uplvl].bfd_jump[n]];       //pointer to continuum
-
-        sp_rec_rate = mplasma->recomb_sp[xconfig[uplvl].bfd_indx_first + n];
-        bf_cont = (sp_rec_rate + q_recomb (cont_ptr, t_e) * ne) * ne;
-
-        jprbs_known[uplvl][m] = jprbs[m] = bf_cont * xconfig[phot_top[xconfig[uplvl].bfd_jump[n]].nlev].ex;     //energy of lower state
-        eprbs_known[uplvl][m] = eprbs[m] = bf_cont * (xconfig[uplvl].ex - xconfig[phot_top[xconfig[uplvl].bfd_jump[n]].nlev].ex);       //energy difference
-        pjnorm += jprbs[m];
-        penorm += eprbs[m];
-        m++;
-      }
-
-      /* Auger ionization */
-      if (iauger >= 0)
-      {
-        auger_ptr = &auger_macro[iauger];
-
-        for (n = 0; n < nauger; n++)
-        {
-          target_level = auger_ptr->nconfig_target[n];
-          auger_rate = auger_ptr->Avalue_auger * auger_ptr->branching_ratio[n];
-
-          jprbs_known[uplvl][m] = jprbs[m] = auger_rate * xconfig[target_level].ex;     //energy of lower state
-          eprbs_known[uplvl][m] = eprbs[m] = auger_rate * (xconfig[uplvl].ex - xconfig[target_level].ex);       //energy difference
-
-          pjnorm += jprbs[m];
-          penorm += eprbs[m];
-          m++;
-        }
-      }
-
-      /* Now upwards jumps. */
-
-      /* bb */
-      /* For bound-bound excitation the jump probability is B-coeff times Jbar with a correction
-         for stimulated emission. To avoid the need for recalculation all the time, the code will
-         be designed to include the stimulated correction in Jbar - i.e. the stimulated correction
-         factor will NOT be included here. (SS) */
-      /* There is no emission probability for upwards transitions. */
-      /* Collisional contribution to jumping probability added. (SS,Apr04) */
-
-      for (n = 0; n < nbbu; n++)
-      {
-        line_ptr = &line[xconfig[uplvl].bbu_jump[n]];
-        rad_rate = (b12 (line_ptr) * mplasma->jbar_old[xconfig[uplvl].bbu_indx_first + n]);
-
-        coll_rate = ne * q12 (line_ptr, t_e);   // this is multiplied by ne below
-
-
-        jprbs_known[uplvl][m] = jprbs[m] = (rad_rate + coll_rate) * xconfig[uplvl].ex;  //energy of lower state
-
-
-        pjnorm += jprbs[m];
-        m++;
-      }
-
-      /* bf */
-      for (n = 0; n < nbfu; n++)
+      jumps = matom_jump_table (xplasma, uplvl);
+      pjnorm = jumps->pjnorm;
+      penorm = jumps->penorm;
+    }
+    else
+    {
+      if (prbs_known[uplvl] == FALSE)
       {
-        /* For bf ionization the jump probability is just gamma * energy
-           gamma is the photoionisation rate. Stimulated recombination also included. */
-        cont_ptr = &phot_top[xconfig[uplvl].bfu_jump[n]];       //pointer to continuum
-
-        /* first let us take care of the situation where the lower level is zero or close to zero */
-        lower_density = den_config (xplasma, cont_ptr->nlev);
-        if (lower_density >= DENSITY_PHOT_MIN)
-        {
-          density_ratio = den_config (xplasma, cont_ptr->uplev) / lower_density;
-        }
-        else
-          density_ratio = 0.0;
-
-        jprbs_known[uplvl][m] = jprbs[m] = (mplasma->gamma_old[xconfig[uplvl].bfu_indx_first + n] - (mplasma->alpha_st_old[xconfig[uplvl].bfu_indx_first + n] * xplasma->ne * density_ratio) + (q_ioniz (cont_ptr, t_e) * ne)) * xconfig[uplvl].ex;     //energy of lower state
-
-        /* this error condition can happen in unconverged hot cells where T_R >> T_E.
-           for the moment we set to 0 and hope spontaneous recombiantion takes care of things */
-        /* note that we check and report this in check_stimulated_recomb() in estimators.c once a cycle */
-        if (jprbs[m] < 0.)      //test (can be deleted eventually SS)
-        {
-          //Error ("Negative probability (matom, 6). Abort?\n");
-          jprbs_known[uplvl][m] = jprbs[m] = 0.0;
-
-        }
-        pjnorm += jprbs[m];
-        m++;
+        matom_jump_prbs (xplasma, uplvl, &jprbs_known[uplvl * matom_known_stride], &eprbs_known[uplvl * matom_known_stride],
+                         &pjnorm_known[uplvl], &penorm_known[uplvl]);
+        prbs_known[uplvl] = TRUE;
       }
-
-      pjnorm_known[uplvl] = pjnorm;
-      penorm_known[uplvl] = penorm;
-      prbs_known[uplvl] = TRUE;
-
+      pjnorm = pjnorm_known[uplvl];
+      penorm = penorm_known[uplvl];
     }
 
 
-    if ((pjnorm_known[uplvl] + penorm_known[uplvl]) <= 0.0)
+    if ((pjnorm + penorm) <= 0.0)
     {
-      Error ("matom: macro atom level has no way out: uplvl %d pj %g pe %g t_e %.3g  ne %.3g\n", uplvl, pjnorm_known[uplvl],
-             penorm_known[uplvl], t_e, ne);
+      Error ("matom: macro atom level has no way out: uplvl %d pj %g pe %g t_e %.3g  ne %.3g\n", uplvl, pjnorm, penorm, t_e, ne);
       Error ("matom: macro atom level has no way out: z %d istate %d nion %d ilv %d nbfu %d nbfd %d nbbu %d nbbd %d\n", xconfig[uplvl].z,
              xconfig[uplvl].istate, xconfig[uplvl].nion, xconfig[uplvl].ilv, nbfu, nbfd, nbbu, nbbd);
       *escape = TRUE;
@@ -324,30 +454,38 @@ matom (p, nres, escape)
 
 
     threshold = random_number (0.0, 1.0);
-    if (((pjnorm_known[uplvl] / (pjnorm_known[uplvl] + penorm_known[uplvl])) < threshold) || (pjnorm_known[uplvl] == 0))
+    if (((pjnorm / (pjnorm + penorm)) < threshold) || (pjnorm == 0))
       break;                    // A deactivation of the macro-atom has occurred and so we leave the for loop.
 
     /* Othewise, a transition/jump to another state of the macro-atom has occurred, so we need
-       to decide what the new state is. We use a running total to decide the new upper level */
+       to decide what the new state is. We use a running total to decide the new upper level,
+       or the alias tables if --matom-tables is set */
 
     uplvl_old = uplvl;
 
-    threshold = random_number (0.0, 1.0);
-    threshold = threshold * pjnorm_known[uplvl_old];
-
-    n = 0;
-    run_tot = 0;
-    while (run_tot < threshold)
+    if (modes.matom_tables)
     {
-      run_tot += jprbs_known[uplvl_old][n];
-      n++;
+      n = matom_jump_choose (jumps);
     }
-    /* This added to prevent case where threshold is essentially 0.
-     */
-
-    if (n > 0)
+    else
     {
-      n = n - 1;
+      threshold = random_number (0.0, 1.0);
+      threshold = threshold * pjnorm_known[uplvl_old];
+
+      n = 0;
+      run_tot = 0;
+      while (run_tot < threshold)
+      {
+        run_tot += jprbs_known[uplvl_old * matom_known_stride + n];
+        n++;
+      }
+      /* This added to prevent case where threshold is essentially 0.
+       */
+
+      if (n > 0)
+      {
+        n = n - 1;
+      }
     }
 
     /* n now identifies the jump that occurs - now set the new level. */
@@ -386,7 +524,7 @@ matom (p, nres, escape)
   if (njumps == MAXJUMPS)
   {
     Error ("Matom: jumped %d times with no emission for photon %d from upper level %d  pjnorm %e penorm %e Abort.\n", MAXJUMPS, p->np,
-           uplvl, pjnorm_known[uplvl], penorm_known[uplvl]);
+           uplvl, pjnorm, penorm);
     *escape = TRUE;
     p->istat = P_ERROR_MATOM;
     return (-1);
@@ -398,19 +536,26 @@ matom (p, nres, escape)
    * by which the macro actom deactivates.
    */
 
-  run_tot = 0;
-  n = 0;
+  if (modes.matom_tables)
+  {
+    n = matom_emit_choose (jumps);
+  }
+  else
+  {
+    run_tot = 0;
+    n = 0;
 
-  threshold = random_number (0.0, 1.0);
+    threshold = random_number (0.0, 1.0);
 
-  threshold = threshold * penorm_known[uplvl];  //normalise to total emission prob.
+    threshold = threshold * penorm_known[uplvl];        //normalise to total emission prob.
 
-  while (run_tot < threshold)
-  {
-    run_tot += eprbs_known[uplvl][n];
-    n++;
+    while (run_tot < threshold)
+    {
+      run_tot += eprbs_known[uplvl * matom_known_stride + n];
+      n++;
+    }
+    n = n - 1;
   }
-  n = n - 1;
   /* n now identifies the jump that occurs - now set nres for the return value. */
   if (n < nbbd)
   {                             /* bb downwards jump */
@@ -501,8 +646,8 @@ matom (p, nres, escape)
 
 #define B12_CONSTANT 5.01983e25
 
-struct lines *b12_line_ptr;
-double b12_a;
+THREAD_LOCAL struct lines *b12_line_ptr;
+THREAD_LOCAL double b12_a;
 
 double
 b12 (line_ptr)
@@ -525,9 +670,9 @@ b12 (line_ptr)
    following external structures are used (SS)*/
 /* This relates to the alpha_sp routines at the end of this file */
 
-struct topbase_phot *cont_ext_ptr;      //continuum pointer passed externally
-double temp_ext;                //temperature passed externally
-int temp_choice;                //choice of type of calcualation for alpha_sp
+THREAD_LOCAL struct topbase_phot *cont_ext_ptr; //continuum pointer passed externally
+THREAD_LOCAL double temp_ext;   //temperature passed externally
+THREAD_LOCAL int temp_choice;   //choice of type of calcualation for alpha_sp
 
 /*****************************************************************************/
 
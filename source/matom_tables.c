@@ -0,0 +1,386 @@
+/***********************************************************/
+/** @file  matom_tables.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Tables of the jump and emission probabilities of each level
+ * of the macro atoms in each cell
+ *
+ * matom calculates the probabilities of all the jumps from, and the
+ * emission by, each level it visits, and chooses one with a running
+ * total.  By default the probabilities are only kept until the packet
+ * moves to another cell or element.
+ *
+ * If the --matom-tables switch is given, the probabilities for each
+ * level in each cell are instead saved, for the rest of the cycle, as
+ * Walker alias tables, from which a jump can be chosen in a time which
+ * does not depend on the number of jumps.  The probabilities only depend
+ * on the properties of the plasma, which do not change during a cycle,
+ * so the jumps chosen do not depend on the order in which photons are
+ * transported.
+ *
+ * Each thread has its own tables, so no locking is needed.  The memory
+ * used by the tables of each thread is limited to its share of
+ * modes.matom_tables_mb; when this is exceeded, the tables which were
+ * used least recently are discarded, and recreated if they are needed
+ * again.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+THREAD_LOCAL MatomJumpsPtr **jump_cells = NULL; /* The tables for each plasma cell and level, or NULL */
+THREAD_LOCAL int jump_ncells = 0;       /* The number of plasma cells for which jump_cells is allocated */
+THREAD_LOCAL MatomJumpsPtr jump_newest = NULL;  /* The most recently used table */
+THREAD_LOCAL MatomJumpsPtr jump_oldest = NULL;  /* The least recently used table */
+THREAD_LOCAL double jump_bytes = 0.0;   /* The memory used by the tables */
+THREAD_LOCAL int jump_cycle = -1;       /* The ionization cycle for which the tables were created */
+THREAD_LOCAL long jump_nbuilt = 0;      /* The number of tables created in this cycle */
+THREAD_LOCAL long jump_nevict = 0;      /* The number of tables discarded in this cycle */
+
+
+
+/**********************************************************/
+/**
+ * @brief      create an alias table
+ *
+ * @param [in] double *  w   The (unnormalized) probabilities
+ * @param [in] int  n   The number of probabilities
+ * @param [out] double *  prob   The probability of keeping each entry
+ * @param [out] int *  alias   The alternative to each entry
+ * @param [in] int *  work   Space for 2 n integers
+ * @return     Always returns 0
+ *
+ * @details
+ * This is Vose's version of Walker's alias method.  Entry i is chosen by
+ * drawing i uniformly from 0 to n-1, and then keeping i with probability
+ * prob[i], or taking alias[i] otherwise.
+ *
+ **********************************************************/
+
+static int
+alias_create (double *w, int n, double *prob, int *alias, int *work)
+{
+  int *small, *large;
+  int nsmall, nlarge, i, s, l;
+  double sum;
+
+  small = work;
+  large = work + n;
+
+  sum = 0.0;
+  for (i = 0; i < n; i++)
+    sum += w[i];
+
+  nsmall = nlarge = 0;
+  for (i = 0; i < n; i++)
+  {
+    prob[i] = sum > 0.0 ? w[i] * n / sum : 1.0;
+    alias[i] = i;
+    if (prob[i] < 1.0)
+      small[nsmall++] = i;
+    else
+      large[nlarge++] = i;
+  }
+
+  while (nsmall > 0 && nlarge > 0)
+  {
+    s = small[--nsmall];
+    l = large[--nlarge];
+    alias[s] = l;
+    prob[l] += prob[s] - 1.0;
+    if (prob[l] < 1.0)
+      small[nsmall++] = l;
+    else
+      large[nlarge++] = l;
+  }
+
+  /* What remains is 1 apart from rounding errors */
+
+  while (nlarge > 0)
+    prob[large[--nlarge]] = 1.0;
+  while (nsmall > 0)
+    prob[small[--nsmall]] = 1.0;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      choose an entry from an alias table
+ *
+ * @param [in] double *  prob   The probability of keeping each entry
+ * @param [in] int *  alias   The alternative to each entry
+ * @param [in] int  n   The number of entries
+ * @return     The entry chosen
+ *
+ **********************************************************/
+
+static int
+alias_choose (double *prob, int *alias, int n)
+{
+  double r;
+  int i;
+
+  r = random_number (0.0, 1.0) * n;
+  i = (int) r;
+  if (i >= n)
+    i = n - 1;
+
+  return ((r - i) < prob[i] ? i : alias[i]);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      remove a table from the list of tables in order of use
+ *
+ **********************************************************/
+
+static void
+jump_unlink (MatomJumpsPtr jumps)
+{
+  if (jumps->newer != NULL)
+    jumps->newer->older = jumps->older;
+  else
+    jump_newest = jumps->older;
+
+  if (jumps->older != NULL)
+    jumps->older->newer = jumps->newer;
+  else
+    jump_oldest = jumps->newer;
+
+  jumps->newer = jumps->older = NULL;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      add a table to the head of the list of tables in order of use
+ *
+ **********************************************************/
+
+static void
+jump_push (MatomJumpsPtr jumps)
+{
+  jumps->older = jump_newest;
+  jumps->newer = NULL;
+  if (jump_newest != NULL)
+    jump_newest->newer = jumps;
+  jump_newest = jumps;
+  if (jump_oldest == NULL)
+    jump_oldest = jumps;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      discard a table
+ *
+ **********************************************************/
+
+static void
+jump_discard (MatomJumpsPtr jumps)
+{
+  jump_unlink (jumps);
+  jump_cells[jumps->nplasma][jumps->uplvl] = NULL;
+  jump_bytes -= jumps->nbytes;
+  free (jumps);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      get the table of jump and emission probabilities for a level
+ * of a macro atom in a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell
+ * @param [in] int  uplvl   The level
+ * @return     The table
+ *
+ * @details
+ * The table is created if it does not already exist.  All the tables of
+ * the thread are discarded at the start of each ionization cycle, and the
+ * least recently used tables are discarded when they use more memory than
+ * the thread's share of modes.matom_tables_mb.
+ *
+ **********************************************************/
+
+MatomJumpsPtr
+matom_jump_table (PlasmaPtr xplasma, int uplvl)
+{
+  MatomJumpsPtr jumps;
+  double jprbs[2 * (NBBJUMPS + NBFJUMPS)];
+  double eprbs[2 * (NBBJUMPS + NBFJUMPS)];
+  double pjnorm, penorm;
+  int work[4 * (NBBJUMPS + NBFJUMPS)];
+  int njump, nemit, nplasma, nthreads;
+  size_t nbytes;
+  char *block;
+
+  nplasma = xplasma->nplasma;
+
+  if (geo.wcycle != jump_cycle || jump_ncells != NPLASMA)
+  {
+    matom_jump_free ();
+    if ((jump_cells = calloc (NPLASMA, sizeof (MatomJumpsPtr *))) == NULL)
+    {
+      Error ("matom_jump_table: Unable to allocate memory for %d cells\n", NPLASMA);
+      Exit (0);
+    }
+    jump_ncells = NPLASMA;
+    jump_cycle = geo.wcycle;
+  }
+
+  if (jump_cells[nplasma] == NULL)
+  {
+    if ((jump_cells[nplasma] = calloc (nlevels_macro, sizeof (MatomJumpsPtr))) == NULL)
+    {
+      Error ("matom_jump_table: Unable to allocate memory for %d levels\n", nlevels_macro);
+      Exit (0);
+    }
+  }
+
+  if ((jumps = jump_cells[nplasma][uplvl]) != NULL)
+  {
+    if (jumps != jump_newest)
+    {
+      jump_unlink (jumps);
+      jump_push (jumps);
+    }
+    return (jumps);
+  }
+
+  /* Calculate the probabilities, and store them as alias tables in a single block */
+
+  njump = matom_jump_prbs (xplasma, uplvl, jprbs, eprbs, &pjnorm, &penorm);
+  nemit = xconfig[uplvl].n_bbd_jump + xconfig[uplvl].n_bfd_jump + xconfig[uplvl].nauger;
+
+  nbytes = sizeof (matom_jumps_dummy) + (njump + nemit) * (sizeof (double) + sizeof (int));
+  if ((block = malloc (nbytes)) == NULL)
+  {
+    Error ("matom_jump_table: Unable to allocate memory for level %d in cell %d\n", uplvl, nplasma);
+    Exit (0);
+  }
+
+  jumps = (MatomJumpsPtr) block;
+  jumps->nplasma = nplasma;
+  jumps->uplvl = uplvl;
+  jumps->njump = njump;
+  jumps->nemit = nemit;
+  jumps->pjnorm = pjnorm;
+  jumps->penorm = penorm;
+  jumps->nbytes = nbytes;
+  jumps->jprob = (double *) (block + sizeof (matom_jumps_dummy));
+  jumps->eprob = jumps->jprob + njump;
+  jumps->jalias = (int *) (jumps->eprob + nemit);
+  jumps->ealias = jumps->jalias + njump;
+
+  alias_create (jprbs, njump, jumps->jprob, jumps->jalias, work);
+  alias_create (eprbs, nemit, jumps->eprob, jumps->ealias, work);
+
+  jump_cells[nplasma][uplvl] = jumps;
+  jump_push (jumps);
+  jump_bytes += nbytes;
+  jump_nbuilt++;
+
+  /* Discard the least recently used tables if this thread is over budget */
+
+  nthreads = modes.nthreads > 1 ? modes.nthreads : 1;
+  while (jump_bytes > modes.matom_tables_mb * 1024. * 1024. / nthreads && jump_oldest != jumps)
+  {
+    jump_discard (jump_oldest);
+    jump_nevict++;
+  }
+
+  return (jumps);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      choose a jump from a level of a macro atom
+ *
+ * @param [in] MatomJumpsPtr  jumps   The table for the level
+ * @return     The index of the jump, in the order used by matom_jump_prbs
+ *
+ **********************************************************/
+
+int
+matom_jump_choose (MatomJumpsPtr jumps)
+{
+  return (alias_choose (jumps->jprob, jumps->jalias, jumps->njump));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      choose the process by which a macro atom deactivates from a level
+ *
+ * @param [in] MatomJumpsPtr  jumps   The table for the level
+ * @return     The index of the downward jump, in the order used by matom_jump_prbs
+ *
+ **********************************************************/
+
+int
+matom_emit_choose (MatomJumpsPtr jumps)
+{
+  return (alias_choose (jumps->eprob, jumps->ealias, jumps->nemit));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      discard all the tables of the calling thread
+ *
+ * @return     The number of tables discarded
+ *
+ **********************************************************/
+
+int
+matom_jump_free (void)
+{
+  int n, i;
+
+  if (jump_nbuilt > 0)
+  {
+    Log_silent ("matom_jump_free: Created %ld macro-atom jump tables in cycle %d, of which %ld were discarded to save memory\n",
+                jump_nbuilt, jump_cycle, jump_nevict);
+  }
+
+  n = 0;
+  while (jump_oldest != NULL)
+  {
+    jump_discard (jump_oldest);
+    n++;
+  }
+
+  if (jump_cells != NULL)
+  {
+    for (i = 0; i < jump_ncells; i++)
+      free (jump_cells[i]);
+    free (jump_cells);
+  }
+
+  jump_cells = NULL;
+  jump_ncells = 0;
+  jump_bytes = 0.0;
+  jump_nbuilt = jump_nevict = 0;
+  jump_cycle = -1;
+
+  return (n);
+}
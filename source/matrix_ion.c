@@ -17,6 +17,94 @@
 #include "atomic.h"
 #include "sirocco.h"
 
+/* Work space for matrix_ion_populations.  This is allocated on the heap,
+   rather than the stack, which can overflow when there are many ions, and
+   is kept from one call to the next */
+
+THREAD_LOCAL int ion_work_nions = -1;   /* The number of ions for which the work space was allocated */
+THREAD_LOCAL double *ion_pi_rates = NULL;       /* photoionization rate coefficients */
+THREAD_LOCAL double *ion_rr_rates = NULL;       /* radiative recombination rate coefficients */
+THREAD_LOCAL double *ion_inner_rates = NULL;    /* inner shell ionization rates */
+THREAD_LOCAL double *ion_populations = NULL;    /* the solution of the rate equations */
+THREAD_LOCAL double *ion_block_a = NULL;        /* the rate matrix of one element */
+THREAD_LOCAL double *ion_block_b = NULL;        /* the right hand side for one element */
+
+
+
+/**********************************************************/
+/**
+ * @brief      allocate the work space used by matrix_ion_populations
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * The rate matrix is block diagonal, since no process changes one element
+ * into another, so only space for the block of the element with the most
+ * ions is needed.
+ *
+ **********************************************************/
+
+static int
+matrix_ion_work ()
+{
+  int n, nmax;
+
+  if (ion_work_nions == nions)
+    return (0);
+
+  matrix_ion_free ();
+
+  nmax = 1;
+  for (n = 0; n < nelements; n++)
+  {
+    if (ele[n].nions > nmax)
+      nmax = ele[n].nions;
+  }
+
+  ion_pi_rates = calloc (nions, sizeof (double));
+  ion_rr_rates = calloc (nions, sizeof (double));
+  ion_inner_rates = calloc (n_inner_tot > 0 ? n_inner_tot : 1, sizeof (double));
+  ion_populations = calloc (nions, sizeof (double));
+  ion_block_a = calloc (nmax * nmax, sizeof (double));
+  ion_block_b = calloc (nmax, sizeof (double));
+
+  if (ion_pi_rates == NULL || ion_rr_rates == NULL || ion_inner_rates == NULL || ion_populations == NULL || ion_block_a == NULL
+      || ion_block_b == NULL)
+  {
+    Error ("matrix_ion_work: Unable to allocate memory for %d ions\n", nions);
+    Exit (0);
+  }
+
+  ion_work_nions = nions;
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      release the work space used by matrix_ion_populations
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+matrix_ion_free ()
+{
+  free (ion_pi_rates);
+  free (ion_rr_rates);
+  free (ion_inner_rates);
+  free (ion_populations);
+  free (ion_block_a);
+  free (ion_block_b);
+
+  ion_pi_rates = ion_rr_rates = ion_inner_rates = ion_populations = ion_block_a = ion_block_b = NULL;
+  ion_work_nions = -1;
+
+  return (0);
+}
+
 
 /**********************************************************/
 /**
@@ -58,24 +146,25 @@ matrix_ion_populations (xplasma, mode)
 
 {
   double elem_dens[NELEMENTS];  //The density of each element
-  int nn, mm, nrows;
-  double rate_matrix[nions][nions];     //The rate matrix that we are going to try and solve
+  int nn, mm, nrows, nelem;
   double newden[NIONS];         //A temporary array to hold our intermediate solutions
   double nh, nh1, nh2, t_e;
   double xne, xxne, xxxne;      //Various stores for intermediate guesses at electron density
-  double b_temp[nions];         //The b matrix
-  double *b_data, *a_data;      //These arrays are allocated later and sent to the matrix solver
-  double *populations;          //This array is allocated later and is retrieved from the matrix solver
-  int matrix_err, niterate;     //counters for errors and the number of iterations we have tried to get a converged electron density
+  double *populations;          //The solution of the matrix equations for all the elements
+  int matrix_err, block_err, niterate;  //counters for errors and the number of iterations we have tried to get a converged electron density
   double xnew;
-  int xion[nions];              // This array keeps track of what ion is in each line
-//OLD  int xelem[nions];             // This array keeps track of the element for each ion
-  double pi_rates[nions];       //photoionization rate coefficients
-  double rr_rates[nions];       //radiative recombination rate coefficients
-  double inner_rates[n_inner_tot];      //This array contains the rates for each of the inner shells. Where they go to requires the electron yield array
+  double *pi_rates;             //photoionization rate coefficients
+  double *rr_rates;             //radiative recombination rate coefficients
+  double *inner_rates;          //This array contains the rates for each of the inner shells. Where they go to requires the electron yield array
 
   nh1 = nh2 = 0;
 
+  matrix_ion_work ();
+  pi_rates = ion_pi_rates;
+  rr_rates = ion_rr_rates;
+  inner_rates = ion_inner_rates;
+  populations = ion_populations;
+
   /* Copy some quantities from the cell into local variables */
 
   nh = xplasma->rho * rho2nh;   // The number density of hydrogen ions - computed from density
@@ -100,10 +189,17 @@ matrix_ion_populations (xplasma, mode)
      charge_exchange rate coefficients depend only on electron temperature, calculate them now -
      they will not change they are all stored in global arrays */
 
-  compute_dr_coeffs (t_e);
-  compute_di_coeffs (t_e);
-  compute_qrecomb_coeffs (t_e);
-  compute_ch_ex_coeffs (t_e);
+  if (modes.rate_table)
+  {
+    rate_table_coeffs (t_e, rr_rates);  // This also sets the radiative recombination rates
+  }
+  else
+  {
+    compute_dr_coeffs (t_e);
+    compute_di_coeffs (t_e);
+    compute_qrecomb_coeffs (t_e);
+    compute_ch_ex_coeffs (t_e);
+  }
 
   /* In the following loop, over all ions in the simulation, we compute the radiative recombination rates, and photionization
      rates OUT OF each ionization stage. The PI rates are calculated either using the modelled mean intensity in a cell, or
@@ -114,8 +210,7 @@ matrix_ion_populations (xplasma, mode)
   for (mm = 0; mm < nions; mm++)
   {
     newden[mm] = xplasma->density[mm] / elem_dens[ion[mm].z];   // newden is our local fractional density array
-    xion[mm] = mm;              // xion is an array we use to track which ion is in which row of the matrix
-    if (mm != ele[ion[mm].nelem].firstion)      // We can recombine since we are not in the first ionization stage
+    if (mm != ele[ion[mm].nelem].firstion && modes.rate_table == FALSE) // We can recombine since we are not in the first ionization stage
     {
       rr_rates[mm] = total_rrate (mm, xplasma->t_e);    // radiative recombination rates
     }
@@ -238,55 +333,32 @@ matrix_ion_populations (xplasma, mode)
     }
 
 
-    populate_ion_rate_matrix (rate_matrix, pi_rates, inner_rates, rr_rates, b_temp, xne, nh1, nh2);
-
-
-    /* The array is now fully populated, and we can begin the process of solving it */
-
-    nrows = nions;              /* This is a placeholder, we may end up removing rows and columns that have no rates (or very
-                                   low rates) connecting them to other rows. This may improve stability but will need to be
-                                   done carefully */
+    /* The rate matrix is block diagonal, since ions are only linked to other ions of the same element,
+       so we populate and solve the matrix equation M x = b for each element in turn, where x is our vector
+       containing the populations of each ion as a fraction w.r.t the whole element.  The actual LU
+       decomposition - the process of obtaining a solution - is done by the routine solve_matrix() */
 
-    /* Here we solve the matrix equation M x = b, where x is our vector containing level populations as a fraction w.r.t the
-       whole element. The actual LU decomposition- the process of obtaining a solution - is done by the routine solve_matrix() */
-
-    a_data = (double *) calloc (sizeof (double), nrows * nrows);
-    populations = (double *) calloc (nrows, sizeof (double));
+    matrix_err = 0;
+    for (nelem = 0; nelem < nelements; nelem++)
+    {
+      nrows = ele[nelem].nions;
+      if (nrows < 1)
+        continue;
 
-    /* This b_data column matrix is the total number density for each element, placed into the row which relates to the neutral
-       ion. This matches the row in the rate matrix which is just 1 1 1 1 for all stages. NB, we could have chosen any line for
-       this. */
+      populate_ion_rate_block (nelem, ion_block_a, ion_block_b, pi_rates, inner_rates, rr_rates, xne, nh1, nh2);
 
-    b_data = (double *) calloc (nrows, sizeof (double));
+      block_err = solve_matrix (ion_block_a, ion_block_b, nrows, &populations[ele[nelem].firstion], xplasma->nplasma);
 
-    /* We now copy our rate matrix into the prepared matrix */
-    for (mm = 0; mm < nrows; mm++)
-    {
-      for (nn = 0; nn < nrows; nn++)
+      if (block_err)
       {
-        a_data[mm * nrows + nn] = rate_matrix[mm][nn];  /* row-major */
+        Error ("matrix_ion_populations: %s (element %d)\n", get_matrix_error_string (block_err), ele[nelem].z);
+        if (block_err > matrix_err)
+          matrix_err = block_err;
       }
     }
 
-    for (nn = 0; nn < nrows; nn++)
-    {
-      b_data[nn] = b_temp[nn];
-    }
-
-    matrix_err = solve_matrix (a_data, b_data, nrows, populations, xplasma->nplasma);
-
-    if (matrix_err)
-    {
-      Error ("matrix_ion_populations: %s\n", get_matrix_error_string (matrix_err));
-    }
-
-    /* free memory */
-    free (a_data);
-    free (b_data);
-
     if (matrix_err == 4)
     {
-      free (populations);
       return (-1);
     }
 
@@ -317,23 +389,15 @@ matrix_ion_populations (xplasma, mode)
         newden[nn] = xplasma->density[nn] / elem_dens[ion[nn].z];
       }
 
-      /* if the ion is "simple" then find it's calculated ionization state in populations array */
+      /* if the ion is "simple" then take its calculated ionization state from the populations array */
       else
       {
-
-        for (mm = 0; mm < nrows; mm++)  // inner loop over the elements of the population array
-        {
-          if (xion[mm] == nn)   // if this element contains the population of the ion is question
-          {
-            newden[nn] = populations[mm];       // get the population
-          }
-        }
+        newden[nn] = populations[nn];
       }
 
       if (newden[nn] < DENSITY_MIN)     // this wil also capture the case where population doesnt have a value for this ion
         newden[nn] = DENSITY_MIN;
     }
-    free (populations);
 
 
 /* We need to get the 'true' new electron density so we need to do a little loop here to compute it */
@@ -417,54 +481,62 @@ matrix_ion_populations (xplasma, mode)
 
 /**********************************************************/
 /**
- * @brief      populates a rate_matrix
+ * @brief      populates the rate matrix for one element
  *
- * @param [out] double  rate_matrix[nions][nions] - the rate matrix that will be filled by this array
+ * @param [in] int  nelem - the element
+ * @param [out] double  *a - the rate matrix for the ions of the element, row-major
+ * @param [out] double  *b - the right hand side of the matrix equation
  * @param [in] double  pi_rates[nions] - vector of photionization rates
  * @param [in] double  inner_rates[n_inner_tot] - vector of inner shell photoionization rates
  * @param [in] double  rr_rates[nions] - vector of radiative recobination rates
- * @param [out] double  b_temp[nions] - the vector of total elemental densities that we also fill here
  * @param [in] double  xne - current electron density
  * @param [in] double  nh1 - current neutral hydrogen density
  * @param [in] double  nh2 - current ionized hydrogen density
  * @return - zero if successful
  *
  * @details
- * populate_ion_rate_matrix populates a rate_matrix of shape nions x nions
- * with the pi_rates and rr_rates supplied at the density xne in question.
- * It also populates the b matrix - that is the total elemental abundance -
- * we use relative abundances so this is just a set of 1s and 0s.
+ * populate_ion_rate_block populates a rate matrix of shape n x n, where n
+ * is the number of ions of the element, with the pi_rates and rr_rates
+ * supplied at the density xne in question.  Row and column i refer to ion
+ * ele[nelem].firstion + i.  It also populates the b matrix - that is the
+ * total elemental abundance - we use relative abundances so this is just a
+ * 1 followed by 0s.
  *
  * ### Notes ###
  * This routine includes the process of replacing the first row of the matrix with
  *     1s in order to make the problem soluble.
  *
+ * No process links the ions of different elements, so the rate matrix for
+ * all of the ions is block diagonal, and each element can be solved for separately.
+ * The rates are added in the same order as they were when the matrix for all
+ * of the ions was populated at once.
+ *
  **********************************************************/
 
 int
-populate_ion_rate_matrix (rate_matrix, pi_rates, inner_rates, rr_rates, b_temp, xne, nh1, nh2)
-     double rate_matrix[nions][nions];
-     double pi_rates[nions];
-     double inner_rates[n_inner_tot];
-     double rr_rates[nions];
+populate_ion_rate_block (nelem, a, b, pi_rates, inner_rates, rr_rates, xne, nh1, nh2)
+     int nelem;
+     double *a, *b;
+     double *pi_rates;
+     double *inner_rates;
+     double *rr_rates;
      double xne;
-     double b_temp[nions];
      double nh1, nh2;
 
 {
-//  int nn, mm, zcount;
-  int nn, mm;
+  int nn, mm, n, first, last;
   int n_elec, d_elec, ion_out;  //The number of electrons left in a current ion
 
+  first = ele[nelem].firstion;
+  n = ele[nelem].nions;
+  last = first + n - 1;
 
+#define A(row,col)  a[((row) - first) * n + ((col) - first)]
 
   /* First we initialise the matrix */
-  for (nn = 0; nn < nions; nn++)
+  for (nn = 0; nn < n * n; nn++)
   {
-    for (mm = 0; mm < nions; mm++)
-    {
-      rate_matrix[nn][mm] = 0.0;
-    }
+    a[nn] = 0.0;
   }
 
 
@@ -474,115 +546,83 @@ populate_ion_rate_matrix (rate_matrix, pi_rates, inner_rates, rr_rates, b_temp,
 
   /* Now we populate the elements relating to PI depopulating a state */
 
-
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first; mm < last; mm++)     // all but the highest ionization state have electrons
   {
-    if (ion[mm].istate != ele[ion[mm].nelem].istate_max)        // we have electrons
-    {
-      rate_matrix[mm][mm] -= pi_rates[mm];
-    }
+    A (mm, mm) -= pi_rates[mm];
   }
 
-
   /* Now we populate the elements relating to PI populating a state */
 
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first + 1; mm <= last; mm++)
   {
-    for (nn = 0; nn < nions; nn++)
-    {
-
-      if (mm == nn + 1 && ion[nn].istate != ele[ion[nn].nelem].istate_max && ion[mm].z == ion[nn].z)
-      {
-        rate_matrix[mm][nn] += pi_rates[nn];
-      }
-    }
+    A (mm, mm - 1) += pi_rates[mm - 1];
   }
 
   /* Now we populate the elements relating to direct ionization depopulating a state */
 
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first; mm < last; mm++)
   {
-    if (ion[mm].istate != ele[ion[mm].nelem].istate_max && ion[mm].dere_di_flag > 0)    // we have electrons and a DI rate
+    if (ion[mm].dere_di_flag > 0)       // we have electrons and a DI rate
     {
-      rate_matrix[mm][mm] -= (xne * di_coeffs[mm]);
+      A (mm, mm) -= (xne * di_coeffs[mm]);
     }
   }
 
   /* Now we populate the elements relating to direct ionization populating a state - this does depend on the electron density */
 
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first + 1; mm <= last; mm++)
   {
-    for (nn = 0; nn < nions; nn++)
+    if (ion[mm - 1].dere_di_flag > 0)
     {
-      if (mm == nn + 1 && ion[nn].istate != ele[ion[nn].nelem].istate_max && ion[mm].z == ion[nn].z && ion[nn].dere_di_flag > 0)
-      {
-        rate_matrix[mm][nn] += (xne * di_coeffs[nn]);
-      }
+      A (mm, mm - 1) += (xne * di_coeffs[mm - 1]);
     }
   }
 
 
   /* Now we populate the elements relating to radiative recomb depopulating a state */
 
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first + 1; mm <= last; mm++)        // we have space for electrons
   {
-    if (mm != ele[ion[mm].nelem].firstion)      // we have space for electrons
-    {
-      rate_matrix[mm][mm] -= xne * (rr_rates[mm] + xne * qrecomb_coeffs[mm]);
-    }
+    A (mm, mm) -= xne * (rr_rates[mm] + xne * qrecomb_coeffs[mm]);
   }
 
 
   /* Now we populate the elements relating to radiative recomb populating a state */
 
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first; mm < last; mm++)
   {
-    for (nn = 0; nn < nions; nn++)
-    {
-      if (mm == nn - 1 && nn != ele[ion[nn].nelem].firstion && ion[mm].z == ion[nn].z)
-      {
-        rate_matrix[mm][nn] += xne * (rr_rates[nn] + xne * qrecomb_coeffs[nn]);
-      }
-    }
+    A (mm, mm + 1) += xne * (rr_rates[mm + 1] + xne * qrecomb_coeffs[mm + 1]);
   }
 
   /* Now we populate the elements relating to dielectronic recombination depopulating a state */
 
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first + 1; mm <= last; mm++)
   {
-    if (mm != ele[ion[mm].nelem].firstion && ion[mm].drflag > 0)        // we have space for electrons
+    if (ion[mm].drflag > 0)     // we have space for electrons
     {
-      rate_matrix[mm][mm] -= (xne * dr_coeffs[mm]);
+      A (mm, mm) -= (xne * dr_coeffs[mm]);
     }
   }
 
 
   /* Now we populate the elements relating to dielectronic recombination populating a state */
 
-
-
-  for (mm = 0; mm < nions; mm++)
+  for (mm = first; mm < last; mm++)
   {
-    for (nn = 0; nn < nions; nn++)
+    if (ion[mm].drflag > 0)
     {
-      if (mm == nn - 1 && nn != ele[ion[nn].nelem].firstion && ion[mm].z == ion[nn].z && ion[mm].drflag > 0)
-      {
-        rate_matrix[mm][nn] += (xne * dr_coeffs[nn]);
-      }
+      A (mm, mm + 1) += (xne * dr_coeffs[mm + 1]);
     }
   }
 
 
   /* Now we populate the elements relating to charge exchange recombination -  */
-  if (n_charge_exchange > 0)
+  if (n_charge_exchange > 0 && ele[nelem].z != 1)       //Only compute for helium and up
   {
-    for (mm = 0; mm < nions; mm++)      //This is a loop over ions - rates are computed for all ions.
+    for (mm = first + 1; mm <= last; mm++)      //This is a loop over ions - rates are computed for all ions but the neutral one
     {
-      if (ion[mm].z != 1 && ion[mm].istate != 0)        //Only compute for helium and up, and not for neutral species
-      {
-        rate_matrix[mm][mm] -= charge_exchange_recomb_rates[mm] * nh1;  //This is the depopulation
-        rate_matrix[mm - 1][mm] += charge_exchange_recomb_rates[mm] * nh1;      //This is the population
-      }
+      A (mm, mm) -= charge_exchange_recomb_rates[mm] * nh1;     //This is the depopulation
+      A (mm - 1, mm) += charge_exchange_recomb_rates[mm] * nh1; //This is the population
     }
   }
 
@@ -592,8 +632,10 @@ populate_ion_rate_matrix (rate_matrix, pi_rates, inner_rates, rr_rates, b_temp,
     if (ion[charge_exchange[mm].nion2].z == 1)  //A hydrogen recomb - metal ionization rate
     {
       ion_out = charge_exchange[mm].nion1;      //This is the ion that is being depopulated
-      rate_matrix[ion_out][ion_out] -= charge_exchange_ioniz_rates[mm] * nh2;   //This is the depopulation
-      rate_matrix[ion_out + 1][ion_out] += charge_exchange_ioniz_rates[mm] * nh2;       //This is the population
+      if (ion_out < first || ion_out >= last)
+        continue;
+      A (ion_out, ion_out) -= charge_exchange_ioniz_rates[mm] * nh2;    //This is the depopulation
+      A (ion_out + 1, ion_out) += charge_exchange_ioniz_rates[mm] * nh2;        //This is the population
     }
 
 
@@ -602,58 +644,36 @@ populate_ion_rate_matrix (rate_matrix, pi_rates, inner_rates, rr_rates, b_temp,
     if (inner_cross[mm].n_elec_yield != -1)     //we only want to treat ionization where we have info about the yield
     {
       ion_out = inner_cross[mm].nion;   //this is the ion which is being depopulated
+      if (ion_out < first || ion_out > last)
+        continue;
 
-      rate_matrix[ion_out][ion_out] -= inner_rates[mm]; //This is the depopulation
+      A (ion_out, ion_out) -= inner_rates[mm];  //This is the depopulation
       n_elec = ion[ion_out].z - ion[ion_out].istate + 1;
       if (n_elec > 11)
         n_elec = 11;
-      for (d_elec = 1; d_elec < n_elec; d_elec++)       //We do a loop over the number of remaining electrons
+      for (d_elec = 1; d_elec < n_elec && ion_out + d_elec <= last; d_elec++)   //We do a loop over the number of remaining electrons
       {
         nn = ion_out + d_elec;  //We will be populating a state d_elec stages higher
-        rate_matrix[nn][ion_out] += inner_rates[mm] * inner_elec_yield[inner_cross[mm].n_elec_yield].prob[d_elec - 1];
+        A (nn, ion_out) += inner_rates[mm] * inner_elec_yield[inner_cross[mm].n_elec_yield].prob[d_elec - 1];
       }
     }
   }
 
 
+  /* Now, we replace the first line with 1's. This is done because we actually have more equations than unknowns. This is
+     equivalent to the equation 1*n1+1*n2+1*n3 = n_total - i.e. the sum of all the partial number densities adds up to the
+     total number density for that element. This also produces the 'b matrix'. This is the right hand side of the matrix
+     equation, and represents the total number density for the element. In the relative abundance scheme this is 1 for the
+     row relating to the ground state, and 0 otherwise */
 
-
-
-  /* Now, we replace the first line for each element with 1's and 0's. This is done because we actually have more equations
-     than unknowns. We replace the array elements relating to each ion stage in this element with a 1, and all the other array
-     elements (which relate to other elements (in the chemicalsense) with zeros. This is equivalent to the equation
-     1*n1+1*n2+1*n3 = n_total - i.e. the sum of all the partial number densities adds up to the total number density for that
-     element. This loop also produces the 'b matrix'. This is the right hand side of the matrix equation, and represents the
-     total number density for each element. This can be a series of 1's for each row in the matrix relating to the ground
-     state of the repsective element, however one can just use the total number density for that elements and then the
-     densities which the solver computes are just the actual number densities for each ion. This does mean that different rows
-     are orders of magnitude different, so one can imagine numerical issues. However each element is essentially solved for
-     seperately.. Something to watch */
-//OLD  zcount = 0;
-  for (nn = 0; nn < nions; nn++)
+  for (mm = first; mm <= last; mm++)
   {
-    if (nn == ele[ion[nn].nelem].firstion)
-    {
-      b_temp[nn] = 1.0;         //In the relative abundance schene this equals one.
-
-      for (mm = 0; mm < nions; mm++)
-      {
-        if (ion[mm].z == ion[nn].z)
-        {
-          rate_matrix[nn][mm] = 1.0;
-        }
-        else
-        {
-          rate_matrix[nn][mm] = 0.0;
-        }
-      }
-    }
-    else
-    {
-      b_temp[nn] = 0.0;
-    }
+    A (first, mm) = 1.0;
+    b[mm - first] = 0.0;
   }
+  b[0] = 1.0;
 
+#undef A
 
   return (0);
 }
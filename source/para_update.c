@@ -60,6 +60,109 @@ get_parallel_nrange (int rank, int ntotal, int nproc, int *my_nmin, int *my_nmax
   return ndo;
 }
 
+struct task_cost
+{
+  double cost;
+  int n;
+};
+
+/**********************************************************/
+/**
+ * @brief   Order tasks so that the most expensive come first
+ **********************************************************/
+
+static int
+compare_task_cost (const void *a, const void *b)
+{
+  const struct task_cost *x = a, *y = b;
+
+  if (x->cost > y->cost)
+    return -1;
+  if (x->cost < y->cost)
+    return 1;
+  return x->n - y->n;
+}
+
+/**********************************************************/
+/**
+ * @brief helper routine for splitting up tasks of different cost in MPI
+ * @param   [in]   int      rank    processor rank (typically set from rank_global)
+ * @param   [in]   int      ntotal  total number of tasks, e.g. NPLASMA
+ * @param   [in]   int      nproc   total number of MPI processors
+ * @param   [in]   double  *cost    the estimated cost of each task, e.g. the time it took last time
+ * @param   [out]  int     *tasks   the tasks given to this rank, the most expensive first
+ * @return         int      ndo     number of tasks this rank is working on
+ *
+ * @details  The tasks are taken in order of decreasing cost, and each in turn
+ * is given to the rank which has the least work so far.  This keeps the ranks
+ * busy for similar times even when a few tasks, e.g. the dense cells at the
+ * base of a wind, take much longer than the rest.  If all of the costs are the
+ * same, the tasks are dealt out in turn, with rank 0 getting tasks 0, nproc,
+ * 2 nproc and so on.
+ *
+ * Each rank works out the whole division for itself, so every rank must call
+ * this with the same costs.  Ties are broken by the task and rank numbers, so
+ * the division does not depend on the order in which qsort leaves equal costs.
+ **********************************************************/
+
+int
+get_parallel_ncost (int rank, int ntotal, int nproc, double *cost, int *tasks)
+{
+  struct task_cost *order;
+  double *load;
+  int *heap;
+  int n, i, j, k, r, ndo;
+
+  order = calloc (ntotal + 1, sizeof (struct task_cost));
+  load = calloc (nproc, sizeof (double));
+  heap = calloc (nproc, sizeof (int));
+  if (order == NULL || load == NULL || heap == NULL)
+  {
+    Error ("get_parallel_ncost: Unable to allocate memory to divide %d tasks between %d ranks\n", ntotal, nproc);
+    Exit (EXIT_FAILURE);
+  }
+
+  for (n = 0; n < ntotal; n++)
+  {
+    order[n].cost = cost[n];
+    order[n].n = n;
+  }
+  qsort (order, ntotal, sizeof (struct task_cost), compare_task_cost);
+
+  /* heap is a binary heap of the ranks, with the rank with the least work at the top */
+
+  for (r = 0; r < nproc; r++)
+    heap[r] = r;
+
+  ndo = 0;
+  for (n = 0; n < ntotal; n++)
+  {
+    r = heap[0];
+    if (r == rank)
+      tasks[ndo++] = order[n].n;
+    load[r] += order[n].cost;
+
+    i = 0;
+    while ((j = 2 * i + 1) < nproc)
+    {
+      if (j + 1 < nproc && (load[heap[j + 1]] < load[heap[j]] || (load[heap[j + 1]] == load[heap[j]] && heap[j + 1] < heap[j])))
+        j++;
+      if (load[heap[j]] > load[r] || (load[heap[j]] == load[r] && heap[j] > r))
+        break;
+      k = heap[i];
+      heap[i] = heap[j];
+      heap[j] = k;
+      i = j;
+    }
+  }
+
+  free (heap);
+  free (load);
+  free (order);
+
+  return ndo;
+}
+
 /**********************************************************/
 /**
  * @brief  Get the max cells a rank will operate on
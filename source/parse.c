@@ -52,6 +52,7 @@ parse_command_line (argc, argv)
      char *argv[];
 {
   int restart_stat, verbosity, max_errors, i;
+  int nthreads;
   int j = 0;
   char dummy[LINELENGTH];
   int mkdir ();
@@ -222,6 +223,210 @@ parse_command_line (argc, argv)
         j = i;
         Log ("Using a persistent RNG state\n");
       }
+      else if (strcmp (argv[i], "--threads") == 0)
+      {
+        if (i + 1 >= argc || sscanf (argv[i + 1], "%d", &nthreads) != 1)
+        {
+          Error ("sirocco: Expected number of threads after --threads switch\n");
+          exit (1);
+        }
+        init_threads (nthreads);
+        i++;
+        j = i;
+        Log ("Using %d thread(s) for photon transport in each process\n", modes.nthreads);
+      }
+      else if (strcmp (argv[i], "--steal") == 0)
+      {
+        modes.steal_photons = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%d", &modes.nphot_batch) == 1)
+        {
+          i++;
+        }
+        else
+        {
+          modes.nphot_batch = 0;
+        }
+        j = i;
+        Log ("Scheduling batches of photons dynamically between processes\n");
+      }
+      else if (strcmp (argv[i], "--events") == 0)
+      {
+        modes.event_transport = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%d", &modes.nphot_event) == 1)
+        {
+          if (modes.nphot_event < 1)
+          {
+            Error ("sirocco: The number of photons in a batch must be at least 1\n");
+            exit (1);
+          }
+          i++;
+        }
+        j = i;
+        Log ("Using the event-based photon transport engine with batches of %d photons\n", modes.nphot_event);
+      }
+      else if (strcmp (argv[i], "--windsave-compress") == 0)
+      {
+        modes.windsave_compress = TRUE;
+        j = i;
+        Log ("Compressing the windsave files\n");
+      }
+      else if (strcmp (argv[i], "--bf-cache") == 0)
+      {
+        modes.bf_cache = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%le", &modes.bf_cache_mb) == 1)
+        {
+          if (modes.bf_cache_mb <= 0)
+          {
+            Error ("sirocco: The memory for the bound-free opacity tables must be positive\n");
+            exit (1);
+          }
+          i++;
+        }
+        j = i;
+        Log ("Tabulating bound-free opacities in each cell, using up to %.0f MB\n", modes.bf_cache_mb);
+      }
+      else if (strcmp (argv[i], "--prune-lines") == 0)
+      {
+        modes.prune_lines = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%le", &modes.prune_lines_mb) == 1)
+        {
+          if (modes.prune_lines_mb <= 0)
+          {
+            Error ("sirocco: The memory for the line lists must be positive\n");
+            exit (1);
+          }
+          i++;
+        }
+        j = i;
+        Log ("Considering only the lines which are significant in each cell, using up to %.0f MB\n", modes.prune_lines_mb);
+      }
+      else if (strcmp (argv[i], "--extract-batch") == 0)
+      {
+        modes.extract_batch = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%le", &modes.extract_tau_max) == 1)
+        {
+          if (modes.extract_tau_max <= 0)
+          {
+            Error ("sirocco: The optical depth at which extracted photons are abandoned must be positive\n");
+            exit (1);
+          }
+          i++;
+        }
+        j = i;
+        Log ("Extracting photons for all observers together, abandoning them at tau > %.1f\n", modes.extract_tau_max);
+      }
+      else if (strcmp (argv[i], "--matrix-storage") == 0)
+      {
+        if (i + 1 >= argc || sscanf (argv[i + 1], "%le", &modes.store_matom_matrix_mb) != 1 || modes.store_matom_matrix_mb < 0)
+        {
+          Error ("sirocco: Expected the memory for the macro-atom matrices in MB after --matrix-storage switch\n");
+          exit (1);
+        }
+        i++;
+        j = i;
+        Log ("Storing macro-atom matrices in at most %.0f MB\n", modes.store_matom_matrix_mb);
+      }
+      else if (strcmp (argv[i], "--matrix-tol") == 0)
+      {
+        if (i + 1 >= argc || sscanf (argv[i + 1], "%le", &modes.matom_matrix_tol) != 1 || modes.matom_matrix_tol < 0)
+        {
+          Error ("sirocco: Expected a non-negative tolerance after --matrix-tol switch\n");
+          exit (1);
+        }
+        i++;
+        j = i;
+        Log ("Reusing macro-atom matrices when the jump probabilities have changed by less than %g\n", modes.matom_matrix_tol);
+      }
+      else if (strcmp (argv[i], "--matrix-sparse") == 0)
+      {
+        modes.matom_matrix_sparse = TRUE;
+        j = i;
+        Log ("Inverting macro-atom matrices one element at a time\n");
+      }
+      else if (strcmp (argv[i], "--profile") == 0)
+      {
+        modes.profile = TRUE;
+        j = i;
+        Log ("Recording the time spent in each routine and cell, and writing it to the diag folder each cycle\n");
+      }
+      else if (strcmp (argv[i], "--compton-table") == 0)
+      {
+        modes.compton_table = TRUE;
+        j = i;
+        Log ("Sampling Compton scattering and thermal electron speeds from tables\n");
+      }
+      else if (strcmp (argv[i], "--matom-tables") == 0)
+      {
+        modes.matom_tables = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%le", &modes.matom_tables_mb) == 1)
+        {
+          if (modes.matom_tables_mb <= 0)
+          {
+            Error ("sirocco: The memory for the macro-atom jump tables must be positive\n");
+            exit (1);
+          }
+          i++;
+        }
+        j = i;
+        Log ("Choosing macro-atom jumps from alias tables for each cell, using up to %.0f MB\n", modes.matom_tables_mb);
+      }
+      else if (strcmp (argv[i], "--reverb-tf") == 0)
+      {
+        modes.reverb_tf = TRUE;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%d", &modes.reverb_tf_ndelay) == 1)
+        {
+          i++;
+          if (i + 1 < argc && sscanf (argv[i + 1], "%d", &modes.reverb_tf_nwave) == 1)
+            i++;
+        }
+        if (modes.reverb_tf_ndelay < 1 || modes.reverb_tf_nwave < 1)
+        {
+          Error ("sirocco: The numbers of delay and wavelength bins for the transfer functions must be positive\n");
+          exit (1);
+        }
+        j = i;
+        Log ("Accumulating reverberation transfer functions with %d delay and %d wavelength bins\n", modes.reverb_tf_ndelay,
+             modes.reverb_tf_nwave);
+      }
+      else if (strcmp (argv[i], "--reverb-dump-binary") == 0)
+      {
+        modes.reverb_dump_binary = TRUE;
+        j = i;
+        Log ("Dumping photons in reverberation mode in binary\n");
+      }
+      else if (strcmp (argv[i], "--te-grid") == 0)
+      {
+        modes.te_grid = 5;
+        if (i + 1 < argc && sscanf (argv[i + 1], "%d", &modes.te_grid) == 1)
+        {
+          if (modes.te_grid < 3 || modes.te_grid > 8)
+          {
+            Error ("sirocco: The number of temperatures for --te-grid must be between 3 and 8\n");
+            exit (1);
+          }
+          i++;
+        }
+        j = i;
+        Log ("Finding electron temperatures by interpolating the cooling at %d temperatures\n", modes.te_grid);
+      }
+      else if (strcmp (argv[i], "--rate-table") == 0)
+      {
+        modes.rate_table = TRUE;
+        j = i;
+        Log ("Interpolating the rate coefficients for the matrix ionization scheme in tables\n");
+      }
+      else if (strcmp (argv[i], "--no-atomic-cache") == 0)
+      {
+        atomic_cache = FALSE;
+        j = i;
+        Log ("Reading the atomic data from the ascii data files, without using or saving a binary cache\n");
+      }
+      else if (strcmp (argv[i], "--shared-atomic") == 0)
+      {
+        modes.shared_atomic = TRUE;
+        j = i;
+        Log ("Reading the atomic data on one process, and sharing it between the processes on each node\n");
+      }
       else if (strcmp (argv[i], "-z") == 0)
       {
         modes.zeus_connect = 1;
@@ -373,6 +578,44 @@ and the switches have the following meanings \n\
                         changes and stop \n\
  --rseed                Set the random number seed to be time-based, rather than fixed. \n\
  --rng                  Save or load the RNG state to file, to allow persistent RNG states between restarts\n\
+ --threads n            Use n threads to transport photons in each (MPI) process. This requires sirocco to be \n\
+                        compiled with OpenMP (make OPENMP=yes), and is currently limited to simple-atom models \n\
+ --steal [n]            In MPI runs, let processes which have finished their own photons transport batches of \n\
+                        n photons belonging to slower processes.  By default n is 1 per cent of the photons per process \n\
+ --events [n]           Transport photons with the event-based engine, which moves batches of n photons (1000 by \n\
+                        default) through the wind together \n\
+ --windsave-compress    Compress the windsave files. This requires sirocco to be compiled with zlib (make ZLIB=yes) \n\
+ --bf-cache [mb]        In macro-atom models, interpolate bound-free opacities from tables calculated for each cell \n\
+                        at the start of each cycle, using at most mb MB (1024 by default) in each process \n\
+ --prune-lines [mb]     Ignore lines whose optical depth in a cell is negligible, using at most mb MB (1024 by \n\
+                        default) in each process for the lists of lines in each cell \n\
+ --extract-batch [tau]  In the spectral cycles, extract photons for all observers together, and stop following \n\
+                        them once the optical depth exceeds tau (10 by default) \n\
+ --matrix-storage mb    Store macro-atom matrices for as many cells as fit into mb MB in each process, and \n\
+                        calculate them when needed in the rest \n\
+ --matrix-tol tol       Do not recalculate the stored macro-atom matrix of a cell if none of its jump \n\
+                        probabilities have changed by more than a fraction tol since it was calculated \n\
+ --matrix-sparse        Invert macro-atom matrices one element at a time, using the fact that levels of \n\
+                        different elements are only connected through the k-packet pool \n\
+ --profile              Record the number of calls to, and time spent in, the most expensive routines, and the \n\
+                        time spent in each wind cell, and write these to diag_root/ at the end of each cycle \n\
+ --compton-table        Interpolate the energy change in Compton scattering, and the speeds of thermal electrons, \n\
+                        from tables instead of solving for them for each scatter \n\
+ --matom-tables [mb]    Keep tables of the macro-atom jump probabilities for each level and cell for the whole \n\
+                        cycle, using at most mb MB (1024 by default) in each process, and choose jumps with \n\
+                        the alias method \n\
+ --reverb-tf [nd [nw]]  In reverberation mode, accumulate transfer functions with nd delay bins (100 by default) \n\
+                        and nw wavelength bins (1000 by default) in memory, and write them to root.tf, instead \n\
+                        of dumping each photon to root.delay_dump \n\
+ --reverb-dump-binary   In reverberation mode, dump each photon in binary, to root.delay_dump.bin \n\
+ --te-grid [n]          Find the electron temperature of each cell by interpolating the heating and cooling \n\
+                        calculated at n (5 by default) temperatures, followed by one exact step \n\
+ --rate-table           Interpolate the recombination, collisional ionization and charge exchange coefficients \n\
+                        used by the matrix ionization scheme in tables, rather than calculating them for each cell \n\
+ --no-atomic-cache      Always read the atomic data from the ascii data files, and do not save it in a binary \n\
+                        cache alongside the masterfile \n\
+ --shared-atomic        In parallel runs, read the atomic data on one process, and keep a single copy of the \n\
+                        largest arrays in memory shared by the processes on each node \n\
 \n\
 Other switches exist but these are not intended for the general user.\n\
 These are largely diagnostic or for special cases. These include\n\
@@ -86,9 +86,12 @@ translate (w, pp, tau_scat, tau, nres)
 {
   int istat;
   int ndomain;
-  int ichoose;
+  int ichoose, ncell;
+  double t0;
 
 
+  t0 = prof_start ();
+
   ichoose = where_in_wind (pp->x, &ndomain);
 
 
@@ -97,10 +100,11 @@ translate (w, pp, tau_scat, tau, nres)
     istat = translate_in_space (pp);
 
   }
-  else if ((pp->grid = where_in_grid (ndomain, pp->x)) >= 0)
+  else if ((pp->grid = ncell = where_in_grid (ndomain, pp->x)) >= 0)
   {
 
     istat = translate_in_wind (w, pp, tau_scat, tau, nres);
+    prof_cell_step (ncell, t0);
   }
   else
   {
@@ -108,6 +112,8 @@ translate (w, pp, tau_scat, tau, nres)
     Error ("translate: Found photon that was not in wind or grid, istat %i\n", where_in_wind (pp->x, &ndomain));
   }
 
+  prof_stop (PROF_TRANSLATE, t0);
+
   return (istat);
 }
 
@@ -419,13 +425,10 @@ translate_in_wind (w, p, tau_scat, tau, nres)
      int *nres;
 {
   int n;
-  double smax, ds_current, ds_cmf;
+  double smax, ds_current;
   int istat;
-  int nplasma;
 
   WindPtr one;
-  PlasmaPtr xplasma;
-  struct photon phot_mid, phot_mid_cmf; // Photon at the midpt of its path in the cell
 
   /* First verify that the photon is in the grid, and if not
      return and record an error */
@@ -437,8 +440,6 @@ translate_in_wind (w, p, tau_scat, tau, nres)
   /* Assign the pointers for the cell containing the photon */
 
   one = &wmain[n];              /* one is the grid cell where the photon is */
-  nplasma = one->nplasma;
-  xplasma = &plasmamain[nplasma];
 
   /* Calculate the maximum distance the photon can travel in the cell */
 
@@ -463,67 +464,115 @@ translate_in_wind (w, p, tau_scat, tau, nres)
   else
   {
     ds_current = calculate_ds (w, p, tau_scat, tau, nres, smax, &istat);
+    translate_in_wind_update (w, p, ds_current, *nres, istat);
+  }
 
-    if (p->nres == NRES_ES)
-      xplasma->nscat_es++;
-    else if (p->nres > 0)
-      xplasma->nscat_res++;
+  p->istat = istat;
 
-    /* We now increment the radiation field in the cell, translate the photon and wrap
-     * things up.  For simple atoms, the routine radiation also reduces
-     * the weight of the photon due to continuum absorption, e.g. free free.
-     */
 
-    if (geo.rt_mode == RT_MODE_MACRO)
-    {
-      /* In the macro-method, b-f and other continuum processes do not reduce the photon
-         weight, but are treated as as scattering processes.  Therefore most of what was in
-         subroutine radiation for the simple atom case can be avoided.  
-       */
-      if (geo.ioniz_or_extract == CYCLE_IONIZ)
-      {
-        /* Provide inputs to bf_estimators in the local frame  */
-        stuff_phot (p, &phot_mid);
-        move_phot (&phot_mid, 0.5 * ds_current);
-        observer_to_local_frame (&phot_mid, &phot_mid_cmf);
-        ds_cmf = observer_to_local_frame_ds (&phot_mid, ds_current);
-        if (p->grid >= 0 && p->grid < geo.ndim2)
-        {
-          bf_estimators_increment (&w[p->grid], &phot_mid_cmf, ds_cmf);
-        }
-        else
-        {
-          Error ("translate_in_wind: Cannot call bf_estimators for photon not in wind: %d\n", p->np);
-        }
 
-      }
-    }
-    else
-    {
-      radiation (p, ds_current);
-    }
+  move_phot (p, ds_current);
+  return (p->istat);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      record the passage of a photon along a path within a cell
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in, out] PhotPtr  p   A photon at the start of the path
+ * @param [in] double  ds   The distance the photon will travel
+ * @param [in] int  nres   The resonance or continuum process that ended the path, if any
+ * @param [in] int  istat   The status returned by calculate_ds
+ * @return     Always returns 0
+ *
+ * @details
+ * This is the part of translate_in_wind which follows the call to calculate_ds. The
+ * scattering counters of the cell are incremented, the radiation field
+ * estimators are updated (and, for simple atoms, the weight of the photon is reduced
+ * by continuum absorption) and the resonance which stopped the photon is recorded.
+ * The photon is not moved.
+ *
+ **********************************************************/
+
+int
+translate_in_wind_update (w, p, ds, nres, istat)
+     WindPtr w;
+     PhotPtr p;
+     double ds;
+     int nres;
+     int istat;
+{
+  double ds_cmf, t0;
+  PlasmaPtr xplasma;
+  struct photon phot_mid, phot_mid_cmf; // Photon at the midpt of its path in the cell
 
-    if (*nres > -1 && *nres <= NLINES && *nres == p->nres && istat == P_SCAT)
+  xplasma = &plasmamain[wmain[p->grid].nplasma];
+
+  if (p->nres == NRES_ES)
+  {
+    OMP_PRAGMA (omp atomic)
+    xplasma->nscat_es++;
+  }
+  else if (p->nres > 0)
+  {
+    OMP_PRAGMA (omp atomic)
+    xplasma->nscat_res++;
+  }
+
+  /* We now increment the radiation field in the cell, translate the photon and wrap
+   * things up.  For simple atoms, the routine radiation also reduces
+   * the weight of the photon due to continuum absorption, e.g. free free.
+   */
+
+  if (geo.rt_mode == RT_MODE_MACRO)
+  {
+    /* In the macro-method, b-f and other continuum processes do not reduce the photon
+       weight, but are treated as as scattering processes.  Therefore most of what was in
+       subroutine radiation for the simple atom case can be avoided.  
+     */
+    if (geo.ioniz_or_extract == CYCLE_IONIZ)
     {
-      if (ds_current < wmain[p->grid].dfudge)
+      /* Provide inputs to bf_estimators in the local frame  */
+      stuff_phot (p, &phot_mid);
+      move_phot (&phot_mid, 0.5 * ds);
+      observer_to_local_frame (&phot_mid, &phot_mid_cmf);
+      ds_cmf = observer_to_local_frame_ds (&phot_mid, ds);
+      if (p->grid >= 0 && p->grid < geo.ndim2)
       {
-        Error
-          ("translate_in_wind: found repeated resonance scattering nres %5d after motion of %10.3e for photon %d in plasma cell %d)\n",
-           *nres, ds_current, p->np, wmain[p->grid].nplasma);
+        bf_estimators_increment (&w[p->grid], &phot_mid_cmf, ds_cmf);
+      }
+      else
+      {
+        Error ("translate_in_wind: Cannot call bf_estimators for photon not in wind: %d\n", p->np);
       }
-    }
 
-    p->nres = *nres;
-    if (p->nres > -1 && p->nres < nlines)
-      p->line_res = p->nres;
+    }
+  }
+  else
+  {
+    t0 = prof_start ();
+    radiation (p, ds);
+    prof_stop (PROF_RADIATION, t0);
   }
 
-  p->istat = istat;
-
+  if (nres > -1 && nres <= NLINES && nres == p->nres && istat == P_SCAT)
+  {
+    if (ds < wmain[p->grid].dfudge)
+    {
+      Error
+        ("translate_in_wind: found repeated resonance scattering nres %5d after motion of %10.3e for photon %d in plasma cell %d)\n",
+         nres, ds, p->np, wmain[p->grid].nplasma);
+    }
+  }
 
+  p->nres = nres;
+  if (p->nres > -1 && p->nres < nlines)
+    p->line_res = p->nres;
 
-  move_phot (p, ds_current);
-  return (p->istat);
+  return (0);
 }
 
 
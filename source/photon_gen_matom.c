@@ -43,6 +43,7 @@ get_kpkt_f ()
     lum += plasmamain[n].kpkt_emiss;
   }
 
+  emission_sampler_init (SAMPLE_KPKT);
 
   return (lum);
 }
@@ -93,6 +94,8 @@ get_kpkt_heating_f ()
       plasmamain[n].kpkt_emiss = 0.0;
   }
 
+  emission_sampler_init (SAMPLE_KPKT);
+
   return (lum);
 }
 
@@ -114,6 +117,10 @@ get_kpkt_heating_f ()
  * (calculated in the ionization cycles). This routine is closely related to photo_gen_wind from which much of the code
  * has been copied.
  *
+ * The cells in which the photons originate are chosen first for all of the photons, using the
+ * table constructed by get_kpkt_f (see emission_sampler.c), and the photons are then generated
+ * cell by cell, so that the data for each cell is used for all of its photons while it is to hand.
+ *
  * Photons are generated at a position in the Observer frame.
  * The weight of the photon should is the weight expected in the local
  * frame since photon is first created in thea local
@@ -128,14 +135,14 @@ photo_gen_kpkt (p, weight, photstart, nphot)
 {
   int photstop;
   int icell;
-  double xlum, xlumsum;
   struct photon pp;
   int nres, esc_ptr, which_out;
   int n;
-  double test;
+  double test, t0;
   int nnscat;
 //OLD  int nplasma, ndom;
   int nplasma;
+  int *cells;
   int kpkt_mode;
   double freq_min, freq_max;
 
@@ -158,24 +165,20 @@ photo_gen_kpkt (p, weight, photstart, nphot)
     kpkt_mode = KPKT_MODE_CONTINUUM;
   }
 
-  for (n = photstart; n < photstop; n++)
-  {
-    /* locate the wind_cell in which the photon bundle originates. */
+  /* locate the cells in which the photon bundles originate, so that the photons
+     from each cell are generated together */
 
-    xlum = random_number (0.0, 1.0) * geo.f_kpkt;
+  if ((cells = calloc (nphot, sizeof (int))) == NULL)
+  {
+    Error ("photo_gen_kpkt: Unable to allocate memory for %d photons\n", nphot);
+    Exit (1);
+  }
+  emission_sampler_draw (SAMPLE_KPKT, geo.f_kpkt, nphot, cells, NULL);
 
-    xlumsum = 0;
-    icell = 0;
-    while (xlumsum < xlum)
-    {
-      if (wmain[icell].inwind >= 0)
-      {
-        nplasma = wmain[icell].nplasma;
-        xlumsum += plasmamain[nplasma].kpkt_emiss;
-      }
-      icell++;
-    }
-    icell--;                    /* This is the cell in which the photon must be generated */
+  for (n = photstart; n < photstop; n++)
+  {
+    nplasma = cells[n - photstart];
+    icell = plasmamain[nplasma].nwind;  /* This is the cell in which the photon must be generated */
 
     /* Now generate a single photon in this cell */
     p[n].w = weight;
@@ -191,7 +194,9 @@ photo_gen_kpkt (p, weight, photstart, nphot)
     while (test > freq_max || test < freq_min)
     {
       pp.w = p[n].w;
+      t0 = prof_start ();
       kpkt (&pp, &nres, &esc_ptr, kpkt_mode);
+      prof_stop (PROF_KPKT, t0);
 
       if (esc_ptr == 0 && kpkt_mode == KPKT_MODE_CONTINUUM)
       {
@@ -269,7 +274,7 @@ photo_gen_kpkt (p, weight, photstart, nphot)
 
   }
 
-
+  free (cells);
 
   return (nphot);               /* Return the number of photons generated */
 
@@ -292,6 +297,9 @@ photo_gen_kpkt (p, weight, photstart, nphot)
  *
  * @details
  * This routine is closely related to photo_gen_kpkt from which much of the code has been copied.
+ * As there, the cells and levels are chosen for all of the photons first, using the
+ * table constructed by get_matom_f (see emission_sampler.c), and the photons are then
+ * generated cell by cell.
  *
  * ### Notes ###
  * Consult Matthews thesis.
@@ -306,7 +314,6 @@ photo_gen_matom (p, weight, photstart, nphot)
 {
   int photstop;
   int icell;
-  double xlum, xlumsum;
   struct photon pp;
   int nres;
   int n;
@@ -315,6 +322,7 @@ photo_gen_matom (p, weight, photstart, nphot)
   int upper;
   int nnscat;
   int nplasma;
+  int *cells, *levels;
 //OLD  int ndom;
 
 
@@ -322,46 +330,23 @@ photo_gen_matom (p, weight, photstart, nphot)
   photstop = photstart + nphot;
   Log ("photo_gen_matom creates nphot %5d photons from %5d to %5d \n", nphot, photstart, photstop);
 
-  for (n = photstart; n < photstop; n++)
-  {
-    /* locate the wind_cell in which the photon bundle originates. And also decide which of the macro
-       atom levels will be sampled (identify that level as "upper"). */
-    xlum = random_number (0.0, 1.0) * geo.f_matom;
-
+  /* locate the wind_cells in which the photon bundles originate. And also decide which of the macro
+     atom levels will be sampled (identify that level as "upper"). The photons are ordered by cell. */
 
-    xlumsum = 0;
-    icell = 0;
-    upper = 0;
-    while (xlumsum < xlum)
-    {
-      if (wmain[icell].inwind >= 0)
-      {
-        nplasma = wmain[icell].nplasma;
-        xlumsum += macromain[nplasma].matom_emiss[upper];
-        upper++;
-        if (upper == nlevels_macro)
-        {
-          upper = 0;
-          icell++;
-        }
-      }
-      else
-      {
-        icell++;
-        upper = 0;
-      }
-    }
-
-    if (upper == 0)
-    {
-      /* If upper = 0 at this point it means the loop above finished with an increment of
-         icell and setting upper = 0. In such a case the process we want was the LAST process
-         in the previous cell. */
-      icell--;
-      upper = nlevels_macro;
-    }
+  cells = calloc (nphot, sizeof (int));
+  levels = calloc (nphot, sizeof (int));
+  if (cells == NULL || levels == NULL)
+  {
+    Error ("photo_gen_matom: Unable to allocate memory for %d photons\n", nphot);
+    Exit (1);
+  }
+  emission_sampler_draw (SAMPLE_MATOM, geo.f_matom, nphot, cells, levels);
 
-    upper--;                    /* This leaves the macro atom level that deactivaties. */
+  for (n = photstart; n < photstop; n++)
+  {
+    nplasma = cells[n - photstart];
+    upper = levels[n - photstart];
+    icell = plasmamain[nplasma].nwind;
 
     /* Now generate a single photon in this cell */
     p[n].w = weight;
@@ -457,6 +442,8 @@ photo_gen_matom (p, weight, photstart, nphot)
     }
   }
 
+  free (cells);
+  free (levels);
 
   return (nphot);               /* Return the number of photons generated */
 
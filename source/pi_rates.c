@@ -17,14 +17,14 @@
 #include "atomic.h"
 #include "sirocco.h"
 
-struct topbase_phot *xtop;      //Topbase description of a photoionization x-section - this is the only type we use - tabulated.
+THREAD_LOCAL struct topbase_phot *xtop; //Topbase description of a photoionization x-section - this is the only type we use - tabulated.
 
-double qromb_temp;              //Temperature used in integrations - has to be an external variable so qromb can use it
+THREAD_LOCAL double qromb_temp; //Temperature used in integrations - has to be an external variable so qromb can use it
 
 //Model parameters for integrations, also passed externally so qromb can use them
 
-double xpl_alpha, xpl_w, xpl_logw;
-double xexp_temp, xexp_w;
+THREAD_LOCAL double xpl_alpha, xpl_w, xpl_logw;
+THREAD_LOCAL double xexp_temp, xexp_w;
 
 
 /**********************************************************/
@@ -0,0 +1,286 @@
+/***********************************************************/
+/** @file  profile.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  A simple profiler for the routines in which most of
+ * the time in a run is spent
+ *
+ * When the --profile switch is given, the number of calls to each
+ * of the routines listed in prof_names, and the (wall clock) time
+ * spent in them, including the time spent in the routines they call,
+ * are accumulated.  So that one can see which regions of the grid
+ * make photons expensive, the number of steps photons take through
+ * each wind cell, the time these take, and the number of times
+ * photons scatter in each cell are also recorded.
+ *
+ * At the end of every ionization and spectral cycle, each
+ * process writes these to a JSON file in the diag folder, named
+ * root_ion01_0.prof.json for the first ionization cycle of rank 0,
+ * root_spec01_0.prof.json for the first spectral cycle, and so on.
+ * The counters are then reset.
+ *
+ * A routine is timed by bracketing it with prof_start and prof_stop,
+ * e.g.
+ *
+ *     t0 = prof_start ();
+ *     ...
+ *     prof_stop (PROF_TRANSLATE, t0);
+ *
+ * When profiling is not enabled, these only test modes.profile.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+static const char *prof_names[NPROF] = {
+  "translate", "calculate_ds", "radiation", "extract", "matom", "kpkt", "compton_scatter",
+  "wind_update", "ion_abundances", "communicate", "wind_save"
+};
+
+static long prof_calls[NPROF];  /* The number of calls to each routine */
+static double prof_time[NPROF]; /* The time spent in each routine */
+
+static int prof_ncells = 0;     /* The number of wind cells for which the arrays below are allocated */
+static long *prof_cell_steps = NULL;    /* The number of steps photons take through each wind cell */
+static long *prof_cell_scat = NULL;     /* The number of scatters in each wind cell */
+static double *prof_cell_time = NULL;   /* The time taken by the steps through each cell */
+
+
+
+/**********************************************************/
+/**
+ * @brief      Get the current wall clock time
+ *
+ * @return     The time in seconds
+ *
+ **********************************************************/
+
+static double
+prof_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec + 1e-9 * ts.tv_nsec);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Prepare the profiler for a run
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * This allocates the per cell counters, once the number of wind cells
+ * is known.  It is called at the start of the ionization and spectral
+ * cycles, and does nothing if --profile is not set.
+ *
+ **********************************************************/
+
+int
+prof_init (void)
+{
+  if (modes.profile == FALSE || prof_ncells == NDIM2)
+    return (0);
+
+  free (prof_cell_steps);
+  free (prof_cell_scat);
+  free (prof_cell_time);
+
+  prof_cell_steps = calloc (NDIM2, sizeof (long));
+  prof_cell_scat = calloc (NDIM2, sizeof (long));
+  prof_cell_time = calloc (NDIM2, sizeof (double));
+  if (prof_cell_steps == NULL || prof_cell_scat == NULL || prof_cell_time == NULL)
+  {
+    Error ("prof_init: Unable to allocate memory for %d cells\n", NDIM2);
+    Exit (0);
+  }
+  prof_ncells = NDIM2;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Start timing a routine
+ *
+ * @return     The current time, or 0 if profiling is not enabled
+ *
+ **********************************************************/
+
+double
+prof_start (void)
+{
+  if (modes.profile == FALSE)
+    return (0.0);
+
+  return (prof_now ());
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record a call to a routine
+ *
+ * @param [in] int  kernel   The routine, e.g. PROF_TRANSLATE
+ * @param [in] double  t0   The value returned by prof_start when the routine was entered
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+prof_stop (int kernel, double t0)
+{
+  double dt;
+
+  if (modes.profile == FALSE)
+    return (0);
+
+  dt = prof_now () - t0;
+
+  OMP_PRAGMA (omp atomic)
+  prof_calls[kernel]++;
+  OMP_PRAGMA (omp atomic)
+  prof_time[kernel] += dt;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record a step of a photon through a wind cell
+ *
+ * @param [in] int  nwind   The wind cell
+ * @param [in] double  t0   The value returned by prof_start when the step began
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+prof_cell_step (int nwind, double t0)
+{
+  double dt;
+
+  if (modes.profile == FALSE || nwind < 0 || nwind >= prof_ncells)
+    return (0);
+
+  dt = prof_now () - t0;
+
+  OMP_PRAGMA (omp atomic)
+  prof_cell_steps[nwind]++;
+  OMP_PRAGMA (omp atomic)
+  prof_cell_time[nwind] += dt;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record a scatter in a wind cell
+ *
+ * @param [in] int  nwind   The wind cell
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+prof_cell_scatter (int nwind)
+{
+  if (modes.profile == FALSE || nwind < 0 || nwind >= prof_ncells)
+    return (0);
+
+  OMP_PRAGMA (omp atomic)
+  prof_cell_scat[nwind]++;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write the profile for a cycle, and reset the counters
+ *
+ * @param [in] char *  type   The type of cycle, "ion" or "spec"
+ * @param [in] int  cycle   The number of the cycle, starting from 1
+ * @return     0 on success, or 1 if the file could not be written
+ *
+ * @details
+ * Every process writes its own file.  Only cells through which photons
+ * have passed are listed.  nplasma is -1 for cells which are not in the wind.
+ *
+ **********************************************************/
+
+int
+prof_report (char *type, int cycle)
+{
+  char filename[LINELENGTH];
+  FILE *fptr;
+  int n, i, j, nfirst;
+
+  if (modes.profile == FALSE)
+    return (0);
+
+  sprintf (filename, "%.100s/%.100s_%.10s%02d_%d.prof.json", files.diagfolder, files.root, type, cycle, rank_global);
+
+  if ((fptr = fopen (filename, "w")) == NULL)
+  {
+    Error ("prof_report: Unable to open %s\n", filename);
+    return (1);
+  }
+
+  fprintf (fptr, "{\n  \"root\": \"%s\",\n  \"rank\": %d,\n  \"cycle_type\": \"%s\",\n  \"cycle\": %d,\n  \"threads\": %d,\n",
+           files.root, rank_global, type, cycle, modes.nthreads);
+
+  fprintf (fptr, "  \"kernels\": [\n");
+  for (n = 0; n < NPROF; n++)
+  {
+    fprintf (fptr, "    {\"name\": \"%s\", \"calls\": %ld, \"seconds\": %.6e}%s\n", prof_names[n], prof_calls[n], prof_time[n],
+             n < NPROF - 1 ? "," : "");
+  }
+  fprintf (fptr, "  ],\n");
+
+  fprintf (fptr, "  \"cells\": [\n");
+  nfirst = TRUE;
+  for (n = 0; n < prof_ncells; n++)
+  {
+    if (prof_cell_steps[n] == 0 && prof_cell_scat[n] == 0)
+      continue;
+    wind_n_to_ij (wmain[n].ndom, n, &i, &j);
+    fprintf (fptr, "%s    {\"nwind\": %d, \"nplasma\": %d, \"i\": %d, \"j\": %d, \"steps\": %ld, \"scatters\": %ld, \"seconds\": %.6e}",
+             nfirst ? "" : ",\n", n, wmain[n].inwind >= 0 ? wmain[n].nplasma : -1, i, j, prof_cell_steps[n], prof_cell_scat[n],
+             prof_cell_time[n]);
+    nfirst = FALSE;
+  }
+  fprintf (fptr, "\n  ]\n}\n");
+  fclose (fptr);
+
+  for (n = 0; n < NPROF; n++)
+  {
+    prof_calls[n] = 0;
+    prof_time[n] = 0.0;
+  }
+  for (n = 0; n < prof_ncells; n++)
+  {
+    prof_cell_steps[n] = 0;
+    prof_cell_scat[n] = 0;
+    prof_cell_time[n] = 0.0;
+  }
+
+  return (0);
+}
@@ -19,6 +19,54 @@
 
 int iicount = 0;
 
+/* Work space for radiation, which holds the opacities of each ion and inner shell
+   cross section along the current path.  This is kept for each thread, and is
+   reused from one call to the next */
+
+static THREAD_LOCAL double *rad_kappa_ion = NULL;
+static THREAD_LOCAL double *rad_frac_ion = NULL;
+static THREAD_LOCAL double *rad_kappa_inner_ion = NULL;
+static THREAD_LOCAL double *rad_frac_inner_ion = NULL;
+static THREAD_LOCAL int rad_work_nions = -1;    /* The number of ions for which the work space was allocated */
+static THREAD_LOCAL int rad_work_ninner = -1;   /* The number of inner shell cross sections for which it was allocated */
+
+
+
+/**********************************************************/
+/**
+ * @brief      allocate the work space used by radiation
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+static int
+radiation_work (void)
+{
+  if (rad_work_nions == nions && rad_work_ninner == n_inner_tot)
+    return (0);
+
+  free (rad_kappa_ion);
+  free (rad_frac_ion);
+  free (rad_kappa_inner_ion);
+  free (rad_frac_inner_ion);
+
+  rad_kappa_ion = calloc (nions > 0 ? nions : 1, sizeof (double));
+  rad_frac_ion = calloc (nions > 0 ? nions : 1, sizeof (double));
+  rad_kappa_inner_ion = calloc (n_inner_tot > 0 ? n_inner_tot : 1, sizeof (double));
+  rad_frac_inner_ion = calloc (n_inner_tot > 0 ? n_inner_tot : 1, sizeof (double));
+
+  if (rad_kappa_ion == NULL || rad_frac_ion == NULL || rad_kappa_inner_ion == NULL || rad_frac_inner_ion == NULL)
+  {
+    Error ("radiation_work: Unable to allocate memory for %d ions\n", nions);
+    Exit (0);
+  }
+
+  rad_work_nions = nions;
+  rad_work_ninner = n_inner_tot;
+  return (0);
+}
+
 
 /**********************************************************/
 /**
@@ -73,10 +121,8 @@ radiation (PhotPtr p, double ds)
   double frac_ind_comp;         /* frac_ind_comp - the heating due to induced Compton heating */
   double frac_auger;
   double frac_tot_abs, frac_auger_abs, z_abs;
-  double kappa_ion[NIONS];
-  double frac_ion[NIONS];
-  double kappa_inner_ion[n_inner_tot];
-  double frac_inner_ion[n_inner_tot];
+  double *kappa_ion, *frac_ion;
+  double *kappa_inner_ion, *frac_inner_ion;
   double density, ft, tau, tau2;
   double energy_abs_obs, energy_abs_cmf;
   int n, nion;
@@ -95,6 +141,12 @@ radiation (PhotPtr p, double ds)
 
   z = frac_path = freq_xs = 0;
 
+  radiation_work ();
+  kappa_ion = rad_kappa_ion;
+  frac_ion = rad_frac_ion;
+  kappa_inner_ion = rad_kappa_inner_ion;
+  frac_inner_ion = rad_frac_inner_ion;
+
 
   one = &wmain[p->grid];
 
@@ -416,6 +468,11 @@ radiation (PhotPtr p, double ds)
 /* Everything after this point is only needed for ionization calculations */
 /* Update the radiation parameters used ultimately in calculating t_r */
 
+  /* Several threads may be transporting photons through this cell, so the estimators must be updated
+     by one thread at a time */
+
+  lock_plasma_cell (xplasma->nplasma);
+
   if (freq > xplasma->max_freq) // check if photon frequency exceeds maximum frequency - use doppler shifted frequency
     xplasma->max_freq = freq;   // set maximum frequency sen in the cell to the mean doppler shifted freq - see bug #391
 
@@ -493,6 +550,8 @@ radiation (PhotPtr p, double ds)
   z_obs = z * p_cmf.freq / p->freq;
   update_force_estimators (xplasma, p, &phot_mid, ds, w_ave_obs, ndom, z_obs, frac_ff, frac_auger, frac_tot);
 
+  unlock_plasma_cell (xplasma->nplasma);
+
   return kappa_tot;
 }
 
@@ -610,6 +669,17 @@ sigma_phot (x_ptr, freq)
 
   if (freq < x_ptr->freq[0])
     return (0.0);               // Since this was below threshold
+
+  /* The cross section structures are shared by all threads, and with --shared-atomic
+     by all the processes on a node, so the values cached in them can only be used or
+     updated when there is a single thread and the structures are private to this process */
+
+  if (in_parallel_region () || atomic_data_shared)
+  {
+    linterp (freq, &x_ptr->freq[0], &x_ptr->x[0], x_ptr->np, &xsection, 1);
+    return (xsection);
+  }
+
   if (freq == x_ptr->f)
     return (x_ptr->sigma);      // Avoid recalculating xsection
 
@@ -880,12 +950,14 @@ mean_intensity_from_models (PlasmaPtr xplasma, double freq, int mode)
                is unlikely to be important in such cells. We generate a warning, just
                so we can see if this is happening a lot */
             j_bar = 0.0;
+            OMP_PRAGMA (omp atomic)
             nerr_Jmodel_wrong_freq++;
           }
         }
         else                    /* There is no model in this band - this should not happen very often  */
         {
           j_bar = 0.0;
+          OMP_PRAGMA (omp atomic)
           nerr_no_Jmodel++;
         }
       }
@@ -24,6 +24,7 @@
 #include <errno.h>
 
 #include "constants.h"
+#include "threads.h"
 #include "math_struc.h"
 #include "math_proto.h"
 #include "log.h"
@@ -35,6 +36,8 @@
  */
 
 gsl_rng *rng = NULL;            // pointer to a global random number generator
+gsl_rng **rng_thread = NULL;    // generators used by individual threads during photon transport
+int nrng_thread = 0;            // the number of elements of rng_thread which are in use
 char rngsave_file[LINELENGTH];
 
 
@@ -140,17 +143,25 @@ randvcos (lmn, north)
 
   if (init_vcos == 0)
   {
-    jumps[0] = 0.01745;
-    jumps[1] = 0.03490;
-    jumps[2] = 0.05230;
-    jumps[3] = 0.06976;
-    jumps[4] = 0.08716;
-
-    if ((echeck = cdf_gen_from_func (&cdf_vcos, &vcos, 0., 1., 5, jumps)) != 0)
+    /* cdf_gen_from_func uses file scope arrays, so only one thread may generate a cdf at a time */
+    OMP_PRAGMA (omp critical (cdf_gen))
     {
-      Error ("Randvcos: return from cdf_gen_from_func %d\n", echeck);;
+      if (init_vcos == 0)
+      {
+        jumps[0] = 0.01745;
+        jumps[1] = 0.03490;
+        jumps[2] = 0.05230;
+        jumps[3] = 0.06976;
+        jumps[4] = 0.08716;
+
+        if ((echeck = cdf_gen_from_func (&cdf_vcos, &vcos, 0., 1., 5, jumps)) != 0)
+        {
+          Error ("Randvcos: return from cdf_gen_from_func %d\n", echeck);;
+        }
+        OMP_PRAGMA (omp flush)
+        init_vcos = 1;
+      }
     }
-    init_vcos = 1;
   }
 
 
@@ -290,26 +301,32 @@ randvdipole (lmn, north)
 
   if (init_vdipole == 0)
   {
-
-    jumps[0] = 0.00010;
-    jumps[1] = 0.00030;
-    jumps[2] = 0.00100;
-    jumps[3] = 0.00300;
-    jumps[4] = 0.00500;
-
-    jumps[5] = 1. - 0.00500;
-    jumps[6] = 1. - 0.00300;
-    jumps[7] = 1. - 0.00100;
-    jumps[8] = 1. - 0.00030;
-    jumps[9] = 1. - 0.00010;
-
-
-    if ((echeck = cdf_gen_from_func (&cdf_vdipole, &vdipole, -1., 1., 10, jumps)) != 0)
+    OMP_PRAGMA (omp critical (cdf_gen))
     {
-      Error ("Randvcos: return from cdf_gen_from_func %d\n", echeck);;
+      if (init_vdipole == 0)
+      {
+        jumps[0] = 0.00010;
+        jumps[1] = 0.00030;
+        jumps[2] = 0.00100;
+        jumps[3] = 0.00300;
+        jumps[4] = 0.00500;
+
+        jumps[5] = 1. - 0.00500;
+        jumps[6] = 1. - 0.00300;
+        jumps[7] = 1. - 0.00100;
+        jumps[8] = 1. - 0.00030;
+        jumps[9] = 1. - 0.00010;
+
+
+        if ((echeck = cdf_gen_from_func (&cdf_vdipole, &vdipole, -1., 1., 10, jumps)) != 0)
+        {
+          Error ("Randvcos: return from cdf_gen_from_func %d\n", echeck);;
+        }
+        cdf_to_file (&cdf_vdipole, "Dipole");
+        OMP_PRAGMA (omp flush)
+        init_vdipole = 1;
+      }
     }
-    init_vdipole = 1;
-    cdf_to_file (&cdf_vdipole, "Dipole");
   }
 
 
@@ -427,6 +444,63 @@ init_rand (seed)
   return (0);
 }
 
+
+
+/**********************************************************/
+/**
+ * @brief	Sets up separate random number generators for each
+ * of the threads used in photon transport
+ *
+ * @param [in] nthreads  The number of threads which will draw random numbers
+ * @return 	     0
+ *
+ * Each thread must have its own generator, both because gsl
+ * generators are not thread safe and so that the streams of
+ * random numbers seen by the threads are independent.
+ *
+ * Thread 0 always uses the global generator rng, so a run
+ * with a single thread is identical to one in which threading
+ * has not been compiled in.  The generators for the remaining
+ * threads are (re)seeded with numbers drawn from rng, so that
+ * the thread streams are reproducible and follow the state of rng
+ * when it is saved and reloaded with --rng.
+ *
+ * ###Notes###
+ *
+ * This routine must be called outside of a parallel region, normally
+ * immediately before the photons are transported in each cycle.
+ * Using several threads produces results which are statistically,
+ * but not bitwise, identical to a serial run.
+***********************************************************/
+
+int
+init_rand_threads (nthreads)
+     int nthreads;
+{
+  int n;
+
+  if (nthreads < 1)
+    nthreads = 1;
+
+  if (nthreads > nrng_thread)
+  {
+    rng_thread = realloc (rng_thread, nthreads * sizeof (gsl_rng *));
+    for (n = nrng_thread; n < nthreads; n++)
+    {
+      rng_thread[n] = (n == 0) ? rng : gsl_rng_alloc (gsl_rng_mt19937);
+    }
+    nrng_thread = nthreads;
+  }
+
+  rng_thread[0] = rng;
+  for (n = 1; n < nthreads; n++)
+  {
+    gsl_rng_set (rng_thread[n], gsl_rng_get (rng));
+  }
+
+  return (0);
+}
+
 /**********************************************************/
 /**
  * @brief  Initialise the RNG directory structure.
@@ -560,13 +634,25 @@ reload_gsl_rng_state ()
  *
  * ###Notes###
  * 2/18	-	Written by NSH
+ *
+ * When photons are being transported by several threads, each
+ * thread draws from its own generator, see init_rand_threads
 ***********************************************************/
 
 
 double
 random_number (double min, double max)
 {
-  double num = gsl_rng_uniform_pos (rng);
+  gsl_rng *r = rng;
+
+#ifdef _OPENMP
+  int n = omp_get_thread_num ();
+
+  if (n > 0 && n < nrng_thread)
+    r = rng_thread[n];
+#endif
+
+  double num = gsl_rng_uniform_pos (r);
   double x = min + ((max - min) * num);
   return (x);
 }
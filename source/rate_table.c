@@ -0,0 +1,353 @@
+/***********************************************************/
+/** @file  rate_table.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Tables of the rate coefficients used in the matrix ionization
+ * scheme which depend only on temperature
+ *
+ * matrix_ion_populations needs, for the electron temperature of each cell,
+ * the total radiative, dielectronic and three body recombination, the
+ * collisional ionization and the charge exchange coefficients of every ion.
+ * These are analytic fits, but with many ions evaluating them for every
+ * cell is a significant part of the cost of the ionization calculation.
+ *
+ * If the --rate-table switch is given, the coefficients are instead
+ * tabulated once, on a grid which is uniform in log T, and their logs
+ * are interpolated (linearly in 1/T) for each cell.  The tables depend
+ * only on the atomic data, and so are shared by all of the cells and
+ * threads.
+ *
+ * Ions for which the total radiative recombination rate has to be calculated
+ * from the Milne relation are not tabulated, since the integral is done
+ * for the cell anyway.  Temperatures outside the table are also calculated
+ * directly.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+#define RATE_TABLE_LTMIN   2.0  /* log10 of the lowest temperature in the tables */
+#define RATE_TABLE_LTMAX   8.7  /* log10 of the highest temperature */
+#define RATE_TABLE_DLT     0.01 /* The spacing of the tables in log10 T */
+#define RATE_TABLE_ZERO    -1e300       /* The value stored for a coefficient which is zero */
+#define RATE_TABLE_TINY    1e-40        /* Coefficients smaller than this are ignored when checking the accuracy */
+
+enum rate_table_enum
+{ RT_RR = 0, RT_DR, RT_DI, RT_QRECOMB, RT_CHEX_RECOMB, NRATE_TABLE };
+
+static int rate_table_nt = 0;   /* The number of temperatures in the tables */
+static int rate_table_nion = 0; /* The number of coefficients at each temperature */
+static double *rate_table = NULL;       /* ln of the coefficients, ordered by temperature, then rate_table_enum and ion */
+static double *rate_table_chex = NULL;  /* ln of the charge exchange ionization coefficients */
+
+
+
+/**********************************************************/
+/**
+ * @brief      calculate the temperature dependent coefficients directly
+ *
+ * @param [in] double  t   The temperature
+ * @param [out] double *  row   The ln of the coefficients for each process and ion
+ * @param [out] double *  chex   The ln of the charge exchange ionization coefficients
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+static int
+rate_table_row (double t, double *row, double *chex)
+{
+  int n, k;
+  double x;
+
+  compute_dr_coeffs (t);
+  compute_di_coeffs (t);
+  compute_qrecomb_coeffs (t);
+  compute_ch_ex_coeffs (t);
+
+  for (n = 0; n < nions; n++)
+  {
+    for (k = 0; k < NRATE_TABLE; k++)
+    {
+      if (k == RT_RR)
+        x = (n != ele[ion[n].nelem].firstion && ion[n].total_rrflag == 1) ? total_rrate (n, t) : 0.0;
+      else if (k == RT_DR)
+        x = dr_coeffs[n];
+      else if (k == RT_DI)
+        x = di_coeffs[n];
+      else if (k == RT_QRECOMB)
+        x = qrecomb_coeffs[n];
+      else
+        x = charge_exchange_recomb_rates[n];
+
+      row[k * nions + n] = x > 0.0 ? log (x) : RATE_TABLE_ZERO;
+    }
+  }
+
+  for (n = 0; n < n_charge_exchange; n++)
+  {
+    x = charge_exchange_ioniz_rates[n];
+    chex[n] = x > 0.0 ? log (x) : RATE_TABLE_ZERO;
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      find the position of a temperature in the tables
+ *
+ * @param [in] double  t   The temperature
+ * @param [out] double *  frac   The fraction of the interval at which to interpolate
+ * @return     The lower of the two points between which t lies
+ *
+ * @details
+ * The fraction is linear in 1/T rather than log T, so that the factors of
+ * exp (-E/kT) in most of the coefficients are interpolated exactly.  The
+ * remaining power laws in T are nearly linear in 1/T over the small
+ * interval between points.
+ *
+ **********************************************************/
+
+static int
+rate_table_index (double t, double *frac)
+{
+  double tlo, thi;
+  int n;
+
+  n = (int) ((log10 (t) - RATE_TABLE_LTMIN) / RATE_TABLE_DLT);
+  tlo = pow (10., RATE_TABLE_LTMIN + n * RATE_TABLE_DLT);
+  thi = pow (10., RATE_TABLE_LTMIN + (n + 1) * RATE_TABLE_DLT);
+  *frac = (1. / t - 1. / tlo) / (1. / thi - 1. / tlo);
+
+  return (n);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      interpolate in ln between two tabulated values
+ *
+ **********************************************************/
+
+static double
+rate_table_interp (double a, double b, double frac)
+{
+  if (a > RATE_TABLE_ZERO && b > RATE_TABLE_ZERO)
+    return (exp (a + frac * (b - a)));
+  if (a > RATE_TABLE_ZERO)
+    return ((1. - frac) * exp (a));
+  if (b > RATE_TABLE_ZERO)
+    return (frac * exp (b));
+  return (0.0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      construct the tables of rate coefficients
+ *
+ * @return     The number of temperatures in the tables
+ *
+ * @details
+ * This is called the first time the coefficients are needed, after the
+ * atomic data has been read.  The accuracy of the interpolation is
+ * estimated, and logged, by comparing the interpolated and exact values
+ * half way between the points in the tables.
+ *
+ * Some of the fits are set to zero outside a range of temperatures, and
+ * between the points on either side of such a cutoff the coefficients are
+ * interpolated linearly.  These intervals, and coefficients so small that
+ * they cannot matter, are counted separately.
+ *
+ **********************************************************/
+
+int
+rate_table_init (void)
+{
+  double *row, *chex, *lo, *hi, t, x, y, err, err_max, t_max, frac;
+  int nt, n, k, ncol, nerr, ncut, k_max;
+
+  if (rate_table != NULL && rate_table_nion == nions)
+    return (rate_table_nt);
+
+  rate_table_free ();
+
+  nt = (int) ((RATE_TABLE_LTMAX - RATE_TABLE_LTMIN) / RATE_TABLE_DLT + 0.5) + 1;
+  ncol = NRATE_TABLE * nions;
+
+  rate_table = calloc ((size_t) nt * ncol, sizeof (double));
+  rate_table_chex = calloc ((size_t) nt * (n_charge_exchange + 1), sizeof (double));
+  row = calloc (ncol, sizeof (double));
+  chex = calloc (n_charge_exchange + 1, sizeof (double));
+  if (rate_table == NULL || rate_table_chex == NULL || row == NULL || chex == NULL)
+  {
+    Error ("rate_table_init: Unable to allocate memory for %d temperatures and %d ions\n", nt, nions);
+    Exit (0);
+  }
+
+  for (n = 0; n < nt; n++)
+  {
+    t = pow (10., RATE_TABLE_LTMIN + n * RATE_TABLE_DLT);
+    rate_table_row (t, &rate_table[(size_t) n * ncol], &rate_table_chex[(size_t) n * (n_charge_exchange + 1)]);
+  }
+
+  rate_table_nt = nt;
+  rate_table_nion = nions;
+
+  /* Check the accuracy of the interpolation */
+
+  err_max = t_max = 0.0;
+  nerr = ncut = k_max = 0;
+  for (n = 0; n < nt - 1; n++)
+  {
+    t = pow (10., RATE_TABLE_LTMIN + (n + 0.5) * RATE_TABLE_DLT);
+    rate_table_index (t, &frac);
+    rate_table_row (t, row, chex);
+    lo = &rate_table[(size_t) n * ncol];
+    hi = lo + ncol;
+    for (k = 0; k < ncol; k++)
+    {
+      if ((lo[k] > RATE_TABLE_ZERO) != (hi[k] > RATE_TABLE_ZERO))
+      {
+        ncut++;
+        continue;
+      }
+      x = row[k] > RATE_TABLE_ZERO ? exp (row[k]) : 0.0;
+      if (x > RATE_TABLE_TINY)
+      {
+        y = rate_table_interp (lo[k], hi[k], frac);
+        err = fabs (y - x) / x;
+        if (err > err_max)
+        {
+          err_max = err;
+          t_max = t;
+          k_max = k;
+        }
+        if (err > 1e-3)
+          nerr++;
+      }
+    }
+  }
+
+  free (row);
+  free (chex);
+
+  Log ("rate_table_init: Tabulated rate coefficients for %d ions at %d temperatures\n", nions, nt);
+  Log ("rate_table_init: The largest interpolation error is %.2e, for process %d of ion %d at %.3e K\n",
+       err_max, k_max / nions, k_max % nions, t_max);
+  Log ("rate_table_init: %d interpolated coefficients are in error by more than 0.1 per cent, and %d are next to a cutoff\n",
+       nerr, ncut);
+
+  return (nt);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      get the temperature dependent rate coefficients of all the ions
+ *
+ * @param [in] double  t   The electron temperature
+ * @param [out] double *  rr_rates   The total radiative recombination rate of each ion
+ * @return     0 if the coefficients were interpolated, 1 if they were calculated directly
+ *
+ * @details
+ * This fills dr_coeffs, di_coeffs, qrecomb_coeffs, charge_exchange_recomb_rates
+ * and charge_exchange_ioniz_rates, as compute_dr_coeffs etc would do, and
+ * rr_rates as total_rrate would.
+ *
+ **********************************************************/
+
+int
+rate_table_coeffs (double t, double *rr_rates)
+{
+  double lt, frac, *lo, *hi;
+  int n, nt, ncol, nchex;
+
+  if (rate_table == NULL || rate_table_nion != nions)
+  {
+    OMP_PRAGMA (omp critical (rate_table))
+    {
+      if (rate_table == NULL || rate_table_nion != nions)
+        rate_table_init ();
+    }
+  }
+
+  lt = log10 (t);
+  if (!(lt >= RATE_TABLE_LTMIN && lt < RATE_TABLE_LTMIN + (rate_table_nt - 1) * RATE_TABLE_DLT))
+  {
+    compute_dr_coeffs (t);
+    compute_di_coeffs (t);
+    compute_qrecomb_coeffs (t);
+    compute_ch_ex_coeffs (t);
+    for (n = 0; n < nions; n++)
+    {
+      if (n != ele[ion[n].nelem].firstion)
+        rr_rates[n] = total_rrate (n, t);
+    }
+    return (1);
+  }
+
+  nt = rate_table_index (t, &frac);
+
+  ncol = NRATE_TABLE * nions;
+  lo = &rate_table[(size_t) nt * ncol];
+  hi = lo + ncol;
+
+  for (n = 0; n < nions; n++)
+  {
+    if (n != ele[ion[n].nelem].firstion)
+    {
+      if (ion[n].total_rrflag == 1)
+        rr_rates[n] = rate_table_interp (lo[RT_RR * nions + n], hi[RT_RR * nions + n], frac);
+      else
+        rr_rates[n] = total_rrate (n, t);
+    }
+    dr_coeffs[n] = rate_table_interp (lo[RT_DR * nions + n], hi[RT_DR * nions + n], frac);
+    di_coeffs[n] = rate_table_interp (lo[RT_DI * nions + n], hi[RT_DI * nions + n], frac);
+    qrecomb_coeffs[n] = rate_table_interp (lo[RT_QRECOMB * nions + n], hi[RT_QRECOMB * nions + n], frac);
+    charge_exchange_recomb_rates[n] = rate_table_interp (lo[RT_CHEX_RECOMB * nions + n], hi[RT_CHEX_RECOMB * nions + n], frac);
+  }
+
+  nchex = n_charge_exchange + 1;
+  lo = &rate_table_chex[(size_t) nt * nchex];
+  hi = lo + nchex;
+  for (n = 0; n < n_charge_exchange; n++)
+  {
+    charge_exchange_ioniz_rates[n] = rate_table_interp (lo[n], hi[n], frac);
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      release the memory used by the tables
+ *
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+rate_table_free (void)
+{
+  free (rate_table);
+  free (rate_table_chex);
+  rate_table = NULL;
+  rate_table_chex = NULL;
+  rate_table_nt = rate_table_nion = 0;
+
+  return (0);
+}
@@ -76,13 +76,13 @@ int nfb = 0;
 Numerical Recipes routines from fb_verner and fb_topbase */
 
 ///Topbase description of a photoionization x-section
-struct topbase_phot *fb_xtop;
+THREAD_LOCAL struct topbase_phot *fb_xtop;
 
 /// Temperature (and log) at which the emissivity is calculated 
-double fbt, log_fbt;
+THREAD_LOCAL double fbt, log_fbt;
 
 /// fb_choice (see above)
-int fbfr;
+THREAD_LOCAL int fbfr;
 
 
 
@@ -506,209 +506,230 @@ total_fb (xplasma, t, f1, f2, fb_choice, mode)
 
 
 double fb_x[NCDF], fb_y[NCDF];
-/// There is at most one jump per level
-double fb_jumps[NLEVELS];
+/// There is at most one jump per photoionization cross section
+double *fb_jumps = NULL;
 /// This is just a dummy array that parallels fb_jumpts
-double xfb_jumps[NLEVELS];
+double *xfb_jumps = NULL;
 int fb_njumps = (-1);
+int fb_jumps_size = 0;          ///< The number of jumps for which fb_jumps has space
+double fb_jumps_f1, fb_jumps_f2;        ///< The frequency limits for which the jumps were found
 
-// WindPtr ww_fb;
-double one_fb_f1, one_fb_f2, one_fb_te; /* Old values */
 
 
 /**********************************************************/
 /**
- * @brief      generates one free bound photon with specific frequency limits
+ * @brief      finds the photoionization edges between two frequencies
  *
- * @param [in] PlasmaPtr  xplasma   The wind cell in which the photon is being
  * @param [in] double  f1   The minimum frequency
- * @param [in] double  f2   The frequency limits
- * @return     The frequency of the fb photon that was generated.
+ * @param [in] double  f2   The maximum frequency
+ * @return     The number of edges
  *
  * @details
- *
- * 	Although the routine returns only a single photon, it stores more
- * 	that one for the same conditions. If the routine is called mulitiple
- * 	times from the same cell with the same frequency limits it will use the pre-
- * 	stored values.  This was intended to avoid the process of having to
- * 	generate cdfs multiple times
- *
- * ### Notes ###
- *
- *
- * 	@bug This routine still assumes the possibility of jumps
- *      even though this possibility has been removed from the cdf generation
- *      routines.
+ * The edges are stored, in increasing order of frequency and without
+ * duplicates, in fb_jumps.
  *
  **********************************************************/
 
-double
-one_fb (xplasma, f1, f2)
-     PlasmaPtr xplasma;         /* a single cell */
-     double f1, f2;             /* freqmin and freqmax */
+static int
+fb_cdf_jumps (f1, f2)
+     double f1, f2;
 {
-  double freq, tt, delta;
-  int n, nn, nnn;
-  double fthresh, dfreq;
-  int nplasma;
-  PhotStorePtr xphot;
-  nplasma = xplasma->nplasma;
-  xphot = &photstoremain[nplasma];
+  int n;
+  double fthresh;
 
-  if (f2 < f1)
+  if (fb_jumps_size <= nphot_total)
   {
-    Error ("one_fb: f2 %g < f1 %g Something is rotten  t %g\n", f2, f1, xplasma->t_e);
-    Exit (0);
+    /* One more than needed, since fb_cdf looks at the element after the last jump */
+    free (fb_jumps);
+    free (xfb_jumps);
+    fb_jumps = calloc (nphot_total + 1, sizeof (double));
+    xfb_jumps = calloc (nphot_total + 1, sizeof (double));
+    if (fb_jumps == NULL || xfb_jumps == NULL)
+    {
+      Error ("fb_cdf_jumps: Unable to allocate memory for %d jumps\n", nphot_total);
+      Exit (0);
+    }
+    fb_jumps_size = nphot_total + 1;
   }
-
-/* Check if an appropriate photon frequency has already been generated, 
-   and use that instead if possible 
- */
-
-  tt = xplasma->t_e;
-  if (xphot->n < NSTORE && xphot->f1 == f1 && xphot->f2 == f2 && xphot->t == tt)
+  fb_njumps = 0;
+  for (n = 0; n < nphot_total; n++)
   {
-    freq = xphot->freq[xphot->n];
-    (xphot->n)++;
-    return (freq);
+    fthresh = phot_top_ptr[n]->freq[0];
+    if (f1 < fthresh && fthresh < f2)
+    {
+      fb_jumps[fb_njumps] = fthresh;
+      fb_njumps++;
+    }
   }
 
+  /* The next line sorts the fb_jumps by frequency and eliminates
+   * duplicate frequencies which is what was causing the error in
+   * cdf.c when more than one jump was intended
+   */
 
-  delta = tt / 100;             // Fudge factor to prevent generation of a CDF if t has changed only slightly
-
-  /* Check to see if we have already generated a cdf */
-  if (tt > (one_fb_te + delta) || tt < (one_fb_te - delta) || f1 != one_fb_f1 || f2 != one_fb_f2)
+  if (fb_njumps > 1)            //We only need to sort and compress if we have more than one jump
   {
-/* Then need to generate a new cdf */
+    fb_njumps = sort_and_compress (fb_jumps, xfb_jumps, fb_njumps);
+    for (n = 0; n < fb_njumps; n++)
+    {
+      fb_jumps[n] = xfb_jumps[n];
+    }
+  }
 
-//OLD    ww_fb = one;
+  fb_jumps_f1 = f1;
+  fb_jumps_f2 = f2;
 
-    /* Create the fb_array */
+  return (fb_njumps);
+}
 
-    /* Determine how many intervals are between f1 and f2.  These need to be
-       put in increasing frequency order */
 
-    if (f1 != one_fb_f1 || f2 != one_fb_f2)
-    {                           // Regenerate the jumps
-      fb_njumps = 0;
-      for (n = 0; n < nphot_total; n++)
-      {
-        fthresh = phot_top_ptr[n]->freq[0];
-        if (f1 < fthresh && fthresh < f2)
-        {
-          fb_jumps[fb_njumps] = fthresh;
-          fb_njumps++;
-        }
-      }
 
+/**********************************************************/
+/**
+ * @brief      constructs the cdf of the free bound emission of a cell
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell
+ * @param [in] double  f1   The minimum frequency
+ * @param [in] double  f2   The maximum frequency
+ * @param [out] CdfPtr  cdf   The cdf
+ * @return     Always returns 0
+ *
+ * @details
+ * The emissivity is calculated on a grid of ARRAY_PDF equally spaced
+ * frequencies, with extra points just above and below each
+ * photoionization edge between f1 and f2.
+ *
+ * ### Notes ###
+ * This may be called by several threads at once, for different cells but
+ * the same frequency limits.  The edges are only found again when the
+ * limits change.
+ *
+ **********************************************************/
 
+int
+fb_cdf (xplasma, f1, f2, cdf)
+     PlasmaPtr xplasma;
+     double f1, f2;
+     CdfPtr cdf;
+{
+  double freq, dfreq;
+  double *x, *y;
+  int n, nn, nnn, nalloc;
 
-      /* The next line sorts the fb_jumps by frequency and eliminates
-       * duplicate frequencies which is what was causing the error in
-       * cdf.c when more than one jump was intended
-       */
+  OMP_PRAGMA (omp critical (fb_cdf_jumps))
+  {
+    if (fb_njumps < 0 || f1 != fb_jumps_f1 || f2 != fb_jumps_f2)
+      fb_cdf_jumps (f1, f2);
+  }
 
-      if (fb_njumps > 1)        //We only need to sort and compress if we have more than one jump
-      {
-        fb_njumps = sort_and_compress (fb_jumps, xfb_jumps, fb_njumps);
-        for (n = 0; n < fb_njumps; n++)
-        {
-          fb_jumps[n] = xfb_jumps[n];
-        }
-      }
+  nalloc = ARRAY_PDF + 2 * fb_njumps;
+  x = calloc (nalloc, sizeof (double));
+  y = calloc (nalloc, sizeof (double));
+  if (x == NULL || y == NULL)
+  {
+    Error ("fb_cdf: Unable to allocate memory for %d points\n", nalloc);
+    Exit (0);
+  }
 
+  /*NSH 1707 - modified the loop below to ensure we have points just below and above any jumps */
 
+  nnn = 0;                      //Zero the index for elements in the flux array
+  nn = 0;                       //Zero the index for elements in the jump array
+  n = 0;                        //Zero the counting element for equally spaced frequencies
+  dfreq = (f2 - f1) / (ARRAY_PDF - 1);  //This is the frequency spacing for the equally spaced elements
+  while (n < (ARRAY_PDF) && nnn < nalloc)       //We keep going until n=ARRAY_PDF-1, which will give the maximum required frequency
+  {
+    freq = f1 + dfreq * n;      //The frequency of the array element we would make in the normal run of things
+    if (freq > fb_jumps[nn] && nn < fb_njumps)  //The element we were going to make has a frequency abouve the jump
+    {
+      x[nnn] = fb_jumps[nn] * (1. - DELTA_V / (2. * VLIGHT));   //We make one frequency point DELTA_V cm/s below the jump
+      y[nnn] = fb (xplasma, xplasma->t_e, x[nnn], nions, FB_FULL);      //And the flux for that point
+      nnn = nnn + 1;            //increase the index of the created array
+      x[nnn] = fb_jumps[nn] * (1. + DELTA_V / (2 * VLIGHT));    //And one frequency point just above the jump
+      y[nnn] = fb (xplasma, xplasma->t_e, x[nnn], nions, FB_FULL);      //And the flux for that point
+      nn = nn + 1;              //We heave dealt with this jump - on to the next one
+      nnn = nnn + 1;            //And we will be filling the next array element next time
     }
-
-
-
-    /*NSH 1707 - modified the loop below to ensure we have points just below and above any jumps */
-
-    nnn = 0;                    //Zero the index for elements in the flux array
-    nn = 0;                     //Zero the index for elements in the jump array
-    n = 0;                      //Zero the counting element for equally spaced frequencies
-    dfreq = (f2 - f1) / (ARRAY_PDF - 1);        //This is the frequency spacing for the equally spaced elements
-    while (n < (ARRAY_PDF) && nnn < NCDF)       //We keep going until n=ARRAY_PDF-1, which will give the maximum required frequency
+    else                        //We haven't hit a jump
     {
-      freq = f1 + dfreq * n;    //The frequency of the array element we would make in the normal run of things
-      if (freq > fb_jumps[nn] && nn < fb_njumps)        //The element we were going to make has a frequency abouve the jump
+      if (nnn == 0 || freq > x[nnn - 1])       //Deal with the unusual case where the upper point in our 'jump' pair is above the next regular point
       {
-        fb_x[nnn] = fb_jumps[nn] * (1. - DELTA_V / (2. * VLIGHT));      //We make one frequency point DELTA_V cm/s below the jump
-        fb_y[nnn] = fb (xplasma, xplasma->t_e, fb_x[nnn], nions, FB_FULL);      //And the flux for that point
-        nnn = nnn + 1;          //increase the index of the created array
-        fb_x[nnn] = fb_jumps[nn] * (1. + DELTA_V / (2 * VLIGHT));       //And one frequency point just above the jump
-        fb_y[nnn] = fb (xplasma, xplasma->t_e, fb_x[nnn], nions, FB_FULL);      //And the flux for that point
-        nn = nn + 1;            //We heave dealt with this jump - on to the next one
-        nnn = nnn + 1;          //And we will be filling the next array element next time
+        x[nnn] = freq;          //Set the next array element frequency
+        y[nnn] = fb (xplasma, xplasma->t_e, x[nnn], nions, FB_FULL);    //And the flux
+        n = n + 1;              //Increment the regular grid counter
+        nnn = nnn + 1;          //Increment the generated array counter
       }
-      else                      //We haven't hit a jump
+      else                      //We dont need to make a new point, the upper frequency pair of the last jump did the trick
       {
-        if (freq > fb_x[nnn - 1])       //Deal with the unusual case where the upper point in our 'jump' pair is above the next regular point
-        {
-          fb_x[nnn] = freq;     //Set the next array element frequency
-          fb_y[nnn] = fb (xplasma, xplasma->t_e, fb_x[nnn], nions, FB_FULL);    //And the flux
-          n = n + 1;            //Increment the regular grid counter
-          nnn = nnn + 1;        //Increment the generated array counter
-        }
-        else                    //We dont need to make a new point, the upper frequency pair of the last jump did the trick
-        {
-          n = n + 1;            //We only need to increment our regualr grid counter
-        }
+        n = n + 1;              //We only need to increment our regualr grid counter
       }
     }
+  }
 
-    //Ensure the last point lines up exatly with f2
+  //Ensure the last point lines up exatly with f2
 
-    fb_x[nnn - 1] = f2;
-    fb_y[nnn - 1] = fb (xplasma, xplasma->t_e, f2, nions, FB_FULL);
+  x[nnn - 1] = f2;
+  y[nnn - 1] = fb (xplasma, xplasma->t_e, f2, nions, FB_FULL);
 
+  /* At this point, the variable nnn stores the number of points */
 
-    if (nnn > NCDF)
-    {
-      Error ("one _fb: Overflow of working array\n");
-      Exit (0);
-    }
+  if (cdf_gen_from_array (cdf, x, y, nnn, f1, f2) != 0)
+  {
+    Error ("fb_cdf after cdf_gen_from_array error: f1 %g f2 %g te %g ne %g nh %g vol %g\n",
+           f1, f2, xplasma->t_e, xplasma->ne, xplasma->density[1], xplasma->vol);
+    Error ("Giving up\n");
+    Exit (0);
+  }
 
+  free (x);
+  free (y);
 
-    /* At this point, the variable nnn stores the number of points */
+  return (0);
+}
 
 
-    if (cdf_gen_from_array (&cdf_fb, fb_x, fb_y, nnn, f1, f2) != 0)
-    {
-      Error ("one_fb after cdf_gen_from_array error: f1 %g f2 %g te %g ne %g nh %g vol %g\n",
-             f1, f2, xplasma->t_e, xplasma->ne, xplasma->density[1], xplasma->vol);
-      Error ("Giving up\n");
-      Exit (0);
-    }
-    one_fb_te = xplasma->t_e;
-    one_fb_f1 = f1;
-    one_fb_f2 = f2;             /* Note that this may not be the best way to check for a previous cdf */
-  }
 
-/* OK, generate photons */
+/**********************************************************/
+/**
+ * @brief      generates one free bound photon with specific frequency limits
+ *
+ * @param [in] PlasmaPtr  xplasma   The wind cell in which the photon is being
+ * @param [in] double  f1   The minimum frequency
+ * @param [in] double  f2   The frequency limits
+ * @return     The frequency of the fb photon that was generated.
+ *
+ * @details
+ * The frequency is drawn from the cdf of the fb emission of this cell,
+ * which is constructed by fb_cdf the first time it is needed after the
+ * luminosity of the cell has been calculated, and kept until the
+ * luminosities change (see emission_cdf.c).
+ *
+ * ### Notes ###
+ *
+ * 	@bug This routine still assumes the possibility of jumps
+ *      even though this possibility has been removed from the cdf generation
+ *      routines.
+ *
+ **********************************************************/
 
-/* First generate the photon we need */
-  freq = cdf_get_rand (&cdf_fb);
-  if (freq < f1 || freq > f2)
+double
+one_fb (xplasma, f1, f2)
+     PlasmaPtr xplasma;         /* a single cell */
+     double f1, f2;             /* freqmin and freqmax */
+{
+  double freq;
+
+  if (f2 < f1)
   {
-    Error ("one_fb:  freq %e  freqmin %e freqmax %e out of range\n", freq, f1, f2);
+    Error ("one_fb: f2 %g < f1 %g Something is rotten  t %g\n", f2, f1, xplasma->t_e);
+    Exit (0);
   }
 
-/* Now create and store for future use a set of additonal photons */
-
-  for (n = 0; n < NSTORE; n++)
+  freq = emission_cdf_rand (xplasma, SPEC_FB, f1, f2, NULL);
+  if (freq < f1 || freq > f2)
   {
-    xphot->freq[n] = cdf_get_rand (&cdf_fb);
-    if (xphot->freq[n] < f1 || xphot->freq[n] > f2)
-    {
-      Error ("one_fb:  freq %e  freqmin %e freqmax %e out of range\n", xphot->freq[n], f1, f2);
-    }
-
+    Error ("one_fb:  freq %e  freqmin %e freqmax %e out of range\n", freq, f1, f2);
   }
-  xphot->n = 0;
-  xphot->t = tt;
-  xphot->f1 = f1;
-  xphot->f2 = f2;
 
   return (freq);
 }
@@ -904,9 +925,8 @@ int init_freebound_nfb;
 
 /**********************************************************/
 /**
- * @brief      initializes the structure fb_struc as well as some
- * associated arrays and variables (found in sirocco.h) that describe
- * recombination rates and band-limited luminosities.
+ * @brief      calculates the recombination rates and band-limited
+ * luminosities for init_freebound
  *
  * @param [in] double  t1   A lower limit for the temperature
  * @param [in] double  t2   An upper limit for the temperature
@@ -915,38 +935,15 @@ int init_freebound_nfb;
  * @return     The routine generally returns 0
  *
  * @details
- * Python typically calculates photons in frequency ranges (in order
- * to enable stratified sampling).  For this to work, one needs
- * freebound emissivities and cooling rates corresponding to these
- * freqency ranges.  Since we retrun to the same frequency ranges every cycle,
- * Python stores the necessary information in structures.
- *
- * This routine is responsible for populating these structures, so
- * that they can be accessed later via the routine get_fb.
- *
- *
- *
- * ### Notes ###
- *
- * The first time the routine is called, both recombination
- * rates and band-limited luminosities are calculated.  On
- * subsequent calls the routine checks to see whether it has
- * already calculated the band-limited freebound emissivities,
- * and if so returns without redoing the calculation.  However,
- * if a new frequency interval is provided, the new luminosities
- * are added to the free-bound structure.  To force a
- * re-initialization nfb must be set to 0.
- *
- * The routine allows for the possibility that there are more
- * frequency intervals than place to store data and will recylce
- * the structure if this occurs (indicating this with several error
- * messages).  This allows the program to proceed, but if this
- * happens often then the variable NFB in sirocco.h should be increased.
+ * This is only ever executed by one thread at a time.  A new set of
+ * luminosities is not counted in nfb until it is complete, so that
+ * the threads which look for it in init_freebound without waiting
+ * for this routine do not use a partly filled set.
  *
  **********************************************************/
 
-int
-init_freebound (t1, t2, f1, f2)
+static int
+make_freebound (t1, t2, f1, f2)
      double t1, t2, f1, f2;
 {
   double t;
@@ -1023,7 +1020,6 @@ been calculated for these conditions, and if so simply return.
   else
   {
     nput = init_freebound_nfb = nfb;
-    nfb++;
   }
 
 
@@ -1037,8 +1033,7 @@ on the assumption that the fb information will be reused.
   Log ("init_freebound: Creating recombination emissivities between %e and %e in structure element %d\n", f1, f2, nput);
 
 
-  freebound[nput].f1 = f1;
-  freebound[nput].f2 = f2;
+  freebound[nput].f1 = freebound[nput].f2 = -1.;
 
   for (nion = 0; nion < nions; nion++)
   {
@@ -1052,6 +1047,85 @@ on the assumption that the fb information will be reused.
     }
   }
 
+  /* Only now that the set is complete can other threads find it */
+
+  freebound[nput].f1 = f1;
+  freebound[nput].f2 = f2;
+  OMP_PRAGMA (omp flush)
+  if (nput == nfb)
+    nfb++;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      initializes the structure fb_struc as well as some
+ * associated arrays and variables (found in sirocco.h) that describe
+ * recombination rates and band-limited luminosities.
+ *
+ * @param [in] double  t1   A lower limit for the temperature
+ * @param [in] double  t2   An upper limit for the temperature
+ * @param [in] double  f1   The lower limit for a frequency interval
+ * @param [in] double  f2   The upper limit for the frequency interval
+ * @return     The routine generally returns 0
+ *
+ * @details
+ * Python typically calculates photons in frequency ranges (in order
+ * to enable stratified sampling).  For this to work, one needs
+ * freebound emissivities and cooling rates corresponding to these
+ * freqency ranges.  Since we retrun to the same frequency ranges every cycle,
+ * Python stores the necessary information in structures.
+ *
+ * This routine is responsible for populating these structures, so
+ * that they can be accessed later via the routine get_fb.
+ *
+ *
+ *
+ * ### Notes ###
+ *
+ * The first time the routine is called, both recombination
+ * rates and band-limited luminosities are calculated.  On
+ * subsequent calls the routine checks to see whether it has
+ * already calculated the band-limited freebound emissivities,
+ * and if so returns without redoing the calculation.  However,
+ * if a new frequency interval is provided, the new luminosities
+ * are added to the free-bound structure.  To force a
+ * re-initialization nfb must be set to 0.
+ *
+ * When the wind is updated by several threads, the new information
+ * is calculated by one thread, in make_freebound, while the others wait.
+ *
+ * The routine allows for the possibility that there are more
+ * frequency intervals than place to store data and will recylce
+ * the structure if this occurs (indicating this with several error
+ * messages).  This allows the program to proceed, but if this
+ * happens often then the variable NFB in sirocco.h should be increased.
+ *
+ **********************************************************/
+
+int
+init_freebound (t1, t2, f1, f2)
+     double t1, t2, f1, f2;
+{
+  int i;
+
+  /* Almost always the information has already been calculated, which can be
+     checked without waiting for any thread which is calculating a new set */
+
+  for (i = 0; i < nfb; i++)
+  {
+    if (freebound[i].f1 == f1 && freebound[i].f2 == f2)
+    {
+      return (0);
+    }
+  }
+
+  OMP_PRAGMA (omp critical (init_freebound))
+  make_freebound (t1, t2, f1, f2);
+
   return (0);
 }
 
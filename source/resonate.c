@@ -84,58 +84,79 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
      double smax;
      int *istat;
 {
-  int nion_for_resonance;
-  int n, current_res_number, nstart, ndelt;
-  double kap_es;
-  double freq_inner, freq_outer, dfreq, running_tau, freq_av;
-  double mean_freq;
-  double fraction_to_resonance;
-  double ds_current, ds;
-  double dvds_cmf, density_cmf;
-  double dvds1, dvds2;
-  struct photon p_start, p_stop, p_now;
-  struct photon p_start_cmf, p_stop_cmf, p_now_cmf;
-  int init_dvds;
-  double kap_bf_tot, kap_ff, kap_cont, kap_cont_obs;
-  double tau_sobolev;
-  WindPtr one, two;
-  int check_in_grid;
-  int nplasma;
+  struct ds_path path;
+  double ds, t0;
+
+  t0 = prof_start ();
+
+  ds_path_continuum (w, p, smax, &path);
+  ds = ds_path_lines (w, p, tau_scat, tau, nres, &path, istat);
+
+  prof_stop (PROF_CALCULATE_DS, t0);
+
+  return (ds);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief     find the range of co-moving frequencies a photon will sample
+ * as it moves through a cell, and the continuum opacity along the path
+ *
+ * @param [in] WindPtr  w   the entire wind structure
+ * @param [in] PhotPtr  p   A photon (bundle)
+ * @param [in] double  smax   the maximum distance the photon can
+ *                          travel in the cell
+ * @param [out] struct ds_path *  path   the frequency range and continuum
+ *                          opacities for the path
+ * @return                  Always returns 0
+ *
+ * @details
+ * This is the first half of calculate_ds.  The maximum distance is reduced
+ * (by factors of 2) until the co-moving frequency varies linearly enough
+ * along the path that the resonances can be located by interpolation.
+ * The continuum opacity, which is assumed to be constant along the path,
+ * is evaluated at the mean frequency.
+ *
+ * ### Notes ###
+ *
+ * The routine is separate from ds_path_lines so that the two stages can be
+ * applied to batches of photons by the event-based transport engine.
+ *
+ **********************************************************/
+
+int
+ds_path_continuum (w, p, smax, path)
+     WindPtr w;
+     PhotPtr p;
+     double smax;
+     struct ds_path *path;
+{
+  double freq_start, freq_stop, diff, mean_freq;
+  struct photon p_now, p_now_cmf;
+  WindPtr one;
   PlasmaPtr xplasma;
   int ndom;
-  double normal[3];
-  double diff;
 
   one = &w[p->grid];
-  nplasma = one->nplasma;
-  xplasma = &plasmamain[nplasma];
+  xplasma = &plasmamain[one->nplasma];
   ndom = one->ndom;
 
-  running_tau = *tau;
-  ds_current = 0;
-  init_dvds = 0;
-  dvds1 = dvds2 = 0.0;
-  *nres = -1;
-  *istat = P_INWIND;
-
-  if (running_tau < 0.0)
-  {
-    Error ("calculate_ds: photon %d has negative tau  %8.2e at %g entering calculate_ds\n", p->np, running_tau, p->freq);
-  }
-
   /* XFRAME - Next section is a problem, but not directly related to CMF.  ksl thinks we want just the
      frequencies at the ends of the paths, but we do not want photon direction to change to CMF frame
    */
 
-  stuff_phot (p, &p_start);
-  observer_to_local_frame (&p_start, &p_start_cmf);
+  observer_to_local_frame (p, &p_now_cmf);
+  freq_start = p_now_cmf.freq;
 
-  stuff_phot (p, &p_stop);
-  move_phot (&p_stop, smax);
-  observer_to_local_frame (&p_stop, &p_stop_cmf);
+  stuff_phot (p, &p_now);
+  move_phot (&p_now, smax);
+  observer_to_local_frame (&p_now, &p_now_cmf);
+  freq_stop = p_now_cmf.freq;
 
-  /* At this point p_start_cmf and p_stop_cmf are in the local frame
-   * at the and p_stop is at the maximum distance it can 
+  /* At this point freq_start and freq_stop are the frequencies in the local frame
+   * at the start of the path and at the maximum distance it can 
    * travel. We want to check that the frequency shift is
    * not too great along the path that a linear approximation
    * to the change in frequency is not reasonable
@@ -146,25 +167,22 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
     stuff_phot (p, &p_now);
     move_phot (&p_now, smax * 0.5);
     observer_to_local_frame (&p_now, &p_now_cmf);
-    diff = fabs (p_now_cmf.freq - 0.5 * (p_start_cmf.freq + p_stop_cmf.freq)) / p_start_cmf.freq;
+    diff = fabs (p_now_cmf.freq - 0.5 * (freq_start + freq_stop)) / freq_start;
     if (diff < MAXDIFF)
     {
       break;
     }
-    stuff_phot (&p_now, &p_stop);
-    stuff_phot (&p_now_cmf, &p_stop_cmf);
+    freq_stop = p_now_cmf.freq;
     smax *= 0.5;
   }
 
+  path->smax = smax;
+  path->freq_inner = freq_start;
+  path->freq_outer = freq_stop;
 
-
-
-  freq_inner = p_start_cmf.freq;
-  freq_outer = p_stop_cmf.freq;
-
-  if (freq_inner < 0 || freq_outer < 0)
+  if (freq_start < 0 || freq_stop < 0)
   {
-    Error ("calculate_ds: photon %d has negative freq_inner %e freq_outer %e\n", p_start_cmf.np, freq_inner, freq_outer);
+    Error ("calculate_ds: photon %d has negative freq_inner %e freq_outer %e\n", p->np, freq_start, freq_stop);
   }
 
   /* We use the doppler shifted frequency to compute the Klein-Nishina cross
@@ -174,42 +192,13 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
    * for every little path section between resonances
    */
 
-  mean_freq = 0.5 * (freq_inner + freq_outer);
-  dfreq = freq_outer - freq_inner;
-
-  /* The next section limits the the resonances we have to worry about, and it
-   * checks to see if the frequency difference at the start and end of the path
-   * is very small .If there difference is smaller, then there are no resonances
-   * to consider. Previously, we would have returned at this point but now we
-   * allow the photon to still try and scatter.
-   */
-
-  if (fabs (dfreq) < EPSILON)
-  {
-    Error ("calculate_ds: frequency along photon %d path's in cell %d (nplasma %d) is the same (dfreq=%8.2e)\n", p_now.np, one->nwind,
-           one->nplasma, dfreq);
-    limit_lines (freq_inner, freq_outer);
-    nstart = nline_min;
-    ndelt = 1;
-  }
-  else if (dfreq > 0)
-  {
-    limit_lines (freq_inner, freq_outer);
-    nstart = nline_min;
-    ndelt = 1;
-  }
-  else
-  {
-    limit_lines (freq_outer, freq_inner);
-    nstart = nline_max;
-    ndelt = (-1);
-  }
+  mean_freq = 0.5 * (freq_start + freq_stop);
 
   /* Compute the angle averaged electron scattering cross section. Note
    * electron scattering is always treated as a scattering event.
    */
 
-  kap_es = klein_nishina (mean_freq) * xplasma->ne * zdom[ndom].fill;
+  path->kap_es = klein_nishina (mean_freq) * xplasma->ne * zdom[ndom].fill;
 
   /* If in macro-atom mode, calculate the bf and ff opacities, because in
    * macro-atom mode everything including bf is calculated as a scattering
@@ -220,23 +209,22 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
    * needed.
    */
 
-  kap_bf_tot = 0;
-  kap_ff = 0;
+  path->kap_bf_tot = 0;
+  path->kap_ff = 0;
 
   if (geo.rt_mode == RT_MODE_MACRO)
   {
-    freq_av = 0.5 * (freq_inner + freq_outer);
-    kap_bf_tot = kappa_bf (xplasma, freq_av, 0);
-    kap_ff = kappa_ff (xplasma, freq_av);
+    path->kap_bf_tot = kappa_bf (xplasma, mean_freq, 0);
+    path->kap_ff = kappa_ff (xplasma, mean_freq);
   }
 
   if (one->inwind < 0)
   {
-    kap_bf_tot = kap_ff = 0.0;
+    path->kap_bf_tot = path->kap_ff = 0.0;
     Error_silent ("ds_calculate: wind vol = 0 for cell %d photon position %g %g %g\n", p->grid, p->x[0], p->x[1], p->x[2]);
   }
 
-  kap_cont = kap_es + kap_bf_tot + kap_ff;      //total continuum opacity in CMF frame
+  path->kap_cont = path->kap_es + path->kap_bf_tot + path->kap_ff;      //total continuum opacity in CMF frame
 
   /* 
      Multiply by scale factor to get to observer frame
@@ -249,8 +237,125 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
      230918 - The current version of this added in 87e
    */
 
-  kap_cont_obs = kap_cont * observer_to_local_frame_ds (p, 1.);
+  path->kap_cont_obs = path->kap_cont * observer_to_local_frame_ds (p, 1.);
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief     find the distance a photon can travel along a path before
+ * it scatters, given the continuum opacity and the resonances it passes through
+ *
+ * @param [in] WindPtr  w   the entire wind structure
+ * @param [in] PhotPtr  p   A photon (bundle)
+ * @param [in] double  tau_scat   the optical depth at which the photon
+ *                          will scatter
+ * @param [in,out] double *  tau   Initially the current optical depth for
+ *                          the photon; finally the optical depth 
+ *                          at the distance the photon can be
+ *                          moved.
+ * @param [out] int *  nres   the number of the resonance, or the continuum
+ *                          process, which stopped the photon
+ * @param [in] struct ds_path *  path   the path, as set up by ds_path_continuum
+ * @param [out] int *  istat   P_SCAT if the photon scatters, P_INWIND otherwise
+ * @return                  The distance the photon can travel in the observer frame
+ *
+ * @details
+ * This is the second half of calculate_ds, which loops over the resonances
+ * between the co-moving frequencies at the ends of the path, adding the
+ * Sobolev optical depth of each line and the continuum optical depth
+ * between them until tau_scat is reached.
+ *
+ **********************************************************/
+
+double
+ds_path_lines (w, p, tau_scat, tau, nres, path, istat)
+     WindPtr w;
+     PhotPtr p;
+     double tau_scat, *tau;
+     int *nres;
+     struct ds_path *path;
+     int *istat;
+{
+  int nion_for_resonance;
+  int n, current_res_number, nstart, ndelt;
+  double freq_inner, dfreq, running_tau;
+  double fraction_to_resonance;
+  double ds_current, ds, smax;
+  double dvds_cmf, density_cmf;
+  double dvds1, dvds2;
+  double x_now[3];
+  struct photon p_stop, p_now, p_now_cmf;
+  int init_dvds;
+  double kap_cont_obs;
+  double tau_sobolev;
+  WindPtr one, two;
+  int check_in_grid;
+  int nplasma;
+  PlasmaPtr xplasma;
+  int ndom;
+  double normal[3];
+  LineListPtr lines;
+
+  one = &w[p->grid];
+  nplasma = one->nplasma;
+  xplasma = &plasmamain[nplasma];
+  ndom = one->ndom;
+
+  running_tau = *tau;
+  ds_current = 0;
+  init_dvds = 0;
+  dvds1 = dvds2 = 0.0;
+  *nres = -1;
+  *istat = P_INWIND;
+
+  if (running_tau < 0.0)
+  {
+    Error ("calculate_ds: photon %d has negative tau  %8.2e at %g entering calculate_ds\n", p->np, running_tau, p->freq);
+  }
+
+  smax = path->smax;
+  freq_inner = path->freq_inner;
+  dfreq = path->freq_outer - path->freq_inner;
+  kap_cont_obs = path->kap_cont_obs;
+
+  /* The next section limits the the resonances we have to worry about, and it
+   * checks to see if the frequency difference at the start and end of the path
+   * is very small .If there difference is smaller, then there are no resonances
+   * to consider. Previously, we would have returned at this point but now we
+   * allow the photon to still try and scatter.
+   */
+
+  /* With --prune-lines, only the lines which can have a significant optical
+   * depth in this cell are considered (see line_lists.c), and nline_min and
+   * nline_max are indices into the list of these lines
+   */
+
+  lines = modes.prune_lines ? cell_lines (nplasma) : NULL;
 
+  if (fabs (dfreq) < EPSILON)
+  {
+    Error ("calculate_ds: frequency along photon %d path's in cell %d (nplasma %d) is the same (dfreq=%8.2e)\n", p->np, one->nwind,
+           one->nplasma, dfreq);
+    limit_cell_lines (lines, path->freq_inner, path->freq_outer);
+    nstart = nline_min;
+    ndelt = 1;
+  }
+  else if (dfreq > 0)
+  {
+    limit_cell_lines (lines, path->freq_inner, path->freq_outer);
+    nstart = nline_min;
+    ndelt = 1;
+  }
+  else
+  {
+    limit_cell_lines (lines, path->freq_outer, path->freq_inner);
+    nstart = nline_max;
+    ndelt = (-1);
+  }
 
   /* Finally begin the loop over the resonances that can interact
    * with the photon in the cell
@@ -258,8 +363,16 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
 
   for (n = 0; n < nline_delt; n++)
   {
-    current_res_number = nstart + n * ndelt;
-    fraction_to_resonance = (lin_ptr[current_res_number]->freq - freq_inner) / dfreq;
+    if (lines != NULL)
+    {
+      current_res_number = lines->nline[nstart + n * ndelt];
+      fraction_to_resonance = (lines->freq[nstart + n * ndelt] - freq_inner) / dfreq;
+    }
+    else
+    {
+      current_res_number = nstart + n * ndelt;
+      fraction_to_resonance = (lin_ptr[current_res_number]->freq - freq_inner) / dfreq;
+    }
 
     if (0.0 < fraction_to_resonance && fraction_to_resonance < 1.0)     /* this particular line is in resonance */
     {
@@ -269,7 +382,7 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
        * within dfudge then we skip over the resonance.
        */
 
-      if (p_now.nres == current_res_number && ds < wmain[p->grid].dfudge)
+      if (p->nres == current_res_number && ds < wmain[p->grid].dfudge)
       {
         continue;
       }
@@ -284,7 +397,7 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
          * We need to randomly select the continuum process which caused
          * the photon to scatter. The variable threshold is used for this. */
 
-        *nres = select_continuum_scattering_process (kap_cont, kap_es, kap_ff, xplasma);
+        *nres = select_continuum_scattering_process (path->kap_cont, path->kap_es, path->kap_ff, xplasma);
         *istat = P_SCAT;
         ds_current += (tau_scat - running_tau) / (kap_cont_obs);
         running_tau = tau_scat;
@@ -304,9 +417,8 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
         /* The density is calculated in the wind array at the center of a cell.
          * We use that as the first estimate of the density.  */
 
-        stuff_phot (p, &p_now);
-        move_phot (&p_now, ds_current);
-        density_cmf = get_ion_density (ndom, p_now.x, nion_for_resonance);
+        vmove (p->x, p->lmn, ds_current, x_now);
+        density_cmf = get_ion_density (ndom, x_now, nion_for_resonance);
 
         if (density_cmf > LDEN_MIN)
         {
@@ -316,6 +428,8 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
 
           if (init_dvds == FALSE)
           {
+            stuff_phot (p, &p_stop);
+            move_phot (&p_stop, smax);
             dvds1 = dvwind_ds_cmf (p);
             dvds2 = dvwind_ds_cmf (&p_stop);
             init_dvds = TRUE;
@@ -328,7 +442,7 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
            * fixed in sobolev. 
            */
 
-          tau_sobolev = sobolev (one, p_now.x, density_cmf, lin_ptr[current_res_number], dvds_cmf);
+          tau_sobolev = sobolev (one, x_now, density_cmf, lin_ptr[current_res_number], dvds_cmf);
           running_tau += tau_sobolev;
 
           if (geo.rt_mode == RT_MODE_MACRO)
@@ -339,6 +453,8 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
              * second get a pointer to the grid cell where the resonance really happens.
              */
 
+            stuff_phot (p, &p_now);
+            move_phot (&p_now, ds_current);
             check_in_grid = walls (&p_now, p, normal);
 
             if (check_in_grid != P_HIT_STAR && check_in_grid != P_HIT_DISK && check_in_grid != P_ESCAPE)
@@ -390,7 +506,7 @@ calculate_ds (w, p, tau_scat, tau, nres, smax, istat)
 
   if (running_tau + kap_cont_obs * (smax - ds_current) > tau_scat)      /* A scattering event has occurred in the shell and we remain in the same shell */
   {
-    *nres = select_continuum_scattering_process (kap_cont, kap_es, kap_ff, xplasma);
+    *nres = select_continuum_scattering_process (path->kap_cont, path->kap_es, path->kap_ff, xplasma);
     ds_current += (tau_scat - running_tau) / (kap_cont_obs);
     *istat = P_SCAT;
     running_tau = tau_scat;
@@ -486,6 +602,14 @@ select_continuum_scattering_process (kap_cont, kap_es, kap_ff, xplasma)
       Exit (0);
     }
 
+    /* If the opacity came from the tables in bf_cache.c, the process is found
+       by a search of the cumulative opacities */
+
+    if (modes.bf_cache && (ncont = bf_cache_select (xplasma, threshold - kap_es - kap_ff)) >= 0)
+    {
+      return (NLINES + 1 + xplasma->kbf_use[ncont]);
+    }
+
     run_tot = kap_es + kap_ff;
     ncont = 0;
     while (run_tot < threshold)
@@ -501,6 +625,34 @@ select_continuum_scattering_process (kap_cont, kap_es, kap_ff, xplasma)
 
 
 
+/**********************************************************/
+/**
+ * @brief      allocate kap_bf for this thread
+ *
+ * @return     Always returns 0
+ *
+ * @details
+ * kap_bf has room for all of the photoionization processes, since any of
+ * them may be in use in a cell.
+ *
+ **********************************************************/
+
+int
+kappa_bf_work (void)
+{
+  free (kap_bf);
+  if ((kap_bf = calloc (nphot_total > 0 ? nphot_total : 1, sizeof (double))) == NULL)
+  {
+    Error ("kappa_bf_work: Unable to allocate memory for %d photoionization processes\n", nphot_total);
+    Exit (0);
+  }
+  kap_bf_size = nphot_total > 0 ? nphot_total : 1;
+
+  return (0);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      calculate the bf opacity in a specific
@@ -520,6 +672,9 @@ select_continuum_scattering_process (kap_cont, kap_es, kap_ff, xplasma)
  * The routine allows for clumping, reducing kappa_bf by the filling
  * factor.
  *
+ * If the bound-free opacities have been tabulated for this cell (see
+ * bf_cache.c), the total is interpolated from the table, and kap_bf is
+ * only filled in if it is needed, by bf_cache_expand.
  *
  **********************************************************/
 
@@ -532,14 +687,19 @@ kappa_bf (xplasma, freq, macro_all)
 
 {
   double kap_bf_tot;
-  double ft;
   double x;
-  int nconf;
-  double density;
   int n;
   int nn;
   int ndom;
 
+  if (kap_bf_size < nphot_total)
+    kappa_bf_work ();
+
+  if (modes.bf_cache && (kap_bf_tot = bf_cache_kappa (xplasma, freq, macro_all)) >= 0.0)
+  {
+    return (kap_bf_tot);
+  }
+
   kap_bf_tot = 0;
 
   macro_all--;                  // Subtract one from macro_all to avoid >= in for loop below.
@@ -549,25 +709,58 @@ kappa_bf (xplasma, freq, macro_all)
   for (nn = 0; nn < xplasma->kbf_nuse; nn++)    // Loop over photoionisation processes.
   {
     n = xplasma->kbf_use[nn];
-    ft = phot_top[n].freq[0];   //This is the edge frequency (SS)
 
     kap_bf[nn] = 0.0;
 
-    if (freq > ft && freq < phot_top[n].freq[phot_top[n].np - 1] && phot_top[n].macro_info > macro_all)
+    if (phot_top[n].macro_info > macro_all)
     {
+      kap_bf[nn] = x = kappa_bf_process (xplasma, n, freq, zdom[ndom].fill);
+      kap_bf_tot += x;
+    }
+  }
 
-      nconf = phot_top[n].nlev;
-      density = den_config (xplasma, nconf);
+  return (kap_bf_tot);
+}
 
-      if (density > DENSITY_PHOT_MIN || phot_top[n].macro_info == TRUE)
-      {
-        kap_bf[nn] = x = sigma_phot (&phot_top[n], freq) * density * zdom[ndom].fill;
-        kap_bf_tot += x;
-      }
+
+
+/**********************************************************/
+/**
+ * @brief      calculate the opacity of a single bf process in a
+ * 	cell at a specific frequency
+ *
+ * @param [in] PlasmaPtr  xplasma   The plasma cell of interest
+ * @param [in] int  n   The index of the process in phot_top
+ * @param [in] double  freq   The frequency at which the opacity is calculated
+ * @param [in] double  fill   The filling factor of the domain
+ * @return     The bf opacity of the process
+ *
+ * @details
+ * The opacity is zero outside the range of the cross section, and for
+ * processes which are not treated as macro atoms if the density of the
+ * lower level is negligible.
+ *
+ **********************************************************/
+
+double
+kappa_bf_process (xplasma, n, freq, fill)
+     PlasmaPtr xplasma;
+     int n;
+     double freq, fill;
+{
+  double density;
+
+  if (freq > phot_top[n].freq[0] && freq < phot_top[n].freq[phot_top[n].np - 1])
+  {
+    density = den_config (xplasma, phot_top[n].nlev);
+
+    if (density > DENSITY_PHOT_MIN || phot_top[n].macro_info == TRUE)
+    {
+      return (sigma_phot (&phot_top[n], freq) * density * fill);
     }
   }
 
-  return (kap_bf_tot);
+  return (0.0);
 }
 
 
@@ -674,6 +867,13 @@ kbf_need (freq_min, freq_max)
     xplasma->kbf_nuse = nuse;
   }
 
+  /* The tables of bf opacity depend on the processes selected here, so they are
+     rebuilt every time the processes change */
+
+  if (modes.bf_cache && geo.rt_mode == RT_MODE_MACRO)
+  {
+    bf_cache_build (freq_min, freq_max);
+  }
 
   return (0);
 }
@@ -717,7 +917,6 @@ sobolev (one, x, den_ion, lptr, dvds)
   double tau, xden_ion, tau_x_dvds, levden_upper;
   double d1, d2;
   int nion;
-  double d_hold;
   int nplasma;
   int ndom;
   PlasmaPtr xplasma;
@@ -755,18 +954,11 @@ ion which was done above in calculate ds.  It was made necessary by a change in
 calls to two_level atom
 */
 
-    d_hold = xplasma->density[nion];    // Store the density of this ion in the cell
-
     if (den_ion < 0)
     {
-      xplasma->density[nion] = get_ion_density (ndom, x, lptr->nion);   // Forced calculation of density
+      den_ion = get_ion_density (ndom, x, lptr->nion);  // Forced calculation of density
     }
-    else
-    {
-      xplasma->density[nion] = den_ion; // Put den_ion into the density array
-    }
-    two_level_atom (lptr, xplasma, &d1, &d2);   // Calculate d1 & d2
-    xplasma->density[nion] = d_hold;    // Restore w
+    two_level_atom_ion (lptr, xplasma, den_ion, &d1, &d2);      // Calculate d1 & d2
     levden_upper = d2 / xplasma->density[nion];
   }
 
@@ -917,6 +1109,8 @@ scatter (p, nres, nnscat)
     return (-1);
   }
 
+  prof_cell_scatter (n);
+
 
   if (observer_to_local_frame (p, p))
   {
@@ -1240,10 +1434,12 @@ if fixed.
 
     if (p_orig.x[2] < 0)
       dp_cyl[2] *= (-1);
+    lock_plasma_cell (xplasma->nplasma);
     for (i = 0; i < 3; i++)
     {
       xplasma->dmo_dt[i] += dp_cyl[i];
     }
+    unlock_plasma_cell (xplasma->nplasma);
 
   }
 
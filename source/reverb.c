@@ -20,6 +20,22 @@ char delay_dump_file[LINELENGTH];
 int delay_dump_bank_size = 65535, delay_dump_bank_curr = 0;
 int *delay_dump_spec;
 PhotPtr delay_dump_bank;
+FILE *delay_dump_fptr = NULL;   /* The binary dump file, which is kept open */
+
+/* A photon in the binary dump file; the doubles come first so that there is no padding */
+struct delay_dump_record
+{
+  double freq, w, x[3], delay;
+  int np, nscat, nrscat, spec, origin, nres, line_res, unused;
+};
+
+#define DELAY_DUMP_MAGIC  "SIRDDUMP"
+#define REVERB_TF_MAGIC   "SIRRVTF1"
+
+double *reverb_tf = NULL;       /* The transfer functions, see reverb_tf_init */
+int reverb_tf_nspec, reverb_tf_nhist;
+double reverb_tf_delay_max, reverb_tf_lfreqmin, reverb_tf_dlfreq;
+long reverb_tf_subzero = 0;     /* The number of photons with negative delays */
 
 
 /**********************************************************/
@@ -49,6 +65,69 @@ delay_to_observer (PhotPtr pp)
   return (pp->path + ds_to_plane (&observer, pp, FALSE));
 }
 
+/**********************************************************/
+/**
+ * @brief	Checks whether a photon belongs in a spectrum
+ *
+ * @param [in] pp			Photon extracted to the spectrum
+ * @param [in] i_spec		The spectrum
+ * @return 					TRUE if the photon contributes
+ *
+ * Applies the same selection on the number of scatters and
+ * the side of the disk as the spectrum itself.  A negative
+ * value of nscat for the spectrum means that photons with
+ * |nscat| or more scatters are accepted.
+***********************************************************/
+static int
+delay_dump_selected (PhotPtr pp, int i_spec)
+{
+  int mscat, mtopbot;
+
+  mscat = xxspec[i_spec].nscat;
+  mtopbot = xxspec[i_spec].top_bot;
+
+  return ((mscat >= MAXSCAT || pp->nscat == mscat || (mscat < 0 && pp->nscat >= (-mscat)))
+          && (mtopbot == 0 || (mtopbot * pp->x[2]) > 0));
+}
+
+/**********************************************************/
+/**
+ * @brief	Opens the binary delay dump file
+ *
+ * @param [in] restart_stat If this is a restart run
+ * @return 					0
+ *
+ * The file is kept open, with a large buffer, until
+ * delay_dump_finish().  Rank 0 writes a header, consisting
+ * of DELAY_DUMP_MAGIC and the size of each record as an int,
+ * followed by a struct delay_dump_record for each photon.
+ * The other ranks write only records, so that their files
+ * can be appended to that of rank 0.
+***********************************************************/
+static int
+delay_dump_binary_open (int restart_stat)
+{
+  int nbytes;
+
+  if ((delay_dump_fptr = fopen (delay_dump_file, restart_stat == TRUE ? "a" : "w")) == NULL)
+  {
+    Error ("delay_dump_prep: Thread %d failed to open file '%s' due to error %d: %s\n", rank_global, delay_dump_file, errno,
+           strerror (errno));
+    return (0);
+  }
+  setvbuf (delay_dump_fptr, NULL, _IOFBF, 1 << 22);
+
+  if (restart_stat == FALSE && rank_global == 0)
+  {
+    nbytes = sizeof (struct delay_dump_record);
+    fwrite (DELAY_DUMP_MAGIC, 1, strlen (DELAY_DUMP_MAGIC), delay_dump_fptr);
+    fwrite (&nbytes, sizeof (int), 1, delay_dump_fptr);
+  }
+
+  Log ("delay_dump_prep: Thread %d successfully prepared file '%s' for writing\n", rank_global, delay_dump_file);
+  return (0);
+}
+
 /**********************************************************/
 /** 
  * @brief	Prepares delay dump output file
@@ -64,6 +143,9 @@ delay_to_observer (PhotPtr pp)
  * thread. The file is then built up in batches using
  * delay_dump() in increments of #delay_dump_bank_size.
  *
+ * With --reverb-tf, photons are only dumped if
+ * --reverb-dump-binary is also given.
+ *
  * ###Notes###
  * 9/14	-	Written by SWM
 ***********************************************************/
@@ -74,14 +156,17 @@ delay_dump_prep (int restart_stat)
   char s_time[LINELENGTH];
   int i;
 
+  if (modes.reverb_tf && !modes.reverb_dump_binary)
+    return (0);
+
   //Get output filename
   if (rank_global > 0)
   {
-    sprintf (delay_dump_file, "%.100s.delay_dump%d", files.root, rank_global);
+    sprintf (delay_dump_file, "%.100s.delay_dump%s%d", files.root, modes.reverb_dump_binary ? ".bin" : "", rank_global);
   }
   else
   {
-    sprintf (delay_dump_file, "%.100s.delay_dump", files.root);
+    sprintf (delay_dump_file, "%.100s.delay_dump%s", files.root, modes.reverb_dump_binary ? ".bin" : "");
   }
 
   //Allocate and zero dump files and set extract status
@@ -90,6 +175,9 @@ delay_dump_prep (int restart_stat)
   for (i = 0; i < delay_dump_bank_size; i++)
     delay_dump_spec[i] = 0;
 
+  if (modes.reverb_dump_binary)
+    return (delay_dump_binary_open (restart_stat));
+
   if (restart_stat == TRUE)
   {                             //Check whether the output file already has a header
     Log ("delay_dump_prep: Resume run, skipping writeout\n");
@@ -128,7 +216,8 @@ delay_dump_prep (int restart_stat)
  *
  * @return 					0
  *
- * Dumps the remaining tracked photons to file, frees memory.
+ * Dumps the remaining tracked photons to file, frees memory,
+ * and writes out the transfer functions with --reverb-tf.
  *
  * ###Notes###
  * 6/15	-	Written by SWM
@@ -136,10 +225,20 @@ delay_dump_prep (int restart_stat)
 int
 delay_dump_finish (void)
 {
-  Log ("delay_dump_finish: Dumping %d photons to file\n", delay_dump_bank_curr - 1);
+  if (modes.reverb_tf)
+    reverb_tf_write ();
+  if (modes.reverb_tf && !modes.reverb_dump_binary)
+    return (0);
+
+  Log ("delay_dump_finish: Dumping %d photons to file\n", delay_dump_bank_curr);
   if (delay_dump_bank_curr > 0)
   {
-    delay_dump (delay_dump_bank, delay_dump_bank_curr - 1);
+    delay_dump (delay_dump_bank, delay_dump_bank_curr);
+  }
+  if (delay_dump_fptr != NULL)
+  {
+    fclose (delay_dump_fptr);
+    delay_dump_fptr = NULL;
   }
   free (delay_dump_bank);
   free (delay_dump_spec);
@@ -178,7 +277,11 @@ delay_dump_combine (int i_ranks)
 	}
 	fclose(f_base);
 */
+  if (modes.reverb_tf && !modes.reverb_dump_binary)
+    return (0);
+
   //Yes this is done as a system call and won 't work on Windows machines. Lazy solution!
+  //Only rank 0 writes a header, so this also works for the binary files
   sprintf (c_call, "cat %.50s[0-9]* >> %.100s", delay_dump_file, delay_dump_file);
   if (system (c_call) < 0)
   {
@@ -216,40 +319,52 @@ int
 delay_dump (PhotPtr p, int np)
 {
   FILE *fopen (), *fptr;
-  int nphot, mscat, mtopbot, i, subzero;
+  struct delay_dump_record record;
+  int nphot, i, subzero;
   double delay;
   subzero = 0;
 
   Log ("delay_dump: Dumping %d photons\n", np);
   /*
-   * Open a file for writing the spectrum
+   * Open a file for writing the spectrum, unless this
+   * is the binary file, which is kept open
    */
-  if ((fptr = fopen (delay_dump_file, "a")) == NULL)
+  if (delay_dump_fptr != NULL)
+  {
+    fptr = delay_dump_fptr;
+  }
+  else if ((fptr = fopen (delay_dump_file, "a")) == NULL)
   {
     Error ("delay_dump: Unable to reopen %s for writing\n", delay_dump_file);
     Exit (0);
   }
   for (nphot = 0; nphot < np; nphot++)
   {
-    /*
-     * Complicated if statement to allow one to choose
-     * whether to construct the spectrum from all photons
-     * or just from photons which have scattered a
-     * specific number of times.  01apr13--ksl-Modified
-     * if statement to change behavior on negative
-     * numbers to say that a negative number for mscat
-     * implies that you accept any photon with |mscat| or
-     * more scatters
-     */
     i = delay_dump_spec[nphot];
-    if (((mscat = xxspec[i].nscat) >= MAXSCAT ||
-         p[nphot].nscat == mscat ||
-         (mscat < 0 && p[nphot].nscat >= (-mscat))) && ((mtopbot = xxspec[i].top_bot) == 0 || (mtopbot * p[nphot].x[2]) > 0))
+    if (delay_dump_selected (&p[nphot], i))
     {
       delay = (delay_to_observer (&p[nphot]) - geo.rmax) / VLIGHT;
       if (delay < 0)
         subzero++;
 
+      if (delay_dump_fptr != NULL)
+      {
+        record.freq = p[nphot].freq;
+        record.w = p[nphot].w;
+        stuff_v (p[nphot].x, record.x);
+        record.delay = delay;
+        record.np = p[nphot].np;
+        record.nscat = p[nphot].nscat;
+        record.nrscat = p[nphot].nrscat;
+        record.spec = i - MSPEC;
+        record.origin = p[nphot].origin;
+        record.nres = p[nphot].nres;
+        record.line_res = p[nphot].line_res;
+        record.unused = 0;
+        fwrite (&record, sizeof (record), 1, delay_dump_fptr);
+        continue;
+      }
+
       fprintf (fptr, "%-12d %-12.5g %-12.7g %-12.5g %-12.5g %-12.5g %-12.5g %-12d %-12d %-12.5g %-12d %-12d %-12d %-12d\n",
                p[nphot].np, p[nphot].freq, VLIGHT * 1e8 / p[nphot].freq, p[nphot].w, p[nphot].x[0], p[nphot].x[1], p[nphot].x[2],
                p[nphot].nscat, p[nphot].nrscat, delay, i - MSPEC, p[nphot].origin, p[nphot].nres, p[nphot].line_res);
@@ -260,7 +375,8 @@ delay_dump (PhotPtr p, int np)
   {
     Error ("delay_dump: %d photons with <0 delay found! Increase path bin resolution to minimise this error.", subzero);
   }
-  fclose (fptr);
+  if (fptr != delay_dump_fptr)
+    fclose (fptr);
   return (0);
 }
 
@@ -273,7 +389,8 @@ delay_dump (PhotPtr p, int np)
  * @return 					0
  *
  * Takes a photon and copies it to the staging arrays for 
- * delay dumping, to be output to file later.
+ * delay dumping, to be output to file later, or with
+ * --reverb-tf adds it to the transfer functions.
  *
  * ###Notes###
  * 6/15	-	Written by SWM
@@ -297,16 +414,242 @@ delay_dump_single (PhotPtr pp, int i_spec)
       return (1);
   }
 
-  stuff_phot (pp, &delay_dump_bank[delay_dump_bank_curr]);      //Bank single photon in temp array
-  delay_dump_spec[delay_dump_bank_curr] = i_spec;       //Record photon spectrum too
-  if (delay_dump_bank_curr == delay_dump_bank_size - 1) //If temp array is full
+  if (modes.reverb_tf)
+  {
+    reverb_tf_add (pp, i_spec);
+    if (!modes.reverb_dump_binary)
+      return (0);
+  }
+
+  OMP_PRAGMA (omp critical (delay_dump))
+  {
+    stuff_phot (pp, &delay_dump_bank[delay_dump_bank_curr]);    //Bank single photon in temp array
+    delay_dump_spec[delay_dump_bank_curr] = i_spec;     //Record photon spectrum too
+    if (delay_dump_bank_curr == delay_dump_bank_size - 1)       //If temp array is full
+    {
+      delay_dump (delay_dump_bank, delay_dump_bank_size);
+      delay_dump_bank_curr = 0; //Dump to file, zero array position
+    }
+    else
+    {
+      delay_dump_bank_curr++;
+    }
+  }
+  return (0);
+}
+
+/**********************************************************/
+/**
+ * @brief	Sets up the transfer functions
+ *
+ * @return 					0
+ *
+ * This is called once the spectra have been set up, at the
+ * start of the spectral cycles.  With --reverb-tf, the photons which would be dumped are
+ * instead added to transfer functions, histograms of the
+ * luminosity in delay and wavelength, for each of the
+ * observer angles.  The first transfer function for each
+ * angle contains all such photons, and there is one more for
+ * each line given by Reverb.filter_line, containing only
+ * the photons which last interacted with that line.
+ *
+ * The delay bins are linear, from 0 to 2 rmax/c, the largest
+ * delay for a photon scattered once, with an extra bin for
+ * larger delays.  The wavelength bins are logarithmic and
+ * cover the range of the spectra.
+***********************************************************/
+int
+reverb_tf_init (void)
+{
+  size_t n;
+
+  reverb_tf_nspec = nspectra - MSPEC;
+  reverb_tf_nhist = 1 + (geo.reverb_filter_lines > 0 ? geo.reverb_filter_lines : 0);
+  if (reverb_tf_nspec < 1)
+  {
+    Error ("reverb_tf_init: There are no observer angles for the transfer functions\n");
+    reverb_tf_nspec = 0;
+    return (0);
+  }
+
+  reverb_tf_delay_max = 2. * geo.rmax / VLIGHT;
+  reverb_tf_lfreqmin = log10 (xxspec[MSPEC].freqmin);
+  reverb_tf_dlfreq = (log10 (xxspec[MSPEC].freqmax) - reverb_tf_lfreqmin) / modes.reverb_tf_nwave;
+
+  n = (size_t) reverb_tf_nhist * reverb_tf_nspec * (modes.reverb_tf_ndelay + 1) * modes.reverb_tf_nwave;
+  free (reverb_tf);
+  if ((reverb_tf = calloc (n, sizeof (double))) == NULL)
   {
-    delay_dump (delay_dump_bank, delay_dump_bank_size);
-    delay_dump_bank_curr = 0;   //Dump to file, zero array position
+    Error ("reverb_tf_init: Unable to allocate %.1f MB for the transfer functions\n", n * sizeof (double) / 1024. / 1024.);
+    Exit (0);
   }
+  reverb_tf_subzero = 0;
+
+  Log ("reverb_tf_init: %d transfer functions for each of %d angles, with %d delay and %d wavelength bins (%.1f MB)\n",
+       reverb_tf_nhist, reverb_tf_nspec, modes.reverb_tf_ndelay, modes.reverb_tf_nwave, n * sizeof (double) / 1024. / 1024.);
+  if (geo.pcycle > 0)
+  {
+    Error ("reverb_tf_init: This is a restart, so the transfer functions will only include the remaining %d spectral cycles\n",
+           geo.pcycles - geo.pcycle);
+  }
+  return (0);
+}
+
+/**********************************************************/
+/**
+ * @brief	Adds a photon to the transfer functions
+ *
+ * @param [in] pp			Photon extracted to a spectrum
+ * @param [in] i_spec		The spectrum
+ * @return 					0
+ *
+ * The same photons are used as would be dumped by
+ * delay_dump().  Photons with negative delays, which are
+ * caused by the finite resolution of the path distributions,
+ * are put in the first delay bin.
+***********************************************************/
+int
+reverb_tf_add (PhotPtr pp, int i_spec)
+{
+  double delay;
+  int n, ndelay, nwave, idelay, iwave;
+  size_t k;
+
+  if (reverb_tf == NULL || i_spec < MSPEC || !delay_dump_selected (pp, i_spec))
+    return (0);
+
+  ndelay = modes.reverb_tf_ndelay;
+  nwave = modes.reverb_tf_nwave;
+
+  delay = (delay_to_observer (pp) - geo.rmax) / VLIGHT;
+  if (delay < 0)
+  {
+    OMP_PRAGMA (omp atomic)
+    reverb_tf_subzero++;
+    idelay = 0;
+  }
+  else if (delay >= reverb_tf_delay_max)
+    idelay = ndelay;
   else
+    idelay = (int) (delay / reverb_tf_delay_max * ndelay);
+
+  iwave = (int) ((log10 (pp->freq) - reverb_tf_lfreqmin) / reverb_tf_dlfreq);
+  if (iwave < 0)
+    iwave = 0;
+  else if (iwave > nwave - 1)
+    iwave = nwave - 1;
+
+  /* Frequency increases with the bin number, so reverse it to give increasing wavelength */
+  iwave = nwave - 1 - iwave;
+
+  for (n = 0; n < reverb_tf_nhist; n++)
+  {
+    if (n > 0 && pp->nres != geo.reverb_filter_line[n - 1])
+      continue;
+    k = (((size_t) n * reverb_tf_nspec + (i_spec - MSPEC)) * (ndelay + 1) + idelay) * nwave + iwave;
+    OMP_PRAGMA (omp atomic)
+    reverb_tf[k] += pp->w;
+  }
+  return (0);
+}
+
+/**********************************************************/
+/**
+ * @brief	Writes out the transfer functions
+ *
+ * @return 					0
+ *
+ * The transfer functions are summed over all the processes
+ * (and divided by their number, as for the spectra), and
+ * rank 0 writes them to root.tf.  This is a binary file,
+ * which starts with REVERB_TF_MAGIC, followed by:
+ *
+ *   int nspec, nhist, ndelay, nwave, pcycles
+ *   double delay_max, wavelength_min, wavelength_max (s, A)
+ *   char name[40] for each observer angle
+ *   int nres for each transfer function (-1 for all photons)
+ *   double tf[nhist][nspec][ndelay+1][nwave]
+ *
+ * The last delay bin contains the photons with delays greater
+ * than delay_max, and the wavelength bins are uniform in log
+ * wavelength.  Like the spectra, the transfer functions are
+ * the luminosity in each bin; they are summed over the spectral
+ * cycles.
+***********************************************************/
+int
+reverb_tf_write (void)
+{
+  FILE *fptr;
+  char filename[LINELENGTH];
+  size_t n, i;
+  int header[5], nres;
+  double range[3];
+#ifdef MPI_ON
+  size_t nchunk;
+#endif
+
+  if (reverb_tf == NULL)
+    return (0);
+
+  n = (size_t) reverb_tf_nhist * reverb_tf_nspec * (modes.reverb_tf_ndelay + 1) * modes.reverb_tf_nwave;
+
+#ifdef MPI_ON
+  for (i = 0; i < n; i++)
+    reverb_tf[i] /= np_mpi_global;
+
+  /* Reduce in chunks, in case the transfer functions are larger than an int can count */
+  for (i = 0; i < n; i += nchunk)
+  {
+    nchunk = n - i < (1 << 26) ? n - i : (1 << 26);
+    if (rank_global == 0)
+      MPI_Reduce (MPI_IN_PLACE, &reverb_tf[i], (int) nchunk, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    else
+      MPI_Reduce (&reverb_tf[i], NULL, (int) nchunk, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  }
+  MPI_Allreduce (MPI_IN_PLACE, &reverb_tf_subzero, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+
+  if (reverb_tf_subzero > 0)
+  {
+    Error ("reverb_tf_write: %ld photons with <0 delay found! Increase path bin resolution to minimise this error.\n",
+           reverb_tf_subzero);
+  }
+
+  if (rank_global == 0)
   {
-    delay_dump_bank_curr++;
+    sprintf (filename, "%.100s.tf", files.root);
+    if ((fptr = fopen (filename, "w")) == NULL)
+    {
+      Error ("reverb_tf_write: Unable to open %s for writing\n", filename);
+    }
+    else
+    {
+      header[0] = reverb_tf_nspec;
+      header[1] = reverb_tf_nhist;
+      header[2] = modes.reverb_tf_ndelay;
+      header[3] = modes.reverb_tf_nwave;
+      header[4] = geo.pcycles;
+      range[0] = reverb_tf_delay_max;
+      range[1] = VLIGHT * 1e8 / xxspec[MSPEC].freqmax;
+      range[2] = VLIGHT * 1e8 / xxspec[MSPEC].freqmin;
+
+      fwrite (REVERB_TF_MAGIC, 1, strlen (REVERB_TF_MAGIC), fptr);
+      fwrite (header, sizeof (int), 5, fptr);
+      fwrite (range, sizeof (double), 3, fptr);
+      for (i = 0; i < (size_t) reverb_tf_nspec; i++)
+        fwrite (xxspec[MSPEC + i].name, 1, sizeof (xxspec[MSPEC + i].name), fptr);
+      for (i = 0; i < (size_t) reverb_tf_nhist; i++)
+      {
+        nres = i == 0 ? -1 : geo.reverb_filter_line[i - 1];
+        fwrite (&nres, sizeof (int), 1, fptr);
+      }
+      fwrite (reverb_tf, sizeof (double), n, fptr);
+      fclose (fptr);
+      Log ("reverb_tf_write: Wrote the transfer functions to %s\n", filename);
+    }
   }
+
+  free (reverb_tf);
+  reverb_tf = NULL;
   return (0);
 }
@@ -56,7 +56,7 @@
  * are in turn used  to find the zero either to dphi_ds
  * or to phi along the path lenght of the photon. p_roche is intialized in binary_basics
  **********************************************************/
-struct photon p_roche;
+THREAD_LOCAL struct photon p_roche;
 
 
 /**********************************************************/
@@ -60,6 +60,7 @@ calculate_ionization (restart_stat)
   long nphot_to_define, nphot_min;
   int iwind;
 
+  prof_init ();
 
   /* Save the the windfile before the first ionization cycle in order to
    * allow investigation of issues that may have arisen at the very beginning
@@ -69,7 +70,7 @@ calculate_ionization (restart_stat)
   if (rank_global == 0)
   {
 #endif
-    wind_save (files.windsave);
+    wind_save_checkpoint (files.windsave);
 #ifdef MPI_ON
   }
 #endif
@@ -209,6 +210,8 @@ calculate_ionization (restart_stat)
      */
 
     kbf_need (freqmin, freqmax);
+    if (modes.prune_lines)
+      line_need ();
 
     /* NSH 22/10/12  This next call populates the prefactor for free free heating for each cell in the plasma array */
     /* NSH 4/12/12  Changed so it is only called if we have read in gsqrd data */
@@ -335,6 +338,7 @@ calculate_ionization (restart_stat)
 /* Completed writing file describing disk heating */
 
     wind_update (w);
+    report_cell_communication ();
     Log ("Completed ionization cycle %d :  The elapsed TIME was %f\n", geo.wcycle + 1, timer ());
 
 #ifdef MPI_ON
@@ -382,7 +386,7 @@ calculate_ionization (restart_stat)
     {
 #endif
       xsignal (files.root, "%-20s Checkpoint wind structure\n", "NOK");
-      wind_save (files.windsave);
+      wind_save_checkpoint (files.windsave);
       Log_silent ("Saved wind structure in %s after cycle %d\n", files.windsave, geo.wcycle);
 
       /* In a diagnostic mode save the wind file for each cycle (from thread 0) */
@@ -400,6 +404,10 @@ calculate_ionization (restart_stat)
         sprintf (dummy, "diag_%.100s/%.100s.%02d", files.root, files.root, geo.wcycle);
         do_windsave2table (dummy, 0, FALSE);
       }
+      if (modes.save_cycle_stream)
+      {
+        cycle_stream_write (geo.wcycle);
+      }
       if (modes.keep_ioncycle_spectra)
       {
         strcpy (dummy, "");
@@ -415,6 +423,7 @@ calculate_ionization (restart_stat)
       save_gsl_rng_state ();
     }
 
+    prof_report ("ion", geo.wcycle);
     check_time (files.root);
     Log_flush ();               /*Flush the logfile */
 
@@ -479,6 +488,7 @@ make_spectra (restart_stat)
      unnecessary during spectrum cycles.  */
 
   geo.ioniz_or_extract = CYCLE_EXTRACT;
+  prof_init ();
 
 /* Next steps to speed up extraction stage */
   if (!modes.keep_photoabs)
@@ -500,6 +510,8 @@ make_spectra (restart_stat)
    */
 
   kbf_need (freqmin, freqmax);
+  if (modes.prune_lines)
+    line_need ();
 
   /* force recalculation of kpacket rates and matrices, if applicable */
   if (geo.rt_mode == RT_MODE_MACRO)
@@ -550,6 +562,9 @@ make_spectra (restart_stat)
     spectrum_restart_renormalise (geo.nangles);
   }
 
+  if (geo.reverb != REV_NONE && modes.reverb_tf)
+    reverb_tf_init ();
+
   if (modes.load_rng && geo.pcycle > 0)
   {
     reload_gsl_rng_state ();
@@ -606,6 +621,7 @@ make_spectra (restart_stat)
     trans_phot (w, p, geo.select_extract);
 
     spectrum_create (p, geo.nangles, geo.select_extract);
+    extract_report ();
 
 /* Write out the detailed spectrum each cycle so that one can see the statistics build up! */
     renorm = ((double) (geo.pcycles)) / (geo.pcycle + 1.0);
@@ -628,6 +644,7 @@ make_spectra (restart_stat)
 #ifdef MPI_ON
     }
 #endif
+    report_cell_communication ();
     Log ("Completed spectrum cycle %3d :  The elapsed TIME was %f\n", geo.pcycle + 1, timer ());
 
     /* JM1304: moved geo.pcycle++ after xsignal to record cycles correctly. First cycle is cycle 0. */
@@ -640,7 +657,7 @@ make_spectra (restart_stat)
     if (rank_global == 0)
     {
 #endif
-      wind_save (files.windsave);       // This is only needed to update pcycle
+      wind_save_checkpoint (files.windsave);    // This is only needed to update pcycle
       spec_save (files.specsave);
 #ifdef MPI_ON
     }
@@ -650,6 +667,7 @@ make_spectra (restart_stat)
       save_gsl_rng_state ();
     }
 
+    prof_report ("spec", geo.pcycle);
     check_time (files.root);
   }
 
@@ -744,6 +744,9 @@ fix_concentrations (xplasma, mode)
   /* Define the element and ion which will be present in the wind */
 
 
+  /* The file is read by the first thread to get here, while the others wait */
+
+  OMP_PRAGMA (omp critical (fix_concentrations))
   if (fix_con_start == 0)
   {
     if ((cptr = fopen (geo.fixed_con_file, "r")) == NULL)
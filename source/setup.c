@@ -321,6 +321,8 @@ init_advanced_modes ()
   modes.save_cell_stats = FALSE;        // save photons statistics by cell
   modes.keep_ioncycle_windsaves = FALSE;        // save wind file each ionization cycle
   modes.keep_ioncycle_spectra = FALSE;  // to save spectrum file each ionization cycle
+  modes.save_cycle_stream = FALSE;      // append selected quantities to a binary file each ionization cycle
+  strcpy (modes.cycle_stream_columns, CSTREAM_COLUMNS);
   modes.track_resonant_scatters = FALSE;        // track resonant scatters
   modes.save_extract_photons = FALSE;   // save details on extracted photons
   modes.adjust_grid = FALSE;    // the user wants to adjust the grid scale
@@ -350,6 +352,33 @@ init_advanced_modes ()
 
   modes.no_macro_pops_for_ions = FALSE; /* use the ion densities from macro_pops where applicable */
 
+  modes.nthreads = 1;           /* transport photons with a single thread in each process */
+  modes.steal_photons = FALSE;  /* each process transports only the photons it generated */
+  modes.nphot_batch = 0;        /* use the default batch size if photons are scheduled dynamically */
+  modes.event_transport = FALSE;        /* transport one photon at a time with trans_phot_single */
+  modes.nphot_event = 1000;     /* the batch size if the event-based engine is used */
+  modes.windsave_compress = FALSE;      /* write windsave files without compression */
+  modes.bf_cache = FALSE;       /* calculate bound-free opacities directly */
+  modes.bf_cache_mb = 1024.;    /* the memory budget for the bound-free opacity tables */
+  modes.prune_lines = FALSE;    /* consider every line in calculate_ds */
+  modes.prune_lines_mb = 1024.; /* the memory budget for the lists of lines in each cell */
+  modes.extract_batch = FALSE;  /* extract photons for each observer separately */
+  modes.extract_tau_max = 10.;  /* the optical depth at which extract_batch abandons a photon */
+  modes.store_matom_matrix_mb = 0.;     /* no limit on the memory used to store macro-atom matrices */
+  modes.matom_matrix_tol = 0.;  /* always recalculate the macro-atom matrices */
+  modes.matom_matrix_sparse = FALSE;    /* invert the whole macro-atom matrix */
+  modes.profile = FALSE;        /* do not profile the run */
+  modes.compton_table = FALSE;  /* solve for the Compton energy change for each scatter */
+  modes.matom_tables = FALSE;   /* calculate macro-atom jump probabilities when a packet enters a cell */
+  modes.matom_tables_mb = 1024.;        /* the memory budget for the macro-atom jump tables */
+  modes.reverb_tf = FALSE;      /* dump each photon in reverberation mode, rather than binning them */
+  modes.reverb_tf_ndelay = 100; /* the number of delay bins in the transfer functions */
+  modes.reverb_tf_nwave = 1000; /* the number of wavelength bins in the transfer functions */
+  modes.reverb_dump_binary = FALSE;     /* dump photons in reverberation mode as text */
+  modes.te_grid = 0;            /* find the electron temperature with zero_find */
+  modes.rate_table = FALSE;     /* calculate the rate coefficients for the matrix ionization scheme in each cell */
+  modes.shared_atomic = FALSE;  /* every process reads the atomic data, and keeps its own copy */
+
   return (0);
 }
 
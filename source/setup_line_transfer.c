@@ -161,7 +161,6 @@ get_line_transfer_mode ()
         {
           for (n = 0; n < NPLASMA; n++)
           {
-            macromain[n].store_matom_matrix = modes.store_matom_matrix;
             macromain[n].matom_transition_mode = geo.matom_transition_mode;
           }
 
@@ -169,13 +168,14 @@ get_line_transfer_mode ()
       }
       else
       {
+        modes.store_matom_matrix = FALSE;
         for (n = 0; n < NPLASMA; n++)
         {
-          macromain[n].store_matom_matrix = modes.store_matom_matrix = FALSE;
           macromain[n].matom_transition_mode = geo.matom_transition_mode;
         }
 
       }
+      set_matom_matrix_storage ();
 
     }
 
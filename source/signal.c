@@ -314,6 +314,11 @@ check_time (char *root)
     error_summary ("Maximum execution time allowed has been reached\n");
     xsignal (root, "\nCOMMENT max_time %.1f seconds exceeded\n", max_time);
 
+    /* Make sure the last checkpoint is complete, so the run can be restarted */
+
+    windsave_wait ();
+    cycle_stream_close ();
+
 #ifdef MPI_ON
     MPI_Finalize ();
 #endif
@@ -202,6 +202,12 @@ main (argc, argv)
 
     xsignal (files.root, "%-20s Read %s\n", "COMMENT", files.old_windsave);
 
+    /* The cells in which macro-atom matrices are stored may differ from the previous run */
+    if (geo.nmacro > 0 && geo.matom_transition_mode == MATOM_MATRIX)
+    {
+      set_matom_matrix_storage ();
+    }
+
     if (geo.model_count > 0)    //We have previously used models - we need to read them in again
     {
       for (n = 0; n < geo.model_count; n++)
@@ -733,6 +739,11 @@ main (argc, argv)
 
   make_spectra (restart_stat);
 
+  /* The windsave file, and the cycle stream, are written in the background at the end
+     of each cycle, so make sure the last ones are complete */
+
+  windsave_wait ();
+  cycle_stream_close ();
 
 /* Finally done */
 
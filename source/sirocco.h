@@ -239,7 +239,7 @@ typedef struct cone
 }
 cone_dummy, *ConePtr;
 
-extern double velocity_electron[3];     // velocity of the electron when thermal effects are included
+extern THREAD_LOCAL double velocity_electron[3];     // velocity of the electron when thermal effects are included
 
 /* End of structures which are used to define boundaries to the emission regions */
 /*******************DOMAIN structure***********************************************/
@@ -1104,22 +1104,9 @@ extern PlasmaPtr plasmamain;
 /*******************************PHOTON_STORE*********************************************/
 #define NSTORE 10
 
-/** A storage area for photons.  The idea is that it is sometimes time-consuming to create the
-cumulative distribution function for a process, but trivial to create more than one photon
-of a particular type once one has the cdf,  This appears to be case for f fb photons.  But
-the same procedure could be used for line photons */
-
-typedef struct photon_store
-{
-  int n;                        /**<  This is the photon number that was last used */
-  double t, f1, f2, freq[NSTORE];
-
-} photon_store_dummy, *PhotStorePtr;
-
-extern PhotStorePtr photstoremain;
-
-/** A second photon store: this is very similar to photon_store above but for use
-   in generating macro atom bf photons from cfds*/
+/** A storage area for photons.  It is time-consuming to create the cumulative
+   distribution function of the bf emission of a macro atom, but trivial to create
+   more than one photon of a particular type once one has the cdf */
 typedef struct matom_photon_store
 {
   int n;                        /**<  This is the photon number that was last used */
@@ -1246,6 +1233,18 @@ extern int size_Jbar_est, size_gamma_est, size_alpha_est;
 #define MODE_OBSERVER_FRAME_TIME 0
 #define MODE_CMF_TIME 1
 
+// types of emission for which the cells are sampled in emission_sampler.c
+#define SAMPLE_WIND  0
+#define SAMPLE_KPKT  1
+#define SAMPLE_MATOM 2
+#define NSAMPLER     3
+
+// types of spectra kept for each cell in emission_cdf.c
+#define SPEC_FF    0
+#define SPEC_FB    1
+#define SPEC_LINE  2
+#define NSPEC_CELL 3
+
 /***************************************PHOTON STRUCTURE*********************************/
 /**
   * The structure that contains information about indidual photons as they pass through
@@ -1336,6 +1335,17 @@ p_dummy, *PhotPtr;
 #define NRES_NOT_SET (-3)
 #define NRES_BF NLINES
 
+/* The frequencies and continuum opacities along the path a photon can travel within a
+   cell, which are passed from ds_path_continuum to ds_path_lines (see calculate_ds) */
+
+struct ds_path
+{
+  double smax;                  /**< the maximum distance the photon can travel in the cell */
+  double freq_inner, freq_outer;        /**< the co-moving frequencies at the start and end of the path */
+  double kap_es, kap_bf_tot, kap_ff;    /**< the electron scattering, bound-free and free-free opacities */
+  double kap_cont, kap_cont_obs;        /**< the total continuum opacity in the local and observer frames */
+};
+
 extern PhotPtr photmain;               /**< A pointer to all of the photons that have been created in a subcycle. Added to ease
                                         breaking the main routine of sirocco into separate rooutines for inputs and
                                         running the program */
@@ -1437,11 +1447,26 @@ have access to the proper normalization.
 */
 
 
-extern struct Cdf cdf_ff;
 extern struct Cdf cdf_fb;
 extern struct Cdf cdf_bb;
 extern struct Cdf cdf_brem;
 
+/** The portion of cdf_bb, and of the low and high frequency approximations to
+  * a bb, which planck uses for a given temperature and frequency range.  Calculating
+  * these requires several numerical integrations, so they are saved, e.g. for each ring
+  * of the disk, in structures of this type.
+  */
+typedef struct bb_limits
+{
+  double t, freqmin, freqmax;   /**< The temperature and frequency range */
+  double alphamin, alphamax;    /**< The frequency range in units of kT/h */
+  double ylo, yhi;              /**< The positions of alphamin and alphamax in the full bb cdf */
+  double lo_alphamin, lo_alphamax;      /**< The range in which the low frequency approximation is used */
+  double hi_alphamin, hi_alphamax;      /**< The range in which the high frequency approximation is used */
+  int use_cdf;                  /**< TRUE if part of the range is sampled from cdf_bb */
+  double limit1, limit2, x1, x2;        /**< The limits cdf_limit sets in cdf_bb */
+} bb_limits_dummy, *BbLimitsPtr;
+
 
 
 /* Variable used to allow something to be printed out the first few times
@@ -1511,9 +1536,37 @@ extern struct xbands xband;
  * It was made an external array to avoid having to pass it between various calling routines
  * but this means that one has to be careful that data is not stale.  It is required for
  * macro-atoms where bf is a scattering process, but not for the simple case.
+ * It is allocated for each thread by kappa_bf_work, with room for kap_bf_size processes.
  */
 
-extern double kap_bf[NLEVELS];
+extern THREAD_LOCAL double *kap_bf;
+extern THREAD_LOCAL int kap_bf_size;
+
+
+/* The lines which can have a significant optical depth in a plasma cell,
+ * as constructed by line_need, see line_lists.c */
+
+typedef struct line_list
+{
+  int nuse;                     /**< The number of lines in the list, or -1 if there is no list */
+  double *freq;                 /**< The frequencies of the lines, in increasing order */
+  int *nline;                   /**< The index of each line in lin_ptr */
+} line_list_dummy, *LineListPtr;
+
+
+/* The alias tables of the jump and emission probabilities of a level of a
+ * macro atom in a plasma cell, see matom_tables.c */
+
+typedef struct matom_jumps
+{
+  int nplasma, uplvl;           /**< The cell and the level */
+  int njump, nemit;             /**< The number of jumps, and of downward jumps which can deactivate the level */
+  double pjnorm, penorm;        /**< The total jump and emission probabilities */
+  double *jprob, *eprob;        /**< The probabilities of keeping each entry of the alias tables */
+  int *jalias, *ealias;         /**< The alternatives to each entry */
+  size_t nbytes;                /**< The memory used by the table */
+  struct matom_jumps *newer, *older;    /**< The tables used before and after this one */
+} matom_jumps_dummy, *MatomJumpsPtr;
 
 
 
@@ -1569,6 +1622,8 @@ struct advanced_modes
   int keep_ioncycle_windsaves;  /**< when TRUE, saves wind files for each ionization cycle */
   int keep_ioncycle_spectra;    /**< when TRUE, saves the total spectra for each ionization cycle */
   int make_tables;              /**< when TRUE, create tables showing various parameters for each cycle */
+  int save_cycle_stream;        /**< when TRUE, append selected quantities for each cell to a binary file each cycle */
+  char cycle_stream_columns[LINELENGTH];        /**< the quantities written to the cycle stream */
   int track_resonant_scatters;  /**< when TRUE, tracks resonant scatters */
   int save_photons;             /**< when TRUE, tracks photons (in photon2d) */
   int save_extract_photons;     /**< when TRUE, saves details on extracted photons */
@@ -1631,10 +1686,76 @@ struct advanced_modes
                                   that make it less useful than it might seem. */
   int no_macro_pops_for_ions;     /* if true, then use the ion densities from the ionization mode
                                      for macro-atoms, rather than from macro_pops */
+  int nthreads;                   /**< The number of threads used to transport photons in each
+                                    * process.  This is set with the --threads command line
+                                    * option, and is only greater than 1 if sirocco has been
+                                    * compiled with OpenMP */
+  int steal_photons;              /**< if TRUE, batches of photons are scheduled dynamically
+                                    * between MPI processes, see --steal */
+  int nphot_batch;                /**< The number of photons in each batch when photons are
+                                    * scheduled dynamically, or 0 for the default */
+  int event_transport;            /**< if TRUE, photons are transported with the event-based
+                                    * engine in trans_phot_event.c, see --events */
+  int nphot_event;                /**< The number of photons transported together by the
+                                    * event-based engine */
+  int windsave_compress;          /**< if TRUE, the sections of windsave files are compressed,
+                                    * see --windsave-compress */
+  int bf_cache;                   /**< if TRUE, the bound-free opacities in macro-atom mode are
+                                    * interpolated from per-cell tables, see --bf-cache */
+  double bf_cache_mb;             /**< The maximum memory (in MB) each process uses for the
+                                    * bound-free opacity tables */
+  int prune_lines;                /**< if TRUE, only the lines which can have a significant
+                                    * optical depth in a cell are considered, see --prune-lines */
+  double prune_lines_mb;          /**< The maximum memory (in MB) each process uses for the
+                                    * lists of lines in each cell */
+  int extract_batch;              /**< if TRUE, the photons extracted for each observer are
+                                    * transported together, see --extract-batch */
+  double extract_tau_max;         /**< The optical depth at which extract_batch abandons a photon */
+  double store_matom_matrix_mb;   /**< The maximum memory (in MB) each process uses to store
+                                    * macro-atom matrices, or 0 for no limit, see --matrix-storage */
+  double matom_matrix_tol;        /**< The fractional change in the macro-atom jump probabilities
+                                    * below which a stored matrix is not recalculated, see --matrix-tol */
+  int matom_matrix_sparse;        /**< if TRUE, macro-atom matrices are inverted one element at a
+                                    * time, see --matrix-sparse */
+  int profile;                    /**< if TRUE, the time spent in the most expensive routines is
+                                    * recorded and written out each cycle, see --profile */
+  int compton_table;              /**< if TRUE, the Compton energy change and the thermal speeds of
+                                    * electrons are interpolated from tables, see --compton-table */
+  int matom_tables;               /**< if TRUE, macro-atom jumps are chosen from per-cell alias tables,
+                                    * see --matom-tables */
+  double matom_tables_mb;         /**< The maximum memory (in MB) each process uses for the tables */
+  int reverb_tf;                  /**< if TRUE, reverberation transfer functions are accumulated in memory
+                                    * instead of dumping each photon, see --reverb-tf */
+  int reverb_tf_ndelay;           /**< The number of delay bins in the transfer functions */
+  int reverb_tf_nwave;            /**< The number of wavelength bins in the transfer functions */
+  int reverb_dump_binary;         /**< if TRUE, the photons contributing to the transfer functions are
+                                    * dumped in binary, see --reverb-dump-binary */
+  int te_grid;                    /**< if non-zero, the number of temperatures at which the cooling is
+                                    * evaluated to find the electron temperature, see --te-grid */
+  int rate_table;                 /**< if TRUE, the temperature dependent rate coefficients used in the
+                                    * matrix ionization scheme are interpolated in tables, see --rate-table */
+  int shared_atomic;              /**< if TRUE, in parallel runs the atomic data is read by one process, and
+                                    * shared by all the processes on each node, see --shared-atomic */
 };
 
 extern struct advanced_modes modes;
 
+/** The routines whose calls are counted and timed by the profiler, see profile.c */
+enum profile_kernel_enum
+{ PROF_TRANSLATE = 0,
+  PROF_CALCULATE_DS,
+  PROF_RADIATION,
+  PROF_EXTRACT,
+  PROF_MATOM,
+  PROF_KPKT,
+  PROF_COMPTON,
+  PROF_WIND_UPDATE,
+  PROF_ION_ABUNDANCES,
+  PROF_COMM,                    /**< The exchange of the wind, plasma and spectra between processes */
+  PROF_WIND_SAVE,
+  NPROF
+};
+
 
 extern FILE *optr;               /**< pointer to a diagnostic file that will contain dvds information */
 
@@ -1726,7 +1847,7 @@ extern struct filenames files;
 #define BOUND_INNER_RHO 7
 #define BOUND_OUTER_RHO 8
 
-extern int xxxbound;
+extern THREAD_LOCAL int xxxbound;
 
 
 /** Structure associated with rdchoice.  This
@@ -1739,6 +1860,173 @@ extern int xxxbound;
  * for each input variable.  At present, this is only
  * used for the selection of spec_types
  */
+/* ************************************************************************** */
+/**
+ * The structures used to describe the properties of the wind, plasma or
+ * macro-atom cells which are exchanged between MPI ranks, see
+ * communicate_cells.c.  Each field is a block of memory associated with
+ * every cell, which is either stored in the cell structure itself (COMM_VALUE),
+ * pointed to by a member of the cell structure (COMM_ARRAY), or is the single
+ * block holding the elements of a matrix allocated with
+ * allocate_macro_matrix (COMM_MATRIX).
+ * ************************************************************************** */
+
+#define COMM_VALUE  0
+#define COMM_ARRAY  1
+#define COMM_MATRIX 2
+
+#define NCOMM_FIELDS 256                /**< The maximum number of fields in one exchange */
+#define COMM_BUFFER_MAX  67108864       /**< The maximum size in bytes of the buffer used to receive cells */
+
+typedef struct comm_field
+{
+  int type;                     /**< COMM_VALUE, COMM_ARRAY or COMM_MATRIX */
+  char *cells;                  /**< The start of the array of cell structures */
+  size_t stride;                /**< The size of a single cell structure */
+  size_t offset;                /**< The offset of the field, or the pointer to it, in the cell structure */
+  size_t nbytes;                /**< The number of bytes in the field */
+  int conditional;              /**< TRUE if the field is only exchanged for cells where an int flag is TRUE */
+  size_t flag_offset;           /**< The offset of the flag in the cell structure */
+} comm_field_dummy, *CommFieldPtr;
+
+typedef struct comm_cells
+{
+  char name[LINELENGTH];        /**< A description of the exchange, used in the logs */
+  int nfields;
+  struct comm_field field[NCOMM_FIELDS];
+  size_t nbytes;                /**< The total number of bytes for a single cell */
+} comm_cells_dummy, *CommCellsPtr;
+
+/* Add a member of a cell structure, a pointer member to an array of n elements, or
+ * a matrix of n elements which is only allocated in cells where flag is TRUE, to
+ * an exchange */
+#define COMM_ADD_VALUE(comm, cells, type, member) \
+  comm_cells_add (comm, COMM_VALUE, cells, sizeof (type), offsetof (type, member), sizeof (((type *) 0)->member))
+#define COMM_ADD_ARRAY(comm, cells, type, member, n) \
+  comm_cells_add (comm, COMM_ARRAY, cells, sizeof (type), offsetof (type, member), (n) * sizeof (*((type *) 0)->member))
+#define COMM_ADD_MATRIX(comm, cells, type, member, n, flag) \
+  comm_cells_add_conditional (comm, COMM_MATRIX, cells, sizeof (type), offsetof (type, member), (n) * sizeof (**((type *) 0)->member), \
+                              offsetof (type, flag))
+
+
+/* The structures which describe a windsave file, see windsave_file.c.  The file begins with a
+ * header, followed by a series of named sections, each of which holds one array, and ends with an
+ * index of the sections */
+
+#define WINDSAVE_MAGIC      "SIROCCO_WINDSAV"   /**< Identifies a windsave file in the sectioned format */
+#define WINDSAVE_FORMAT     2   /**< The version of the format, the original unsectioned files being version 1 */
+#define WINDSAVE_BYTE_ORDER 0x01020304  /**< Written in the native byte order to identify the byte order of the file */
+#define WINDSAVE_NAMELEN    48  /**< The maximum length of the name of a section */
+#define NWINDSAVE_SIZES     10  /**< The number of sizes of types and structures recorded in the header */
+#define WINDSAVE_CHUNK      16777216    /**< The size in bytes of the chunks in which a compressed section is stored */
+#define WINDSAVE_BUFFER_MAX 1073741824  /**< The largest file which is assembled in memory to be written by a helper thread */
+
+/* The parts of a windsave file that are read by wind_read_select */
+
+#define WINDSAVE_PLASMA_ARRAYS  1       /**< The variable length arrays in the plasma structure */
+#define WINDSAVE_MACRO_ARRAYS   2       /**< The macro-atom estimators */
+#define WINDSAVE_ALL            (WINDSAVE_PLASMA_ARRAYS | WINDSAVE_MACRO_ARRAYS)
+
+typedef struct windsave_header
+{
+  char magic[16];
+  int format;                   /**< WINDSAVE_FORMAT for the version of the program that wrote the file */
+  int byte_order;               /**< WINDSAVE_BYTE_ORDER */
+  char version[LINELENGTH];     /**< The version of sirocco that wrote the file */
+  int sizes[NWINDSAVE_SIZES];   /**< The sizes of the basic types and structures when the file was written */
+  int nsections;
+  long long index_offset;       /**< The position of the index of sections in the file */
+} windsave_header_dummy;
+
+typedef struct windsave_section
+{
+  char name[WINDSAVE_NAMELEN];
+  long long offset;             /**< The position of the section in the file */
+  long long nbytes;             /**< The size of the section once it has been uncompressed */
+  long long nstored;            /**< The number of bytes of the file occupied by the section */
+  int elsize;                   /**< The size of one element of the array */
+  int compressed;               /**< TRUE if the section is compressed with zlib, in chunks of WINDSAVE_CHUNK */
+} windsave_section_dummy, *WindsaveSectionPtr;
+
+typedef struct windsave_file
+{
+  char filename[LINELENGTH];
+  struct windsave_header header;
+  WindsaveSectionPtr section;   /**< The index of sections */
+  int nalloc;                   /**< The number of sections for which space has been allocated */
+  int compress;                 /**< TRUE if sections are to be compressed when written */
+
+  /* Used when writing a file */
+  char tmpname[LINELENGTH];     /**< The file is written to this name, and renamed when it is complete */
+  FILE *fptr;                   /**< The temporary file, which is NULL while sections are held in memory */
+  int async;                    /**< TRUE if the file is to be written by a helper thread */
+  char **data;                  /**< The sections which are held in memory */
+  size_t nbuffered;             /**< The number of bytes held in memory */
+  long long offset;             /**< The current position in the file */
+  int nerr;                     /**< The number of failed writes */
+
+  /* Used when reading a file */
+  char *map;                    /**< The file, mapped into memory */
+  size_t map_size;
+  int chunk_section, chunk_index;       /**< The compressed chunk which is currently held in chunk */
+  char *chunk;
+} windsave_file_dummy, *WindsaveFilePtr;
+
+
+/* The columns of the tables written by windsave2table, see windsave2table_columns.c */
+
+#define WTAB_MAGIC   "sirocco_table"
+#define WTAB_FORMAT  1          /**< The version of the format of the binary tables */
+#define WTAB_NAMELEN 32         /**< The length of the name of a column */
+
+typedef struct wind_table_header
+{
+  char magic[16];
+  int format;                   /**< WTAB_FORMAT */
+  int byte_order;               /**< WINDSAVE_BYTE_ORDER */
+  int ndom, coord_type, ndim, mdim;
+  int ncells;                   /**< The number of cells, that is the length of each column */
+  int ncols;
+} wind_table_header_dummy;
+
+typedef struct wind_table_column
+{
+  char name[WTAB_NAMELEN];
+  int source;                   /**< Whether the value is found in the wind or plasma structure, or is an ion */
+  int type;                     /**< Whether the variable is a double or an int */
+  size_t offset;                /**< The offset of the variable in the wind or plasma structure */
+  int nion, nelem;              /**< For an ion, the ion and its element */
+  int ion_switch;               /**< For an ion, the quantity returned, as for get_ion */
+} WindTableColumn, *WindTableColumnPtr;
+
+
+/* The stream of per-cycle diagnostics, see cycle_stream.c */
+
+#define CSTREAM_MAGIC   "sirocco_cycles"
+#define CSTREAM_FORMAT  1       /**< The version of the format of the stream */
+#define CSTREAM_NDOM    5       /**< The number of integers which describe each domain */
+#define CSTREAM_COLUMNS "t_e,t_r,ne,converge"   /**< The columns written if none are given */
+
+typedef struct cycle_stream_header
+{
+  char magic[16];
+  int format;                   /**< CSTREAM_FORMAT */
+  int byte_order;               /**< WINDSAVE_BYTE_ORDER */
+  int ndomain;
+  int ncells;                   /**< The number of cells in all domains, that is NDIM2 */
+  int ncols;
+  int spare;
+  long long record_size;        /**< The size in bytes of one record, including the cycle_stream_record */
+} cycle_stream_header_dummy;
+
+typedef struct cycle_stream_record
+{
+  int cycle;                    /**< The number of ionization cycles which have been completed */
+  int ncols;
+  double time;                  /**< The elapsed time of the run when the record was written */
+} cycle_stream_record_dummy;
+
+
 #define MAX_RDPAR_CHOICES 20 
 
 typedef struct rdpar_choices
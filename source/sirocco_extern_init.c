@@ -72,8 +72,6 @@ WindPtr wmain;
 
 PlasmaPtr plasmamain;
 
-PhotStorePtr photstoremain;
-
 MatomPhotStorePtr matomphotstoremain;
 
 MacroPtr macromain;
@@ -98,7 +96,6 @@ SpecPtr xxspec;
 int swind_min, swind_max, swind_delta, swind_project;
 double *aaa;                    ///< A pointer to an array used by swind
 
-struct Cdf cdf_ff;
 struct Cdf cdf_fb;
 struct Cdf cdf_vcos;
 struct Cdf cdf_vdipole;
@@ -111,7 +108,8 @@ char hubeny_list[132];          ///< Location of listing of files representing h
 
 struct xbands xband;
 
-double kap_bf[NLEVELS];
+THREAD_LOCAL double *kap_bf = NULL;
+THREAD_LOCAL int kap_bf_size = 0;
 
 FILE *pstatptr;                 ///<  pointer to a diagnostic file that will contain photon data for given cells
 int cell_phot_stats;            ///< 1=do  it, 0=dont do it
@@ -127,11 +125,11 @@ FILE *optr;                     ///< pointer to a diagnostic file that will cont
 
 struct filenames files;
 
-int xxxbound;
+THREAD_LOCAL int xxxbound;
 
 struct rdpar_choices zz_spec;
 
 struct Import *imported_model;  ///<  MAX_DOM is defined in sirocco.h and as such import.h has to be included after
 
 
-double velocity_electron[3];    // velocity of the electron when thermal effects are included
+THREAD_LOCAL double velocity_electron[3];    // velocity of the electron when thermal effects are included
@@ -23,14 +23,66 @@ struct CommandlineArguments
 {
   double freq_min;
   double freq_max;
-  double n_freq;
+  int n_freq;
   double inclinations[MAX_CUSTOM_ANGLES];
 };
 
+/* ************************************************************************* */
+/**
+ * @brief  Trace the path of each sight line through the wind.
+ *
+ * @param[in]  inclinations  The sight lines
+ * @param[in]  n_inclinations  The number of sight lines
+ * @param[in]  freq  The frequency of the photon used to trace the paths
+ *
+ * @return  The paths of the sight lines
+ *
+ * @details
+ *
+ * The sight lines are shared between the threads given by --threads. If a
+ * photon could not be created or moved through the wind, the status of the
+ * path is EXIT_FAILURE.
+ *
+ * ************************************************************************** */
+
+SightLinePath_t *
+trace_sight_lines (SightLines_t * inclinations, int n_inclinations, double freq)
+{
+  int i;
+  SightLinePath_t *paths;
+  struct photon photon;
+
+  paths = calloc (n_inclinations, sizeof *paths);
+  if (paths == NULL)
+  {
+    errormsg ("cannot allocate %lu bytes for paths\n", n_inclinations * sizeof *paths);
+    exit (EXIT_FAILURE);
+  }
+
+  OMP_PRAGMA (omp parallel for num_threads (modes.nthreads) schedule (dynamic, 1) private (photon))
+  for (i = 0; i < n_inclinations; i++)
+  {
+    paths[i].status = create_photon (&photon, freq, inclinations[i].lmn);
+    if (paths[i].status == EXIT_FAILURE)
+    {
+      errormsg ("skipping sight line %s\n", inclinations[i].name);
+      continue;
+    }
+    trace_sight_line (&photon, &paths[i]);
+  }
+
+  return paths;
+}
+
 /* ************************************************************************* */
 /**
  * @brief  Create spectra of tau vs lambda for each observer angle
  *
+ * @param[in]  u_freq_min  The minimum frequency given on the command line, or 0
+ * @param[in]  u_freq_max  The maximum frequency given on the command line, or 0
+ * @param[in]  n_freq  The number of frequency bins
+ * @param[in]  input_inclinations  The inclinations given on the command line
+ *
  * @details
  *
  * This is the main function which will generate the optical depth spectra for
@@ -38,37 +90,35 @@ struct CommandlineArguments
  * tau_diag algorithm which this function is called in.
  *
  * A photon is generated at the central source of the model and is extracted
- * from this location towards the observer where it escapes, where integrate_tau_across_wind
- * returns the integrated optical depth along its path to escape. This is done
- * for a range of photon frequencies to find how optical depth changes with
- * frequency.
+ * from this location towards the observer where it escapes. The path through
+ * the grid is the same for every frequency, so it is traced once for each
+ * sight line, recording the cells crossed, the length of the path in each and
+ * the Doppler shift along it. The optical depth at each frequency is then
+ * found from this list of segments.
  *
- * This processes can take some time compared to tau_evalulate_photo_edges. But,
- * since NUM_FREQUENCY_BINS photons are being generated for each spectrum and the fact
- * that these photons do not interact, the spectra does not actually take that
- * long to complete.
+ * The frequencies of all of the sight lines are shared between the threads
+ * given by --threads.
  *
  * ************************************************************************** */
 
 void
-create_optical_depth_spectrum (double u_freq_min, double u_freq_max, double *input_inclinations)
+create_optical_depth_spectrum (double u_freq_min, double u_freq_max, int n_freq, double *input_inclinations)
 {
   int i, j;
-  int err;
-  double *tau_spectrum;
-  double c_optical_depth, c_column_density;
+  double *tau_spectrum, *frequency;
   double c_frequency, freq_min, freq_max, d_freq;
-  struct photon photon;
+  SightLinePath_t *paths;
 
   int n_inclinations;
   SightLines_t *inclinations = initialize_inclination_angles (&n_inclinations, input_inclinations);
 
   printf ("Creating optical depth spectra:\n");
 
-  tau_spectrum = calloc (n_inclinations * NUM_FREQUENCY_BINS, sizeof *tau_spectrum);
-  if (tau_spectrum == NULL)
+  tau_spectrum = calloc (n_inclinations * n_freq, sizeof *tau_spectrum);
+  frequency = calloc (n_freq, sizeof *frequency);
+  if (tau_spectrum == NULL || frequency == NULL)
   {
-    errormsg ("cannot allocate %lu bytes for tau_spectrum\n", n_inclinations * NUM_FREQUENCY_BINS * sizeof *tau_spectrum);
+    errormsg ("cannot allocate %lu bytes for tau_spectrum\n", n_inclinations * n_freq * sizeof *tau_spectrum);
     exit (EXIT_FAILURE);
   }
 
@@ -131,40 +181,52 @@ create_optical_depth_spectrum (double u_freq_min, double u_freq_max, double *inp
     }
   }
 
-  d_freq = (log10 (freq_max) - log10 (freq_min)) / NUM_FREQUENCY_BINS;
+  d_freq = (log10 (freq_max) - log10 (freq_min)) / n_freq;
   kbf_need (freq_min, freq_max);
 
   /*
-   * Now create the optical depth spectra for each inclination
+   * The frequencies are accumulated in the same way as they are written out
+   * by write_optical_depth_spectrum
    */
 
+  c_frequency = log10 (freq_min);
+  for (j = 0; j < n_freq; j++)
+  {
+    frequency[j] = pow (10, c_frequency);
+    c_frequency += d_freq;
+  }
+
+  /*
+   * Now trace each sight line, and create the optical depth spectra for each
+   * inclination from the paths
+   */
+
+  paths = trace_sight_lines (inclinations, n_inclinations, freq_min);
+
   for (i = 0; i < n_inclinations; i++)
   {
     printf ("  - Creating spectrum: %s\n", inclinations[i].name);
-    c_frequency = log10 (freq_min);
+  }
 
-    for (j = 0; j < NUM_FREQUENCY_BINS; j++)
+  OMP_PRAGMA (omp parallel for collapse (2) num_threads (modes.nthreads) schedule (dynamic, 64))
+  for (i = 0; i < n_inclinations; i++)
+  {
+    for (j = 0; j < n_freq; j++)
     {
-      c_optical_depth = 0.0;
-      c_column_density = 0.0;
-
-      err = create_photon (&photon, pow (10, c_frequency), inclinations[i].lmn);
-      if (err == EXIT_FAILURE)
-      {
-        errormsg ("skipping photon of frequency %e\n", pow (10, c_frequency));
+      if (paths[i].status == EXIT_FAILURE)
         continue;
-      }
-
-      err = integrate_tau_across_wind (&photon, &c_column_density, &c_optical_depth);
-      if (err == EXIT_FAILURE)
-        continue;
-
-      tau_spectrum[i * NUM_FREQUENCY_BINS + j] = c_optical_depth;
-      c_frequency += d_freq;
+      tau_spectrum[i * n_freq + j] = sight_line_optical_depth (&paths[i], inclinations[i].lmn, frequency[j]);
     }
   }
 
-  write_optical_depth_spectrum (inclinations, n_inclinations, tau_spectrum, freq_min, d_freq);
+  write_optical_depth_spectrum (inclinations, n_inclinations, tau_spectrum, freq_min, d_freq, n_freq);
+
+  for (i = 0; i < n_inclinations; i++)
+  {
+    free_sight_line (&paths[i]);
+  }
+  free (paths);
+  free (frequency);
   free (tau_spectrum);
   free (inclinations);
 }
@@ -197,10 +259,8 @@ void
 evaluate_photoionization_edges (double *input_inclinations)
 {
   int i, j;
-  int err;
-  double c_frequency, c_optical_depth, c_column_density;
   double *optical_depth_values = NULL, *column_density_values = NULL;
-  struct photon photon;
+  SightLinePath_t *paths;
   enum RunModeEnum original_run_mode = RUN_MODE;
   RUN_MODE = RUN_MODE_NO_ES_OPACITY;
 
@@ -231,35 +291,33 @@ evaluate_photoionization_edges (double *input_inclinations)
   }
 
   /*
-   * Now extract the optical depths and mass column densities. We loop over
-   * each PI edge for each inclination angle.
+   * Now extract the optical depths and mass column densities. Each sight line
+   * is traced once, and the optical depth at each PI edge is found from its
+   * path.
    */
 
+  paths = trace_sight_lines (inclinations, n_inclinations, edges[0].freq);
+
+  OMP_PRAGMA (omp parallel for num_threads (modes.nthreads) schedule (dynamic, 1) private (j))
   for (i = 0; i < n_inclinations; i++)
   {
+    if (paths[i].status == EXIT_FAILURE)
+      continue;               // do not throw extra warning when one is already thrown in trace_sight_lines
+
     for (j = 0; j < n_edges; j++)
     {
-      c_optical_depth = 0.0;
-      c_column_density = 0.0;
-      c_frequency = edges[j].freq;
-
-      err = create_photon (&photon, c_frequency, inclinations[i].lmn);
-      if (err == EXIT_FAILURE)
-      {
-        errormsg ("skipping photon of frequency %e\n", c_frequency);
-        continue;
-      }
-
-      err = integrate_tau_across_wind (&photon, &c_column_density, &c_optical_depth);
-      if (err == EXIT_FAILURE)
-        continue;               // do not throw extra warning when one is already thrown in integrate_tau_across_wind
-
-      optical_depth_values[i * n_edges + j] = c_optical_depth;
-      column_density_values[i] = c_column_density;
+      optical_depth_values[i * n_edges + j] = sight_line_optical_depth (&paths[i], inclinations[i].lmn, edges[j].freq);
     }
+    column_density_values[i] = paths[i].column_density;
   }
 
   print_optical_depths (inclinations, n_inclinations, edges, n_edges, optical_depth_values, column_density_values);
+
+  for (i = 0; i < n_inclinations; i++)
+  {
+    free_sight_line (&paths[i]);
+  }
+  free (paths);
   free (inclinations);
   free (optical_depth_values);
   free (column_density_values);
@@ -274,7 +332,8 @@ evaluate_photoionization_edges (double *input_inclinations)
  *
  * This is the main controlling function for finding the photosphere. The
  * electron scattering optical depth is controlled by the global variable
- * TAU_DEPTH.
+ * TAU_DEPTH. The sight lines are shared between the threads given by
+ * --threads.
  *
  * ************************************************************************** */
 
@@ -304,6 +363,7 @@ find_photosphere (void)
 
   printf ("Locating electron scattering photosphere surface for tau_es = %f\n", TAU_DEPTH);
 
+  OMP_PRAGMA (omp parallel for num_threads (modes.nthreads) schedule (dynamic, 1) private (photon, err, optical_depth, column_density))
   for (i = 0; i < n_inclinations; i++)
   {
     err = create_photon (&photon, test_freq, inclinations[i].lmn);
@@ -344,8 +404,8 @@ print_help (void)
   char *help =
     "A utility program to analyse the optical depth in a Python model.\n\n"
     "usage: py_optical_depth [-h] [-d ndom] [-p tau_stop] [-cion nion] \n"
-    "                        [-freq_min min] [-freq_max max] [-i i1 i2 ...]\n"
-    "                        [--nonrel] [--smax frac] [--no-es] [--version]\n"
+    "                        [-freq_min min] [-freq_max max] [-n-freq n] [-i i1 i2 ...]\n"
+    "                        [--nonrel] [--smax frac] [--no-es] [--threads n] [--version]\n"
     "                        root\n\n"
     "This program can be used in multiple ways. By default, the integrated continuum\n"
     "optical depth along the defined observer lines of sight for the model are returned.\n"
@@ -359,11 +419,13 @@ print_help (void)
     "-cion nion       Extract the column density for an ion of number nion\n"
     "-freq_min min    The lower frequency boundary for optical depth spectra\n"
     "-freq_max max    The upper frequency boundary for optical depth spectra\n"
+    "-n-freq n        The number of frequency bins in the optical depth spectra\n"
     "-i i1 i2 i3 ...  Calculate the optical depth for the given space seperated list of sight lines\n"
     "--nonrel         Use linear frequency transforms, to be used when Python was run\n"
     "                 in non-relativistic mode\n"
     "--smax frac      Set the maximum fraction a photon can move in terms of cell distances\n"
     "--no-es          Do not include opacity contributions from electron scattering\n"
+    "--threads n      Use n threads, if compiled with OpenMP\n"
     "--version        Print the version information and exit.\n";
   printf ("%s", help);
 }
@@ -548,6 +610,33 @@ get_arguments (int argc, char *argv[])
       }
       n_args_read = i++;
     }
+    else if (!strcmp (argv[i], "-n-freq"))      //NOTE: number of frequency bins for optical depth spectrum
+    {
+      char *check;
+      arguments.n_freq = (int) strtol (argv[i + 1], &check, 10);
+      if (*check != '\0')
+      {
+        printf ("Unable to convert argument provided for -n-freq into an integer\n");
+        exit (EXIT_FAILURE);
+      }
+      if (arguments.n_freq < 1)
+      {
+        printf ("Argument for -n-freq must be at least 1\n");
+        exit (EXIT_FAILURE);
+      }
+      n_args_read = i++;
+    }
+    else if (!strcmp (argv[i], "--threads"))    //NOTE: number of threads
+    {
+      char *check;
+      init_threads ((int) strtol (argv[i + 1], &check, 10));
+      if (*check != '\0')
+      {
+        printf ("Unable to convert argument provided for --threads into an integer\n");
+        exit (EXIT_FAILURE);
+      }
+      n_args_read = i++;
+    }
     else if (!strcmp (argv[i], "--no-es"))
     {
       RUN_MODE = RUN_MODE_NO_ES_OPACITY;
@@ -609,6 +698,7 @@ main (int argc, char *argv[])
   COLUMN_MODE = COLUMN_MODE_RHO;
   RUN_MODE = RUN_MODE_TAU_INTEGRATE;
   N_DOMAIN = 0;
+  modes.nthreads = 1;           // this is updated in get_arguments if required
 
   struct CommandlineArguments arguments;
   arguments = get_arguments (argc, argv);
@@ -621,7 +711,8 @@ main (int argc, char *argv[])
   /*
    * Read in the wind_save file and initialize the wind cones and DFUDGE which
    * are important for photon transport. The atomic data is also read in at
-   * this point (which is also very important)
+   * this point (which is also very important). The macro-atom estimators are
+   * not needed, so they are not read
    */
 
   zdom = calloc (MAX_DOM, sizeof (domain_dummy));
@@ -631,7 +722,7 @@ main (int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
-  if (wind_read (windsave_filename) < 0)
+  if (wind_read_select (windsave_filename, WINDSAVE_PLASMA_ARRAYS) < 0)
   {
     errormsg ("unable to open %s\n", windsave_filename);
     exit (EXIT_FAILURE);
@@ -640,6 +731,13 @@ main (int argc, char *argv[])
   DFUDGE = setup_dfudge ();
   setup_windcone ();
 
+  /*
+   * The estimators are not needed, so radiation should not update them when
+   * it is called to find the opacity of a cell
+   */
+
+  geo.ioniz_or_extract = CYCLE_EXTRACT;
+
   /*
    * If a spec_save exists, and there are spectral cycles (possibly a redundant
    * check), then read in the spec_save file.
@@ -694,7 +792,7 @@ main (int argc, char *argv[])
   if (RUN_MODE == RUN_MODE_TAU_INTEGRATE || RUN_MODE == RUN_MODE_NO_ES_OPACITY)
   {
     evaluate_photoionization_edges (arguments.inclinations);
-    create_optical_depth_spectrum (arguments.freq_min, arguments.freq_max, arguments.inclinations);
+    create_optical_depth_spectrum (arguments.freq_min, arguments.freq_max, arguments.n_freq, arguments.inclinations);
   }
   else if (RUN_MODE == RUN_MODE_ES_PHOTOSPHERE)
   {
@@ -54,6 +54,33 @@ typedef struct Positions_s
   double x, y, z;
 } Positions_t;
 
+/** Structure to hold one segment of the path of a sight line through the wind.
+  * The Doppler factors are the ratios of the frequency in the rest frame of
+  * the cell to the frequency in the observer frame, at the start and end of
+  * the segment, so the segment can be used for a photon of any frequency
+  */
+
+typedef struct Segment_s
+{
+  int grid;
+  double x[3];
+  double ds;
+  double doppler_inner, doppler_outer;
+} Segment_t;
+
+/** Structure to hold the path of a sight line through the wind, which is the
+  * same for photons of all frequencies
+  */
+
+typedef struct SightLinePath_s
+{
+  int status;
+  int n_segments;
+  int n_alloc;
+  double column_density;
+  Segment_t *segments;
+} SightLinePath_t;
+
 /** Enumerator used to control the column density which is extracted, i.e. by
   * default mass density/N_H is extracted by the density of an ion can also
   * be extracted
@@ -92,7 +119,11 @@ extern double TAU_DEPTH;
 int create_photon (PhotPtr p_out, double freq, double *lmn);
 SightLines_t *initialize_inclination_angles (int *n_angles, double *input_inclinations);
 int integrate_tau_across_wind (PhotPtr photon, double *c_column_density, double *c_optical_depth);
+int trace_sight_line (PhotPtr photon, SightLinePath_t * path);
+double sight_line_optical_depth (SightLinePath_t * path, double *lmn, double freq);
+void free_sight_line (SightLinePath_t * path);
 void print_optical_depths (SightLines_t * inclinations, int n_inclinations, Edges_t edges[], int n_edges, double *optical_depth,
                            double *column_density);
-void write_optical_depth_spectrum (SightLines_t * inclinations, int n_inclinations, double *tau_spectrum, double freq_min, double d_freq);
+void write_optical_depth_spectrum (SightLines_t * inclinations, int n_inclinations, double *tau_spectrum, double freq_min, double d_freq,
+                                  int n_freq);
 void write_photosphere_location_to_file (Positions_t * positions, int n_angles);
@@ -117,6 +117,7 @@ print_optical_depths (SightLines_t *inclinations, int n_inclinations, Edges_t ed
  * @param[in]  double  freq_min            The starting frequency of the
  *                                         spectrum
  * @param[in]  double  dfreq               The frequency spacing of the spectrum
+ * @param[in]  int  n_freq                 The number of frequency bins
  *
  * @details
  *
@@ -126,7 +127,7 @@ print_optical_depths (SightLines_t *inclinations, int n_inclinations, Edges_t ed
  * ************************************************************************** */
 
 void
-write_optical_depth_spectrum (SightLines_t *inclinations, int n_inclinations, double *tau_spectrum, double freq_min, double d_freq)
+write_optical_depth_spectrum (SightLines_t *inclinations, int n_inclinations, double *tau_spectrum, double freq_min, double d_freq, int n_freq)
 {
   int i, j;
   double c_wavelength, c_frequency;
@@ -156,14 +157,14 @@ write_optical_depth_spectrum (SightLines_t *inclinations, int n_inclinations, do
   fprintf (fp, "\n");
 
   c_frequency = log10 (freq_min);
-  for (i = 0; i < NUM_FREQUENCY_BINS; i++)
+  for (i = 0; i < n_freq; i++)
   {
     c_wavelength = VLIGHT / pow (10, c_frequency) / ANGSTROM;
     fprintf (fp, "%-15e %-15e ", pow (10, c_frequency), c_wavelength);
 
     for (j = 0; j < n_inclinations; j++)
     {
-      fprintf (fp, "%-15e ", tau_spectrum[j * NUM_FREQUENCY_BINS + i]);
+      fprintf (fp, "%-15e ", tau_spectrum[j * n_freq + i]);
     }
 
     fprintf (fp, "\n");
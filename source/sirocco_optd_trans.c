@@ -20,33 +20,28 @@ static const double MAXDIFF = VCHECK / VLIGHT;  // For linear velocity requireme
 
 /* ************************************************************************* */
 /**
- * @brief  Calculate the total optical depth a photon experiences across the
- *         cell of distance SMAX_FRAC * smax.
+ * @brief  Find the segment of the path of a photon across its current cell.
+ *
  * @param[in]  photon  The photon packet
- * @param[in,out]  *c_column_density  The column density the photon has moved
- *                                    through
- * @param[in,out]  *c_optical_depth  The optical depth experienced by the photon
+ * @param[out]  segment  The segment of the path across the cell
  *
- * @return p_istat  The current photon status or EXIT_FAILURE on failure.
+ * @return  EXIT_SUCCESS or EXIT_FAILURE
  *
  * @details
  *
- * This function is concerned with finding the opacity of the photon's current
- * cell, the distance the photon can move in the cell and hence it increments
- * the optical depth tau a photon has experienced as it moves through the wind.
+ * The segment is of length SMAX_FRAC * smax, reduced until the change in the
+ * frequency of the photon in the rest frame of the cell is small enough for
+ * a linear approximation. The frequency shift along the segment is the same,
+ * as a fraction, for photons of every frequency, so is recorded as the ratio
+ * of the frequency in the rest frame of the cell to that in the observer
+ * frame at each end of the segment.
  *
  * ************************************************************************** */
 
-int
-integrate_tau_across_cell (PhotPtr photon, double *c_column_density, double *c_optical_depth)
+static int
+find_cell_segment (PhotPtr photon, Segment_t * segment)
 {
-  int p_istat;
-  int n_domain, n_plasma;
-  double kappa_total, density;
   double smax, diff;
-  double freq_inner, freq_outer, mean_freq;
-  WindPtr c_wind_cell;
-  PlasmaPtr c_plasma_cell;
   struct photon p_start, p_stop, p_now;
 
   photon->grid = where_in_grid (wmain[photon->grid].ndom, photon->x);
@@ -56,26 +51,6 @@ integrate_tau_across_cell (PhotPtr photon, double *c_column_density, double *c_o
     return EXIT_FAILURE;
   }
 
-  /*
-   * Determine where in the plasma grid the cell is. This is required so a
-   * column density can be calculated. Also calculate the maximum distance the
-   * photon can traverse across the cell
-   */
-
-  c_wind_cell = &wmain[photon->grid];
-  n_domain = c_wind_cell->ndom;
-  n_plasma = wmain[photon->grid].nplasma;
-  c_plasma_cell = &plasmamain[n_plasma];
-
-  if (COLUMN_MODE == COLUMN_MODE_RHO)
-  {
-    density = c_plasma_cell->rho;
-  }
-  else
-  {
-    density = c_plasma_cell->density[COLUMN_MODE_ION_NUMBER];
-  }
-
   smax = smax_in_cell (photon) * SMAX_FRAC;
   if (smax < 0)
   {
@@ -112,19 +87,54 @@ integrate_tau_across_cell (PhotPtr photon, double *c_column_density, double *c_o
     smax *= 0.5;
   }
 
-  freq_inner = p_start.freq;
-  freq_outer = p_stop.freq;
-  mean_freq = 0.5 * (freq_inner + freq_outer);
+  segment->grid = photon->grid;
+  stuff_v (photon->x, segment->x);
+  segment->ds = smax;
+  segment->doppler_inner = p_start.freq / photon->freq;
+  segment->doppler_outer = p_stop.freq / photon->freq;
 
-  /*
-   * Now we can finally calculate the opacity due to all the continuum
-   * processes. In macro-atom mode, we need to calculate the continuum opacity
-   * using kappa_bf and kappa_ff using the macro treatment. For simple mode, we
-   * can simply use radiation which **SHOULD** return the continuum opacity
-   * as well, plus something from induced Compton heating. In either cases,
-   * we still then need to add the optical depth from electron scattering at
-   * the end.
-   */
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************* */
+/**
+ * @brief  Calculate the opacity along a segment of a sight line for a photon
+ *         of a given frequency.
+ *
+ * @param[in]  segment  The segment of the sight line
+ * @param[in]  lmn  The direction of the sight line
+ * @param[in]  freq  The frequency of the photon in the observer frame
+ *
+ * @return  The total opacity
+ *
+ * @details
+ *
+ * In macro-atom mode, we need to calculate the continuum opacity using
+ * kappa_bf and kappa_ff using the macro treatment. For simple mode, we can
+ * simply use radiation which **SHOULD** return the continuum opacity as well,
+ * plus something from induced Compton heating. In either cases, we still then
+ * need to add the opacity from electron scattering at the end.
+ *
+ * This may be called by several threads at once.
+ *
+ * ************************************************************************** */
+
+static double
+segment_opacity (Segment_t * segment, double *lmn, double freq)
+{
+  int n_domain;
+  double kappa_total;
+  double freq_inner, mean_freq;
+  WindPtr c_wind_cell;
+  PlasmaPtr c_plasma_cell;
+  struct photon photon;
+
+  c_wind_cell = &wmain[segment->grid];
+  n_domain = c_wind_cell->ndom;
+  c_plasma_cell = &plasmamain[c_wind_cell->nplasma];
+
+  freq_inner = freq * segment->doppler_inner;
+  mean_freq = 0.5 * (freq_inner + freq * segment->doppler_outer);
 
   kappa_total = 0;
 
@@ -132,7 +142,10 @@ integrate_tau_across_cell (PhotPtr photon, double *c_column_density, double *c_o
   {
     if (geo.rt_mode == RT_MODE_2LEVEL)
     {
-      kappa_total += radiation (photon, smax);
+      create_photon (&photon, freq, lmn);
+      stuff_v (segment->x, photon.x);
+      photon.grid = segment->grid;
+      kappa_total += radiation (&photon, segment->ds);
     }
     else                        // macro atom case
     {
@@ -149,30 +162,109 @@ integrate_tau_across_cell (PhotPtr photon, double *c_column_density, double *c_o
     kappa_total += klein_nishina (mean_freq) * c_plasma_cell->ne * zdom[n_domain].fill;
   }
 
+  return kappa_total;
+}
+
+/* ************************************************************************* */
+/**
+ * @brief  Add a segment to the path of a sight line.
+ *
+ * @param[in,out]  path  The path of the sight line
+ * @param[in]  segment  The segment to add
+ *
+ * ************************************************************************** */
+
+static void
+add_segment (SightLinePath_t * path, Segment_t * segment)
+{
+  if (path->n_segments == path->n_alloc)
+  {
+    path->n_alloc = path->n_alloc > 0 ? 2 * path->n_alloc : 256;
+    path->segments = realloc (path->segments, path->n_alloc * sizeof *path->segments);
+    if (path->segments == NULL)
+    {
+      errormsg ("cannot allocate %lu bytes for the path of a sight line\n", path->n_alloc * sizeof *path->segments);
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  path->segments[path->n_segments++] = *segment;
+}
+
+/* ************************************************************************* */
+/**
+ * @brief  Move a photon across its current cell, either adding the optical
+ *         depth across the cell or recording the segment of its path.
+ *
+ * @param[in]  photon  The photon packet
+ * @param[in,out]  path  If not NULL, the path to which the segment is added
+ * @param[in,out]  *c_column_density  The column density the photon has moved
+ *                                    through
+ * @param[in,out]  *c_optical_depth  The optical depth experienced by the photon,
+ *                                   if path is NULL
+ *
+ * @return p_istat  The current photon status or EXIT_FAILURE on failure.
+ *
+ * @details
+ *
+ * This function is concerned with finding the opacity of the photon's current
+ * cell, the distance the photon can move in the cell and hence it increments
+ * the optical depth tau a photon has experienced as it moves through the wind.
+ *
+ * ************************************************************************** */
+
+int
+integrate_tau_across_cell (PhotPtr photon, SightLinePath_t * path, double *c_column_density, double *c_optical_depth)
+{
+  double density;
+  PlasmaPtr c_plasma_cell;
+  Segment_t segment;
+
+  if (find_cell_segment (photon, &segment))
+    return EXIT_FAILURE;
+
+  c_plasma_cell = &plasmamain[wmain[segment.grid].nplasma];
+
+  if (COLUMN_MODE == COLUMN_MODE_RHO)
+  {
+    density = c_plasma_cell->rho;
+  }
+  else
+  {
+    density = c_plasma_cell->density[COLUMN_MODE_ION_NUMBER];
+  }
+
   /*
-   * Increment the optical depth and column density variables and move the
-   * photon to the edge of the cell
+   * Increment the optical depth and column density variables, or record the
+   * segment, and move the photon to the edge of the cell
    */
 
   photon->nscat++;
 
-  *c_column_density += smax * density;
-  *c_optical_depth += smax * kappa_total;
-  move_phot (photon, smax);
-  p_istat = photon->istat;
+  *c_column_density += segment.ds * density;
+  if (path != NULL)
+  {
+    add_segment (path, &segment);
+  }
+  else
+  {
+    *c_optical_depth += segment.ds * segment_opacity (&segment, photon->lmn, photon->freq);
+  }
+  move_phot (photon, segment.ds);
 
-  return p_istat;
+  return photon->istat;
 }
 
 /* ************************************************************************* */
 /**
- * @brief           Extract the optical depth the photon packet porig must
- *                  travel through to reach the observer.
+ * @brief           Move the photon packet porig through the wind towards
+ *                  the observer.
  *
  * @param[in]  photon  The photon packet to extract
+ * @param[in,out]  path  If not NULL, the path to which the segments are added
  * @param[out]  *c_column_density  The column depth of the extracted photon angle
  * @param[out]  *c_optical_depth  The optical depth from photon origin to
- *                                the observer
+ *                                the observer, if path is NULL
  *
  * @return  EXIT_SUCCESS or EXIT_FAILURE
  *
@@ -185,8 +277,8 @@ integrate_tau_across_cell (PhotPtr photon, double *c_column_density, double *c_o
  *
  * ************************************************************************** */
 
-int
-integrate_tau_across_wind (PhotPtr photon, double *c_column_density, double *c_optical_depth)
+static int
+walk_sight_line (PhotPtr photon, SightLinePath_t * path, double *c_column_density, double *c_optical_depth)
 {
   int err;
   int n_dom, where;
@@ -215,7 +307,7 @@ integrate_tau_across_wind (PhotPtr photon, double *c_column_density, double *c_o
     }
     else if ((p_extract.grid = where_in_grid (n_dom, p_extract.x)) >= 0)
     {
-      err = integrate_tau_across_cell (&p_extract, c_column_density, c_optical_depth);
+      err = integrate_tau_across_cell (&p_extract, path, c_column_density, c_optical_depth);
       if (err)
         return EXIT_FAILURE;
     }
@@ -261,3 +353,102 @@ integrate_tau_across_wind (PhotPtr photon, double *c_column_density, double *c_o
 
   return EXIT_SUCCESS;
 }
+
+/* ************************************************************************* */
+/**
+ * @brief           Extract the optical depth the photon packet porig must
+ *                  travel through to reach the observer.
+ *
+ * @param[in]  photon  The photon packet to extract
+ * @param[out]  *c_column_density  The column depth of the extracted photon angle
+ * @param[out]  *c_optical_depth  The optical depth from photon origin to
+ *                                the observer
+ *
+ * @return  EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * ************************************************************************** */
+
+int
+integrate_tau_across_wind (PhotPtr photon, double *c_column_density, double *c_optical_depth)
+{
+  return walk_sight_line (photon, NULL, c_column_density, c_optical_depth);
+}
+
+/* ************************************************************************* */
+/**
+ * @brief  Record the path of a sight line through the wind.
+ *
+ * @param[in]  photon  A photon at the start of the sight line
+ * @param[out]  path  The path of the sight line
+ *
+ * @return  EXIT_SUCCESS or EXIT_FAILURE, which is also stored in path->status
+ *
+ * @details
+ *
+ * The path through the grid does not depend on the frequency of the photon,
+ * so it is traced once for each sight line and the optical depth for each
+ * frequency is then found from the segments of the path with
+ * sight_line_optical_depth. The column density is also found, and stored in
+ * path->column_density.
+ *
+ * ************************************************************************** */
+
+int
+trace_sight_line (PhotPtr photon, SightLinePath_t * path)
+{
+  double dummy_optical_depth = 0.0;
+
+  path->n_segments = 0;
+  path->column_density = 0.0;
+  path->status = walk_sight_line (photon, path, &path->column_density, &dummy_optical_depth);
+
+  return path->status;
+}
+
+/* ************************************************************************* */
+/**
+ * @brief  Calculate the optical depth along the path of a sight line for a
+ *         photon of a given frequency.
+ *
+ * @param[in]  path  The path of the sight line, from trace_sight_line
+ * @param[in]  lmn  The direction of the sight line
+ * @param[in]  freq  The frequency of the photon in the observer frame
+ *
+ * @return  The optical depth along the sight line
+ *
+ * @details
+ *
+ * This may be called by several threads at once, for the same or different
+ * paths.
+ *
+ * ************************************************************************** */
+
+double
+sight_line_optical_depth (SightLinePath_t * path, double *lmn, double freq)
+{
+  int i;
+  double c_optical_depth = 0.0;
+
+  for (i = 0; i < path->n_segments; i++)
+  {
+    c_optical_depth += path->segments[i].ds * segment_opacity (&path->segments[i], lmn, freq);
+  }
+
+  return c_optical_depth;
+}
+
+/* ************************************************************************* */
+/**
+ * @brief  Free the segments of the path of a sight line.
+ *
+ * @param[in,out]  path  The path of the sight line
+ *
+ * ************************************************************************** */
+
+void
+free_sight_line (SightLinePath_t * path)
+{
+  free (path->segments);
+  path->segments = NULL;
+  path->n_segments = path->n_alloc = 0;
+}
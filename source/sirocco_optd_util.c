@@ -107,7 +107,7 @@ outward_initialize_2d_model_angles (int *n_angles, double *input_inclinations)
     {
       strcpy (inclinations[i - MSPEC].name, xxspec[i].name);
       stuff_v (xxspec[i].lmn, inclinations[i - MSPEC].lmn);
-      inclinations[i].angle = -1;       // todo: implement way to get angle xxspec
+      inclinations[i - MSPEC].angle = -1;       // todo: implement way to get angle xxspec
     }
   }
   else
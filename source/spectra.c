@@ -772,10 +772,12 @@ spec_add_one (p, spec_type)
   else if (k < 0)
     k = 0;
 
+  OMP_PRAGMA (omp atomic)
   xxspec[spec_type].f[k] += p->w;
 
   if (iwind)
   {
+    OMP_PRAGMA (omp atomic)
     xxspec[SPEC_SCATTERED].f_wind[k] += p->w;
   }
 
@@ -786,9 +788,11 @@ spec_add_one (p, spec_type)
   else if (k < 0)
     k = 0;
 
+  OMP_PRAGMA (omp atomic)
   xxspec[spec_type].lf[k] += p->w;
   if (iwind)
   {
+    OMP_PRAGMA (omp atomic)
     xxspec[SPEC_SCATTERED].lf_wind[k] += p->w;
   }
 
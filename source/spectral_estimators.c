@@ -21,9 +21,9 @@
 /* external variables set up so zbrent can solve for various variables  */
 
 /// Minimum, maximum and mean frequency in a band
-double spec_numin, spec_numax, spec_numean;
+THREAD_LOCAL double spec_numin, spec_numax, spec_numean;
 /// Log versions of numin and numax - the band ends
-double lspec_numin, lspec_numax;
+THREAD_LOCAL double lspec_numin, lspec_numax;
 
 
 /**********************************************************/
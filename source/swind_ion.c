@@ -429,7 +429,7 @@ line_summary (w, rootname, ochoice)
     nline = 0;
     freq_search = VLIGHT / lambda;
 
-    while (fabs (1. - lin_ptr[nline]->freq / freq_search) > 0.0001 && nline < nlines)
+    while (nline < nlines && fabs (1. - lin_ptr[nline]->freq / freq_search) > 0.0001)
       nline++;
     if (nline == nlines)
     {
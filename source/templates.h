@@ -8,8 +8,16 @@ int randwind_thermal_trapping(PhotPtr p, int *nnscat);
 /* atomic_extern_init.c */
 /* atomicdata.c */
 int get_atomic_data(char masterfile[]);
+int read_atomic_data(char masterfile[]);
+/* atomicdata_cache.c */
+char *atomic_cache_pack(size_t *nbytes);
+int atomic_cache_unpack(char *image, int shared);
+int atomic_cache_read(char masterfile[]);
+int atomic_cache_write(char masterfile[]);
 /* atomicdata_init.c */
 int init_atomic_data(void);
+int atomic_data_reserve(int nline, int nlevel, int nphot, int ninner);
+int atomic_data_resize(int nline, int nlevel, int nphot, int ninner);
 /* atomicdata_sub.c */
 int atomicdata2file(void);
 int index_lines(void);
@@ -18,6 +26,7 @@ int index_inner_cross(void);
 void indexx(int n, float arrin[], int indx[]);
 int limit_lines(double freqmin, double freqmax);
 int check_xsections(void);
+int check_phot_info(void);
 double q21(struct lines *line_ptr, double t);
 double q12(struct lines *line_ptr, double t);
 double a21(struct lines *line_ptr);
@@ -28,7 +37,9 @@ int bands_init(int imode, struct xbands *band);
 int ion_bands_init(int mode, double freqmin, double freqmax, struct xbands *band);
 void check_appropriate_banding(struct xbands *band, int mode);
 /* bb.c */
+int planck_limits(double t, double freqmin, double freqmax, BbLimitsPtr lim);
 double planck(double t, double freqmin, double freqmax);
+double planck_from_limits(BbLimitsPtr lim);
 double get_rand_pow(double x1, double x2, double alpha);
 double get_rand_exp(double alpha_min, double alpha_max);
 double integ_planck_d(double alphamin, double alphamax);
@@ -37,6 +48,12 @@ double planck_d(double alpha, void *params);
 double planck_d_2(double alpha, void *params);
 double emittance_bb(double freqmin, double freqmax, double t);
 double check_freq_max(double freq_max, double temp);
+/* bf_cache.c */
+int bf_cache_build(double freq_min, double freq_max);
+double bf_cache_kappa(PlasmaPtr xplasma, double freq, int macro_all);
+int bf_cache_select(PlasmaPtr xplasma, double threshold);
+int bf_cache_expand(void);
+int bf_cache_free(void);
 /* bilinear.c */
 int bilin(double x[], double x00[], double x01[], double x10[], double x11[], double *f, double *g);
 /* brem.c */
@@ -48,6 +65,7 @@ int cdf_gen_from_func(CdfPtr cdf, double (*func)(double, void *), double xmin, d
 double gen_array_from_func(double (*func)(double, void *), double xmin, double xmax, int pdfsteps);
 int cdf_gen_from_array(CdfPtr cdf, double x[], double y[], int n_xy, double xmin, double xmax);
 double cdf_get_rand(CdfPtr cdf);
+double cdf_get_rand_array(double *xcdf, double *ycdf, double *dcdf, int ncdf);
 int cdf_limit(CdfPtr cdf, double xmin, double xmax);
 double cdf_get_rand_limit(CdfPtr cdf);
 int cdf_to_file(CdfPtr cdf, char comment[]);
@@ -58,17 +76,29 @@ int cdf_array_fixup(double *x, double *y, int n_xy);
 /* charge_exchange.c */
 int compute_ch_ex_coeffs(double T);
 double ch_ex_heat(WindPtr one, double t_e);
+/* communicate_atomic.c */
+int share_atomic_data(char masterfile[]);
+/* communicate_cells.c */
+void comm_cells_init(CommCellsPtr comm, char *name);
+void comm_cells_add(CommCellsPtr comm, int type, void *cells, size_t stride, size_t offset, size_t nbytes);
+void comm_cells_add_conditional(CommCellsPtr comm, int type, void *cells, size_t stride, size_t offset, size_t nbytes, size_t flag_offset);
+void communicate_cells(CommCellsPtr comm, const int n_start, const int n_stop);
+void communicate_cell_list(CommCellsPtr comm, const int *cells, const int n_cells_rank);
+void report_cell_communication(void);
 /* communicate_macro.c */
 void broadcast_macro_atom_emissivities(const int n_start, const int n_stop, const int n_cells_rank);
 void broadcast_macro_atom_recomb(const int n_start, const int n_stop, const int n_cells_rank);
-int broadcast_updated_macro_atom_properties(const int n_start, const int n_stop, const int n_cells_rank);
+int broadcast_updated_macro_atom_properties(const int *cells, const int n_cells_rank);
 int broadcast_macro_atom_state_matrix(int n_start, int n_stop, int n_cells_rank);
 void reduce_macro_atom_estimators(void);
+/* communicate_photons.c */
+int trans_phot_dynamic(WindPtr w, PhotPtr p, int iextract, int nthreads, int *nbatch_stolen);
+void report_transport_load(double t_busy, double t_idle, int nphot_done, int nbatch_stolen);
 /* communicate_plasma.c */
 void broadcast_plasma_grid(const int n_start, const int n_stop, const int n_cells_rank);
 void broadcast_wind_luminosity(const int n_start, const int n_stop, const int n_cells_rank);
 void broadcast_wind_cooling(const int n_start, const int n_stop, const int n_cells_rank);
-int broadcast_updated_plasma_properties(const int n_start_rank, const int n_stop_rank, const int n_cells_rank);
+int broadcast_updated_plasma_properties(const int *cells, const int n_cells_rank);
 int reduce_simple_estimators(void);
 /* communicate_spectra.c */
 int normalize_spectra_across_ranks(void);
@@ -86,6 +116,10 @@ double pdf_thermal(double x, void *params);
 int compton_get_thermal_velocity(double t, double *v);
 double compton_func(double f, void *params);
 double sigma_compton_partial(double f, double x);
+double thermal_cdf(double x);
+int compton_table_init(void);
+double compton_table_f(double x, double u);
+double thermal_table_speed(double u);
 double compton_alpha(double nu);
 double compton_beta(double nu);
 double comp_cool_integrand(double nu, void *params);
@@ -110,6 +144,11 @@ double wdrad(double m);
 double diskrad(double m1, double m2, double period);
 double roche2(double q, double a);
 double logg(double mass, double rwd);
+/* cycle_stream.c */
+int cycle_stream_open(char *filename, char *list);
+void cycle_stream_wait(void);
+int cycle_stream_write(int cycle);
+int cycle_stream_close(void);
 /* cylind_var.c */
 double cylvar_ds_in_cell(int ndom, PhotPtr p);
 int cylvar_make_grid(int ndom, WindPtr w);
@@ -177,8 +216,19 @@ int photo_gen_wind(PhotPtr p, double weight, double freqmin, double freqmax, int
 double one_line(PlasmaPtr xplasma, int *nres);
 double total_free(PlasmaPtr xplasma, double t_e, double f1, double f2);
 double ff(PlasmaPtr xplasma, double t_e, double freq);
+int ff_cdf(PlasmaPtr xplasma, double f1, double f2, CdfPtr cdf);
 double one_ff(PlasmaPtr xplasma, double f1, double f2);
 double gaunt_ff(double gsquared);
+/* emission_cdf.c */
+int emission_cdf_reset(void);
+int emission_cdf_init(int need[][NSPEC_CELL], double f1, double f2);
+double emission_cdf_rand(PlasmaPtr xplasma, int type, double f1, double f2, int *nres);
+int emission_cdf_free(void);
+/* emission_sampler.c */
+int emission_sampler_init(int type);
+int emission_sampler_cell(int type, double xlum, int *level);
+int emission_sampler_draw(int type, double ftot, int nphot, int *cells, int *levels);
+int emission_sampler_free(void);
 /* estimators_macro.c */
 int bf_estimators_increment(WindPtr one, PhotPtr p, double ds);
 int bb_estimators_increment(WindPtr one, PhotPtr p, double tau_sobolev, double dvds, int nn);
@@ -211,6 +261,8 @@ void update_persistent_directional_flux_estimators(int nplasma, double flux_pers
 /* extract.c */
 int extract(WindPtr w, PhotPtr p, int itype);
 int extract_one(WindPtr w, PhotPtr pp, int nspec);
+int extract_batch(WindPtr w, PhotPtr batch, int *nspec, int nbatch);
+long extract_report(void);
 /* frame.c */
 int check_frame(PhotPtr p, enum frame desired_frame, char *msg);
 double calculate_gamma_factor(double vel[3]);
@@ -239,6 +291,7 @@ int calloc_macro(int nelem);
 int calloc_estimators(int nelem);
 int calloc_dyn_plasma(int nelem);
 int calloc_matom_matrix(int nelem);
+int set_matom_matrix_storage(void);
 void allocate_macro_matrix(double ***matrix_addr, int matrix_size);
 /* homologous.c */
 int get_homologous_params(int ndom);
@@ -295,6 +348,8 @@ int convergence(PlasmaPtr xplasma);
 int check_convergence(void);
 int one_shot(PlasmaPtr xplasma, int mode);
 double calc_te(PlasmaPtr xplasma, double tmin, double tmax);
+double calc_te_grid(double tmin, double z1, double tmax, double z2);
+int calc_te_summary(void);
 double zero_emit(double t);
 double zero_emit2(double t, void *params);
 /* janitor.c */
@@ -315,17 +370,27 @@ double kn_wind_mdot_integral(double r, void *params);
 double kn_rho_zero(int ndom, double r);
 /* levels.c */
 int levels(PlasmaPtr xplasma, int mode);
+/* line_lists.c */
+int line_need(void);
+LineListPtr cell_lines(int nplasma);
+int limit_cell_lines(LineListPtr list, double freqmin, double freqmax);
+int line_lists_free(void);
 /* lines.c */
 double total_line_emission(PlasmaPtr xplasma, double f1, double f2);
 double lum_lines(PlasmaPtr xplasma, int nmin, int nmax);
+double line_power(PlasmaPtr xplasma, int nmin, int nmax, double *lpow);
 double two_level_atom(struct lines *line_ptr, PlasmaPtr xplasma, double *d1, double *d2);
+double two_level_atom_ion(struct lines *line_ptr, PlasmaPtr xplasma, double den_ion, double *d1, double *d2);
 double line_nsigma(struct lines *line_ptr, PlasmaPtr xplasma);
 double scattering_fraction(struct lines *line_ptr, PlasmaPtr xplasma);
 double p_escape(struct lines *line_ptr, PlasmaPtr xplasma);
 double p_escape_from_tau(double tau);
 int line_heat(PlasmaPtr xplasma, PhotPtr pp, int nres);
 /* macro_accelerate.c */
+int matom_fingerprint_free(void);
 void calc_matom_matrix(PlasmaPtr xplasma, double **matom_matrix);
+void calc_matom_matrix_from_rates(PlasmaPtr xplasma, double *N, double *R, double **matom_matrix);
+int calc_stored_matom_matrix(PlasmaPtr xplasma);
 int fill_kpkt_rates(PlasmaPtr xplasma, int *escape, PhotPtr p);
 double f_matom_emit_accelerate(PlasmaPtr xplasma, int upper, double freq_min, double freq_max);
 double f_kpkt_emit_accelerate(PlasmaPtr xplasma, double freq_min, double freq_max);
@@ -337,11 +402,12 @@ double get_matom_f_accelerate(int mode);
 /* macro_gov.c */
 int macro_gov(PhotPtr p, int *nres, int matom_or_kpkt, int *which_out);
 int macro_pops(PlasmaPtr xplasma, double xne);
-int macro_pops_fill_rate_matrix(MacroPtr mplasma, PlasmaPtr xplasma, double xne, int index_element, double rate_matrix[600][600], int radiative_flag[600][600], int conf_to_matrix[600]);
-int macro_pops_check_for_population_inversion(int index_element, double *populations, int radiative_flag[600][600], int conf_to_matrix[600]);
-int macro_pops_check_densities_for_numerical_errors(PlasmaPtr xplasma, int index_element, double *populations, int conf_to_matrix[600], int n_iterations);
-void macro_pops_copy_to_xplasma(PlasmaPtr xplasma, int index_element, double *populations, int conf_to_matrix[600]);
+int macro_pops_fill_rate_matrix(MacroPtr mplasma, PlasmaPtr xplasma, double xne, int index_element, int nlev, double rate_matrix[nlev][nlev], int radiative_flag[nlev][nlev], int conf_to_matrix[nlev]);
+int macro_pops_check_for_population_inversion(int index_element, double *populations, int nlev, int radiative_flag[nlev][nlev], int conf_to_matrix[nlev]);
+int macro_pops_check_densities_for_numerical_errors(PlasmaPtr xplasma, int index_element, double *populations, int *conf_to_matrix, int n_iterations);
+void macro_pops_copy_to_xplasma(PlasmaPtr xplasma, int index_element, double *populations, int *conf_to_matrix);
 /* matom.c */
+int matom_jump_prbs(PlasmaPtr xplasma, int uplvl, double *jprbs, double *eprbs, double *pjnorm_out, double *penorm_out);
 int matom(PhotPtr p, int *nres, int *escape);
 double b12(struct lines *line_ptr);
 double xalpha_sp(struct topbase_phot *cont_ptr, PlasmaPtr xplasma, int ichoice);
@@ -354,18 +420,25 @@ int fake_matom_bf(PhotPtr p, int *nres, int *escape);
 int emit_matom(WindPtr w, PhotPtr p, int *nres, int upper, double freq_min, double freq_max);
 /* matom_diag.c */
 int matom_emiss_report(void);
+/* matom_tables.c */
+MatomJumpsPtr matom_jump_table(PlasmaPtr xplasma, int uplvl);
+int matom_jump_choose(MatomJumpsPtr jumps);
+int matom_emit_choose(MatomJumpsPtr jumps);
+int matom_jump_free(void);
 /* matrix_cpu.c */
 const char *get_matrix_error_string(int error_code);
 int solve_matrix(double *a_matrix, double *b_matrix, int size, double *x_matrix, int nplasma);
 int invert_matrix(double *matrix, double *inverted_matrix, int num_rows);
 /* matrix_ion.c */
 int matrix_ion_populations(PlasmaPtr xplasma, int mode);
-int populate_ion_rate_matrix(double rate_matrix[nions][nions], double pi_rates[nions], double inner_rates[n_inner_tot], double rr_rates[nions], double b_temp[nions], double xne, double nh1, double nh2);
+int matrix_ion_free(void);
+int populate_ion_rate_block(int nelem, double *a, double *b, double *pi_rates, double *inner_rates, double *rr_rates, double xne, double nh1, double nh2);
 /* matrix_ion2.c */
 int matrix_ion_populations2(PlasmaPtr xplasma, int mode);
 /* models_extern_init.c */
 /* para_update.c */
 int get_parallel_nrange(int rank, int ntotal, int nproc, int *my_nmin, int *my_nmax);
+int get_parallel_ncost(int rank, int ntotal, int nproc, double *cost, int *tasks);
 int get_max_cells_per_rank(const int n_total);
 int calculate_comm_buffer_size(const int num_ints, const int num_doubles);
 /* parse.c */
@@ -408,6 +481,7 @@ int translate(WindPtr w, PhotPtr pp, double tau_scat, double *tau, int *nres);
 int translate_in_space(PhotPtr pp);
 double ds_to_wind(PhotPtr pp, int *ndom_current);
 int translate_in_wind(WindPtr w, PhotPtr p, double tau_scat, double *tau, int *nres);
+int translate_in_wind_update(WindPtr w, PhotPtr p, double ds, int nres, int istat);
 double smax_in_cell(PhotPtr p);
 double ds_in_cell(int ndom, PhotPtr p);
 /* photon_gen.c */
@@ -430,6 +504,13 @@ double calc_pi_rate(int nion, PlasmaPtr xplasma, int mode, int type);
 double tb_planck(double freq, void *params);
 double tb_logpow(double freq, void *params);
 double tb_exp(double freq, void *params);
+/* profile.c */
+int prof_init(void);
+double prof_start(void);
+int prof_stop(int kernel, double t0);
+int prof_cell_step(int nwind, double t0);
+int prof_cell_scatter(int nwind);
+int prof_report(char *type, int cycle);
 /* sirocco_extern_init.c */
 /* radiation.c */
 double radiation(PhotPtr p, double ds);
@@ -447,10 +528,15 @@ double vcos(double x, void *params);
 int randvdipole(double lmn[], double north[]);
 double vdipole(double cos_theta, void *params);
 int init_rand(int seed);
+int init_rand_threads(int nthreads);
 void init_rng_directory(char *root, int rank);
 void save_gsl_rng_state(void);
 void reload_gsl_rng_state(void);
 double random_number(double min, double max);
+/* rate_table.c */
+int rate_table_init(void);
+int rate_table_coeffs(double t, double *rr_rates);
+int rate_table_free(void);
 /* rdpar.c */
 int opar(char filename[]);
 int add_par(char filename[]);
@@ -489,6 +575,7 @@ double fb_topbase_partial(double freq);
 double fb_topbase_partial2(double freq, void *params);
 double integ_fb(double t, double f1, double f2, int nion, int fb_choice, int mode);
 double total_fb(PlasmaPtr xplasma, double t, double f1, double f2, int fb_choice, int mode);
+int fb_cdf(PlasmaPtr xplasma, double f1, double f2, CdfPtr cdf);
 double one_fb(PlasmaPtr xplasma, double f1, double f2);
 int num_recomb(PlasmaPtr xplasma, double t_e, int mode);
 double fb(PlasmaPtr xplasma, double t, double freq, int ion_choice, int fb_choice);
@@ -504,8 +591,12 @@ int compare_doubles(const void *a, const void *b);
 double matom_select_bf_freq(WindPtr one, int nconf);
 /* resonate.c */
 double calculate_ds(WindPtr w, PhotPtr p, double tau_scat, double *tau, int *nres, double smax, int *istat);
+int ds_path_continuum(WindPtr w, PhotPtr p, double smax, struct ds_path *path);
+double ds_path_lines(WindPtr w, PhotPtr p, double tau_scat, double *tau, int *nres, struct ds_path *path, int *istat);
 int select_continuum_scattering_process(double kap_cont, double kap_es, double kap_ff, PlasmaPtr xplasma);
+int kappa_bf_work(void);
 double kappa_bf(PlasmaPtr xplasma, double freq, int macro_all);
+double kappa_bf_process(PlasmaPtr xplasma, int n, double freq, double fill);
 int kbf_need(double freq_min, double freq_max);
 double sobolev(WindPtr one, double x[], double den_ion, struct lines *lptr, double dvds);
 int scatter(PhotPtr p, int *nres, int *nnscat);
@@ -516,6 +607,9 @@ int delay_dump_finish(void);
 int delay_dump_combine(int i_ranks);
 int delay_dump(PhotPtr p, int np);
 int delay_dump_single(PhotPtr pp, int i_spec);
+int reverb_tf_init(void);
+int reverb_tf_add(PhotPtr pp, int i_spec);
+int reverb_tf_write(void);
 /* roche.c */
 int binary_basics(void);
 int hit_secondary(PhotPtr p);
@@ -631,9 +725,22 @@ double timer(void);
 int get_time(char curtime[]);
 struct timeval init_timer_t0(void);
 void print_timer_duration(char *msg, struct timeval timer_t0);
+/* threads.c */
+int init_threads(int nthreads);
+int get_transport_threads(void);
+int get_update_threads(void);
+int init_plasma_locks(void);
+void lock_plasma_cell(int nplasma);
+void unlock_plasma_cell(int nplasma);
+int in_parallel_region(void);
 /* trans_phot.c */
 int trans_phot(WindPtr w, PhotPtr p, int iextract);
+int trans_phot_batch(WindPtr w, PhotPtr p, int nphot_batch, int iextract, int nthreads, int nreport);
+void trans_phot_progress(int nphot);
 int trans_phot_single(WindPtr w, PhotPtr p, int iextract);
+int trans_phot_interact(WindPtr w, PhotPtr p, PhotPtr pp, int iextract, double weight_min, int *current_nres, double *tau_scat, double *tau, enum istat_enum *istat);
+/* trans_phot_event.c */
+int trans_phot_events(WindPtr w, PhotPtr p, int nphot, int iextract, int nthreads, int nreport);
 /* vvector.c */
 double dot(double a[], double b[]);
 double length(double a[]);
@@ -688,10 +795,23 @@ int wind_ij_to_n(int ndom, int i, int j, int *n);
 int wind_x_to_n(double x[], int *n);
 /* windsave.c */
 int wind_save(char filename[]);
+int wind_save_checkpoint(char filename[]);
 int wind_read(char filename[]);
+int wind_read_select(char filename[], int select);
 void wind_complete(void);
 int spec_save(char filename[]);
 int spec_read(char filename[]);
+/* windsave_file.c */
+WindsaveFilePtr windsave_create(char *filename, int compress, int async);
+void windsave_add(WindsaveFilePtr ws, char *name, void *data, size_t elsize, size_t count);
+void windsave_add_cells(WindsaveFilePtr ws, char *name, void *cells, size_t stride, size_t offset, size_t elsize, size_t n, int ncells);
+int windsave_finish(WindsaveFilePtr ws);
+void windsave_wait(void);
+int windsave_is_sectioned(char *filename);
+WindsaveFilePtr windsave_open(char *filename);
+int windsave_read(WindsaveFilePtr ws, char *name, void *dest, size_t elsize, size_t count);
+int windsave_read_cells(WindsaveFilePtr ws, char *name, void *cells, size_t stride, size_t offset, size_t elsize, size_t n, int first, int ncells);
+void windsave_close(WindsaveFilePtr ws);
 /* windsave2table_sub.c */
 int do_windsave2table(char *root, int ion_switch, int edge_switch);
 int create_master_table(int ndom, char rootname[]);
@@ -705,6 +825,13 @@ int get_one_array_element(int ndom, char variable_name[], int array_dim, double
 int create_spec_table(int ndom, char rootname[]);
 int create_detailed_cell_spec_table(int ncell, char rootname[]);
 int create_big_detailed_spec_table(int ndom, char *rootname);
+/* windsave2table_columns.c */
+char *ion_table_quantity(int ion_switch);
+int ion_table_column(int nion, int ion_switch, WindTableColumnPtr column);
+int resolve_table_column(char *name, int ion_switch, WindTableColumnPtr column);
+int fill_table_columns(int ndom, WindTableColumnPtr columns, int ncols, int edge, int nfirst, int nlast, double **values);
+int parse_table_columns(char *list, int ion_switch, WindTableColumnPtr *columns);
+int do_windsave2table_columns(char *root, char *list, int ion_switch, int edge, int ascii, int binary);
 /* xlog.c */
 int Log_init(char *filename);
 int Log_append(char *filename);
@@ -805,7 +932,7 @@ int main(int argc, char *argv[]);
 int one_choice(int choice, char *root, int ochoice);
 void swind_help(void);
 /* windsave2table.c */
-void parse_arguments(int argc, char *argv[], char root[], int *ion_switch, int *spec_switch, int *edge_switch);
+void parse_arguments(int argc, char *argv[], char root[], int *ion_switch, int *spec_switch, int *edge_switch, char *column_list, int *ascii, int *binary);
 int main(int argc, char *argv[]);
 /* windsave2table_sub.c */
 int do_windsave2table(char *root, int ion_switch, int edge_switch);
@@ -106,6 +106,78 @@ test_klein_nishina (void)
   CU_ASSERT_DOUBLE_EQUAL_FATAL (klein_nishina (1e18), 6.546940139261951e-25, 1e-30);
 }
 
+/** *******************************************************************************************************************
+ *
+ * @brief Test the tabulated sampler for the Compton energy change against the Klein-Nishina distribution
+ *
+ * @details
+ *
+ * For a range of photon energies, the fractional energy change is interpolated for many values of the random cross
+ * section u. compton_func, as used by compton_dir to find the energy change with zero_find, then gives the difference
+ * between the cumulative distribution at the tabulated energy change and u, the largest value of which bounds the
+ * difference between the tabulated and exact distributions.
+ *
+ * ****************************************************************************************************************** */
+
+void
+test_compton_table (void)
+{
+  const double test_frequencies[] = { 1e17, 5e18, 1e20, 5e21, 1e23 };
+  const int n_freq = sizeof test_frequencies / sizeof test_frequencies[0];
+  const int n_u = 1000;
+  int i, j;
+  double energy_ratio, u, f;
+
+  for (i = 0; i < n_freq; i++)
+  {
+    energy_ratio = (PLANCK * test_frequencies[i]) / (MELEC * VLIGHT * VLIGHT);
+    for (j = 0; j < n_u; j++)
+    {
+      u = (j + 0.37) / n_u;
+      f = compton_table_f (energy_ratio, u);
+      CU_ASSERT_FATAL (f >= 1.0 && f <= 1 + 2 * energy_ratio);
+      set_comp_func_values (u, sigma_compton_partial (1 + 2 * energy_ratio, energy_ratio), energy_ratio);
+      CU_ASSERT_DOUBLE_EQUAL_FATAL (compton_func (f, NULL), 0.0, 1e-4);
+    }
+  }
+}
+
+/** *******************************************************************************************************************
+ *
+ * @brief Test the tabulated sampler for the thermal speed of electrons against the Maxwell-Boltzmann distribution
+ *
+ * @details
+ *
+ * The analytic cumulative distribution used to create the table is first compared to cdf_thermal, which is used by
+ * compton_get_thermal_velocity. The cumulative distribution at the tabulated speeds is then compared to the values
+ * of the cumulative distribution for which they are interpolated.
+ *
+ * ****************************************************************************************************************** */
+
+void
+test_thermal_table (void)
+{
+  extern struct Cdf cdf_thermal;
+  const int n_u = 10000;
+  int j;
+  double v[3], u, x;
+
+  compton_get_thermal_velocity (1e5, v);        /* Ensure that cdf_thermal has been created */
+
+  for (j = 0; j <= cdf_thermal.ncdf; j++)
+  {
+    CU_ASSERT_DOUBLE_EQUAL_FATAL (thermal_cdf (cdf_thermal.x[j]), cdf_thermal.y[j], 1e-3);
+  }
+
+  for (j = 0; j < n_u; j++)
+  {
+    u = (j + 0.37) / n_u;
+    x = thermal_table_speed (u);
+    CU_ASSERT_FATAL (x >= 0.0 && x <= 5.0);
+    CU_ASSERT_DOUBLE_EQUAL_FATAL (thermal_cdf (x), u, 1e-4);
+  }
+}
+
 /** *******************************************************************************************************************
  *
  * @brief Create a CUnit test suite for Compton processes
@@ -133,7 +205,9 @@ create_compton_test_suite (void)
   if ((CU_add_test (suite, "Klein-Nisina Formula", test_klein_nishina) == NULL) ||
       (CU_add_test (suite, "Compton Alpha - heating cross section ", test_compton_alpha) == NULL) ||
       (CU_add_test (suite, "Compton Beta - cooling cross section", test_compton_beta) == NULL) ||
-      (CU_add_test (suite, "Compton Formula", test_compton_func) == NULL))
+      (CU_add_test (suite, "Compton Formula", test_compton_func) == NULL) ||
+      (CU_add_test (suite, "Compton Energy Change - tabulated sampler", test_compton_table) == NULL) ||
+      (CU_add_test (suite, "Thermal Speed - tabulated sampler", test_thermal_table) == NULL))
   {
     fprintf (stderr, "Failed to add tests to `Compton Processes` suite\n");
     CU_cleanup_registry ();
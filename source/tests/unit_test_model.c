@@ -156,7 +156,7 @@ cleanup_model (const char *root_name)
   }
 
   free_and_null ((void **) &plasmamain);
-  free_and_null ((void **) &photstoremain);
+  emission_cdf_free ();
   free_and_null ((void **) &matomphotstoremain);        /* This one doesn't care about if macro atoms are used or not */
 
   if (nlevels_macro > 0)
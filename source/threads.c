@@ -0,0 +1,291 @@
+/***********************************************************/
+/** @file  threads.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Routines which support the transport of photons by
+ * several threads within a single MPI process
+ *
+ * Threading is only available if sirocco has been compiled with
+ * OpenMP, e.g. make OPENMP=yes sirocco, and is requested with
+ * the --threads command line switch.  The threads share the
+ * wind and plasma structures.  Each thread has its own random
+ * number generator (see init_rand_threads) and its own copies of
+ * the various file scope caches used in the transport routines
+ * (see threads.h), while updates to the estimators of an
+ * individual plasma cell are serialised by a lock associated with
+ * that cell.
+ *
+ * Since threads accumulate directly into the (shared) plasma
+ * structure, the estimators for a cycle are complete as soon as
+ * the parallel region ends, and the MPI reduction of the estimators
+ * proceeds exactly as in a serial run.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+#ifdef _OPENMP
+omp_lock_t *plasma_locks = NULL;
+#endif
+int nplasma_locks = 0;
+
+
+
+/**********************************************************/
+/**
+ * @brief      Set the number of threads which are to be used
+ * for photon transport in each MPI process
+ *
+ * @param [in] int  nthreads   The number of threads requested
+ * @return     The number of threads that will be used
+ *
+ * @details
+ * This is called when the command line is parsed.  If sirocco
+ * has not been compiled with OpenMP, the request is ignored and
+ * a single thread is used.
+ *
+ **********************************************************/
+
+int
+init_threads (nthreads)
+     int nthreads;
+{
+  if (nthreads < 1)
+  {
+    Error ("init_threads: Number of threads %d must be at least 1, using 1\n", nthreads);
+    nthreads = 1;
+  }
+
+#ifdef _OPENMP
+  modes.nthreads = nthreads;
+#else
+  if (nthreads > 1)
+  {
+    Error ("init_threads: sirocco was not compiled with OpenMP (make OPENMP=yes), so only 1 thread will be used\n");
+  }
+  modes.nthreads = 1;
+#endif
+
+  return (modes.nthreads);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Determine the number of threads to use when
+ * transporting photons in the current cycle
+ *
+ * @return     The number of threads to use
+ *
+ * @details
+ * Threaded transport is currently limited to the simple-atom
+ * (two-level) line transfer modes.  Several of the diagnostic
+ * modes that write information about individual photons
+ * to files, and the reverberation mapping options, are also
+ * not supported, so if any of these are in use, a single thread
+ * is used.
+ *
+ * ### Notes ###
+ * The macro-atom routines make use of a number of file scope
+ * variables to carry information between the routines that
+ * calculate and sample the macro-atom jumping probabilities.
+ * These would need to be made thread safe before macro-atom
+ * runs could use more than one thread.
+ *
+ **********************************************************/
+
+int
+get_transport_threads ()
+{
+  static int warned = FALSE;
+  int nthreads;
+
+  nthreads = modes.nthreads;
+
+  if (nthreads > 1)
+  {
+    if (geo.rt_mode == RT_MODE_MACRO || geo.reverb != REV_NONE || modes.save_photons || modes.save_extract_photons
+        || modes.track_resonant_scatters || modes.save_cell_stats || modes.searchlight)
+    {
+      if (warned == FALSE)
+      {
+        Error ("get_transport_threads: Threaded transport is not supported with macro atoms, reverberation or photon diagnostics;"
+               " using 1 thread\n");
+        warned = TRUE;
+      }
+      nthreads = 1;
+    }
+  }
+
+  return (nthreads);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Determine the number of threads to use when
+ * updating the plasma cells at the end of an ionization cycle
+ *
+ * @return     The number of threads to use
+ *
+ * @details
+ * In wind_update, each thread updates whole cells, taken from
+ * the cells assigned to the MPI process as each thread finishes
+ * its previous cell.  Unlike photon transport, this works for
+ * macro-atom as well as simple-atom models.  The rates and cross
+ * sections which the ionization and temperature calculations
+ * keep in file scope variables are per thread, and the tables
+ * which are built the first time they are needed are built by
+ * one thread at a time.
+ *
+ * ### Notes ###
+ * The GPU matrix solver is not used by several threads at once,
+ * so a single thread is used if sirocco was compiled with CUDA.
+ *
+ **********************************************************/
+
+int
+get_update_threads ()
+{
+  int nthreads;
+
+  nthreads = modes.nthreads;
+
+#ifdef CUDA_ON
+  nthreads = 1;
+#endif
+
+  return (nthreads);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Allocate and initialise the locks used to serialise
+ * updates to the estimators of individual plasma cells
+ *
+ * @return     0
+ *
+ * @details
+ * One lock is created for each element of plasmamain, including the
+ * dummy cell at the end of the array.  The locks are only
+ * reallocated if the number of plasma cells has changed.
+ *
+ **********************************************************/
+
+int
+init_plasma_locks ()
+{
+#ifdef _OPENMP
+  int n;
+
+  if (nplasma_locks == NPLASMA + 1)
+    return (0);
+
+  for (n = 0; n < nplasma_locks; n++)
+  {
+    omp_destroy_lock (&plasma_locks[n]);
+  }
+
+  nplasma_locks = NPLASMA + 1;
+  plasma_locks = realloc (plasma_locks, nplasma_locks * sizeof (omp_lock_t));
+  if (plasma_locks == NULL)
+  {
+    Error ("init_plasma_locks: Could not allocate memory for %d locks\n", nplasma_locks);
+    Exit (1);
+  }
+
+  for (n = 0; n < nplasma_locks; n++)
+  {
+    omp_init_lock (&plasma_locks[n]);
+  }
+#endif
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Obtain exclusive access to the estimators of a plasma cell
+ *
+ * @param [in] int  nplasma   The plasma cell whose estimators are about to be updated
+ * @return     Nothing
+ *
+ * @details
+ * This must be paired with a call to unlock_plasma_cell.  If the locks
+ * have not been initialised, or sirocco has not been compiled with
+ * OpenMP, the routine does nothing.
+ *
+ **********************************************************/
+
+void
+lock_plasma_cell (nplasma)
+     int nplasma;
+{
+#ifdef _OPENMP
+  if (nplasma >= 0 && nplasma < nplasma_locks)
+    omp_set_lock (&plasma_locks[nplasma]);
+#else
+  (void) nplasma;
+#endif
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Release the lock obtained with lock_plasma_cell
+ *
+ * @param [in] int  nplasma   The plasma cell whose estimators have been updated
+ * @return     Nothing
+ *
+ **********************************************************/
+
+void
+unlock_plasma_cell (nplasma)
+     int nplasma;
+{
+#ifdef _OPENMP
+  if (nplasma >= 0 && nplasma < nplasma_locks)
+    omp_unset_lock (&plasma_locks[nplasma]);
+#else
+  (void) nplasma;
+#endif
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Determine whether the calling routine is being executed
+ * by one of several threads
+ *
+ * @return     TRUE if the routine is being called within an active
+ * parallel region, FALSE otherwise
+ *
+ * @details
+ * This is used by routines which cache results in shared
+ * structures, which is only safe when a single thread is
+ * running.
+ *
+ **********************************************************/
+
+int
+in_parallel_region ()
+{
+#ifdef _OPENMP
+  return (omp_in_parallel ()? TRUE : FALSE);
+#else
+  return (FALSE);
+#endif
+}
@@ -0,0 +1,35 @@
+/***********************************************************/
+/** @file  threads.h
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Macros which allow photon transport to be carried out
+ * by several threads within a single MPI process
+ *
+ * Threading is optional and is enabled by compiling with OpenMP,
+ * e.g make OPENMP=yes sirocco.  When sirocco is compiled without
+ * OpenMP, the macros defined here expand to nothing, so that the
+ * code which uses them is identical to the serial version.
+ *
+ * THREAD_LOCAL is used for the (many) file scope variables which
+ * cache the results of previous calculations or which are used to
+ * pass information to root finders. OMP_PRAGMA is used to
+ * insert OpenMP directives, e.g. OMP_PRAGMA (omp atomic), in a way
+ * that does not generate warnings about unknown pragmas when
+ * OpenMP is not in use.
+ *
+***********************************************************/
+
+#ifndef SIROCCO_THREADS_H
+#define SIROCCO_THREADS_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#define THREAD_LOCAL __thread
+#define OMP_PRAGMA(x) _Pragma (#x)
+#else
+#define THREAD_LOCAL
+#define OMP_PRAGMA(x)
+#endif
+
+#endif
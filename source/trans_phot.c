@@ -79,14 +79,29 @@ long n_lost_to_dfudge = 0;
  * last point where the photon was in the wind, * not the outer boundary of
  * the radiative transfer
  *
+ * If sirocco has been compiled with OpenMP and more than one thread
+ * has been requested with --threads, the photons are shared amongst
+ * the threads in small batches. Each thread uses its own random number
+ * generator, so the results are statistically, but not bitwise,
+ * identical to those obtained with a single thread.
+ *
+ * If --steal has been given on the command line of an MPI run, batches of
+ * photons are scheduled dynamically between the processes, so that a process
+ * which finishes its own photons early transports some of the photons
+ * belonging to a slower process (see trans_phot_dynamic).  In either case,
+ * the time each process spent transporting photons and the time it then
+ * waited for the other processes is logged for each cycle.
+ *
  **********************************************************/
 
 int
 trans_phot (WindPtr w, PhotPtr p, int iextract)
 {
   int nphot;
-  struct photon pp, pextract;
   int nreport;
+  int nthreads;
+  int nphot_done, nbatch_stolen;
+  double t_start, t_busy, t_idle;
   struct timeval timer_t0;
 
   xsignal (files.root, "%-20s Photon transport started\n", "NOK");
@@ -94,25 +109,113 @@ trans_phot (WindPtr w, PhotPtr p, int iextract)
   nreport = NPHOT / 10;
   Log ("\n");
 
-  timer_t0 = init_timer_t0 ();
+  nthreads = get_transport_threads ();
+  if (nthreads > 1)
+  {
+    init_plasma_locks ();
+    Log ("trans_phot: Transporting photons with %d threads\n", nthreads);
+  }
+  init_rand_threads (nthreads);
 
   for (nphot = 0; nphot < NPHOT; nphot++)
   {
     p[nphot].np = nphot;
+  }
+
+  timer_t0 = init_timer_t0 ();
+  t_start = timer ();
+  nbatch_stolen = 0;
+
+  if (modes.steal_photons && np_mpi_global > 1)
+  {
+    nphot_done = trans_phot_dynamic (w, p, iextract, nthreads, &nbatch_stolen);
+  }
+  else
+  {
+    trans_phot_batch (w, p, NPHOT, iextract, nthreads, nreport);
+    nphot_done = NPHOT;
+  }
+
+  t_busy = timer () - t_start;
+
+  Log ("\n");
+
+  print_timer_duration ("!!sirocco: photon transport completed in", timer_t0);
+
+  /* Wait for the other processes to finish, so that the time each process was
+   * left idle can be recorded */
+
+#ifdef MPI_ON
+  MPI_Barrier (MPI_COMM_WORLD);
+#endif
+  t_idle = timer () - t_start - t_busy;
+  report_transport_load (t_busy, t_idle, nphot_done, nbatch_stolen);
+
+  //XXXX Delete when understand what is going on with state machines
+  xsignal (files.root, "%-20s Photon transport completed\n", "NOK");
+
+  /* Sometimes a photon will scatter near the edge of the wind and get pushed
+   * out by DFUDGE. We record these. */
+
+  if (n_lost_to_dfudge > 0)
+  {
+    Error
+      ("trans_phot: %ld photons were lost due to DFUDGE (%8.4e) pushing them outside of the wind after scatter\n",
+       n_lost_to_dfudge, DFUDGE);
+  }
+
+  n_lost_to_dfudge = 0;         // reset the counter
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Transport a batch of photons through the wind
+ *
+ * @param [in] WindPtr  w   The entire wind domain
+ * @param [in, out] PhotPtr  p   The first photon of the batch
+ * @param [in] int  nphot_batch   The number of photons in the batch
+ * @param [in] int  iextract   Whether photons are also to be extracted in
+ * specific directions
+ * @param [in] int  nthreads   The number of threads to use
+ * @param [in] int  nreport   The interval at which progress is reported, or 0
+ * if progress is not to be reported
+ * @return   Always returns 0
+ *
+ * @details
+ * This is the main loop of trans_phot.  It is used either for all of the
+ * photons belonging to a process or, when photons are scheduled
+ * dynamically between processes, for the batches claimed by the
+ * process (see trans_phot_dynamic).
+ *
+ * If the event-based transport engine has been selected with --events, the
+ * photons are passed to trans_phot_events.  Otherwise each photon is
+ * transported in turn with trans_phot_single.
+ *
+ **********************************************************/
+
+int
+trans_phot_batch (WindPtr w, PhotPtr p, int nphot_batch, int iextract, int nthreads, int nreport)
+{
+  int nphot;
+  struct photon pp, pextract;
+
+  if (modes.event_transport)
+  {
+    return (trans_phot_events (w, p, nphot_batch, iextract, nthreads, nreport));
+  }
+
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 64) private (pp, pextract))
+  for (nphot = 0; nphot < nphot_batch; nphot++)
+  {
     check_frame (&p[nphot], F_OBSERVER, "trans_phot: photon not in observer frame as expeced\n");
 
-    if (nphot % nreport == 0)
+    if (nreport > 0 && nphot % nreport == 0)
     {
-      if (geo.ioniz_or_extract == CYCLE_IONIZ)
-      {
-        Log (" Ion. Cycle %d/%d of %s : Photon %10d of %10d or %6.1f per cent \n", geo.wcycle + 1, geo.wcycles, files.root, nphot, NPHOT,
-             nphot * 100. / NPHOT);
-      }
-      else
-      {
-        Log ("Spec. Cycle %d/%d of %s : Photon %10d of %10d or %6.1f per cent \n", geo.pcycle + 1, geo.pcycles, files.root, nphot, NPHOT,
-             nphot * 100. / NPHOT);
-      }
+      trans_phot_progress (nphot);
     }
 
     Log_flush ();
@@ -131,25 +234,33 @@ trans_phot (WindPtr w, PhotPtr p, int iextract)
     trans_phot_single (w, &p[nphot], iextract);
   }
 
-  Log ("\n");
+  return (0);
+}
 
-  print_timer_duration ("!!sirocco: photon transport completed in", timer_t0);
-  //XXXX Delete when understand what is going on with state machines
-  xsignal (files.root, "%-20s Photon transport completed\n", "NOK");
 
-  /* Sometimes a photon will scatter near the edge of the wind and get pushed
-   * out by DFUDGE. We record these. */
 
-  if (n_lost_to_dfudge > 0)
+/**********************************************************/
+/**
+ * @brief      Report how far photon transport has progressed in the current cycle
+ *
+ * @param [in] int  nphot   The number of photons transported so far by this process
+ * @return   Nothing
+ *
+ **********************************************************/
+
+void
+trans_phot_progress (int nphot)
+{
+  if (geo.ioniz_or_extract == CYCLE_IONIZ)
   {
-    Error
-      ("trans_phot: %ld photons were lost due to DFUDGE (%8.4e) pushing them outside of the wind after scatter\n",
-       n_lost_to_dfudge, DFUDGE);
+    Log (" Ion. Cycle %d/%d of %s : Photon %10d of %10d or %6.1f per cent \n", geo.wcycle + 1, geo.wcycles, files.root, nphot, NPHOT,
+         nphot * 100. / NPHOT);
+  }
+  else
+  {
+    Log ("Spec. Cycle %d/%d of %s : Photon %10d of %10d or %6.1f per cent \n", geo.pcycle + 1, geo.pcycles, files.root, nphot, NPHOT,
+         nphot * 100. / NPHOT);
   }
-
-  n_lost_to_dfudge = 0;         // reset the counter
-
-  return (0);
 }
 
 /**********************************************************/
@@ -205,14 +316,10 @@ int
 trans_phot_single (WindPtr w, PhotPtr p, int iextract)
 {
   double tau_scat, tau;
-  int i, n_grid, ierr;
   enum istat_enum istat;
-  int nnscat;
   int current_nres;
   double weight_min;
-  struct photon pp, pextract;
-  double normal[3];
-  double rho, dz;
+  struct photon pp;
 
 
   /* Initialize parameters that are needed for the flight of the photon through the wind */
@@ -244,306 +351,370 @@ trans_phot_single (WindPtr w, PhotPtr p, int iextract)
       break;
     }
 
-    if (pp.w < weight_min)
+    if (trans_phot_interact (w, p, &pp, iextract, weight_min, &current_nres, &tau_scat, &tau, &istat))
     {
-      pp.istat = P_ABSORB;
-      pp.tau = VERY_BIG;
-      stuff_phot (&pp, p);
       break;
     }
+  }
 
-    /* Check boundary with walls - note that pp is the proposed new photon location
-     * and p is the "original" location of the photon */
+  /* This is set up for looking at photons in spectral cycles at present */
+  // if (modes.save_photons && geo.ioniz_or_extract == CYCLE_EXTRACT)
+  //   save_photons (&pp, "End");
 
-    istat = walls (&pp, p, normal);
+  return (0);
+}
 
 
-    if (istat == P_HIT_STAR)
-    {
 
-      /*
-       * The photon has hit the star. Reflect or absorb.
-       */
 
-      geo.lum_star_back += pp.w;
-      spec_add_one (&pp, SPEC_HITSURF);
+/**********************************************************/
+/**
+ * @brief      Deal with whatever stopped a photon at the end of a step
+ * through the wind
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in, out] PhotPtr  p   The photon at the position of its last interaction
+ * @param [in, out] PhotPtr  pp   The photon at the end of the step
+ * @param [in] int  iextract   If TRUE, extract the photon in the directions
+ * of the observers whenever it scatters
+ * @param [in] double  weight_min   The weight below which the photon is considered
+ * to have been absorbed
+ * @param [in, out] int *  current_nres   The resonance (or continuum process) which stopped
+ * the photon, which may be changed if the photon scatters
+ * @param [in, out] double *  tau_scat   The optical depth at which the photon will scatter,
+ * which is regenerated if the photon scatters
+ * @param [in, out] double *  tau   The optical depth the photon has travelled
+ * since it last scattered
+ * @param [in, out] int *  istat   The status returned by translate, which
+ * is updated to reflect what happened to the photon
+ * @return     TRUE if the flight of the photon has ended, FALSE otherwise
+ *
+ * @details
+ * This routine contains everything which happens to a photon in
+ * trans_phot_single after it has been moved by translate.  The photon
+ * is checked against the boundaries of the system, and if it has hit the
+ * star or disk, it is either absorbed or reflected.  If the photon has
+ * scattered, the scattering is carried out and, if required, the photon
+ * is extracted.
+ *
+ * ### Notes ###
+ *
+ * The routine is separate from trans_phot_single, so that it can also
+ * be used by the event-based transport engine in trans_phot_event.c
+ *
+ **********************************************************/
 
-      /* The a new photon direction needs to be defined that will cause the photon to continue in the wind.
-       * Since this is effectively a scattering event we also have to extract a photon to construct the
-       * detailed spectrum.
-       */
+int
+trans_phot_interact (WindPtr w, PhotPtr p, PhotPtr pp, int iextract, double weight_min, int *current_nres, double *tau_scat, double *tau,
+                     enum istat_enum *istat)
+{
+  int i, n_grid, ierr;
+  int nnscat;
+  struct photon pextract;
+  double normal[3];
+  double rho, dz;
 
-      if (geo.absorb_reflect == BACK_RAD_SCATTER)
-      {
-        randvcos (pp.lmn, normal);
-        if (move_phot (&pp, DFUDGE))
-        {
-          Error ("trans_phot_single: photon not in correct frame when reflecting off of star\n");
-        }
+  if (pp->w < weight_min)
+  {
+    pp->istat = P_ABSORB;
+    pp->tau = VERY_BIG;
+    stuff_phot (pp, p);
+    return (TRUE);
+  }
 
-        p->ds = 0;
-        tau_scat = -log (1. - random_number (0.0, 1.0));
-        istat = pp.istat = P_INWIND;    /* Set the status back to P_INWIND so the photon will continue */
-        tau = 0;
-        stuff_phot (&pp, p);
+  /* Check boundary with walls - note that pp is the proposed new photon location
+   * and p is the "original" location of the photon */
 
-        if (iextract)
-        {
-          stuff_phot (&pp, &pextract);
-          extract (w, &pextract, PTYPE_STAR);   // Treat as stellar photon for purpose of extraction
-        }
+  *istat = walls (pp, p, normal);
+
+
+  if (*istat == P_HIT_STAR)
+  {
+
+    /*
+     * The photon has hit the star. Reflect or absorb.
+     */
+
+    OMP_PRAGMA (omp atomic)
+    geo.lum_star_back += pp->w;
+    spec_add_one (pp, SPEC_HITSURF);
+
+    /* The a new photon direction needs to be defined that will cause the photon to continue in the wind.
+     * Since this is effectively a scattering event we also have to extract a photon to construct the
+     * detailed spectrum.
+     */
+
+    if (geo.absorb_reflect == BACK_RAD_SCATTER)
+    {
+      randvcos (pp->lmn, normal);
+      if (move_phot (pp, DFUDGE))
+      {
+        Error ("trans_phot_single: photon not in correct frame when reflecting off of star\n");
       }
-      else                      /*Photons that hit the star are simply absorbed  */
+
+      p->ds = 0;
+      *tau_scat = -log (1. - random_number (0.0, 1.0));
+      *istat = pp->istat = P_INWIND;    /* Set the status back to P_INWIND so the photon will continue */
+      *tau = 0;
+      stuff_phot (pp, p);
+
+      if (iextract)
       {
-        stuff_phot (&pp, p);
-        break;
+        stuff_phot (pp, &pextract);
+        extract (w, &pextract, PTYPE_STAR);   // Treat as stellar photon for purpose of extraction
       }
     }
-
-    if (istat == P_HIT_DISK)
+    else                      /*Photons that hit the star are simply absorbed  */
     {
-      /*
-       * The photon has hit the disk. Reflect or absorb.
-       */
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
+  }
 
-      /* Store the energy of the photon bundle into a disk structure so that one
-         can determine later how much and where the disk was heated by photons.
-         Note that the disk is defined from 0 to NRINGS-2. NRINGS-1 contains the
-         position of the outer radius of the disk. */
+  if (*istat == P_HIT_DISK)
+  {
+    /*
+     * The photon has hit the disk. Reflect or absorb.
+     */
 
-      rho = sqrt (pp.x[0] * pp.x[0] + pp.x[1] * pp.x[1]);
+    /* Store the energy of the photon bundle into a disk structure so that one
+       can determine later how much and where the disk was heated by photons.
+       Note that the disk is defined from 0 to NRINGS-2. NRINGS-1 contains the
+       position of the outer radius of the disk. */
 
-      i = 0;
-      while (rho > qdisk.r[i] && i < NRINGS - 1)
-        i++;
-      i--;                      /* So that the heating refers to the heating between i and i+1 */
+    rho = sqrt (pp->x[0] * pp->x[0] + pp->x[1] * pp->x[1]);
 
+    i = 0;
+    while (rho > qdisk.r[i] && i < NRINGS - 1)
+      i++;
+    i--;                      /* So that the heating refers to the heating between i and i+1 */
+
+    OMP_PRAGMA (omp critical (qdisk))
+    {
       qdisk.nhit[i]++;
-      geo.lum_disk_back = qdisk.heat[i] += pp.w;
-      qdisk.ave_freq[i] += pp.w * pp.freq;
+      geo.lum_disk_back = qdisk.heat[i] += pp->w;
+      qdisk.ave_freq[i] += pp->w * pp->freq;
+    }
 
-      if (geo.absorb_reflect == BACK_RAD_SCATTER)
-      {
-        /*
-         * If the disk is vertically extended, then we need to move the photon
-         * outside of the disk and push it by a little amount. It's unclear
-         * to me why we haven't used dfudge here.
-         */
+    if (geo.absorb_reflect == BACK_RAD_SCATTER)
+    {
+      /*
+       * If the disk is vertically extended, then we need to move the photon
+       * outside of the disk and push it by a little amount. It's unclear
+       * to me why we haven't used dfudge here.
+       */
 
-        if (geo.disk_type == DISK_VERTICALLY_EXTENDED)
+      if (geo.disk_type == DISK_VERTICALLY_EXTENDED)
+      {
+        dz = (zdisk (rho) - fabs (pp->x[2]));
+        if (dz > 0)
         {
-          dz = (zdisk (rho) - fabs (pp.x[2]));
-          if (dz > 0)
+          if (pp->x[2] > 0)
+          {
+            pp->x[2] += (dz + 1000.);
+          }
+          else
           {
-            if (pp.x[2] > 0)
-            {
-              pp.x[2] += (dz + 1000.);
-            }
-            else
-            {
-              pp.x[2] -= (dz + 1000.);
-            }
+            pp->x[2] -= (dz + 1000.);
           }
         }
+      }
 
-        spec_add_one (&pp, SPEC_HITSURF);
+      spec_add_one (pp, SPEC_HITSURF);
 
-        /* If we got here, a new photon direction needs to be defined that will cause the photon
-         * to continue in the wind.  Since this is effectively a scattering event we also have to
-         * extract a photon to construct the detailed spectrum.
-         */
+      /* If we got here, a new photon direction needs to be defined that will cause the photon
+       * to continue in the wind.  Since this is effectively a scattering event we also have to
+       * extract a photon to construct the detailed spectrum.
+       */
 
-        randvcos (pp.lmn, normal);
-        p->ds = 0;
-        tau_scat = -log (1. - random_number (0.0, 1.0));
-        istat = pp.istat = P_INWIND;
-        tau = 0;
-        stuff_phot (&pp, p);
+      randvcos (pp->lmn, normal);
+      p->ds = 0;
+      *tau_scat = -log (1. - random_number (0.0, 1.0));
+      *istat = pp->istat = P_INWIND;
+      *tau = 0;
+      stuff_phot (pp, p);
 
-        if (iextract)
-        {
-          stuff_phot (&pp, &pextract);
-          extract (w, &pextract, PTYPE_DISK);
-        }
-      }
-      else                      /* Photons that hit the disk are to be absorbed */
+      if (iextract)
       {
-        stuff_phot (&pp, p);
-        break;
+        stuff_phot (pp, &pextract);
+        extract (w, &pextract, PTYPE_DISK);
       }
     }
-
-    if (istat == P_SCAT)
+    else                      /* Photons that hit the disk are to be absorbed */
     {
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
+  }
 
-      /*
-       * The photon has scattered, as either a resonance or continuum scatter.
-       */
-
-      pp.grid = n_grid = where_in_grid (wmain[pp.grid].ndom, pp.x);
-
-      if (n_grid < 0)
-      {
-        Error ("trans_phot: trying to scatter a photon which is not in the wind grid and the photon has been lost\n");
-        Error ("trans_phot: %d grid %3d x %8.2e %8.2e %8.2e (%8.2e)\n", pp.np, pp.grid, pp.x[0], pp.x[1], pp.x[2],
-               sqrt (pp.x[0] * pp.x[0] + pp.x[1] * pp.x[1] + pp.x[2] * pp.x[2]));
-        pp.istat = P_ERROR;
-        stuff_phot (&pp, p);
-        break;
-      }
+  if (*istat == P_SCAT)
+  {
 
-      if (wmain[n_grid].nplasma == NPLASMA)     /* If the next error reoccurs, see Issue #154 (on GitHub) for discussion */
-      {
-        Error ("trans_phot: Trying to scatter a photon which is not in a cell in the plasma structure\n");
-        Error ("trans_phot: %d grid %3d x %8.2e %8.2e %8.2e\n", pp.np, pp.grid, pp.x[0], pp.x[1], pp.x[2]);
-        Error ("trans_phot: This photon is effectively lost!\n");
-        pp.istat = P_ERROR;
-        stuff_phot (&pp, p);
-        break;
-      }
+    /*
+     * The photon has scattered, as either a resonance or continuum scatter.
+     */
 
-      if (wmain[n_grid].inwind < 0)
-      {
-        Error ("trans_phot: Trying to scatter a photon in a cell with no wind volume and the photon has been lost\n");
-        Error ("trans_phot: istat %d %d grid %3d x %8.2e %8.2e %8.2e\n", istat, pp.np, pp.grid, pp.x[0], pp.x[1], pp.x[2]);
-        pp.istat = P_ERROR;
-        stuff_phot (&pp, p);
-        break;
-      }
+    pp->grid = n_grid = where_in_grid (wmain[pp->grid].ndom, pp->x);
 
-      /* Add path lengths for reverberation mapping */
+    if (n_grid < 0)
+    {
+      Error ("trans_phot: trying to scatter a photon which is not in the wind grid and the photon has been lost\n");
+      Error ("trans_phot: %d grid %3d x %8.2e %8.2e %8.2e (%8.2e)\n", pp->np, pp->grid, pp->x[0], pp->x[1], pp->x[2],
+             sqrt (pp->x[0] * pp->x[0] + pp->x[1] * pp->x[1] + pp->x[2] * pp->x[2]));
+      pp->istat = P_ERROR;
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
 
-      if ((geo.reverb == REV_WIND || geo.reverb == REV_MATOM) && geo.ioniz_or_extract == CYCLE_IONIZ && geo.wcycle == geo.wcycles - 1)
-      {
-        wind_paths_add_phot (&wmain[n_grid], &pp);
-      }
+    if (wmain[n_grid].nplasma == NPLASMA)     /* If the next error reoccurs, see Issue #154 (on GitHub) for discussion */
+    {
+      Error ("trans_phot: Trying to scatter a photon which is not in a cell in the plasma structure\n");
+      Error ("trans_phot: %d grid %3d x %8.2e %8.2e %8.2e\n", pp->np, pp->grid, pp->x[0], pp->x[1], pp->x[2]);
+      Error ("trans_phot: This photon is effectively lost!\n");
+      pp->istat = P_ERROR;
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
 
-      nnscat = 1;
-      pp.nscat++;
+    if (wmain[n_grid].inwind < 0)
+    {
+      Error ("trans_phot: Trying to scatter a photon in a cell with no wind volume and the photon has been lost\n");
+      Error ("trans_phot: istat %d %d grid %3d x %8.2e %8.2e %8.2e\n", *istat, pp->np, pp->grid, pp->x[0], pp->x[1], pp->x[2]);
+      pp->istat = P_ERROR;
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
 
-      if (current_nres == NRES_ES)
-      {
-        stuff_phot (&pp, &pextract);
-      }
+    /* Add path lengths for reverberation mapping */
 
-      if ((ierr = scatter (&pp, &current_nres, &nnscat)))       // pp is modified
-      {
-        Error ("trans_phot_single: photon %d returned error code %d whilst scattering \n", pp.np, ierr);
-      }
+    if ((geo.reverb == REV_WIND || geo.reverb == REV_MATOM) && geo.ioniz_or_extract == CYCLE_IONIZ && geo.wcycle == geo.wcycles - 1)
+    {
+      wind_paths_add_phot (&wmain[n_grid], pp);
+    }
 
-      if (geo.matom_radiation == 1 && geo.rt_mode == RT_MODE_MACRO && pp.w < weight_min)
-      {
-        pp.istat = P_ABSORB;
-        pp.tau = VERY_BIG;
-        stuff_phot (&pp, p);
-        break;
-      }
+    nnscat = 1;
+    pp->nscat++;
 
-      /* If this is a BB interaction, calculate the line heating
-       * and break the transport loop if it was absorbed */
+    if (*current_nres == NRES_ES)
+    {
+      stuff_phot (pp, &pextract);
+    }
 
-      if (current_nres > -1 && current_nres < nlines)
-      {
-        pp.nrscat++;
+    if ((ierr = scatter (pp, current_nres, &nnscat)))       // pp is modified
+    {
+      Error ("trans_phot_single: photon %d returned error code %d whilst scattering \n", pp->np, ierr);
+    }
 
-        if (modes.track_resonant_scatters)
-          track_scatters (&pp, wmain[n_grid].nplasma, "Resonant");
+    if (geo.matom_radiation == 1 && geo.rt_mode == RT_MODE_MACRO && pp->w < weight_min)
+    {
+      pp->istat = P_ABSORB;
+      pp->tau = VERY_BIG;
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
 
-        plasmamain[wmain[n_grid].nplasma].scatters[line[current_nres].nion] += 1;
+    /* If this is a BB interaction, calculate the line heating
+     * and break the transport loop if it was absorbed */
 
-        if (geo.rt_mode == RT_MODE_2LEVEL)
-        {
-          line_heat (&plasmamain[wmain[n_grid].nplasma], &pp, current_nres);
-        }
+    if (*current_nres > -1 && *current_nres < nlines)
+    {
+      pp->nrscat++;
 
-        if (pp.w < weight_min)
-        {
-          pp.istat = P_ABSORB;
-          pp.tau = VERY_BIG;
-          stuff_phot (&pp, p);
-          break;
-        }
-      }
+      if (modes.track_resonant_scatters)
+        track_scatters (pp, wmain[n_grid].nplasma, "Resonant");
 
-      if (pp.w < weight_min)
-      {
-        pp.istat = P_ABSORB;
-        pp.tau = VERY_BIG;
-        stuff_phot (&pp, p);
-        break;
-      }
+      lock_plasma_cell (wmain[n_grid].nplasma);
+      plasmamain[wmain[n_grid].nplasma].scatters[line[*current_nres].nion] += 1;
 
-      if (pp.istat == P_ERROR_MATOM || pp.istat == P_LOFREQ_FF || pp.istat == P_ADIABATIC)
+      if (geo.rt_mode == RT_MODE_2LEVEL)
       {
-        p->istat = pp.istat;
-        pp.tau = VERY_BIG;
-        stuff_phot (&pp, p);
-        break;
+        line_heat (&plasmamain[wmain[n_grid].nplasma], pp, *current_nres);
       }
+      unlock_plasma_cell (wmain[n_grid].nplasma);
 
-      /* Now extract photons if we are in detailed the detailed spectrum portion of the program
-       * N.B. To use the anisotropic scattering option, extract needs to follow scatter.
-       * This is because the re-weighting which occurs in extract needs the pdf for scattering
-       * to have been initialized
-       *
-       * For BB photons the photon we pass to extract is the one that has been scattered, but
-       * for ES we pass the photon prior to scattering.
-       */
-
-      if (iextract)
+      if (pp->w < weight_min)
       {
-        if (current_nres != NRES_ES)
-        {
-          stuff_phot (&pp, &pextract);
-        }
-        pextract.nnscat = nnscat;
-        extract (w, &pextract, PTYPE_WIND);
+        pp->istat = P_ABSORB;
+        pp->tau = VERY_BIG;
+        stuff_phot (pp, p);
+        return (TRUE);
       }
+    }
 
-      /* Reinitialize parameters for the scattered photon so it can can continue through the wind
-       */
-
-      tau = 0;
-      tau_scat = -log (1. - random_number (0.0, 1.0));
-      pp.istat = P_INWIND;
-      pp.ds = 0;
+    if (pp->w < weight_min)
+    {
+      pp->istat = P_ABSORB;
+      pp->tau = VERY_BIG;
+      stuff_phot (pp, p);
+      return (TRUE);
+    }
 
-      stuff_phot (&pp, p);
-      istat = p->istat;
+    if (pp->istat == P_ERROR_MATOM || pp->istat == P_LOFREQ_FF || pp->istat == P_ADIABATIC)
+    {
+      p->istat = pp->istat;
+      pp->tau = VERY_BIG;
+      stuff_phot (pp, p);
+      return (TRUE);
     }
 
-    /*
-     * Now we check if a photon has gotten stuck scattering in the wind, this
-     * is mostly done for speed concerns as it is pointless to track photons which
-     * are probably low weight and not contributing. However, in some cases MAXSCAT
-     * should be increased to stop the code from throwing away too many photons
+    /* Now extract photons if we are in detailed the detailed spectrum portion of the program
+     * N.B. To use the anisotropic scattering option, extract needs to follow scatter.
+     * This is because the re-weighting which occurs in extract needs the pdf for scattering
+     * to have been initialized
+     *
+     * For BB photons the photon we pass to extract is the one that has been scattered, but
+     * for ES we pass the photon prior to scattering.
      */
 
-    if (pp.nscat == MAXSCAT)
+    if (iextract)
     {
-      pp.istat = P_TOO_MANY_SCATTERS;
-      stuff_phot (&pp, p);
-      break;
+      if (*current_nres != NRES_ES)
+      {
+        stuff_phot (pp, &pextract);
+      }
+      pextract.nnscat = nnscat;
+      extract (w, &pextract, PTYPE_WIND);
     }
 
-    if (pp.istat == P_ERROR_MATOM || pp.istat == P_LOFREQ_FF || pp.istat == P_ADIABATIC)
-    {
-      p->istat = pp.istat;
-      stuff_phot (&pp, p);
-      break;
-    }
+    /* Reinitialize parameters for the scattered photon so it can can continue through the wind
+     */
+
+    *tau = 0;
+    *tau_scat = -log (1. - random_number (0.0, 1.0));
+    pp->istat = P_INWIND;
+    pp->ds = 0;
 
-    /* This is an insurance policy but it is not obvious that, for example nscat
-     * and nrscat, need to be updated */
-    p->istat = istat;
-    p->nscat = pp.nscat;
-    p->nrscat = pp.nrscat;
-    p->w = pp.w;
+    stuff_phot (pp, p);
+    *istat = p->istat;
   }
 
-  /* This is set up for looking at photons in spectral cycles at present */
-  // if (modes.save_photons && geo.ioniz_or_extract == CYCLE_EXTRACT)
-  //   save_photons (&pp, "End");
+  /*
+   * Now we check if a photon has gotten stuck scattering in the wind, this
+   * is mostly done for speed concerns as it is pointless to track photons which
+   * are probably low weight and not contributing. However, in some cases MAXSCAT
+   * should be increased to stop the code from throwing away too many photons
+   */
 
-  return (0);
+  if (pp->nscat == MAXSCAT)
+  {
+    pp->istat = P_TOO_MANY_SCATTERS;
+    stuff_phot (pp, p);
+    return (TRUE);
+  }
+
+  if (pp->istat == P_ERROR_MATOM || pp->istat == P_LOFREQ_FF || pp->istat == P_ADIABATIC)
+  {
+    p->istat = pp->istat;
+    stuff_phot (pp, p);
+    return (TRUE);
+  }
+
+  /* This is an insurance policy but it is not obvious that, for example nscat
+   * and nrscat, need to be updated */
+  p->istat = *istat;
+  p->nscat = pp->nscat;
+  p->nrscat = pp->nrscat;
+  p->w = pp->w;
+
+  return (FALSE);
 }
@@ -0,0 +1,690 @@
+
+/***********************************************************/
+/** @file  trans_phot_event.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  An event-based engine for transporting photons through
+ * the wind
+ *
+ * In the standard engine, trans_phot_single, each photon is followed
+ * from the point where it is created until it escapes or is destroyed,
+ * before the next photon is started.  In the event-based engine, a batch
+ * of photons is transported together.  The photons in flight are stored
+ * as a structure of arrays, and the whole batch is taken through each stage
+ * of a step through the wind before the next stage is started:
+ *
+ * * finding the cell the photon is in and the distance to the cell boundary
+ * * calculating the continuum opacity along the path
+ * * searching for resonances along the path
+ * * moving the photon
+ * * dealing with whatever stopped the photon (a scatter, the star, the disk etc.)
+ *
+ * Photons which have finished are moved to the end of the arrays, so that
+ * each stage works on a contiguous set of photons.
+ *
+ * The engine is selected with the --events command line switch.  It uses
+ * exactly the same physics as trans_phot_single, via translate_in_wind's
+ * component routines and trans_phot_interact, so the spectra produced by
+ * the two engines should agree to within the Monte Carlo noise.  The random
+ * numbers are consumed in a different order, so the results are not
+ * bitwise identical.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+/* The stage a photon reached in the current step through the wind */
+
+#define STEP_SPACE  0           /* The photon was outside the wind, and has already been moved */
+#define STEP_WIND   1           /* The photon is in a wind cell, and the path has to be calculated */
+#define STEP_SKIP   2           /* The photon is in a cell which is ignored, and moves to the boundary */
+#define STEP_ERROR  3           /* The photon was not in the wind or the grid */
+
+/* The photons in flight.  All of the properties which change as a photon moves from cell to cell
+   are stored as separate arrays, while the remaining properties (the origin, the number of
+   scatters etc) are kept in the photon structures in pp, which are also used to pass a photon to
+   the routines that deal with a single photon */
+
+typedef struct photon_batch
+{
+  int nmax;                     /* The number of photons the arrays can hold */
+  int n;                        /* The number of photons in the batch */
+  int nactive;                  /* The number of photons still in flight, which are the first nactive */
+  int *iphot;                   /* The position of each photon in the photon array */
+  double *x[3], *lmn[3];        /* The position and direction of each photon */
+  double *freq, *w;             /* The frequency and weight */
+  double *ds_event, *path;      /* The distance since the last interaction, and the total path length */
+  double *tau, *tau_scat;       /* The optical depth since the last scatter, and the depth at which to scatter */
+  double *w_min;                /* The weight below which a photon is considered to be absorbed */
+  double *smax, *ds;            /* The maximum distance in the current cell, and the length of the step */
+  int *grid, *istat, *nres;
+  int *status;                  /* The status returned by the current step */
+  int *current_nres;            /* The resonance which stopped the photon in the current step */
+  int *step;                    /* The stage the photon reached in the current step */
+  struct ds_path *dspath;       /* The frequencies and continuum opacities along the path */
+  PhotPtr pp;
+} photon_batch_dummy, *PhotBatchPtr;
+
+
+
+/**********************************************************/
+/**
+ * @brief      Allocate the arrays for a batch of photons
+ *
+ * @param [in] int  nmax   The maximum number of photons in the batch
+ * @return     A pointer to the batch
+ *
+ **********************************************************/
+
+static PhotBatchPtr
+batch_alloc (int nmax)
+{
+  PhotBatchPtr b;
+  int i;
+
+  b = calloc (1, sizeof (photon_batch_dummy));
+  if (b == NULL)
+  {
+    Error ("batch_alloc: Could not allocate a batch of photons\n");
+    Exit (1);
+  }
+
+  b->nmax = nmax;
+  b->iphot = calloc (nmax, sizeof (int));
+  for (i = 0; i < 3; i++)
+  {
+    b->x[i] = calloc (nmax, sizeof (double));
+    b->lmn[i] = calloc (nmax, sizeof (double));
+  }
+  b->freq = calloc (nmax, sizeof (double));
+  b->w = calloc (nmax, sizeof (double));
+  b->ds_event = calloc (nmax, sizeof (double));
+  b->path = calloc (nmax, sizeof (double));
+  b->tau = calloc (nmax, sizeof (double));
+  b->tau_scat = calloc (nmax, sizeof (double));
+  b->w_min = calloc (nmax, sizeof (double));
+  b->smax = calloc (nmax, sizeof (double));
+  b->ds = calloc (nmax, sizeof (double));
+  b->grid = calloc (nmax, sizeof (int));
+  b->istat = calloc (nmax, sizeof (int));
+  b->nres = calloc (nmax, sizeof (int));
+  b->status = calloc (nmax, sizeof (int));
+  b->current_nres = calloc (nmax, sizeof (int));
+  b->step = calloc (nmax, sizeof (int));
+  b->dspath = calloc (nmax, sizeof (struct ds_path));
+  b->pp = calloc (nmax, sizeof (p_dummy));
+
+  if (b->pp == NULL || b->dspath == NULL || b->step == NULL)
+  {
+    Error ("batch_alloc: Could not allocate a batch of %d photons\n", nmax);
+    Exit (1);
+  }
+
+  return (b);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Free a batch of photons
+ *
+ * @param [in] PhotBatchPtr  b   The batch
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+batch_free (PhotBatchPtr b)
+{
+  int i;
+
+  free (b->iphot);
+  for (i = 0; i < 3; i++)
+  {
+    free (b->x[i]);
+    free (b->lmn[i]);
+  }
+  free (b->freq);
+  free (b->w);
+  free (b->ds_event);
+  free (b->path);
+  free (b->tau);
+  free (b->tau_scat);
+  free (b->w_min);
+  free (b->smax);
+  free (b->ds);
+  free (b->grid);
+  free (b->istat);
+  free (b->nres);
+  free (b->status);
+  free (b->current_nres);
+  free (b->step);
+  free (b->dspath);
+  free (b->pp);
+  free (b);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy the properties of a photon in the batch which are
+ * stored in arrays into its photon structure
+ *
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] int  k   The photon in the batch
+ * @return     The photon structure
+ *
+ * @details
+ * This is used before one of the routines which work on a single photon
+ * is called.  It must be followed by a call to batch_put if the routine
+ * modifies the photon.
+ *
+ **********************************************************/
+
+static PhotPtr
+batch_get (PhotBatchPtr b, int k)
+{
+  PhotPtr p;
+
+  p = &b->pp[k];
+  p->x[0] = b->x[0][k];
+  p->x[1] = b->x[1][k];
+  p->x[2] = b->x[2][k];
+  p->lmn[0] = b->lmn[0][k];
+  p->lmn[1] = b->lmn[1][k];
+  p->lmn[2] = b->lmn[2][k];
+  p->freq = b->freq[k];
+  p->w = b->w[k];
+  p->ds = b->ds_event[k];
+  p->path = b->path[k];
+  p->grid = b->grid[k];
+  p->istat = b->istat[k];
+  p->nres = b->nres[k];
+
+  return (p);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy the properties of a photon which are stored in arrays
+ * from its photon structure back to the arrays
+ *
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] int  k   The photon in the batch
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+batch_put (PhotBatchPtr b, int k)
+{
+  PhotPtr p;
+
+  p = &b->pp[k];
+  b->x[0][k] = p->x[0];
+  b->x[1][k] = p->x[1];
+  b->x[2][k] = p->x[2];
+  b->lmn[0][k] = p->lmn[0];
+  b->lmn[1][k] = p->lmn[1];
+  b->lmn[2][k] = p->lmn[2];
+  b->freq[k] = p->freq;
+  b->w[k] = p->w;
+  b->ds_event[k] = p->ds;
+  b->path[k] = p->path;
+  b->grid[k] = p->grid;
+  b->istat[k] = p->istat;
+  b->nres[k] = p->nres;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Exchange two photons in a batch
+ *
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] int  k1   The first photon
+ * @param [in] int  k2   The second photon
+ * @return     Nothing
+ *
+ * @details
+ * This is used to move photons which have finished to the end of the
+ * arrays. Only the properties which persist from one step to the next
+ * are exchanged.
+ *
+ **********************************************************/
+
+#define SWAP(type,a,i,j) {type _tmp = (a)[i]; (a)[i] = (a)[j]; (a)[j] = _tmp;}
+
+static void
+batch_swap (PhotBatchPtr b, int k1, int k2)
+{
+  int i;
+
+  SWAP (int, b->iphot, k1, k2);
+  for (i = 0; i < 3; i++)
+  {
+    SWAP (double, b->x[i], k1, k2);
+    SWAP (double, b->lmn[i], k1, k2);
+  }
+  SWAP (double, b->freq, k1, k2);
+  SWAP (double, b->w, k1, k2);
+  SWAP (double, b->ds_event, k1, k2);
+  SWAP (double, b->path, k1, k2);
+  SWAP (double, b->tau, k1, k2);
+  SWAP (double, b->tau_scat, k1, k2);
+  SWAP (double, b->w_min, k1, k2);
+  SWAP (int, b->grid, k1, k2);
+  SWAP (int, b->istat, k1, k2);
+  SWAP (int, b->nres, k1, k2);
+  SWAP (int, b->current_nres, k1, k2);
+  SWAP (int, b->step, k1, k2);
+  SWAP (p_dummy, b->pp, k1, k2);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Load a set of photons into a batch
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] PhotPtr  p   The first photon to load
+ * @param [in] int  nphot   The number of photons to load
+ * @param [in] int  iextract   If TRUE, extract the photons before they
+ * are transported
+ * @return     Nothing
+ *
+ * @details
+ * This carries out the initialisation of each photon that is done at the start of
+ * trans_phot_single, including the generation of the optical depth at which the
+ * photon will first scatter.
+ *
+ **********************************************************/
+
+static void
+batch_load (WindPtr w, PhotBatchPtr b, PhotPtr p, int nphot, int iextract)
+{
+  int k;
+  struct photon pextract;
+
+  for (k = 0; k < nphot; k++)
+  {
+    check_frame (&p[k], F_OBSERVER, "trans_phot: photon not in observer frame as expeced\n");
+
+    if (iextract)
+    {
+      stuff_phot (&p[k], &pextract);
+      extract (w, &pextract, pextract.origin);
+    }
+
+    b->iphot[k] = k;
+    stuff_phot (&p[k], &b->pp[k]);
+    batch_put (b, k);
+    b->tau_scat[k] = -log (1. - random_number (0.0, 1.0));
+    b->w_min[k] = EPSILON * b->w[k];
+    b->tau[k] = 0;
+    b->current_nres[k] = NRES_NOT_SET;
+  }
+
+  b->n = b->nactive = nphot;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the cell each photon is in, and the maximum distance it can
+ * travel in it
+ *
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] int  nthreads   The number of threads to use
+ * @return     Nothing
+ *
+ * @details
+ * This is the first part of translate and translate_in_wind.  Photons which are
+ * not in the wind are moved to the edge of the wind with translate_in_space, which
+ * completes the step for them.
+ *
+ **********************************************************/
+
+static void
+stage_boundary (PhotBatchPtr b, int nthreads)
+{
+  int k, n, ndom;
+  PhotPtr pp;
+  WindPtr one;
+
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 16) private (n, ndom, pp, one))
+  for (k = 0; k < b->nactive; k++)
+  {
+    pp = batch_get (b, k);
+    b->ds[k] = 0;
+
+    if (where_in_wind (pp->x, &ndom) < 0)
+    {
+      b->status[k] = translate_in_space (pp);
+      b->step[k] = STEP_SPACE;
+    }
+    else if ((pp->grid = where_in_grid (ndom, pp->x)) < 0)
+    {
+      b->status[k] = pp->istat = P_ERROR;
+      b->step[k] = STEP_ERROR;
+      Error ("translate: Found photon that was not in wind or grid, istat %i\n", where_in_wind (pp->x, &ndom));
+    }
+    else if ((pp->grid = n = where_in_grid (wmain[pp->grid].ndom, pp->x)) < 0)
+    {
+      b->status[k] = n;
+      b->step[k] = STEP_SPACE;
+    }
+    else
+    {
+      one = &wmain[n];
+      b->smax[k] = smax_in_cell (pp);
+
+      if ((modes.partial_cells == PC_EXTEND && one->inwind == W_PART_INWIND) || one->inwind == W_IGNORE)
+      {
+        b->ds[k] = b->smax[k];
+        b->status[k] = P_INWIND;
+        b->step[k] = STEP_SKIP;
+        if (b->smax[k] < 0)
+        {
+          Error ("Houston, there is a problem %e\n", b->smax[k]);
+        }
+      }
+      else
+      {
+        b->step[k] = STEP_WIND;
+      }
+    }
+
+    batch_put (b, k);
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Calculate the co-moving frequencies and the continuum opacity
+ * along the path of each photon in a wind cell
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] int  nthreads   The number of threads to use
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+stage_continuum (WindPtr w, PhotBatchPtr b, int nthreads)
+{
+  int k;
+  PhotPtr pp;
+
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 16) private (pp))
+  for (k = 0; k < b->nactive; k++)
+  {
+    if (b->step[k] == STEP_WIND)
+    {
+      pp = batch_get (b, k);
+      ds_path_continuum (w, pp, b->smax[k], &b->dspath[k]);
+    }
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the distance each photon in a wind cell travels before it scatters or
+ * reaches the edge of the cell, and update the radiation field estimators
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in] int  nthreads   The number of threads to use
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+stage_lines (WindPtr w, PhotBatchPtr b, int nthreads)
+{
+  int k;
+  int nres, istat;
+  PhotPtr pp;
+
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 16) private (pp, nres, istat))
+  for (k = 0; k < b->nactive; k++)
+  {
+    if (b->step[k] == STEP_WIND)
+    {
+      pp = batch_get (b, k);
+
+      /* kappa_bf stores the opacity of each bf process in kap_bf (or, with --bf-cache, the
+         interpolation from which they are obtained), which is used to choose the process when
+         a photon is scattered by the continuum and by bf_estimators_increment.  This is
+         shared by all of the photons in the batch, so it has to be recalculated for this photon */
+
+      if (geo.rt_mode == RT_MODE_MACRO)
+      {
+        kappa_bf (&plasmamain[w[pp->grid].nplasma], 0.5 * (b->dspath[k].freq_inner + b->dspath[k].freq_outer), 0);
+      }
+
+      b->ds[k] = ds_path_lines (w, pp, b->tau_scat[k], &b->tau[k], &nres, &b->dspath[k], &istat);
+      translate_in_wind_update (w, pp, b->ds[k], nres, istat);
+      b->current_nres[k] = nres;
+      b->status[k] = pp->istat = istat;
+      batch_put (b, k);
+    }
+    else if (b->step[k] == STEP_SKIP)
+    {
+      b->istat[k] = b->status[k];
+    }
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Move the photons to the end of the current step
+ *
+ * @param [in] PhotBatchPtr  b   The batch
+ * @return     Nothing
+ *
+ * @details
+ * This is the equivalent of move_phot for the whole batch. The length of the
+ * step is zero for photons which have already been moved, or which could not
+ * be moved, so the loop can be vectorised.
+ *
+ **********************************************************/
+
+static void
+stage_move (PhotBatchPtr b)
+{
+  int k;
+  int nactive;
+  double *x0, *x1, *x2, *l0, *l1, *l2, *ds, *ds_event, *path;
+
+  nactive = b->nactive;
+  x0 = b->x[0];
+  x1 = b->x[1];
+  x2 = b->x[2];
+  l0 = b->lmn[0];
+  l1 = b->lmn[1];
+  l2 = b->lmn[2];
+  ds = b->ds;
+  ds_event = b->ds_event;
+  path = b->path;
+
+  for (k = 0; k < nactive; k++)
+  {
+    x0[k] += l0[k] * ds[k];
+    x1[k] += l1[k] * ds[k];
+    x2[k] += l2[k] * ds[k];
+    ds_event[k] += ds[k];
+    path[k] += fabs (ds[k]);
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Deal with whatever stopped each photon, and move the photons
+ * which have finished to the end of the batch
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in] PhotBatchPtr  b   The batch
+ * @param [in, out] PhotPtr  p   The photons the batch was loaded from
+ * @param [in] int  iextract   If TRUE, extract photons when they scatter
+ * @param [in] int  nthreads   The number of threads to use
+ * @return     Nothing
+ *
+ * @details
+ * This is the remainder of the loop in trans_phot_single, which checks
+ * whether the photon has hit the star or disk and deals with scattering
+ * via trans_phot_interact.
+ *
+ **********************************************************/
+
+static void
+stage_interact (WindPtr w, PhotBatchPtr b, PhotPtr p, int iextract, int nthreads)
+{
+  int k, done;
+  enum istat_enum istat;
+  PhotPtr pp;
+
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 16) private (pp, istat, done))
+  for (k = 0; k < b->nactive; k++)
+  {
+    pp = batch_get (b, k);
+
+    if (b->step[k] == STEP_ERROR)
+    {
+      Error ("trans_phot: abnormal return from translate on photon %d\n", p[b->iphot[k]].np);
+      done = TRUE;
+    }
+    else
+    {
+      istat = b->status[k];
+      done = trans_phot_interact (w, &p[b->iphot[k]], pp, iextract, b->w_min[k], &b->current_nres[k], &b->tau_scat[k], &b->tau[k], &istat);
+      if (istat != P_INWIND)
+      {
+        done = TRUE;
+      }
+    }
+
+    batch_put (b, k);
+    b->status[k] = done;
+  }
+
+  /* Move the photons which have finished to the end of the arrays */
+
+  k = 0;
+  while (k < b->nactive)
+  {
+    if (b->status[k])
+    {
+      b->nactive--;
+      if (k < b->nactive)
+      {
+        batch_swap (b, k, b->nactive);
+        b->status[k] = b->status[b->nactive];
+      }
+    }
+    else
+    {
+      k++;
+    }
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Transport photons through the wind with the event-based engine
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in, out] PhotPtr  p   The photons to transport
+ * @param [in] int  nphot   The number of photons to transport
+ * @param [in] int  iextract   If TRUE, extract the photons in the directions of the
+ * observers whenever they scatter
+ * @param [in] int  nthreads   The number of threads to use
+ * @param [in] int  nreport   The interval at which progress is reported, or 0
+ * if progress is not to be reported
+ * @return     Always returns 0
+ *
+ * @details
+ * The photons are transported in batches of modes.nphot_event photons.
+ * Each pass through the loop takes all of the photons in flight one step
+ * through the wind, that is to say to the edge of their current cell,
+ * or to the point where they scatter or hit a boundary.  When the routine
+ * returns, each photon in p is in the same state as if it had been transported
+ * by trans_phot_single.
+ *
+ **********************************************************/
+
+int
+trans_phot_events (WindPtr w, PhotPtr p, int nphot, int iextract, int nthreads, int nreport)
+{
+  PhotBatchPtr b;
+  int nstart, nbatch, nsteps;
+
+  nbatch = modes.nphot_event;
+  if (nbatch > nphot)
+  {
+    nbatch = nphot;
+  }
+  if (nbatch < 1)
+  {
+    return (0);
+  }
+
+  b = batch_alloc (nbatch);
+  nsteps = 0;
+
+  for (nstart = 0; nstart < nphot; nstart += nbatch)
+  {
+    if (nstart + nbatch > nphot)
+    {
+      nbatch = nphot - nstart;
+    }
+
+    if (nreport > 0 && (nstart + nbatch) / nreport > nstart / nreport)
+    {
+      trans_phot_progress (nstart);
+    }
+
+    batch_load (w, b, &p[nstart], nbatch, iextract);
+
+    while (b->nactive > 0)
+    {
+      stage_boundary (b, nthreads);
+      stage_continuum (w, b, nthreads);
+      stage_lines (w, b, nthreads);
+      stage_move (b);
+      stage_interact (w, b, &p[nstart], iextract, nthreads);
+      nsteps++;
+    }
+  }
+
+  Log ("trans_phot_events: %d photons were transported in %d steps of batches of up to %d photons\n", nphot, nsteps, modes.nphot_event);
+
+  batch_free (b);
+
+  return (0);
+}
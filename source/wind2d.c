@@ -18,8 +18,8 @@
 #include "atomic.h"
 #include "sirocco.h"
 
-int wig_n;
-double wig_x, wig_y, wig_z;
+THREAD_LOCAL int wig_n;
+THREAD_LOCAL double wig_x, wig_y, wig_z;
 
 /**********************************************************/
 /**
@@ -151,13 +151,14 @@ int ierr_vwind = 0;
  **********************************************************/
 
 #define NVWIND  3
-int nvwind = 0;
-int nvwind_last = 0;
+THREAD_LOCAL int nvwind = 0;
+THREAD_LOCAL int nvwind_last = 0;
 struct vwind
 {
   int iorder;
   double v[3], pos[3];
-} xvwind[NVWIND];
+};
+THREAD_LOCAL struct vwind xvwind[NVWIND];
 
 int
 vwind_xyz (ndom, p, v)
@@ -19,6 +19,154 @@
 #include "atomic.h"
 #include "sirocco.h"
 
+static double *update_cost = NULL;     /* The time taken to update each plasma cell in the last cycle */
+static int *update_cells = NULL;        /* The cells which this rank updates */
+static int update_ncells = 0;   /* The number of plasma cells for which these are allocated */
+
+
+
+/**********************************************************/
+/**
+ * @brief      choose the plasma cells which this rank will update
+ *
+ * @return     The number of cells this rank will update, which
+ * are listed in update_cells
+ *
+ * @details
+ * The cost of updating a cell varies a great deal, since the
+ * ionization and temperature calculations take far longer in
+ * dense, optically thick cells than in the sparse outer parts
+ * of the wind.  The cells are therefore divided between the ranks
+ * according to the time each took to update in the last cycle
+ * (see get_parallel_ncost), rather than in equal ranges.  In the
+ * first cycle, when there are no times, every cell is taken to cost
+ * the same, and the cells are dealt out to the ranks in turn.
+ *
+ * The cells are listed with the most expensive first, so that
+ * the threads within a rank also finish at close to the same time.
+ *
+ **********************************************************/
+
+static int
+get_update_cells (void)
+{
+  int n;
+
+  if (update_ncells != NPLASMA)
+  {
+    free (update_cost);
+    free (update_cells);
+    update_cost = calloc (NPLASMA + 1, sizeof (double));
+    update_cells = calloc (NPLASMA + 1, sizeof (int));
+    if (update_cost == NULL || update_cells == NULL)
+    {
+      Error ("get_update_cells: Unable to allocate memory for %d cells\n", NPLASMA);
+      Exit (EXIT_FAILURE);
+    }
+    for (n = 0; n < NPLASMA; n++)
+    {
+      update_cost[n] = 1.0;
+    }
+    update_ncells = NPLASMA;
+  }
+
+  return (get_parallel_ncost (rank_global, NPLASMA, np_mpi_global, update_cost, update_cells));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      update the radiation field estimators, the ion
+ * abundances and the temperature of a single plasma cell
+ *
+ * @param [in] WindPtr  w   The entire wind
+ * @param [in] int  n_plasma   The plasma cell to update
+ * @param [in] double  flux_persist_scale   The fraction of the latest
+ * flux which is added into the persistent flux
+ * @return     Nothing
+ *
+ * @details
+ * This is called for each of the cells assigned to this rank by
+ * wind_update, possibly by several threads at once.
+ *
+ **********************************************************/
+
+static void
+wind_update_cell (WindPtr w, int n_plasma, double flux_persist_scale)
+{
+  double volume;
+  int nwind;
+  double t0_ion;
+
+  nwind = plasmamain[n_plasma].nwind;
+  volume = w[nwind].vol;
+
+  /* Skip cells that are partially in the wind these are not to be included
+     in the calculation */
+
+  if (modes.partial_cells == PC_EXTEND && wmain[nwind].inwind == W_PART_INWIND)
+  {
+    return;
+  }
+
+  if (plasmamain[n_plasma].ntot < 100)
+  {
+    Log
+      ("!!wind_update: Cell %4d Dom %d  Vol. %8.2e r %8.2e theta %8.2e has only %4d photons\n",
+       n_plasma, w[nwind].ndom, volume, w[nwind].rcen, w[nwind].thetacen, plasmamain[n_plasma].ntot);
+  }
+
+  /* Start with a call to the routine which normalises all the macro atom
+     monte carlo radiation field estimators. It's best to do this first since
+     some of the estimators include temperature terms (stimulated correction
+     terms) which were included during the monte carlo simulation so we want
+     to be sure that the SAME temperatures are used here. */
+
+  if (geo.rt_mode == RT_MODE_MACRO && geo.macro_simple == FALSE)
+  {
+    normalise_macro_estimators (&plasmamain[n_plasma]);
+  }
+
+  /* this routine normalises the unbanded and banded estimators for simple atoms */
+  normalise_simple_estimators (&plasmamain[n_plasma]);
+
+  /* update the persistent fluxes */
+  update_persistent_directional_flux_estimators (n_plasma, flux_persist_scale);
+
+  /* If geo.adiabatic is true, then calculate the adiabatic cooling using the current, i.e
+   * previous value of t_e.  Note that this may not be the best way to determine the cooling.
+   * Changes made here should also be reflected in wind2d.c. At present, adiabatic cooling
+   * is not included in updates to the temperature, even if the adiabatic cooling is calculated
+   * here.
+   */
+
+  if (geo.adiabatic)
+  {
+    plasmamain[n_plasma].cool_adiabatic = adiabatic_cooling (&w[nwind], plasmamain[n_plasma].t_e);
+  }
+  else
+  {
+    plasmamain[n_plasma].cool_adiabatic = 0.0;
+  }
+
+  if (geo.nonthermal)
+  {
+    plasmamain[n_plasma].heat_shock = shock_heating (&w[nwind]);
+  }
+  else
+  {
+    plasmamain[n_plasma].heat_shock = 0.0;
+  }
+
+  /* Calculate the densities in various ways depending on the ioniz_mode */
+  t0_ion = prof_start ();
+  ion_abundances (&plasmamain[n_plasma], geo.ioniz_mode);
+  prof_stop (PROF_ION_ABUNDANCES, t0_ion);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      updates the parameters in the wind that are
@@ -40,7 +188,11 @@
  * is responsible for calculaing the updates for a certain set of cells.  At
  * the end of the routine the updates are collected and reshared.
  *
- * The real need for prallelising the routine is the work done in ion_abundances
+ * The real need for prallelising the routine is the work done in ion_abundances.
+ * The cells are assigned to the MPI ranks according to how long each took to
+ * update in the previous cycle (see get_update_cells), so a rank's cells need
+ * not be contiguous, and within a rank, if --threads is used, the cells are
+ * shared between the threads as each finishes its last cell.
  *
  * Once this is done, various checks are made to determined what happened as a
  * function of the updates, various variables in geo are updated,  and for
@@ -56,14 +208,14 @@ wind_update (WindPtr w)
   double cool_sum, lum_sum, radiated_luminosity_sum;    //1706 - the total cooling and luminosity of the wind
   double apsum, aausum, abstot; //Absorbed photon energy from PI and auger
   double flux_persist_scale;
-  double volume;
   double dt_r, dt_e;
   double t_r_ave_old, t_r_ave, t_e_ave_old, t_e_ave;
   int nmax_r, nmax_e;
-  int nwind;
-  int my_nmin, my_nmax;         //Note that these variables are still used even without MPI on
   int ndom;
-  int n_cells_rank;
+  int n_cells_rank, nthreads;
+  double t0, t_cell, t_update, t_update_max, t_update_ave;
+
+  t0 = prof_start ();
 
   dt_r = 0.0;
   dt_e = 0.0;
@@ -76,88 +228,51 @@ wind_update (WindPtr w)
 
   xsignal (files.root, "%-20s Start wind update\n", "NOK");
 
-#ifdef MPI_ON
-  n_cells_rank = get_parallel_nrange (rank_global, NPLASMA, np_mpi_global, &my_nmin, &my_nmax);
-#else
-  my_nmin = 0;
-  my_nmax = NPLASMA;
-  n_cells_rank = NPLASMA;
-#endif
+  n_cells_rank = get_update_cells ();
+  nthreads = get_update_threads ();
 
-  flux_persist_scale = 0.5;     //The amount of the latest flux that gets added into the persistent flux
+  /* Only the times for this rank's cells are kept, so that the times of all the cells
+     can be shared by summing over the ranks */
 
-  for (n_plasma = my_nmin; n_plasma < my_nmax; ++n_plasma)
+  for (n_plasma = 0; n_plasma < NPLASMA; n_plasma++)
   {
-    nwind = plasmamain[n_plasma].nwind;
-    volume = w[nwind].vol;
-
-    /* Skip cells that are partially in the wind these are not to be included
-       in the calculation */
-
-    if (modes.partial_cells == PC_EXTEND && wmain[nwind].inwind == W_PART_INWIND)
-    {
-      continue;
-    }
-
-    if (plasmamain[n_plasma].ntot < 100)
-    {
-      Log
-        ("!!wind_update: Cell %4d Dom %d  Vol. %8.2e r %8.2e theta %8.2e has only %4d photons\n",
-         n_plasma, w[nwind].ndom, volume, w[nwind].rcen, w[nwind].thetacen, plasmamain[n_plasma].ntot);
-    }
-
-    /* Start with a call to the routine which normalises all the macro atom
-       monte carlo radiation field estimators. It's best to do this first since
-       some of the estimators include temperature terms (stimulated correction
-       terms) which were included during the monte carlo simulation so we want
-       to be sure that the SAME temperatures are used here. */
+    update_cost[n_plasma] = 0.0;
+  }
 
-    if (geo.rt_mode == RT_MODE_MACRO && geo.macro_simple == FALSE)
-    {
-      normalise_macro_estimators (&plasmamain[n_plasma]);
-    }
+  flux_persist_scale = 0.5;     //The amount of the latest flux that gets added into the persistent flux
 
-    /* this routine normalises the unbanded and banded estimators for simple atoms */
-    normalise_simple_estimators (&plasmamain[n_plasma]);
+  t_update = timer ();
 
-    /* update the persistent fluxes */
-    update_persistent_directional_flux_estimators (n_plasma, flux_persist_scale);
+  OMP_PRAGMA (omp parallel for if (nthreads > 1) num_threads (nthreads) schedule (dynamic, 1) private (n_plasma, t_cell))
+  for (i = 0; i < n_cells_rank; i++)
+  {
+    n_plasma = update_cells[i];
+    t_cell = timer ();
+    wind_update_cell (w, n_plasma, flux_persist_scale);
+    update_cost[n_plasma] = timer () - t_cell;
+  }
 
-    /* If geo.adiabatic is true, then calculate the adiabatic cooling using the current, i.e
-     * previous value of t_e.  Note that this may not be the best way to determine the cooling.
-     * Changes made here should also be reflected in wind2d.c. At present, adiabatic cooling
-     * is not included in updates to the temperature, even if the adiabatic cooling is calculated
-     * here.
-     */
+  t_update = timer () - t_update;
+  t_update_max = t_update_ave = t_update;
 
-    if (geo.adiabatic)
-    {
-      plasmamain[n_plasma].cool_adiabatic = adiabatic_cooling (&w[nwind], plasmamain[n_plasma].t_e);
-    }
-    else
-    {
-      plasmamain[n_plasma].cool_adiabatic = 0.0;
-    }
+#ifdef MPI_ON
+  MPI_Allreduce (MPI_IN_PLACE, update_cost, NPLASMA, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce (&t_update, &t_update_max, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce (&t_update, &t_update_ave, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  t_update_ave /= np_mpi_global;
+#endif
 
-    if (geo.nonthermal)
-    {
-      plasmamain[n_plasma].heat_shock = shock_heating (&w[nwind]);
-    }
-    else
-    {
-      plasmamain[n_plasma].heat_shock = 0.0;
-    }
+  Log ("wind_update: Updated %d of %d cells with %d thread(s) in %.2f s; the slowest rank took %.2f s, the average %.2f s\n",
+       n_cells_rank, NPLASMA, nthreads, t_update, t_update_max, t_update_ave);
 
-    /* Calculate the densities in various ways depending on the ioniz_mode */
-    ion_abundances (&plasmamain[n_plasma], geo.ioniz_mode);
-  }
+  calc_te_summary ();
 
   /*This is the end of the update loop that is parallised. We now need to exchange data between the tasks. */
 
-  broadcast_updated_plasma_properties (my_nmin, my_nmax, n_cells_rank);
+  broadcast_updated_plasma_properties (update_cells, n_cells_rank);
   if (geo.rt_mode == RT_MODE_MACRO && geo.macro_simple == FALSE)
   {
-    broadcast_updated_macro_atom_properties (my_nmin, my_nmax, n_cells_rank);
+    broadcast_updated_macro_atom_properties (update_cells, n_cells_rank);
   }
 
   /* Now we need to updated the densities immediately outside the wind so that the density interpolation in resonate will work.
@@ -392,6 +507,8 @@ wind_update (WindPtr w)
 
   xsignal (files.root, "%-20s Finished wind update\n", "NOK");
 
+  prof_stop (PROF_WIND_UPDATE, t0);
+
   return (0);
 }
 
@@ -837,17 +954,17 @@ shell_output_wind_update_diagnostics (double xsum, double psum, double fsum, dou
       for (i = 0; i < nlines; i++)
       {
         if (lin_ptr[i]->z == 1)
-          lum_h_line = lum_h_line + lin_ptr[i]->pow;
+          lum_h_line = lum_h_line + lin_pow[i];
         else if (lin_ptr[i]->z == 2)
-          lum_he_line = lum_he_line + lin_ptr[i]->pow;
+          lum_he_line = lum_he_line + lin_pow[i];
         else if (lin_ptr[i]->z == 6)
-          lum_c_line = lum_c_line + lin_ptr[i]->pow;
+          lum_c_line = lum_c_line + lin_pow[i];
         else if (lin_ptr[i]->z == 7)
-          lum_n_line = lum_n_line + lin_ptr[i]->pow;
+          lum_n_line = lum_n_line + lin_pow[i];
         else if (lin_ptr[i]->z == 8)
-          lum_o_line = lum_o_line + lin_ptr[i]->pow;
+          lum_o_line = lum_o_line + lin_pow[i];
         else if (lin_ptr[i]->z == 26)
-          lum_fe_line = lum_fe_line + lin_ptr[i]->pow;
+          lum_fe_line = lum_fe_line + lin_pow[i];
       }
       agn_ip = geo.const_agn * (((pow (50000 / HEV, geo.alpha_agn + 1.0)) - pow (100 / HEV, geo.alpha_agn + 1.0)) / (geo.alpha_agn + 1.0));
       agn_ip /= (w[n].r * w[n].r);
@@ -26,21 +26,36 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stddef.h>
 #include <sys/stat.h>
 
 #include "atomic.h"
 #include "sirocco.h"
 
 
+/* Add or read the variable length array member, which has n elements in each
+ * cell, of an array of cell structures such as plasmamain */
+
+#define WINDSAVE_ADD_CELLS(ws, cells, type, member, n, ncells) \
+  windsave_add_cells (ws, #cells "." #member, cells, sizeof (type), offsetof (type, member), sizeof (*((type *) 0)->member), n, ncells)
+#define WINDSAVE_READ_CELLS(ws, cells, type, member, n, ncells) \
+  windsave_read_cells (ws, #cells "." #member, cells, sizeof (type), offsetof (type, member), sizeof (*((type *) 0)->member), n, 0, \
+                       ncells)
+
+
 /**********************************************************/
 /** 
- * @brief      Save all of the strutures associated with the 
- * wind to a file
+ * @brief      Add all of the structures associated with the wind
+ * to a windsave file
  *
- * @param [in] char  filename[]   The name of the file to write to
- * @return     The number of successful writes
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @return     Nothing
  *
  * @details
+ * Each structure, or array of structures, is written as a section, and
+ * each of the variable length arrays of the plasma and macro-atom
+ * structures is written as a section which contains the arrays for all
+ * of the cells.
  *
  * ### Notes ###
  *
@@ -50,93 +65,111 @@
  *
  **********************************************************/
 
-int
-wind_save (filename)
-     char filename[];
+static void
+wind_save_sections (ws)
+     WindsaveFilePtr ws;
 {
-  FILE *fptr;
-  char header[LINELENGTH];
+  char name[LINELENGTH];
   int ndom;
-  int m;
-  int n;
 
-  if ((fptr = fopen (filename, "w")) == NULL)
-  {
-    Error ("wind_save: Unable to open %s\n", filename);
-    Exit (0);
-  }
+  windsave_add (ws, "geo", &geo, sizeof (geo), 1);
 
-  sprintf (header, "Version %s\n", VERSION);
-  n = fwrite (header, sizeof (header), 1, fptr);
-  n += fwrite (&geo, sizeof (geo), 1, fptr);
-
-  n += fwrite (zdom, sizeof (domain_dummy), geo.ndomain, fptr);
+  windsave_add (ws, "zdom", zdom, sizeof (domain_dummy), geo.ndomain);
   for (ndom = 0; ndom < geo.ndomain; ++ndom)
   {
-    n += fwrite (zdom[ndom].wind_x, sizeof (double), zdom[ndom].ndim, fptr);
-    n += fwrite (zdom[ndom].wind_z, sizeof (double), zdom[ndom].mdim, fptr);
-    n += fwrite (zdom[ndom].wind_midx, sizeof (double), zdom[ndom].ndim, fptr);
-    n += fwrite (zdom[ndom].wind_midz, sizeof (double), zdom[ndom].mdim, fptr);
+    sprintf (name, "zdom.%d.wind_x", ndom);
+    windsave_add (ws, name, zdom[ndom].wind_x, sizeof (double), zdom[ndom].ndim);
+    sprintf (name, "zdom.%d.wind_z", ndom);
+    windsave_add (ws, name, zdom[ndom].wind_z, sizeof (double), zdom[ndom].mdim);
+    sprintf (name, "zdom.%d.wind_midx", ndom);
+    windsave_add (ws, name, zdom[ndom].wind_midx, sizeof (double), zdom[ndom].ndim);
+    sprintf (name, "zdom.%d.wind_midz", ndom);
+    windsave_add (ws, name, zdom[ndom].wind_midz, sizeof (double), zdom[ndom].mdim);
 
     if (zdom[ndom].coord_type == CYLVAR)
     {
-      n += fwrite (zdom[ndom].wind_z_var, sizeof (double), zdom[ndom].ndim * zdom[ndom].mdim, fptr);
-      n += fwrite (zdom[ndom].wind_midz_var, sizeof (double), zdom[ndom].ndim * zdom[ndom].mdim, fptr);
+      sprintf (name, "zdom.%d.wind_z_var", ndom);
+      windsave_add (ws, name, zdom[ndom].wind_z_var[0], sizeof (double), zdom[ndom].ndim * zdom[ndom].mdim);
+      sprintf (name, "zdom.%d.wind_midz_var", ndom);
+      windsave_add (ws, name, zdom[ndom].wind_midz_var[0], sizeof (double), zdom[ndom].ndim * zdom[ndom].mdim);
     }
   }
 
-  n += fwrite (wmain, sizeof (wind_dummy), NDIM2, fptr);
-  n += fwrite (&disk, sizeof (disk), 1, fptr);
-  n += fwrite (&qdisk, sizeof (disk), 1, fptr);
-  n += fwrite (plasmamain, sizeof (plasma_dummy), NPLASMA, fptr);
-
-/* Write out the variable length arrays
-in the plasma structure */
+  windsave_add (ws, "wmain", wmain, sizeof (wind_dummy), NDIM2);
+  windsave_add (ws, "disk", &disk, sizeof (disk), 1);
+  windsave_add (ws, "qdisk", &qdisk, sizeof (disk), 1);
+  windsave_add (ws, "plasmamain", plasmamain, sizeof (plasma_dummy), NPLASMA);
+
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, density, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, partition, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, ioniz, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, recomb, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, inner_recomb, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, scatters, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, xscatters, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, heat_ion, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, cool_rr_ion, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, cool_dr_ion, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, lum_rr_ion, nions, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, levden, nlte_levels, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, recomb_simple, nphot_total, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, recomb_simple_upweight, nphot_total, NPLASMA);
+  WINDSAVE_ADD_CELLS (ws, plasmamain, plasma_dummy, kbf_use, nphot_total, NPLASMA);
+
+  /* Now write out the macro atom info */
 
-  for (m = 0; m < NPLASMA; m++)
+  if (geo.nmacro)
   {
-    n += fwrite (plasmamain[m].density, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].partition, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].ioniz, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].recomb, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].inner_recomb, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].scatters, sizeof (int), nions, fptr);
-    n += fwrite (plasmamain[m].xscatters, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].heat_ion, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].cool_rr_ion, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].cool_dr_ion, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].lum_rr_ion, sizeof (double), nions, fptr);
-    n += fwrite (plasmamain[m].levden, sizeof (double), nlte_levels, fptr);
-    n += fwrite (plasmamain[m].recomb_simple, sizeof (double), nphot_total, fptr);
-    n += fwrite (plasmamain[m].recomb_simple_upweight, sizeof (double), nphot_total, fptr);
-    n += fwrite (plasmamain[m].kbf_use, sizeof (double), nphot_total, fptr);
+    windsave_add (ws, "macromain", macromain, sizeof (macro_dummy), NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, jbar, size_Jbar_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, jbar_old, size_Jbar_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, gamma, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, gamma_old, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, gamma_e, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, gamma_e_old, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, alpha_st, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, alpha_st_old, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, alpha_st_e, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, alpha_st_e_old, size_gamma_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, recomb_sp, size_alpha_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, recomb_sp_e, size_alpha_est, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, matom_emiss, nlevels_macro, NPLASMA);
+    WINDSAVE_ADD_CELLS (ws, macromain, macro_dummy, matom_abs, nlevels_macro, NPLASMA);
   }
+}
 
-/* Now write out the macro atom info */
 
-  if (geo.nmacro)
-  {
-    n += fwrite (macromain, sizeof (macro_dummy), NPLASMA, fptr);
-    for (m = 0; m < NPLASMA; m++)
-    {
-      n += fwrite (macromain[m].jbar, sizeof (double), size_Jbar_est, fptr);
-      n += fwrite (macromain[m].jbar_old, sizeof (double), size_Jbar_est, fptr);
-      n += fwrite (macromain[m].gamma, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].gamma_old, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].gamma_e, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].gamma_e_old, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].alpha_st, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].alpha_st_old, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].alpha_st_e, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].alpha_st_e_old, sizeof (double), size_gamma_est, fptr);
-      n += fwrite (macromain[m].recomb_sp, sizeof (double), size_alpha_est, fptr);
-      n += fwrite (macromain[m].recomb_sp_e, sizeof (double), size_alpha_est, fptr);
-      n += fwrite (macromain[m].matom_emiss, sizeof (double), nlevels_macro, fptr);
-      n += fwrite (macromain[m].matom_abs, sizeof (double), nlevels_macro, fptr);
-    }
-  }
 
-  fclose (fptr);
+/**********************************************************/
+/** 
+ * @brief      Save all of the strutures associated with the 
+ * wind to a file
+ *
+ * @param [in] char  filename[]   The name of the file to write to
+ * @return     The number of sections written
+ *
+ * @details
+ * The file is complete when the routine returns.
+ *
+ **********************************************************/
+
+int
+wind_save (filename)
+     char filename[];
+{
+  WindsaveFilePtr ws;
+  int n;
+  double t0;
+
+  t0 = prof_start ();
+
+  windsave_wait ();
+
+  ws = windsave_create (filename, modes.windsave_compress, FALSE);
+  wind_save_sections (ws);
+  n = windsave_finish (ws);
+
+  prof_stop (PROF_WIND_SAVE, t0);
 
   Log_silent
     ("wind_write sizes: NPLASMA %d size_Jbar_est %d size_gamma_est %d size_alpha_est %d nlevels_macro %d\n",
@@ -146,46 +179,103 @@ in the plasma structure */
 
 }
 
-/*
 
-   wind_read (filename)
 
-   History
-	11dec	ksl	Updated so returns -1 if it cannot open the windsave file.  This
-			was done to enable one to handle missing files differently in
-			different cases
-	14jul	nsh	Code added to read in variable length arrays in plasma structure
-	15aug	ksl	Updated to read domain structure
-	15oct	ksl	Updated to read disk and qdisk stuctures
-*/
+/**********************************************************/
+/** 
+ * @brief      Save all of the strutures associated with the 
+ * wind to a file, without waiting for the file to be written
+ *
+ * @param [in] char  filename[]   The name of the file to write to
+ * @return     The number of sections written
+ *
+ * @details
+ * This is used to checkpoint the wind at the end of each cycle.  The
+ * structures are copied into memory, and the file is written by a helper
+ * thread while the program continues.  If the copy would be larger
+ * than WINDSAVE_BUFFER_MAX, the file is instead written before the
+ * routine returns, as in wind_save.
+ *
+ * ### Notes ###
+ *
+ * windsave_wait must be called before the program ends, to
+ * ensure that the last file has been completed.
+ *
+ **********************************************************/
+
+int
+wind_save_checkpoint (filename)
+     char filename[];
+{
+  WindsaveFilePtr ws;
+  int n;
+  double t0;
+
+  t0 = prof_start ();
+
+  windsave_wait ();
+
+  ws = windsave_create (filename, modes.windsave_compress, TRUE);
+  wind_save_sections (ws);
+  n = windsave_finish (ws);
+
+  prof_stop (PROF_WIND_SAVE, t0);
+
+  return (n);
+}
+
 
 
 /**********************************************************/
 /** 
- * @brief      Read back the windsavefile 
+ * @brief      Read the atomic data used by the model in a windsave file
  *
- * @param [in] char  filename[]   The full name of the windsave file
- * @return     The number of successful reads, or -1 if the file cannot 
- * be opened
+ * @return     Nothing
  *
  * @details
- * 
- * The routine reads in both the windsave file and the
- * associated atomic data files for a model. It also reads the
- * disk and qdisk structures.
+ * This is called once the geo structure has been read, and must be
+ * done before the rest of the file is read, in order to establish the
+ * dimensions of some of the variable length structures, especially
+ * those associated with macro atoms.
  *
+ **********************************************************/
+
+static void
+wind_read_atomic_data ()
+{
+  struct stat file_stat;        // Used to check the atomic data exists
+
+  if (stat (geo.atomic_filename, &file_stat))
+  {
+    if (system ("Setup_Sirocco_Dir"))
+    {
+      Error ("Unable to open %s or create link for atomic data\n", geo.atomic_filename);
+      Exit (1);
+    }
+  }
+
+  get_atomic_data (geo.atomic_filename);
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      Read back a windsave file written in the original format, in
+ * which the structures were written one after another
  *
- * ### Notes ###
+ * @param [in] char  filename[]   The full name of the windsave file
+ * @return     The number of successful reads, or -1 if the file cannot 
+ * be opened
  *
- * ### Programming Comment ### 
- * This routine calls wind_complete. This looks superfluous, since 
- * wind_complete and its subsidiary routines but it
- * also appears harmless.  ksl 
+ * @details
+ * This allows models from older versions of sirocco to be
+ * read, as long as the structures have not changed.
  *
  **********************************************************/
 
-int
-wind_read (filename)
+static int
+wind_read_unsectioned (filename)
      char filename[];
 {
   FILE *fptr;
@@ -193,7 +283,6 @@ wind_read (filename)
   int n, m;
   char header[LINELENGTH];
   char version[LINELENGTH];
-  struct stat file_stat;        // Used to check the atomic data exists
 
   if ((fptr = fopen (filename, "r")) == NULL)
   {
@@ -208,21 +297,7 @@ wind_read (filename)
 
   n += fread (&geo, sizeof (geo), 1, fptr);
 
-  /* Read the atomic data file.  This is necessary to do here in order to establish the 
-   * values for the dimensionality of some of the variable length structures, associated 
-   * with macro atoms, especially but likely to be a good idea ovrall
-   */
-
-  if (stat (geo.atomic_filename, &file_stat))
-  {
-    if (system ("Setup_Sirocco_Dir"))
-    {
-      Error ("Unable to open %s or create link for atomic data\n", geo.atomic_filename);
-      Exit (1);
-    }
-  }
-
-  get_atomic_data (geo.atomic_filename);
+  wind_read_atomic_data ();
 
 /* Now allocate space for the wind array */
 
@@ -324,6 +399,196 @@ wind_read (filename)
 
   fclose (fptr);
 
+  return (n);
+
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      Read back the windsavefile 
+ *
+ * @param [in] char  filename[]   The full name of the windsave file
+ * @return     The number of successful reads, or -1 if the file cannot 
+ * be opened
+ *
+ * @details
+ * 
+ * The routine reads in both the windsave file and the
+ * associated atomic data files for a model. It also reads the
+ * disk and qdisk structures.
+ *
+ *
+ * ### Notes ###
+ *
+ * ### Programming Comment ### 
+ * This routine calls wind_complete. This looks superfluous, since 
+ * wind_complete and its subsidiary routines but it
+ * also appears harmless.  ksl 
+ *
+ **********************************************************/
+
+int
+wind_read (filename)
+     char filename[];
+{
+  return (wind_read_select (filename, WINDSAVE_ALL));
+}
+
+
+
+/**********************************************************/
+/** 
+ * @brief      Read back the windsavefile, but only those variable
+ * length arrays which are needed
+ *
+ * @param [in] char  filename[]   The full name of the windsave file
+ * @param [in] int  select   The arrays which are to be read, a combination
+ * of WINDSAVE_PLASMA_ARRAYS and WINDSAVE_MACRO_ARRAYS
+ * @return     The number of sections read, or -1 if the file cannot 
+ * be opened
+ *
+ * @details
+ * This is wind_read for programs, such as windsave2table, which only
+ * need part of a model.  All of the structures are allocated, but the
+ * arrays which are not selected are left as zeros.  Since the file is
+ * mapped into memory, the parts of the file which contain these arrays
+ * are never read, and since the arrays are allocated with calloc, they
+ * generally do not occupy any memory unless they are used.
+ *
+ * Files written in the original format, before the files were divided
+ * into sections, are read in their entirety.
+ *
+ **********************************************************/
+
+int
+wind_read_select (filename, select)
+     char filename[];
+     int select;
+{
+  WindsaveFilePtr ws;
+  char name[LINELENGTH];
+  int ndom;
+  int n, m, sectioned;
+
+  if ((sectioned = windsave_is_sectioned (filename)) < 0)
+  {
+    return (-1);
+  }
+
+  if (sectioned)
+  {
+    if ((ws = windsave_open (filename)) == NULL)
+    {
+      return (-1);
+    }
+
+    Log ("Reading Windfile %s created with sirocco version %s with sirocco version %s\n", filename, ws->header.version, VERSION);
+
+    n = windsave_read (ws, "geo", &geo, sizeof (geo), 1);
+
+    wind_read_atomic_data ();
+
+    NDIM2 = geo.ndim2;
+    NPLASMA = geo.nplasma;
+
+    n += windsave_read (ws, "zdom", zdom, sizeof (domain_dummy), geo.ndomain);
+    for (ndom = 0; ndom < geo.ndomain; ++ndom)
+    {
+      allocate_domain_wind_coords (ndom);
+      sprintf (name, "zdom.%d.wind_x", ndom);
+      n += windsave_read (ws, name, zdom[ndom].wind_x, sizeof (double), zdom[ndom].ndim);
+      sprintf (name, "zdom.%d.wind_z", ndom);
+      n += windsave_read (ws, name, zdom[ndom].wind_z, sizeof (double), zdom[ndom].mdim);
+      sprintf (name, "zdom.%d.wind_midx", ndom);
+      n += windsave_read (ws, name, zdom[ndom].wind_midx, sizeof (double), zdom[ndom].ndim);
+      sprintf (name, "zdom.%d.wind_midz", ndom);
+      n += windsave_read (ws, name, zdom[ndom].wind_midz, sizeof (double), zdom[ndom].mdim);
+      if (zdom[ndom].coord_type == CYLVAR)
+      {
+        cylvar_allocate_domain (ndom);
+        sprintf (name, "zdom.%d.wind_z_var", ndom);
+        n += windsave_read (ws, name, zdom[ndom].wind_z_var[0], sizeof (double), zdom[ndom].ndim * zdom[ndom].mdim);
+        sprintf (name, "zdom.%d.wind_midz_var", ndom);
+        n += windsave_read (ws, name, zdom[ndom].wind_midz_var[0], sizeof (double), zdom[ndom].ndim * zdom[ndom].mdim);
+      }
+    }
+
+    calloc_wind (NDIM2);
+    n += windsave_read (ws, "wmain", wmain, sizeof (wind_dummy), NDIM2);
+    n += windsave_read (ws, "disk", &disk, sizeof (disk), 1);
+    n += windsave_read (ws, "qdisk", &qdisk, sizeof (disk), 1);
+
+    calloc_plasma (NPLASMA);
+    n += windsave_read (ws, "plasmamain", plasmamain, sizeof (plasma_dummy), NPLASMA);
+    calloc_dyn_plasma (NPLASMA);
+
+    if (select & WINDSAVE_PLASMA_ARRAYS)
+    {
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, density, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, partition, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, ioniz, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, recomb, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, inner_recomb, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, scatters, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, xscatters, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, heat_ion, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, cool_rr_ion, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, cool_dr_ion, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, lum_rr_ion, nions, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, levden, nlte_levels, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, recomb_simple, nphot_total, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, recomb_simple_upweight, nphot_total, NPLASMA);
+      n += WINDSAVE_READ_CELLS (ws, plasmamain, plasma_dummy, kbf_use, nphot_total, NPLASMA);
+    }
+
+    /*Allocate space for macro-atoms and read in the data */
+
+    if (geo.nmacro > 0)
+    {
+      calloc_macro (NPLASMA);
+      n += windsave_read (ws, "macromain", macromain, sizeof (macro_dummy), NPLASMA);
+      calloc_estimators (NPLASMA);
+      calloc_matom_matrix (NPLASMA);
+
+      if (select & WINDSAVE_MACRO_ARRAYS)
+      {
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, jbar, size_Jbar_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, jbar_old, size_Jbar_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, gamma, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, gamma_old, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, gamma_e, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, gamma_e_old, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, alpha_st, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, alpha_st_old, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, alpha_st_e, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, alpha_st_e_old, size_gamma_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, recomb_sp, size_alpha_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, recomb_sp_e, size_alpha_est, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, matom_emiss, nlevels_macro, NPLASMA);
+        n += WINDSAVE_READ_CELLS (ws, macromain, macro_dummy, matom_abs, nlevels_macro, NPLASMA);
+      }
+
+      /* Force recalculation of kpkt_rates and matrix rates */
+
+      for (m = 0; m < NPLASMA; m++)
+      {
+        macromain[m].kpkt_rates_known = FALSE;
+        macromain[m].matrix_rates_known = FALSE;
+      }
+    }
+
+    windsave_close (ws);
+  }
+  else
+  {
+    if ((n = wind_read_unsectioned (filename)) < 0)
+    {
+      return (-1);
+    }
+  }
+
   wind_complete ();
 
   Log ("Read geometry and wind structures from windsavefile %s\n", filename);
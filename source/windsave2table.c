@@ -41,8 +41,10 @@
  * ### Notes ###
  *
  * Whereas swind is intended to be run interactively, windsave2table is
- * entirely hardwired so that it produces a standard set of output
- * files.  To change the outputs one has to modify the routine
+ * hardwired so that it produces a standard set of output
+ * files.  To change the standard outputs one has to modify the routine.
+ * Alternatively a list of columns can be given with -c, in which case
+ * only those columns are written, see windsave2table_columns.c
  *
  * This file just contains the driving routine.  All of the 
  * real work is carried out in windsave2table_sub.c  Indeed so 
@@ -85,8 +87,12 @@
  *  -x     windcell Writes out the detailed spectra in a specific windcell 
  *  -xall  Writes out the detiled windcell spectra for all of the cells that are acutally in 
  *         the wind
+ *  -c list  Write only the columns in list, to a single table, see parse_table_columns
+ *  -bin   Write the columns to a binary file, rootname.table.bin
+ *  -noascii  Do not write ascii tables, when -bin is used
+ *  --threads n  Use n threads to fill and format the columns
  *
- * The switches only affect the ion tables not the master table
+ * The switches -d and -s only affect the ion tables not the master table
  * This was originally implemented to enable somebody to query which version of
  * Python windsave2table was compiled with. Works in a similar fashion to how
  * the version information is stored and viewed in Python.
@@ -95,7 +101,7 @@
  *
  **********************************************************/
 
-char windsave2table_help[] = "Usage: windsave2table [-r or -s] [-a] [-x wincell_no] [-xall] [-h] [--version] rootname \n\
+char windsave2table_help[] = "Usage: windsave2table [-r or -s] [-a] [-x wincell_no] [-xall] [-c list] [-bin] [-noascii] [--threads n] [-h] [--version] rootname \n\
 -d             Return densities instead of ion fraction in ion tables \n\
 -s             Return number of scatters per unit volume of an ion instead if ion fractions \n\
 -a             Print additional tables with more information about ions  \n\
@@ -104,19 +110,30 @@ char windsave2table_help[] = "Usage: windsave2table [-r or -s] [-a] [-x wincell_
 -x windcell    In addition to the normal tables, print out the detailed spectra in a specific windcell\n\
 -xall          In addition to the normal tables, print out a large file containing all of the detailed cell spectra\n\
                for those cells that are in the wind\n\
+-c list        Write only the columns in list to rootname.table.txt, instead of the normal tables.\n\
+               list is separated by commas, e.g. ne,t_e,c4,c4:den,he*, or is @filename to read it from a file.\n\
+               all selects all of the variables, and ions all of the ions\n\
+-bin           Also write the columns to a binary file, rootname.table.bin.  Without -c all variables and ions\n\
+               are written\n\
+-noascii       With -bin, do not write any ascii tables\n\
+--threads n    Use n threads to fill and format the columns (requires OpenMP)\n\
 -h             get this help message and quit\n\
 ";
 
 void
-parse_arguments (int argc, char *argv[], char root[], int *ion_switch, int *spec_switch, int *edge_switch)
+parse_arguments (int argc, char *argv[], char root[], int *ion_switch, int *spec_switch, int *edge_switch, char *column_list,
+                 int *ascii, int *binary)
 {
-  int i;
+  int i, nthreads;
   char *fget_rc;
   char input[LINELENGTH];
 
   *ion_switch = 0;
   *spec_switch = -1;
   *edge_switch = FALSE;
+  column_list[0] = '\0';
+  *ascii = TRUE;
+  *binary = FALSE;
 
 
   if (argc == 1)
@@ -175,6 +192,36 @@ parse_arguments (int argc, char *argv[], char root[], int *ion_switch, int *spec
         *ion_switch = 99;
         printf ("Various files detailing information about each ion in a cell will be created\n");
       }
+      else if (!strcmp (argv[i], "-c"))
+      {
+        if (i + 1 >= argc)
+        {
+          Error ("windsave2table: No list of columns after -c switch\n");
+          exit (1);
+        }
+        snprintf (column_list, LINELENGTH, "%s", argv[i + 1]);
+        printf ("Only the columns %s will be written\n", column_list);
+        i++;
+      }
+      else if (!strcmp (argv[i], "-bin"))
+      {
+        *binary = TRUE;
+        printf ("The columns will be written to a binary file\n");
+      }
+      else if (!strcmp (argv[i], "-noascii"))
+      {
+        *ascii = FALSE;
+      }
+      else if (!strcmp (argv[i], "--threads"))
+      {
+        if (i + 1 >= argc || sscanf (argv[i + 1], "%d", &nthreads) != 1)
+        {
+          Error ("windsave2table: No number of threads after --threads switch\n");
+          exit (1);
+        }
+        init_threads (nthreads);
+        i++;
+      }
       else if (!strncmp (argv[i], "-edge", 5))
       {
         *edge_switch = TRUE;
@@ -242,6 +289,8 @@ main (argc, argv)
   int ion_switch;
   int spec_switch;
   int edge_switch;
+  int ascii, binary;
+  char column_list[LINELENGTH];
   int ndom;
 
 
@@ -256,7 +305,15 @@ main (argc, argv)
    * last compiled and on what commit this was
    */
 
-  parse_arguments (argc, argv, root, &ion_switch, &spec_switch, &edge_switch);
+  modes.nthreads = 1;           // this is updated in parse_arguments if required
+
+  parse_arguments (argc, argv, root, &ion_switch, &spec_switch, &edge_switch, column_list, &ascii, &binary);
+
+  if (!ascii && !binary)
+  {
+    printf ("-noascii can only be used with -bin\n");
+    exit (0);
+  }
 
   printf ("Reading data from file %s\n", root);
 
@@ -278,7 +335,9 @@ main (argc, argv)
     return EXIT_FAILURE;
   }
 
-  if (wind_read (windsavefile) < 0)
+  /* The tables do not use the macro-atom estimators, so these are not read */
+
+  if (wind_read_select (windsavefile, WINDSAVE_PLASMA_ARRAYS) < 0)
   {
     Error ("swind: Could not open %s", windsavefile);
     exit (0);
@@ -287,7 +346,28 @@ main (argc, argv)
   printf ("Read wind_file %s\n", windsavefile);
   printf ("Read Atomic data from %s\n", geo.atomic_filename);
 
-  do_windsave2table (root, ion_switch, edge_switch);
+  /* With -c, only the selected columns are written, to a single table.
+     With -bin and no list, all of the variables and ions are written to
+     the binary table, in addition to the normal tables */
+
+  if (column_list[0] != '\0')
+  {
+    if (do_windsave2table_columns (root, column_list, ion_switch, edge_switch, ascii, binary))
+    {
+      Error ("windsave2table: Could not write the columns %s\n", column_list);
+      exit (1);
+    }
+  }
+  else
+  {
+    if (binary && do_windsave2table_columns (root, "all,ions", ion_switch, edge_switch, FALSE, TRUE))
+    {
+      Error ("windsave2table: Could not write the binary table\n");
+      exit (1);
+    }
+    if (ascii)
+      do_windsave2table (root, ion_switch, edge_switch);
+  }
 
   if (spec_switch == -2)
   {
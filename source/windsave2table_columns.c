@@ -0,0 +1,883 @@
+/***********************************************************/
+/** @file  windsave2table_columns.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Selection of the columns written by windsave2table, and
+ * the writing of a table of selected columns in a single pass
+ *
+ * The standard tables written by windsave2table fetch each column
+ * with get_one or get_ion, which used to find the variable by
+ * comparing its name with each of the possible names, for every
+ * cell.  Here the name of a column is resolved once, into the
+ * position of the variable in the wind or plasma structure, or
+ * the ion and the quantity wanted for that ion, after which the
+ * values for all of the cells can be filled without reference to
+ * the name.
+ *
+ * A list of columns can also be given to windsave2table, in which
+ * case the columns are filled in parallel and written to a single
+ * ascii table, rootname.table.txt, and/or a binary file,
+ * rootname.table.bin, in which the data are stored by column.
+ *
+ * The binary file consists of a header, wind_table_header, the
+ * names of the columns, each WTAB_NAMELEN characters long, and
+ * then the values of each column in turn, as ncells doubles.
+ * The file is written in the native byte order, which can be
+ * identified from the byte_order field of the header.  The
+ * routine read_wind_table in py_progs/py_read_output.py reads
+ * these files.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+
+#include "atomic.h"
+#include "sirocco.h"
+
+/* Where the value of a column is found */
+
+#define WTAB_GEOMETRY 0         /* A variable in the wind structure, reported for every cell */
+#define WTAB_WIND     1         /* A variable in the wind structure, reported for cells in the wind */
+#define WTAB_PLASMA   2         /* A variable in the plasma structure, reported for cells in the wind */
+#define WTAB_ION      3         /* A quantity for one ion, see get_ion */
+#define WTAB_INDEX    4         /* The i (offset 0) or j (offset 1) index of the cell */
+
+#define WTAB_DOUBLE   0
+#define WTAB_INT      1
+
+#define WTAB_BLOCK    1024      /* The number of rows of the ascii table which are formatted together */
+
+static struct table_variable
+{
+  char *name;
+  int source;
+  int type;
+  size_t offset;
+} table_variables[] = {
+  {"x", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, x[0])},
+  {"z", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, x[2])},
+  {"xcen", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, xcen[0])},
+  {"zcen", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, xcen[2])},
+  {"r", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, r)},
+  {"rcen", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, rcen)},
+  {"theta", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, theta)},
+  {"theta_cen", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, thetacen)},
+  {"i", WTAB_INDEX, WTAB_INT, 0},
+  {"j", WTAB_INDEX, WTAB_INT, 1},
+  {"inwind", WTAB_GEOMETRY, WTAB_INT, offsetof (wind_dummy, inwind)},
+  {"v_x", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, v[0])},
+  {"v_y", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, v[1])},
+  {"v_z", WTAB_GEOMETRY, WTAB_DOUBLE, offsetof (wind_dummy, v[2])},
+
+  {"ne", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, ne)},
+  {"rho", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, rho)},
+  {"vol", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, vol)},
+  {"t_e", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, t_e)},
+  {"t_r", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, t_r)},
+  {"t_e_old", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, t_e_old)},
+  {"t_r_old", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, t_r_old)},
+  {"dt_e", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, dt_e)},
+  {"dt_e_old", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, dt_e_old)},
+  {"J", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, j)},
+  {"J_direct", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, j_direct)},
+  {"J_scatt", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, j_scatt)},
+  {"ave_freq", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, ave_freq)},
+  {"converge", WTAB_PLASMA, WTAB_INT, offsetof (plasma_dummy, converge_whole)},
+  {"dmo_dt_x", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, dmo_dt[0])},
+  {"dmo_dt_y", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, dmo_dt[1])},
+  {"dmo_dt_z", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, dmo_dt[2])},
+  {"ntot", WTAB_PLASMA, WTAB_INT, offsetof (plasma_dummy, ntot)},
+  {"ip", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, ip)},
+  {"xi", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, xi)},
+  {"heat_tot", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_tot)},
+  {"heat_tot_old", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_tot_old)},
+  {"heat_comp", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_comp)},
+  {"heat_lines", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_lines)},
+  {"heat_ff", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_ff)},
+  {"heat_photo", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_photo)},
+  {"heat_auger", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_auger)},
+  {"cool_comp", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, cool_comp)},
+  {"lum_tot", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, lum_tot)},
+  {"lum_lines", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, lum_lines)},
+  {"lum_ff", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, lum_ff)},
+  {"lum_rr", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, lum_rr)},
+  {"cool_rr", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, cool_rr)},
+  {"cool_dr", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, cool_dr)},
+  {"cool_tot", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, cool_tot)},
+  {"w", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, w)},
+  {"nrad", WTAB_PLASMA, WTAB_INT, offsetof (plasma_dummy, nrad)},
+  {"nioniz", WTAB_PLASMA, WTAB_INT, offsetof (plasma_dummy, nioniz)},
+  {"heat_shock", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_shock)},
+  {"cool_adiab", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, cool_adiabatic)},
+  {"heat_lines_macro", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_lines_macro)},
+  {"heat_photo_macro", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, heat_photo_macro)},
+  {"gain", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, gain)},
+  {"macro_bf_in", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, bf_simple_ionpool_in)},
+  {"macro_bf_out", WTAB_PLASMA, WTAB_DOUBLE, offsetof (plasma_dummy, bf_simple_ionpool_out)},
+
+  {"dv_x_dx", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[0][0])},
+  {"dv_x_dy", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[0][1])},
+  {"dv_x_dz", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[0][2])},
+  {"dv_y_dx", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[1][0])},
+  {"dv_y_dy", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[1][1])},
+  {"dv_y_dz", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[1][2])},
+  {"dv_z_dx", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[2][0])},
+  {"dv_z_dy", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[2][1])},
+  {"dv_z_dz", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, v_grad[2][2])},
+  {"dvds_max", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, dvds_max)},
+  {"div_v", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, div_v)},
+  {"gamma", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, xgamma)},
+  {"dfudge", WTAB_WIND, WTAB_DOUBLE, offsetof (wind_dummy, dfudge)},
+};
+
+#define NTABLE_VARIABLES (int) (sizeof table_variables / sizeof table_variables[0])
+
+/* The quantities which can be returned for an ion, in the order of
+ * the ion_switch of get_ion */
+
+static char *ion_quantities[] = { "frac", "den", "scat", "ion_frac", "ioniz", "recomb", "heat", "cool_rr", "lum_rr", "cool_dr" };
+
+#define NION_QUANTITIES (int) (sizeof ion_quantities / sizeof ion_quantities[0])
+
+
+
+/**********************************************************/
+/**
+ * @brief      the name of a quantity which can be returned for an ion
+ *
+ * @param [in] int  ion_switch   The quantity, as for get_ion
+ * @return     The name of the quantity, e.g. "frac" or "den", or NULL
+ * if ion_switch is not valid
+ *
+ **********************************************************/
+
+char *
+ion_table_quantity (int ion_switch)
+{
+  if (ion_switch < 0 || ion_switch >= NION_QUANTITIES)
+    return (NULL);
+
+  return (ion_quantities[ion_switch]);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      set up a column for one quantity of an ion
+ *
+ * @param [in] int  nion   The ion
+ * @param [in] int  ion_switch   The quantity, as for get_ion
+ * @param [out] WindTableColumnPtr  column   The column
+ * @return     0 on success, or -1 if ion_switch is not valid
+ *
+ * @details
+ * The name of the column is the element symbol, in lower case,
+ * followed by the ionization state, e.g. c4, to which the name
+ * of the quantity is appended if this is not the ion fraction,
+ * e.g. c4_den.
+ *
+ **********************************************************/
+
+int
+ion_table_column (int nion, int ion_switch, WindTableColumnPtr column)
+{
+  char symbol[20];
+  int n;
+
+  if (ion_table_quantity (ion_switch) == NULL)
+    return (-1);
+
+  for (n = 0; ele[ion[nion].nelem].name[n] != '\0' && n < 19; n++)
+    symbol[n] = tolower ((unsigned char) ele[ion[nion].nelem].name[n]);
+  symbol[n] = '\0';
+
+  if (ion_switch == 0)
+    snprintf (column->name, WTAB_NAMELEN, "%s%d", symbol, ion[nion].istate);
+  else
+    snprintf (column->name, WTAB_NAMELEN, "%s%d_%s", symbol, ion[nion].istate, ion_quantities[ion_switch]);
+
+  column->source = WTAB_ION;
+  column->type = WTAB_DOUBLE;
+  column->offset = 0;
+  column->nion = nion;
+  column->nelem = ion[nion].nelem;
+  column->ion_switch = ion_switch;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      find the element whose symbol begins a column name
+ *
+ * @param [in] char *  name   The name, e.g. c4 or he*
+ * @param [out] char **  rest   The remainder of the name after the symbol
+ * @return     The element, or -1 if name does not start with a symbol
+ *
+ **********************************************************/
+
+static int
+table_element (char *name, char **rest)
+{
+  int nelem, n;
+
+  for (nelem = 0; nelem < nelements; nelem++)
+  {
+    for (n = 0; ele[nelem].name[n] != '\0'; n++)
+      if (tolower ((unsigned char) name[n]) != tolower ((unsigned char) ele[nelem].name[n]))
+        break;
+
+    if (ele[nelem].name[n] == '\0' && n > 0 && (isdigit ((unsigned char) name[n]) || name[n] == '*'))
+    {
+      *rest = &name[n];
+      return (nelem);
+    }
+  }
+
+  return (-1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      resolve the name of a column
+ *
+ * @param [in] char *  name   The name of the column
+ * @param [in] int  ion_switch   The quantity returned for ions, unless
+ * it is given in the name
+ * @param [out] WindTableColumnPtr  column   The column
+ * @return     0 on success, or -1 if the name is not recognised
+ *
+ * @details
+ * The name is either one of the variables in table_variables, or an
+ * ion, written as the element symbol followed by the ionization state,
+ * e.g. c4, and optionally a colon and the quantity wanted, e.g. c4:den.
+ *
+ * ### Notes ###
+ * Variables take precedence, so ne is the electron density; neon
+ * ions always have an ionization state, e.g. ne8.
+ *
+ **********************************************************/
+
+int
+resolve_table_column (char *name, int ion_switch, WindTableColumnPtr column)
+{
+  int n, nelem, istate, nion;
+  char *rest, *quantity;
+
+  for (n = 0; n < NTABLE_VARIABLES; n++)
+  {
+    if (strcmp (name, table_variables[n].name) == 0)
+    {
+      snprintf (column->name, WTAB_NAMELEN, "%s", table_variables[n].name);
+      column->source = table_variables[n].source;
+      column->type = table_variables[n].type;
+      column->offset = table_variables[n].offset;
+      column->nion = column->nelem = column->ion_switch = -1;
+      return (0);
+    }
+  }
+
+  if ((nelem = table_element (name, &rest)) < 0)
+    return (-1);
+
+  istate = (int) strtol (rest, &quantity, 10);
+  if (quantity == rest)
+    return (-1);
+
+  if (*quantity == ':')
+  {
+    quantity++;
+    for (ion_switch = 0; ion_switch < NION_QUANTITIES; ion_switch++)
+      if (strcmp (quantity, ion_quantities[ion_switch]) == 0)
+        break;
+    if (ion_switch == NION_QUANTITIES)
+      return (-1);
+  }
+  else if (*quantity != '\0')
+  {
+    return (-1);
+  }
+
+  for (nion = ele[nelem].firstion; nion < ele[nelem].firstion + ele[nelem].nions; nion++)
+  {
+    if (ion[nion].istate == istate)
+      return (ion_table_column (nion, ion_switch, column));
+  }
+
+  return (-1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      the value of a column in one cell
+ *
+ * @param [in] int  ndom   The domain
+ * @param [in] WindTableColumnPtr  column   The column
+ * @param [in] int  nwind   The wind cell
+ * @param [in] int  edge   If TRUE, report the variables of cells which are not in the wind
+ * @return     The value, or 0 if the cell is not in the wind
+ *
+ * @details
+ * As in the original versions of get_one and get_ion, variables of the
+ * wind and plasma structures are reported for cells which are in the wind,
+ * or for every cell if edge is TRUE, and ions for cells which are in the
+ * wind and have a non-zero density.
+ *
+ **********************************************************/
+
+static double
+table_column_value (int ndom, WindTableColumnPtr column, int nwind, int edge)
+{
+  WindPtr one;
+  PlasmaPtr xplasma;
+  char *base;
+  int i, j;
+  double x;
+
+  one = &wmain[nwind];
+
+  if (column->source == WTAB_INDEX)
+  {
+    if (zdom[ndom].coord_type == SPHERICAL)
+    {
+      i = nwind - zdom[ndom].nstart;
+      j = 0;
+    }
+    else
+    {
+      wind_n_to_ij (ndom, nwind, &i, &j);
+    }
+    return (column->offset == 0 ? i : j);
+  }
+
+  if (column->source == WTAB_GEOMETRY)
+  {
+    base = (char *) one;
+  }
+  else if (column->source == WTAB_ION)
+  {
+    if (one->inwind < 0)
+      return (0);
+    xplasma = &plasmamain[one->nplasma];
+    if (xplasma->rho <= 0.0)
+      return (0);
+
+    switch (column->ion_switch)
+    {
+    case 0:
+      x = xplasma->density[column->nion] / (rho2nh * xplasma->rho * ele[column->nelem].abun);
+      break;
+    case 1:
+      x = xplasma->density[column->nion];
+      break;
+    case 2:
+      x = (double) xplasma->scatters[column->nion] / xplasma->vol;
+      break;
+    case 3:
+      x = xplasma->xscatters[column->nion];
+      break;
+    case 4:
+      x = xplasma->ioniz[column->nion];
+      break;
+    case 5:
+      x = xplasma->recomb[column->nion];
+      break;
+    case 6:
+      x = xplasma->heat_ion[column->nion];
+      break;
+    case 7:
+      x = xplasma->cool_rr_ion[column->nion];
+      break;
+    case 8:
+      x = xplasma->lum_rr_ion[column->nion];
+      break;
+    default:
+      x = xplasma->cool_dr_ion[column->nion];
+      break;
+    }
+    return (x);
+  }
+  else
+  {
+    if (one->inwind < 0 && !edge)
+      return (0);
+    if (column->source == WTAB_WIND)
+      base = (char *) one;
+    else
+      base = (char *) &plasmamain[one->nplasma];
+  }
+
+  if (column->type == WTAB_INT)
+    return (*(int *) (base + column->offset));
+
+  return (*(double *) (base + column->offset));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      fill the values of a set of columns for a range of cells
+ *
+ * @param [in] int  ndom   The domain
+ * @param [in] WindTableColumnPtr  columns   The columns
+ * @param [in] int  ncols   The number of columns
+ * @param [in] int  edge   If TRUE, report the variables of cells which are not in the wind
+ * @param [in] int  nfirst   The first cell, counted from the start of the domain
+ * @param [in] int  nlast   One more than the last cell
+ * @param [out] double **  values   values[n][i] is the value of column n in cell nfirst + i
+ * @return     Always returns 0
+ *
+ * @details
+ * The cells are shared between the threads given by modes.nthreads.
+ *
+ **********************************************************/
+
+int
+fill_table_columns (int ndom, WindTableColumnPtr columns, int ncols, int edge, int nfirst, int nlast, double **values)
+{
+  int n, i;
+  int nstart;
+
+  nstart = zdom[ndom].nstart;
+
+  OMP_PRAGMA (omp parallel for num_threads (modes.nthreads) schedule (static) private (n))
+  for (i = nfirst; i < nlast; i++)
+  {
+    for (n = 0; n < ncols; n++)
+      values[n][i - nfirst] = table_column_value (ndom, &columns[n], nstart + i, edge);
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      add a column to a list of columns
+ *
+ * @param [in, out] WindTableColumnPtr *  columns   The list, which is extended as needed
+ * @param [in, out] int *  ncols   The number of columns in the list
+ * @param [in, out] int *  nalloc   The number of columns for which space has been allocated
+ * @param [in] WindTableColumnPtr  column   The new column
+ * @return     The number of columns in the list
+ *
+ **********************************************************/
+
+static int
+add_table_column (WindTableColumnPtr * columns, int *ncols, int *nalloc, WindTableColumnPtr column)
+{
+  if (*ncols == *nalloc)
+  {
+    *nalloc = *nalloc > 0 ? 2 * *nalloc : 64;
+    *columns = realloc (*columns, *nalloc * sizeof (WindTableColumn));
+    if (*columns == NULL)
+    {
+      Error ("add_table_column: Unable to allocate memory for %d columns\n", *nalloc);
+      Exit (1);
+    }
+  }
+
+  (*columns)[(*ncols)++] = *column;
+
+  return (*ncols);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      resolve a list of columns
+ *
+ * @param [in] char *  list   The names of the columns, separated by commas or
+ * white space, or @filename to read the names from a file
+ * @param [in] int  ion_switch   The quantity returned for ions, unless it is
+ * given in the name
+ * @param [out] WindTableColumnPtr *  columns   The columns, which are allocated here
+ * @return     The number of columns, or -1 if a name is not recognised
+ *
+ * @details
+ * In addition to the names accepted by resolve_table_column, an element
+ * symbol followed by *, e.g. c*, selects all of the ions of that element,
+ * ions selects all of the ions in the atomic data, and all selects all
+ * of the variables in table_variables.  The i, j and inwind columns
+ * and the positions of the cells are always written, so are not added
+ * to the list here.
+ *
+ * In a file, anything following a # on a line is ignored.
+ *
+ **********************************************************/
+
+int
+parse_table_columns (char *list, int ion_switch, WindTableColumnPtr * columns)
+{
+  WindTableColumn column;
+  FILE *fptr;
+  char *names, *word, *rest, *quantity, *saveptr;
+  char line[LINELENGTH];
+  int ncols, nalloc, n, nelem, nion, len;
+
+  if (list[0] == '@')
+  {
+    if ((fptr = fopen (&list[1], "r")) == NULL)
+    {
+      Error ("parse_table_columns: Could not open %s\n", &list[1]);
+      return (-1);
+    }
+    names = calloc (1, 1);
+    len = 0;
+    while (fgets (line, LINELENGTH, fptr) != NULL)
+    {
+      if ((rest = strchr (line, '#')) != NULL)
+        *rest = '\0';
+      len += strlen (line) + 1;
+      names = realloc (names, len + 1);
+      strcat (names, line);
+      strcat (names, " ");
+    }
+    fclose (fptr);
+  }
+  else
+  {
+    names = strdup (list);
+  }
+
+  *columns = NULL;
+  ncols = nalloc = 0;
+
+  for (word = strtok_r (names, ", \t\n", &saveptr); word != NULL; word = strtok_r (NULL, ", \t\n", &saveptr))
+  {
+    if (strcmp (word, "all") == 0)
+    {
+      for (n = 0; n < NTABLE_VARIABLES; n++)
+      {
+        if (table_variables[n].source != WTAB_GEOMETRY && table_variables[n].source != WTAB_INDEX)
+        {
+          resolve_table_column (table_variables[n].name, ion_switch, &column);
+          add_table_column (columns, &ncols, &nalloc, &column);
+        }
+      }
+    }
+    else if (strcmp (word, "ions") == 0)
+    {
+      for (nion = 0; nion < nions; nion++)
+      {
+        ion_table_column (nion, ion_switch, &column);
+        add_table_column (columns, &ncols, &nalloc, &column);
+      }
+    }
+    else if ((nelem = table_element (word, &rest)) >= 0 && *rest == '*')
+    {
+      n = ion_switch;
+      quantity = rest + 1;
+      if (*quantity == ':')
+      {
+        for (n = 0; n < NION_QUANTITIES; n++)
+          if (strcmp (quantity + 1, ion_quantities[n]) == 0)
+            break;
+      }
+      if (ion_table_quantity (n) == NULL || (*quantity != ':' && *quantity != '\0'))
+      {
+        Error ("parse_table_columns: Unknown column %s\n", word);
+        free (names);
+        return (-1);
+      }
+      for (nion = ele[nelem].firstion; nion < ele[nelem].firstion + ele[nelem].nions; nion++)
+      {
+        ion_table_column (nion, n, &column);
+        add_table_column (columns, &ncols, &nalloc, &column);
+      }
+    }
+    else if (resolve_table_column (word, ion_switch, &column) == 0)
+    {
+      if (column.source != WTAB_GEOMETRY && column.source != WTAB_INDEX)
+        add_table_column (columns, &ncols, &nalloc, &column);
+    }
+    else
+    {
+      Error ("parse_table_columns: Unknown column %s\n", word);
+      free (names);
+      return (-1);
+    }
+  }
+
+  free (names);
+
+  return (ncols);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      write an ascii table of a set of columns
+ *
+ * @param [in] int  ndom   The domain
+ * @param [in] char *  filename   The name of the file
+ * @param [in] WindTableColumnPtr  columns   The columns
+ * @param [in] int  ncols   The number of columns
+ * @param [in] int  edge   If TRUE, report the variables of cells which are not in the wind
+ * @return     0 on success, -1 if the file could not be written
+ *
+ * @details
+ * The rows are filled and formatted WTAB_BLOCK at a time, in parallel,
+ * and then written in order, so the whole table is never held in memory.
+ * Each column is at least 9 characters wide, or the length of its name.
+ *
+ **********************************************************/
+
+static int
+write_table_ascii (int ndom, char *filename, WindTableColumnPtr columns, int ncols, int edge)
+{
+  FILE *fptr;
+  double **values;
+  char *buffer;
+  int *width, *length;
+  int n, i, nfirst, nlast, ndim2, rowlen;
+
+  if ((fptr = fopen (filename, "w")) == NULL)
+  {
+    Error ("write_table_ascii: Could not open %s\n", filename);
+    return (-1);
+  }
+
+  ndim2 = zdom[ndom].ndim2;
+
+  width = calloc (ncols, sizeof (int));
+  values = calloc (ncols, sizeof (double *));
+  rowlen = 2;
+  for (n = 0; n < ncols; n++)
+  {
+    width[n] = strlen (columns[n].name) > 9 ? strlen (columns[n].name) : 9;
+    rowlen += width[n] + 1;
+    values[n] = calloc (WTAB_BLOCK, sizeof (double));
+  }
+  buffer = malloc ((size_t) WTAB_BLOCK * rowlen);
+  length = calloc (WTAB_BLOCK, sizeof (int));
+
+  for (n = 0; n < ncols; n++)
+    fprintf (fptr, "%*s ", width[n], columns[n].name);
+  fprintf (fptr, "\n");
+
+  for (nfirst = 0; nfirst < ndim2; nfirst += WTAB_BLOCK)
+  {
+    nlast = nfirst + WTAB_BLOCK < ndim2 ? nfirst + WTAB_BLOCK : ndim2;
+
+    fill_table_columns (ndom, columns, ncols, edge, nfirst, nlast, values);
+
+    OMP_PRAGMA (omp parallel for num_threads (modes.nthreads) schedule (static) private (n))
+    for (i = 0; i < nlast - nfirst; i++)
+    {
+      char *row = &buffer[(size_t) i * rowlen];
+      int len = 0;
+
+      for (n = 0; n < ncols; n++)
+      {
+        if (columns[n].type == WTAB_INT)
+          len += snprintf (row + len, rowlen - len, "%*d ", width[n], (int) values[n][i]);
+        else
+          len += snprintf (row + len, rowlen - len, "%*.2e ", width[n], values[n][i]);
+        if (len >= rowlen - 1)
+          len = rowlen - 2;
+      }
+      row[len++] = '\n';
+      length[i] = len;
+    }
+
+    for (i = 0; i < nlast - nfirst; i++)
+      fwrite (&buffer[(size_t) i * rowlen], 1, length[i], fptr);
+  }
+
+  for (n = 0; n < ncols; n++)
+    free (values[n]);
+  free (values);
+  free (width);
+  free (length);
+  free (buffer);
+
+  return (fclose (fptr) == 0 ? 0 : -1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      write a binary table of a set of columns
+ *
+ * @param [in] int  ndom   The domain
+ * @param [in] char *  filename   The name of the file
+ * @param [in] WindTableColumnPtr  columns   The columns
+ * @param [in] int  ncols   The number of columns
+ * @param [in] int  edge   If TRUE, report the variables of cells which are not in the wind
+ * @return     0 on success, -1 if the file could not be written
+ *
+ * @details
+ * Each column is filled in parallel and written in turn, see the
+ * description of the format at the top of this file.
+ *
+ **********************************************************/
+
+static int
+write_table_binary (int ndom, char *filename, WindTableColumnPtr columns, int ncols, int edge)
+{
+  FILE *fptr;
+  struct wind_table_header header;
+  char name[WTAB_NAMELEN];
+  double *values;
+  int n, ndim2, nerr;
+
+  if ((fptr = fopen (filename, "wb")) == NULL)
+  {
+    Error ("write_table_binary: Could not open %s\n", filename);
+    return (-1);
+  }
+
+  ndim2 = zdom[ndom].ndim2;
+
+  memset (&header, 0, sizeof header);
+  strcpy (header.magic, WTAB_MAGIC);
+  header.format = WTAB_FORMAT;
+  header.byte_order = WINDSAVE_BYTE_ORDER;
+  header.ndom = ndom;
+  header.coord_type = zdom[ndom].coord_type;
+  header.ndim = zdom[ndom].ndim;
+  header.mdim = zdom[ndom].mdim;
+  header.ncells = ndim2;
+  header.ncols = ncols;
+
+  nerr = 0;
+  if (fwrite (&header, sizeof header, 1, fptr) != 1)
+    nerr++;
+
+  for (n = 0; n < ncols; n++)
+  {
+    memset (name, 0, WTAB_NAMELEN);
+    strncpy (name, columns[n].name, WTAB_NAMELEN - 1);
+    if (fwrite (name, WTAB_NAMELEN, 1, fptr) != 1)
+      nerr++;
+  }
+
+  values = calloc (ndim2, sizeof (double));
+  for (n = 0; n < ncols; n++)
+  {
+    fill_table_columns (ndom, &columns[n], 1, edge, 0, ndim2, &values);
+    if (fwrite (values, sizeof (double), ndim2, fptr) != (size_t) ndim2)
+      nerr++;
+  }
+  free (values);
+
+  if (fclose (fptr) != 0)
+    nerr++;
+
+  if (nerr)
+  {
+    Error ("write_table_binary: Failed to write %s\n", filename);
+    return (-1);
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      write a table of selected columns for each domain
+ *
+ * @param [in] char *  root   The rootname of the windsave file
+ * @param [in] char *  list   The columns, see parse_table_columns
+ * @param [in] int  ion_switch   The quantity returned for ions, unless it is
+ * given in the name of a column
+ * @param [in] int  edge   If TRUE, report the variables of cells which are not in the wind
+ * @param [in] int  ascii   If TRUE, write rootname.table.txt
+ * @param [in] int  binary   If TRUE, write rootname.table.bin
+ * @return     0 on success, -1 if the list could not be resolved or a
+ * file could not be written
+ *
+ * @details
+ * The table begins with the position of each cell, its i and j indices
+ * and inwind, as the other tables do, followed by the selected columns.
+ * As for the other tables, the domain number is added to rootname if
+ * there is more than one domain.
+ *
+ **********************************************************/
+
+int
+do_windsave2table_columns (char *root, char *list, int ion_switch, int edge, int ascii, int binary)
+{
+  WindTableColumnPtr selected, columns;
+  char rootname[LINELENGTH], filename[LINELENGTH + 20];
+  char *spherical[] = { "r", "rcen", "i", "inwind" };
+  char *cylindrical[] = { "x", "z", "xcen", "zcen", "i", "j", "inwind" };
+  char **position;
+  int nselected, nposition, ncols, n, ndom, status;
+
+  if (ion_table_quantity (ion_switch) == NULL)
+    ion_switch = 0;
+
+  if ((nselected = parse_table_columns (list, ion_switch, &selected)) < 0)
+    return (-1);
+
+  status = 0;
+
+  for (ndom = 0; ndom < geo.ndomain; ndom++)
+  {
+    if (geo.ndomain > 1)
+      sprintf (rootname, "%.380s.%d", root, ndom);
+    else
+      sprintf (rootname, "%.380s", root);
+
+    if (zdom[ndom].coord_type == SPHERICAL)
+    {
+      position = spherical;
+      nposition = 4;
+    }
+    else
+    {
+      position = cylindrical;
+      nposition = 7;
+    }
+
+    columns = calloc (nposition + nselected, sizeof (WindTableColumn));
+    for (n = 0; n < nposition; n++)
+      resolve_table_column (position[n], ion_switch, &columns[n]);
+    for (n = 0; n < nselected; n++)
+      columns[nposition + n] = selected[n];
+    ncols = nposition + nselected;
+
+    if (ascii)
+    {
+      sprintf (filename, "%s.table.txt", rootname);
+      if (write_table_ascii (ndom, filename, columns, ncols, edge))
+        status = -1;
+    }
+
+    if (binary)
+    {
+      sprintf (filename, "%s.table.bin", rootname);
+      if (write_table_binary (ndom, filename, columns, ncols, edge))
+        status = -1;
+    }
+
+    Log ("Wrote %d columns for %d cells of domain %d\n", ncols, zdom[ndom].ndim2, ndom);
+
+    free (columns);
+  }
+
+  free (selected);
+
+  return (status);
+}
@@ -1162,12 +1162,15 @@ create_ion_table (ndom, rootname, iz, ion_switch)
  * @param [in] int  element   the element number
  * @param [in] int  istate   the ionization state
  * @param [in] int  iswitch   a switch controlling exactly what is returned for that ion
+ * @param [out] char *  name   The name of the quantity returned, e.g. frac or den
  * @return     Normally returns an array with values associated with what is requested
  *    	This will return an array with all zeros if there is no such ion
  *
  * @details
  *
  * ### Notes ###
+ * The quantities which can be returned are listed in ion_quantities
+ * in windsave2table_columns.c
  *
  **********************************************************/
 
@@ -1176,15 +1179,12 @@ get_ion (ndom, element, istate, iswitch, name)
      int ndom, element, istate, iswitch;
      char *name;
 {
-  int nion, nelem;
-  int n;
-  int nplasma;
+  int nion;
   double *x;
-  int nstart, ndim2;
-  double nh;
+  int ndim2;
+  WindTableColumn column;
 
 
-  nstart = zdom[ndom].nstart;
   ndim2 = zdom[ndom].ndim2;
 
   x = (double *) calloc (sizeof (double), ndim2);
@@ -1199,78 +1199,17 @@ get_ion (ndom, element, istate, iswitch, name)
     Log ("Error--element %d ion %d not found in define_wind\n", element, istate);
     return (x);
   }
-  nelem = 0;
-  while (nelem < nelements && ele[nelem].z != element)
-    nelem++;
 
+  if (ion_table_column (nion, iswitch, &column))
+  {
+    Error ("get_ion : Unknown switch %d \n", iswitch);
+    exit (0);
+  }
+  strcpy (name, ion_table_quantity (iswitch));
 
   /* Now populate the array */
 
-  for (n = 0; n < ndim2; n++)
-  {
-    x[n] = 0;
-    nplasma = wmain[nstart + n].nplasma;
-    if (wmain[nstart + n].inwind >= 0 && plasmamain[nplasma].rho > 0.0)
-    {
-      if (iswitch == 0)
-      {
-        x[n] = plasmamain[nplasma].density[nion];
-        nh = rho2nh * plasmamain[nplasma].rho;
-        x[n] /= (nh * ele[nelem].abun);
-        strcpy (name, "frac");
-      }
-      else if (iswitch == 1)
-      {
-        x[n] = plasmamain[nplasma].density[nion];
-        strcpy (name, "den");
-      }
-      else if (iswitch == 2)
-      {
-        x[n] = (double) plasmamain[nplasma].scatters[nion] / plasmamain[nplasma].vol;
-        strcpy (name, "scat");
-      }
-      else if (iswitch == 3)
-      {
-        x[n] = plasmamain[nplasma].xscatters[nion];
-        strcpy (name, "ion_frac");
-      }
-      else if (iswitch == 4)
-      {
-        x[n] = plasmamain[nplasma].ioniz[nion];
-        strcpy (name, "ioniz");
-      }
-      else if (iswitch == 5)
-      {
-        x[n] = plasmamain[nplasma].recomb[nion];
-        strcpy (name, "recomb");
-      }
-      else if (iswitch == 6)
-      {
-        x[n] = plasmamain[nplasma].heat_ion[nion];
-        strcpy (name, "heat");
-      }
-      else if (iswitch == 7)
-      {
-        x[n] = plasmamain[nplasma].cool_rr_ion[nion];
-        strcpy (name, "cool_rr");
-      }
-      else if (iswitch == 8)
-      {
-        x[n] = plasmamain[nplasma].lum_rr_ion[nion];
-        strcpy (name, "lum_rr");
-      }
-      else if (iswitch == 9)
-      {
-        x[n] = plasmamain[nplasma].cool_dr_ion[nion];
-        strcpy (name, "cool_dr");
-      }
-      else
-      {
-        Error ("get_ion : Unknown switch %d \n", iswitch);
-        exit (0);
-      }
-    }
-  }
+  fill_table_columns (ndom, &column, 1, FALSE, 0, ndim2, &x);
 
   return (x);
 }
@@ -1291,15 +1230,16 @@ get_ion (ndom, element, istate, iswitch, name)
  *
  * A simple variable is a variable that is just a number, not an array
  *
- * The routine performes a simple tranlation of the character name
- * to a variable in the PlasmaPtr.
+ * The name is resolved once, by resolve_table_column, to the position
+ * of the variable in the wind or plasma structure, and the values are
+ * then filled for all of the cells.
  *
  * ### Notes ###
  * Normally returns non-zero values only if a cell is in the wind
  * but this can be changed if external variable xedge is TRUE.
  *
  * Only selected variables are returned, but new variables are easy
- * to add using the template of the other variables
+ * to add to table_variables in windsave2table_columns.c
  *
  **********************************************************/
 
@@ -1308,264 +1248,22 @@ get_one (ndom, variable_name)
      int ndom;
      char variable_name[];
 {
-  int n;
-  int nplasma;
   double *x;
   int ndim2;
-  int nstart;
+  WindTableColumn column;
 
-  nstart = zdom[ndom].nstart;
   ndim2 = zdom[ndom].ndim2;
 
   x = (double *) calloc (sizeof (double), ndim2);
 
-  for (n = 0; n < ndim2; n++)
+  if (resolve_table_column (variable_name, 0, &column) || column.nion >= 0)
   {
-    x[n] = 0;
-    if (wmain[n + nstart].inwind >= 0 || xedge)
-    {
-      nplasma = wmain[n + nstart].nplasma;
-
-
-      if (strcmp (variable_name, "ne") == 0)
-      {
-        x[n] = plasmamain[nplasma].ne;
-      }
-      else if (strcmp (variable_name, "rho") == 0)
-      {
-        x[n] = plasmamain[nplasma].rho;
-      }
-      else if (strcmp (variable_name, "vol") == 0)
-      {
-        x[n] = plasmamain[nplasma].vol;
-      }
-      else if (strcmp (variable_name, "t_e") == 0)
-      {
-        x[n] = plasmamain[nplasma].t_e;
-      }
-      else if (strcmp (variable_name, "t_r") == 0)
-      {
-        x[n] = plasmamain[nplasma].t_r;
-      }
-      else if (strcmp (variable_name, "t_e_old") == 0)
-      {
-        x[n] = plasmamain[nplasma].t_e_old;
-      }
-      else if (strcmp (variable_name, "t_r_old") == 0)
-      {
-        x[n] = plasmamain[nplasma].t_r_old;
-      }
-      else if (strcmp (variable_name, "dt_e") == 0)
-      {
-        x[n] = plasmamain[nplasma].dt_e;
-      }
-      else if (strcmp (variable_name, "dt_e_old") == 0)
-      {
-        x[n] = plasmamain[nplasma].dt_e_old;
-      }
-      else if (strcmp (variable_name, "J") == 0)
-      {
-        x[n] = plasmamain[nplasma].j;
-      }
-      else if (strcmp (variable_name, "J_direct") == 0)
-      {
-        x[n] = plasmamain[nplasma].j_direct;
-      }
-      else if (strcmp (variable_name, "J_scatt") == 0)
-      {
-        x[n] = plasmamain[nplasma].j_scatt;
-      }
-      else if (strcmp (variable_name, "ave_freq") == 0)
-      {
-        x[n] = plasmamain[nplasma].ave_freq;
-      }
-      else if (strcmp (variable_name, "converge") == 0)
-      {
-        x[n] = plasmamain[nplasma].converge_whole;
-      }
-      else if (strcmp (variable_name, "dmo_dt_x") == 0)
-      {
-        x[n] = plasmamain[nplasma].dmo_dt[0];
-      }
-      else if (strcmp (variable_name, "dmo_dt_y") == 0)
-      {
-        x[n] = plasmamain[nplasma].dmo_dt[1];
-      }
-      else if (strcmp (variable_name, "dmo_dt_z") == 0)
-      {
-        x[n] = plasmamain[nplasma].dmo_dt[2];
-      }
-      else if (strcmp (variable_name, "ntot") == 0)
-      {
-        x[n] = plasmamain[nplasma].ntot;
-      }
-      else if (strcmp (variable_name, "ip") == 0)
-      {
-        x[n] = plasmamain[nplasma].ip;
-      }
-      else if (strcmp (variable_name, "xi") == 0)
-      {
-        x[n] = plasmamain[nplasma].xi;
-      }
-      else if (strcmp (variable_name, "heat_tot") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_tot;
-      }
-      else if (strcmp (variable_name, "heat_tot_old") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_tot_old;
-      }
-      else if (strcmp (variable_name, "heat_comp") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_comp;
-      }
-      else if (strcmp (variable_name, "heat_lines") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_lines;
-      }
-      else if (strcmp (variable_name, "heat_ff") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_ff;
-      }
-      else if (strcmp (variable_name, "heat_photo") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_photo;
-      }
-      else if (strcmp (variable_name, "heat_auger") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_auger;
-      }
-      else if (strcmp (variable_name, "cool_comp") == 0)
-      {
-        x[n] = plasmamain[nplasma].cool_comp;
-      }
-      else if (strcmp (variable_name, "lum_tot") == 0)
-      {
-        x[n] = plasmamain[nplasma].lum_tot;
-      }
-      else if (strcmp (variable_name, "lum_lines") == 0)
-      {
-        x[n] = plasmamain[nplasma].lum_lines;
-      }
-      else if (strcmp (variable_name, "lum_ff") == 0)
-      {
-        x[n] = plasmamain[nplasma].lum_ff;
-      }
-      else if (strcmp (variable_name, "lum_rr") == 0)
-      {
-        x[n] = plasmamain[nplasma].lum_rr;
-      }
-      else if (strcmp (variable_name, "cool_rr") == 0)
-      {
-        x[n] = plasmamain[nplasma].cool_rr;
-      }
-      else if (strcmp (variable_name, "cool_dr") == 0)
-      {
-        x[n] = plasmamain[nplasma].cool_dr;
-      }
-      else if (strcmp (variable_name, "cool_tot") == 0)
-      {
-        x[n] = plasmamain[nplasma].cool_tot;
-      }
-      else if (strcmp (variable_name, "w") == 0)
-      {
-        x[n] = plasmamain[nplasma].w;
-      }
-      else if (strcmp (variable_name, "nrad") == 0)
-      {
-        x[n] = plasmamain[nplasma].nrad;
-      }
-      else if (strcmp (variable_name, "nioniz") == 0)
-      {
-        x[n] = plasmamain[nplasma].nioniz;
-      }
-      else if (strcmp (variable_name, "heat_shock") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_shock;
-      }
-      else if (strcmp (variable_name, "cool_adiab") == 0)
-      {
-        x[n] = plasmamain[nplasma].cool_adiabatic;
-      }
-      else if (strcmp (variable_name, "heat_lines_macro") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_lines_macro;
-      }
-      else if (strcmp (variable_name, "heat_photo_macro") == 0)
-      {
-        x[n] = plasmamain[nplasma].heat_photo_macro;
-      }
-      else if (strcmp (variable_name, "gain") == 0)
-      {
-        x[n] = plasmamain[nplasma].gain;
-      }
-      else if (strcmp (variable_name, "macro_bf_in") == 0)
-      {
-        x[n] = plasmamain[nplasma].bf_simple_ionpool_in;
-      }
-      else if (strcmp (variable_name, "macro_bf_out") == 0)
-      {
-        x[n] = plasmamain[nplasma].bf_simple_ionpool_out;
-      }
-      else if (strcmp (variable_name, "dv_x_dx") == 0)
-      {
-        x[n] = wmain[n].v_grad[0][0];
-      }
-      else if (strcmp (variable_name, "dv_x_dy") == 0)
-      {
-        x[n] = wmain[n].v_grad[0][1];
-      }
-      else if (strcmp (variable_name, "dv_x_dz") == 0)
-      {
-        x[n] = wmain[n].v_grad[0][2];
-      }
-      else if (strcmp (variable_name, "dv_y_dx") == 0)
-      {
-        x[n] = wmain[n].v_grad[1][0];
-      }
-      else if (strcmp (variable_name, "dv_y_dy") == 0)
-      {
-        x[n] = wmain[n].v_grad[1][1];
-      }
-      else if (strcmp (variable_name, "dv_y_dz") == 0)
-      {
-        x[n] = wmain[n].v_grad[1][2];
-      }
-      else if (strcmp (variable_name, "dv_z_dx") == 0)
-      {
-        x[n] = wmain[n].v_grad[2][0];
-      }
-      else if (strcmp (variable_name, "dv_z_dy") == 0)
-      {
-        x[n] = wmain[n].v_grad[2][1];
-      }
-      else if (strcmp (variable_name, "dv_z_dz") == 0)
-      {
-        x[n] = wmain[n].v_grad[2][2];
-      }
-      else if (strcmp (variable_name, "dvds_max") == 0)
-      {
-        x[n] = wmain[n].dvds_max;
-      }
-      else if (strcmp (variable_name, "div_v") == 0)
-      {
-        x[n] = wmain[n].div_v;
-      }
-      else if (strcmp (variable_name, "gamma") == 0)
-      {
-        x[n] = wmain[n].xgamma;
-      }
-      else if (strcmp (variable_name, "dfudge") == 0)
-      {
-        x[n] = wmain[n].dfudge;
-      }
-      else
-      {
-        Error ("get_one: Unknown variable %s\n", variable_name);
-      }
-    }
+    Error ("get_one: Unknown variable %s\n", variable_name);
+    return (x);
   }
 
+  fill_table_columns (ndom, &column, 1, xedge, 0, ndim2, &x);
+
   return (x);
 
 }
@@ -0,0 +1,891 @@
+/***********************************************************/
+/** @file  windsave_file.c
+ * @author ksl
+ * @date   October, 2026
+ *
+ * @brief  Low level routines to write and read windsave files which
+ * are divided into named sections
+ *
+ * A windsave file consists of a header, a series of sections, each of
+ * which contains a single array, and an index which gives the name,
+ * position and size of each section.  The variable length arrays of
+ * the plasma and macro-atom structures are stored as one section per
+ * array, with the values for all of the cells stored contiguously, so
+ * that a program which needs only some of the arrays, or only some of
+ * the cells, can read just those.
+ *
+ * Files are read by mapping them into memory, so that only the
+ * parts of the file which are actually used are read from disk.
+ * If sirocco has been compiled with zlib (make ZLIB=yes), the
+ * sections can be compressed.  Compressed sections are divided into
+ * chunks of WINDSAVE_CHUNK bytes which are compressed separately, so
+ * that part of a section can be read without uncompressing all of it.
+ *
+ * A file can be assembled in memory and then written by a helper thread,
+ * so that the program can continue while the file is written.  Files
+ * are always written to a temporary file which is renamed once it is
+ * complete, so that an existing file is never left half written.
+ *
+ * ### Notes ###
+ *
+ * The header records the byte order and the sizes of the basic types
+ * and of the structures which are written as a whole, and the file is
+ * only read if these agree with those of the program reading it.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef ZLIB_ON
+#include <zlib.h>
+#endif
+
+#include "atomic.h"
+#include "sirocco.h"
+
+static pthread_t windsave_thread;       /* The helper thread writing a file */
+static int windsave_thread_active = FALSE;
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record the sizes of the basic types and structures that are
+ * written to a windsave file
+ *
+ * @param [out] int  sizes[]   The sizes
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+windsave_sizes (int sizes[])
+{
+  sizes[0] = sizeof (int);
+  sizes[1] = sizeof (double);
+  sizes[2] = sizeof (long long);
+  sizes[3] = sizeof (geo);
+  sizes[4] = sizeof (domain_dummy);
+  sizes[5] = sizeof (wind_dummy);
+  sizes[6] = sizeof (plasma_dummy);
+  sizes[7] = sizeof (macro_dummy);
+  sizes[8] = sizeof (disk);
+  sizes[9] = sizeof (void *);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Start a new windsave file
+ *
+ * @param [in] char *  filename   The name of the file
+ * @param [in] int  compress   If TRUE, compress the sections of the file
+ * @param [in] int  async   If TRUE, the file is assembled in memory and
+ * written by a helper thread when windsave_finish is called
+ * @return     A pointer to the description of the file
+ *
+ * @details
+ * If the file is not to be written asynchronously, the temporary file is
+ * opened at once and each section is written as it is added.
+ *
+ **********************************************************/
+
+WindsaveFilePtr
+windsave_create (char *filename, int compress, int async)
+{
+  WindsaveFilePtr ws;
+
+  if ((ws = calloc (1, sizeof (windsave_file_dummy))) == NULL)
+  {
+    Error ("windsave_create: Unable to allocate memory to write %s\n", filename);
+    Exit (EXIT_FAILURE);
+  }
+
+  strncpy (ws->filename, filename, LINELENGTH - 1);
+  snprintf (ws->tmpname, LINELENGTH, "%.*s.tmp", LINELENGTH - 5, filename);
+
+#ifndef ZLIB_ON
+  if (compress)
+  {
+    Error ("windsave_create: sirocco was not compiled with zlib (make ZLIB=yes), so %s will not be compressed\n", filename);
+    compress = FALSE;
+  }
+#endif
+
+  strcpy (ws->header.magic, WINDSAVE_MAGIC);
+  ws->header.format = WINDSAVE_FORMAT;
+  ws->header.byte_order = WINDSAVE_BYTE_ORDER;
+  strncpy (ws->header.version, VERSION, LINELENGTH - 1);
+  windsave_sizes (ws->header.sizes);
+  ws->compress = compress;
+  ws->async = async;
+
+  if (!async)
+  {
+    if ((ws->fptr = fopen (ws->tmpname, "w")) == NULL)
+    {
+      Error ("windsave_create: Unable to open %s\n", ws->tmpname);
+      Exit (EXIT_FAILURE);
+    }
+    ws->nerr += fwrite (&ws->header, sizeof (ws->header), 1, ws->fptr) != 1;
+    ws->offset = sizeof (ws->header);
+  }
+
+  return (ws);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write one section to the temporary file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] int  i   The section
+ * @param [in] char *  data   The contents of the section
+ * @return     Nothing
+ *
+ * @details
+ * Each section starts on an 8 byte boundary, so that the arrays
+ * in the file are aligned when it is mapped into memory.  A compressed
+ * section begins with the compressed size of each chunk.
+ *
+ **********************************************************/
+
+static void
+windsave_write_section (WindsaveFilePtr ws, int i, char *data)
+{
+  WindsaveSectionPtr s;
+  char zero[8] = { 0 };
+  int npad;
+#ifdef ZLIB_ON
+  long long *csize;
+  int nchunks, k;
+  uLongf nout;
+  uLong nin;
+  Bytef *out;
+#endif
+
+  s = &ws->section[i];
+
+  npad = (8 - ws->offset % 8) % 8;
+  ws->nerr += fwrite (zero, 1, npad, ws->fptr) != (size_t) npad;
+  ws->offset += npad;
+  s->offset = ws->offset;
+
+  if (!s->compressed)
+  {
+    ws->nerr += fwrite (data, 1, s->nbytes, ws->fptr) != (size_t) s->nbytes;
+    s->nstored = s->nbytes;
+  }
+#ifdef ZLIB_ON
+  else
+  {
+    nchunks = (s->nbytes + WINDSAVE_CHUNK - 1) / WINDSAVE_CHUNK;
+    csize = calloc (nchunks + 1, sizeof (long long));
+    out = malloc (compressBound (WINDSAVE_CHUNK));
+    if (csize == NULL || out == NULL)
+    {
+      Error ("windsave_write_section: Unable to allocate memory to compress %s\n", s->name);
+      Exit (EXIT_FAILURE);
+    }
+
+    /* Reserve space for the sizes of the chunks, which are filled in once they are known */
+
+    ws->nerr += fwrite (csize, sizeof (long long), nchunks, ws->fptr) != (size_t) nchunks;
+    s->nstored = nchunks * sizeof (long long);
+
+    for (k = 0; k < nchunks; k++)
+    {
+      nin = (k < nchunks - 1) ? WINDSAVE_CHUNK : s->nbytes - (long long) k *WINDSAVE_CHUNK;
+      nout = compressBound (WINDSAVE_CHUNK);
+      if (compress2 (out, &nout, (Bytef *) data + (long long) k * WINDSAVE_CHUNK, nin, Z_BEST_SPEED) != Z_OK)
+      {
+        Error ("windsave_write_section: Unable to compress chunk %d of %s\n", k, s->name);
+        ws->nerr++;
+      }
+      ws->nerr += fwrite (out, 1, nout, ws->fptr) != nout;
+      csize[k] = nout;
+      s->nstored += nout;
+    }
+
+    fseek (ws->fptr, s->offset, SEEK_SET);
+    ws->nerr += fwrite (csize, sizeof (long long), nchunks, ws->fptr) != (size_t) nchunks;
+    fseek (ws->fptr, 0, SEEK_END);
+
+    free (out);
+    free (csize);
+  }
+#endif
+
+  ws->offset += s->nstored;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Open the temporary file and write the sections which are held in memory
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @return     Nothing
+ *
+ **********************************************************/
+
+static void
+windsave_spill (WindsaveFilePtr ws)
+{
+  int i;
+
+  if ((ws->fptr = fopen (ws->tmpname, "w")) == NULL)
+  {
+    Error ("windsave_spill: Unable to open %s\n", ws->tmpname);
+    ws->nerr++;
+    return;
+  }
+  ws->nerr += fwrite (&ws->header, sizeof (ws->header), 1, ws->fptr) != 1;
+  ws->offset = sizeof (ws->header);
+
+  for (i = 0; i < ws->header.nsections; i++)
+  {
+    windsave_write_section (ws, i, ws->data[i]);
+    free (ws->data[i]);
+    ws->data[i] = NULL;
+  }
+  ws->nbuffered = 0;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add a section to a windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] char *  name   The name of the section
+ * @param [in] char *  data   The array to be written
+ * @param [in] size_t  elsize   The size of one element of the array
+ * @param [in] size_t  count   The number of elements
+ * @param [in] int  owned   TRUE if data was allocated for this section, in which
+ * case it is freed here or once it has been written
+ * @return     Nothing
+ *
+ * @details
+ * If the file is being assembled in memory, data is kept (or copied if it is not
+ * owned) until the file is written.  Should the sections held in memory exceed
+ * WINDSAVE_BUFFER_MAX, the file is instead written as the sections are added.
+ *
+ **********************************************************/
+
+static void
+windsave_add_section (WindsaveFilePtr ws, char *name, char *data, size_t elsize, size_t count, int owned)
+{
+  WindsaveSectionPtr s;
+  char *copy;
+  int i;
+
+  i = ws->header.nsections;
+  if (i == ws->nalloc)
+  {
+    ws->nalloc = 2 * ws->nalloc + 32;
+    ws->section = realloc (ws->section, ws->nalloc * sizeof (windsave_section_dummy));
+    ws->data = realloc (ws->data, ws->nalloc * sizeof (char *));
+    if (ws->section == NULL || ws->data == NULL)
+    {
+      Error ("windsave_add_section: Unable to allocate memory for the index of %s\n", ws->filename);
+      Exit (EXIT_FAILURE);
+    }
+  }
+
+  s = &ws->section[i];
+  memset (s, 0, sizeof (windsave_section_dummy));
+  strncpy (s->name, name, WINDSAVE_NAMELEN - 1);
+  s->elsize = elsize;
+  s->nbytes = (long long) elsize *count;
+  s->compressed = ws->compress && s->nbytes > 0;
+  ws->data[i] = NULL;
+  ws->header.nsections++;
+
+  if (ws->fptr == NULL && ws->async && ws->nbuffered + s->nbytes > WINDSAVE_BUFFER_MAX)
+  {
+    Log_silent ("windsave_add_section: %s is too large to be written in the background\n", ws->filename);
+    windsave_spill (ws);
+  }
+
+  if (ws->fptr != NULL)
+  {
+    windsave_write_section (ws, i, data);
+    if (owned)
+      free (data);
+  }
+  else if (owned)
+  {
+    ws->data[i] = data;
+    ws->nbuffered += s->nbytes;
+  }
+  else
+  {
+    if ((copy = malloc (s->nbytes + 1)) == NULL)
+    {
+      Error ("windsave_add_section: Unable to allocate memory for %s\n", name);
+      Exit (EXIT_FAILURE);
+    }
+    memcpy (copy, data, s->nbytes);
+    ws->data[i] = copy;
+    ws->nbuffered += s->nbytes;
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add an array to a windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] char *  name   The name of the section
+ * @param [in] void *  data   The array
+ * @param [in] size_t  elsize   The size of one element of the array
+ * @param [in] size_t  count   The number of elements
+ * @return     Nothing
+ *
+ **********************************************************/
+
+void
+windsave_add (WindsaveFilePtr ws, char *name, void *data, size_t elsize, size_t count)
+{
+  windsave_add_section (ws, name, (char *) data, elsize, count, FALSE);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add a variable length array which belongs to each cell to a
+ * windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] char *  name   The name of the section
+ * @param [in] void *  cells   The first element of the array of cell structures
+ * @param [in] size_t  stride   The size of one cell structure
+ * @param [in] size_t  offset   The offset of the pointer to the array in the cell structure
+ * @param [in] size_t  elsize   The size of one element of the array
+ * @param [in] size_t  n   The number of elements in the array for each cell
+ * @param [in] int  ncells   The number of cells
+ * @return     Nothing
+ *
+ * @details
+ * The arrays of all the cells are gathered into a single section, in which
+ * the array of cell m starts at element m * n. This is normally called via
+ * the WINDSAVE_ADD_CELLS macro in windsave.c.
+ *
+ **********************************************************/
+
+void
+windsave_add_cells (WindsaveFilePtr ws, char *name, void *cells, size_t stride, size_t offset, size_t elsize, size_t n, int ncells)
+{
+  char *data, *src;
+  int m;
+
+  if ((data = malloc (elsize * n * ncells + 1)) == NULL)
+  {
+    Error ("windsave_add_cells: Unable to allocate memory for %s\n", name);
+    Exit (EXIT_FAILURE);
+  }
+
+  for (m = 0; m < ncells; m++)
+  {
+    src = *(char **) ((char *) cells + m * stride + offset);
+    memcpy (data + m * n * elsize, src, n * elsize);
+  }
+
+  windsave_add_section (ws, name, data, elsize, n * ncells, TRUE);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write whatever remains of a windsave file, and rename it
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file, which is freed
+ * @return     The number of failed writes
+ *
+ **********************************************************/
+
+static int
+windsave_complete (WindsaveFilePtr ws)
+{
+  int nerr, i;
+
+  if (ws->fptr == NULL)
+  {
+    windsave_spill (ws);
+  }
+
+  if (ws->fptr != NULL)
+  {
+    ws->offset += (8 - ws->offset % 8) % 8;
+    fseek (ws->fptr, ws->offset, SEEK_SET);
+    ws->header.index_offset = ws->offset;
+    ws->nerr +=
+      fwrite (ws->section, sizeof (windsave_section_dummy), ws->header.nsections, ws->fptr) != (size_t) ws->header.nsections;
+    fseek (ws->fptr, 0, SEEK_SET);
+    ws->nerr += fwrite (&ws->header, sizeof (ws->header), 1, ws->fptr) != 1;
+    ws->nerr += fclose (ws->fptr) != 0;
+
+    if (ws->nerr == 0 && rename (ws->tmpname, ws->filename))
+    {
+      ws->nerr++;
+    }
+  }
+
+  if (ws->nerr)
+  {
+    Error ("windsave_complete: There were %d errors writing %s\n", ws->nerr, ws->filename);
+  }
+
+  nerr = ws->nerr;
+  for (i = 0; i < ws->header.nsections; i++)
+  {
+    free (ws->data[i]);
+  }
+  free (ws->data);
+  free (ws->section);
+  free (ws);
+
+  return (nerr);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The routine run by the helper thread which writes a windsave file
+ *
+ **********************************************************/
+
+static void *
+windsave_thread_main (void *arg)
+{
+  windsave_complete ((WindsaveFilePtr) arg);
+  return (NULL);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Finish writing a windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file, which is freed
+ * @return     The number of sections in the file
+ *
+ * @details
+ * If the file was created to be written asynchronously, and has been
+ * assembled in memory, a helper thread is started to write it, and the
+ * routine returns at once.  Otherwise the file is completed before
+ * the routine returns.
+ *
+ **********************************************************/
+
+int
+windsave_finish (WindsaveFilePtr ws)
+{
+  int nsections;
+
+  nsections = ws->header.nsections;
+
+  if (ws->async && ws->fptr == NULL)
+  {
+    windsave_wait ();
+    if (pthread_create (&windsave_thread, NULL, windsave_thread_main, ws) == 0)
+    {
+      windsave_thread_active = TRUE;
+      return (nsections);
+    }
+    Error ("windsave_finish: Unable to start a thread to write %s\n", ws->filename);
+  }
+
+  windsave_complete (ws);
+
+  return (nsections);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Wait until any windsave file which is being written by a helper
+ * thread has been completed
+ *
+ * @return     Nothing
+ *
+ * @details
+ * This must be called before the program ends, and before another
+ * file is written.
+ *
+ **********************************************************/
+
+void
+windsave_wait (void)
+{
+  if (windsave_thread_active)
+  {
+    pthread_join (windsave_thread, NULL);
+    windsave_thread_active = FALSE;
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Check whether a file is a windsave file in the sectioned format
+ *
+ * @param [in] char *  filename   The name of the file
+ * @return     TRUE if the file is in the sectioned format, FALSE if it is not,
+ * and -1 if it cannot be opened
+ *
+ **********************************************************/
+
+int
+windsave_is_sectioned (char *filename)
+{
+  FILE *fptr;
+  char magic[16];
+  int result;
+
+  if ((fptr = fopen (filename, "r")) == NULL)
+  {
+    return (-1);
+  }
+
+  result = fread (magic, sizeof (magic), 1, fptr) == 1 && strncmp (magic, WINDSAVE_MAGIC, sizeof (magic)) == 0;
+  fclose (fptr);
+
+  return (result);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Open a windsave file for reading
+ *
+ * @param [in] char *  filename   The name of the file
+ * @return     A pointer to the description of the file, or NULL if it
+ * cannot be opened
+ *
+ * @details
+ * The file is mapped into memory, and the header is checked.  The
+ * program exits if the file was written in a format, or on a machine,
+ * which is incompatible with this program.
+ *
+ **********************************************************/
+
+WindsaveFilePtr
+windsave_open (char *filename)
+{
+  WindsaveFilePtr ws;
+  struct stat file_stat;
+  int fd, i, sizes[NWINDSAVE_SIZES];
+
+  if ((fd = open (filename, O_RDONLY)) < 0)
+  {
+    return (NULL);
+  }
+
+  if ((ws = calloc (1, sizeof (windsave_file_dummy))) == NULL)
+  {
+    Error ("windsave_open: Unable to allocate memory to read %s\n", filename);
+    Exit (EXIT_FAILURE);
+  }
+  strncpy (ws->filename, filename, LINELENGTH - 1);
+  ws->chunk_section = -1;
+
+  if (fstat (fd, &file_stat) || (size_t) file_stat.st_size < sizeof (windsave_header_dummy))
+  {
+    Error ("windsave_open: %s is too short to be a windsave file\n", filename);
+    Exit (EXIT_FAILURE);
+  }
+
+  ws->map_size = file_stat.st_size;
+  ws->map = mmap (NULL, ws->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (ws->map == MAP_FAILED)
+  {
+    Error ("windsave_open: Unable to map %s into memory\n", filename);
+    Exit (EXIT_FAILURE);
+  }
+
+  memcpy (&ws->header, ws->map, sizeof (windsave_header_dummy));
+
+  if (ws->header.byte_order != WINDSAVE_BYTE_ORDER)
+  {
+    Error ("windsave_open: %s was written on a machine with a different byte order\n", filename);
+    Exit (EXIT_FAILURE);
+  }
+  if (ws->header.format > WINDSAVE_FORMAT)
+  {
+    Error ("windsave_open: %s has format %d, but this version of sirocco can only read format %d\n", filename, ws->header.format,
+           WINDSAVE_FORMAT);
+    Exit (EXIT_FAILURE);
+  }
+
+  windsave_sizes (sizes);
+  for (i = 0; i < NWINDSAVE_SIZES; i++)
+  {
+    if (sizes[i] != ws->header.sizes[i])
+    {
+      Error ("windsave_open: %s was written by a version of sirocco (%s) whose structures differ from this one (%s)\n", filename,
+             ws->header.version, VERSION);
+      Error ("windsave_open: size %d is %d bytes in the file and %d bytes in this program\n", i, ws->header.sizes[i], sizes[i]);
+      Exit (EXIT_FAILURE);
+    }
+  }
+
+  if (ws->header.index_offset + (long long) ws->header.nsections * sizeof (windsave_section_dummy) > (long long) ws->map_size)
+  {
+    Error ("windsave_open: %s is incomplete\n", filename);
+    Exit (EXIT_FAILURE);
+  }
+  ws->section = (WindsaveSectionPtr) (ws->map + ws->header.index_offset);
+
+  return (ws);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find a section of a windsave file
+ *
+ * @param [in] WindsaveFilePtr  ws   The file
+ * @param [in] char *  name   The name of the section
+ * @return     The number of the section, or -1 if there is no such section
+ *
+ **********************************************************/
+
+static int
+windsave_find (WindsaveFilePtr ws, char *name)
+{
+  int i;
+
+  for (i = 0; i < ws->header.nsections; i++)
+  {
+    if (strncmp (ws->section[i].name, name, WINDSAVE_NAMELEN) == 0)
+    {
+      return (i);
+    }
+  }
+
+  return (-1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy part of a section of a windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] int  i   The section
+ * @param [out] char *  dest   Where the data is to be copied
+ * @param [in] long long  start   The first byte of the section to copy
+ * @param [in] long long  nbytes   The number of bytes to copy
+ * @return     Nothing
+ *
+ * @details
+ * For a compressed section, only the chunks which contain the bytes
+ * which have been requested are uncompressed.  The last chunk which was
+ * uncompressed is kept, since successive calls usually read neighbouring
+ * parts of a section.
+ *
+ **********************************************************/
+
+static void
+windsave_copy (WindsaveFilePtr ws, int i, char *dest, long long start, long long nbytes)
+{
+  WindsaveSectionPtr s;
+#ifdef ZLIB_ON
+  long long *csize, pos, first, n;
+  int k, kk, nchunks;
+  uLongf nout;
+#endif
+
+  s = &ws->section[i];
+
+  if (!s->compressed)
+  {
+    memcpy (dest, ws->map + s->offset + start, nbytes);
+    return;
+  }
+
+#ifdef ZLIB_ON
+  nchunks = (s->nbytes + WINDSAVE_CHUNK - 1) / WINDSAVE_CHUNK;
+  csize = (long long *) (ws->map + s->offset);
+
+  if (ws->chunk == NULL && (ws->chunk = malloc (WINDSAVE_CHUNK)) == NULL)
+  {
+    Error ("windsave_copy: Unable to allocate memory to uncompress %s\n", s->name);
+    Exit (EXIT_FAILURE);
+  }
+
+  while (nbytes > 0)
+  {
+    k = start / WINDSAVE_CHUNK;
+    if (ws->chunk_section != i || ws->chunk_index != k)
+    {
+      pos = s->offset + nchunks * sizeof (long long);
+      for (kk = 0; kk < k; kk++)
+      {
+        pos += csize[kk];
+      }
+      nout = WINDSAVE_CHUNK;
+      if (uncompress ((Bytef *) ws->chunk, &nout, (Bytef *) ws->map + pos, csize[k]) != Z_OK)
+      {
+        Error ("windsave_copy: Unable to uncompress chunk %d of %s in %s\n", k, s->name, ws->filename);
+        Exit (EXIT_FAILURE);
+      }
+      ws->chunk_section = i;
+      ws->chunk_index = k;
+    }
+
+    first = start - (long long) k *WINDSAVE_CHUNK;
+    n = WINDSAVE_CHUNK - first;
+    if (n > nbytes)
+      n = nbytes;
+    memcpy (dest, ws->chunk + first, n);
+    dest += n;
+    start += n;
+    nbytes -= n;
+  }
+#else
+  Error ("windsave_copy: %s is compressed, but sirocco was not compiled with zlib (make ZLIB=yes)\n", ws->filename);
+  Exit (EXIT_FAILURE);
+#endif
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Read an array from a windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] char *  name   The name of the section
+ * @param [out] void *  dest   The array
+ * @param [in] size_t  elsize   The size of one element of the array
+ * @param [in] size_t  count   The number of elements
+ * @return     The number of elements read, or -1 if there is no such section, which
+ * is reported as an error
+ *
+ * @details
+ * The program exits if the section does not have the expected size.
+ *
+ **********************************************************/
+
+int
+windsave_read (WindsaveFilePtr ws, char *name, void *dest, size_t elsize, size_t count)
+{
+  int i;
+
+  if ((i = windsave_find (ws, name)) < 0)
+  {
+    Error ("windsave_read: There is no section %s in %s\n", name, ws->filename);
+    return (-1);
+  }
+
+  if ((size_t) ws->section[i].elsize != elsize || (size_t) ws->section[i].nbytes != elsize * count)
+  {
+    Error ("windsave_read: section %s of %s has %lld bytes in elements of %d bytes, but %d elements of %d bytes were expected\n",
+           name, ws->filename, ws->section[i].nbytes, ws->section[i].elsize, (int) count, (int) elsize);
+    Exit (EXIT_FAILURE);
+  }
+
+  windsave_copy (ws, i, (char *) dest, 0, ws->section[i].nbytes);
+
+  return (count);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Read the variable length arrays belonging to a range of cells
+ * from a windsave file
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file
+ * @param [in] char *  name   The name of the section
+ * @param [in, out] void *  cells   The first element of the array of cell structures
+ * @param [in] size_t  stride   The size of one cell structure
+ * @param [in] size_t  offset   The offset of the pointer to the array in the cell structure
+ * @param [in] size_t  elsize   The size of one element of the array
+ * @param [in] size_t  n   The number of elements in the array for each cell
+ * @param [in] int  first   The first cell to read
+ * @param [in] int  ncells   The number of cells to read
+ * @return     The number of cells read, or -1 if there is no such section
+ *
+ * @details
+ * This is the counterpart of windsave_add_cells.  The arrays must already
+ * have been allocated.  Only the part of the file which contains the requested
+ * cells is accessed.
+ *
+ **********************************************************/
+
+int
+windsave_read_cells (WindsaveFilePtr ws, char *name, void *cells, size_t stride, size_t offset, size_t elsize, size_t n, int first,
+                     int ncells)
+{
+  int i, m;
+  char *dest;
+
+  if ((i = windsave_find (ws, name)) < 0)
+  {
+    Error ("windsave_read_cells: There is no section %s in %s\n", name, ws->filename);
+    return (-1);
+  }
+
+  if ((size_t) ws->section[i].elsize != elsize || (size_t) ws->section[i].nbytes < (first + ncells) * n * elsize)
+  {
+    Error ("windsave_read_cells: section %s of %s has %lld bytes in elements of %d bytes, too few for %d cells of %d elements of %d bytes\n",
+           name, ws->filename, ws->section[i].nbytes, ws->section[i].elsize, first + ncells, (int) n, (int) elsize);
+    Exit (EXIT_FAILURE);
+  }
+
+  for (m = first; m < first + ncells; m++)
+  {
+    dest = *(char **) ((char *) cells + m * stride + offset);
+    windsave_copy (ws, i, dest, (long long) m * n * elsize, n * elsize);
+  }
+
+  return (ncells);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Close a windsave file which has been read
+ *
+ * @param [in, out] WindsaveFilePtr  ws   The file, which is freed
+ * @return     Nothing
+ *
+ **********************************************************/
+
+void
+windsave_close (WindsaveFilePtr ws)
+{
+  munmap (ws->map, ws->map_size);
+  free (ws->chunk);
+  free (ws);
+}
@@ -92,6 +92,10 @@
 
 #include "log.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #define LINELENGTH 256
 #define NERROR_MAX 500          // Number of different errors that are recorded
 
@@ -127,6 +131,11 @@ FILE *diagptr;
 int init_log = 0;
 int log_verbosity = 5;          // A parameter which can be used to suppress what would normally be logged or printed
 
+#ifdef _OPENMP
+omp_nest_lock_t errorlog_lock;  // Serialises access to errorlog when photons are transported by several threads
+int init_errorlog_lock = 0;
+#endif
+
 
 /**********************************************************/
 /** 
@@ -154,6 +163,14 @@ Log_init (filename)
   }
   init_log = 1;
 
+#ifdef _OPENMP
+  if (init_errorlog_lock == 0)
+  {
+    omp_init_nest_lock (&errorlog_lock);
+    init_errorlog_lock = 1;
+  }
+#endif
+
   nerrors = 0;
   errorlog = (ErrorPtr) calloc (sizeof (error_dummy), NERROR_MAX);
 
@@ -197,6 +214,14 @@ Log_append (filename)
   }
   init_log = 1;
 
+#ifdef _OPENMP
+  if (init_errorlog_lock == 0)
+  {
+    omp_init_nest_lock (&errorlog_lock);
+    init_errorlog_lock = 1;
+  }
+#endif
+
   nerrors = 0;
   errorlog = (ErrorPtr) calloc (sizeof (error_dummy), NERROR_MAX);
 
@@ -584,12 +609,21 @@ sane_check (x)
  * The number for stopping  the program is controled by max_errors and can be altered, see
  * log_set_max_errors 
  *
+ * When sirocco is compiled with OpenMP, the error log is protected by a (nestable) lock,
+ * since error_count calls Error, which in turn calls error_count.
+ *
  **********************************************************/
 
 int
 error_count (char *format)
 {
   int n;
+
+#ifdef _OPENMP
+  if (init_errorlog_lock)
+    omp_set_nest_lock (&errorlog_lock);
+#endif
+
   n = 0;
   while (n < nerrors)
   {
@@ -624,6 +658,12 @@ error_count (char *format)
       Exit (0);
     }
   }
+
+#ifdef _OPENMP
+  if (init_errorlog_lock)
+    omp_unset_nest_lock (&errorlog_lock);
+#endif
+
   return (n + 1);
 }
 